@@ -0,0 +1,272 @@
+//
+//  KLinMatrix.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KLinMatrix_hpp
+#define KLinMatrix_hpp
+
+#include <string>
+#include <vector>
+#include "KMatrix.hpp"
+
+/*
+ Linear algebra matrix. Identical to KMatrix except that the '*' and '*=' operators
+ perform matrix multiplication instead of element-wise multiplication. Because the
+ multiplication mode is part of the type, it is resolved at compile time and
+ multiplying a KLinMatrix by a KMatrix (or KVector) will not compile. Convert
+ explicitly with KLinMatrix(km) or by copying into a KMatrix.
+ */
+template <class T>
+class KLinMatrix : public KMatrix<T> {
+
+public:
+
+    //Initializers
+    KLinMatrix();
+    KLinMatrix(int rows, int cols);
+    KLinMatrix(std::string init);
+    KLinMatrix(T** init, int rows, int cols);
+    KLinMatrix(T init, int rows, int cols);
+    KLinMatrix(std::vector<std::vector<T> > init);
+    KLinMatrix(const KLinMatrix<T>& init);
+    explicit KLinMatrix(const KMatrix<T>& init);
+
+    //Operators
+    using KMatrix<T>::operator*=;
+    KLinMatrix<T>& operator*=(const KLinMatrix<T>& rv);
+    KLinMatrix<T>& operator*=(const KMatrix<T>& rv) = delete; //Mixed-mode multiplication is ambiguous
+    KLinMatrix<T>& operator=(KLinMatrix rh);
+
+};
+
+template <class T>
+KLinMatrix<T> operator+(KLinMatrix<T> lv, const KLinMatrix<T>& rv);
+
+template <class T>
+KLinMatrix<T> operator-(KLinMatrix<T> lv, const KLinMatrix<T>& rv);
+
+template <class T>
+KLinMatrix<T> operator*(KLinMatrix<T> lv, const KLinMatrix<T>& rv);
+
+template <class T>
+KLinMatrix<T> operator/(KLinMatrix<T> lv, const KLinMatrix<T>& rv);
+
+template <class T>
+KLinMatrix<T> operator*(const KLinMatrix<T>& lv, const typename KMatrix<T>::value_type& rv);
+
+template <class T>
+KLinMatrix<T> operator*(const typename KMatrix<T>::value_type& lv, const KLinMatrix<T>& rv);
+
+template <class T>
+KLinMatrix<T> operator/(const KLinMatrix<T>& lv, const typename KMatrix<T>::value_type& rv);
+
+typedef KLinMatrix<double> KLinMat;
+
+/*----------------------------------------------------------------
+-------------------------- INITIALIZERS --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to no specific size or value (will be 0x0).
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(){
+
+}
+
+/*
+ Initializes the matrix to the specified size. Each element is populated with the type's defualt constructor
+
+ rows - number of rows
+ cols - number of columns per row
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(int rows, int cols) : KMatrix<T>(rows, cols){
+
+}
+
+/*
+ Initializes the matrix from a string. See KMatrix(std::string) for format.
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(std::string init) : KMatrix<T>(init){
+
+}
+
+/*
+ Initializes the matrix to the size 'rows'x'cols', populating each element with the value of 'init' at that cell.
+
+ init - array from which to fill each element
+ rows - number of rows in matrix
+ cols - number of columns in matrix
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(T** init, int rows, int cols) : KMatrix<T>(init, rows, cols){
+
+}
+
+/*
+ Initializes the matrix to the size 'rows'x'cols', populating each element with the value 'init'.
+
+ init - value with which to fill each element
+ rows - number of rows in matrix
+ cols - number of columns in matrix
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(T init, int rows, int cols) : KMatrix<T>(init, rows, cols){
+
+}
+
+/*
+ Populates a matrix from the 2D vector 'init'.
+
+ init - vector from which to initialize matrix
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(std::vector<std::vector<T> > init) : KMatrix<T>(init){
+
+}
+
+template <class T>
+KLinMatrix<T>::KLinMatrix(const KLinMatrix<T>& init) : KMatrix<T>(init){
+
+}
+
+/*
+ Converts an element-wise KMatrix into a KLinMatrix. Explicit so that switching
+ multiplication modes is always visible in the calling code.
+ */
+template <class T>
+KLinMatrix<T>::KLinMatrix(const KMatrix<T>& init) : KMatrix<T>(init){
+
+}
+
+//Operators
+
+/*
+ Multiplies the matrix by 'rv' using matrix multiplication (this = this * rv).
+ */
+template <class T>
+KLinMatrix<T>& KLinMatrix<T>::operator*=(const KLinMatrix<T>& rv){
+
+    KMatrix<T> out = matrixMult<T>(*this, rv);
+    swapMat<T>(*this, out);
+
+    return *this;
+}
+
+template <class T>
+KLinMatrix<T>& KLinMatrix<T>::operator=(KLinMatrix rh){
+    swapMat<T>(*this, rh);
+    return *this;
+}
+
+/*
+ Adds lv and rv.
+
+ lv - left matrix value
+ rv - right matrix value
+
+ Returns sum of lv and rv.
+ */
+template <class T>
+KLinMatrix<T> operator+(KLinMatrix<T> lv, const KLinMatrix<T>& rv){
+    lv += rv;
+    return lv;
+}
+
+/*
+ Subtracts rv from lv.
+
+ lv - left matrix
+ rv - matrix to subtract from left matrix
+
+ Returns (lv - rv)
+ */
+template <class T>
+KLinMatrix<T> operator-(KLinMatrix<T> lv, const KLinMatrix<T>& rv){
+    lv -= rv;
+    return lv;
+}
+
+/*
+ Multiplies lv and rv using matrix multiplication.
+
+ lv - left matrix value
+ rv - right matrix value
+
+ Returns matrix product of lv and rv.
+ */
+template <class T>
+KLinMatrix<T> operator*(KLinMatrix<T> lv, const KLinMatrix<T>& rv){
+    lv *= rv;
+    return lv;
+}
+
+/*
+ Divides lv by rv element-wise.
+
+ lv - left matrix value
+ rv - right matrix value
+
+ Returns (lv/rv).
+ */
+template <class T>
+KLinMatrix<T> operator/(KLinMatrix<T> lv, const KLinMatrix<T>& rv){
+    lv /= rv;
+    return lv;
+}
+
+/*
+ Scales a matrix by a scalar. (Scalar addition and subtraction use the KMatrix operators.)
+
+ lv - left value
+ rv - right value
+
+ Returns the scaled matrix
+ */
+template <class T>
+KLinMatrix<T> operator*(const KLinMatrix<T>& lv, const typename KMatrix<T>::value_type& rv){
+    KLinMatrix<T> out;
+    KMatrix<T> scaled = static_cast<const KMatrix<T>&>(lv) * rv;
+    swapMat<T>(out, scaled);
+    return out;
+}
+
+template <class T>
+KLinMatrix<T> operator*(const typename KMatrix<T>::value_type& lv, const KLinMatrix<T>& rv){
+    return rv * lv;
+}
+
+template <class T>
+KLinMatrix<T> operator/(const KLinMatrix<T>& lv, const typename KMatrix<T>::value_type& rv){
+    KLinMatrix<T> out;
+    KMatrix<T> scaled = static_cast<const KMatrix<T>&>(lv) / rv;
+    swapMat<T>(out, scaled);
+    return out;
+}
+
+#define KLINMATRIX_INSTANTIATE(EXTERN, T) \
+    EXTERN template class KLinMatrix<T>; \
+    EXTERN template KLinMatrix<T> operator+(KLinMatrix<T> lv, const KLinMatrix<T>& rv); \
+    EXTERN template KLinMatrix<T> operator-(KLinMatrix<T> lv, const KLinMatrix<T>& rv); \
+    EXTERN template KLinMatrix<T> operator*(KLinMatrix<T> lv, const KLinMatrix<T>& rv); \
+    EXTERN template KLinMatrix<T> operator/(KLinMatrix<T> lv, const KLinMatrix<T>& rv); \
+    EXTERN template KLinMatrix<T> operator*(const KLinMatrix<T>& lv, const T& rv); \
+    EXTERN template KLinMatrix<T> operator*(const T& lv, const KLinMatrix<T>& rv); \
+    EXTERN template KLinMatrix<T> operator/(const KLinMatrix<T>& lv, const T& rv);
+
+#ifndef KMATRIX_HEADER_ONLY
+KLINMATRIX_INSTANTIATE(extern, float)
+KLINMATRIX_INSTANTIATE(extern, double)
+KLINMATRIX_INSTANTIATE(extern, int)
+KLINMATRIX_INSTANTIATE(extern, std::complex<double>)
+KLINMATRIX_INSTANTIATE(extern, KHalf)
+KLINMATRIX_INSTANTIATE(extern, KBFloat16)
+#endif
+
+#endif /* KLinMatrix_hpp */
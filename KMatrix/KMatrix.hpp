@@ -9,25 +9,96 @@
 #ifndef KMatrix_hpp
 #define KMatrix_hpp
 
-#include <stdio.h>
+#include <algorithm>
 #include <string>
-#include <GiesbrechtCPP/string_manip.hpp>
-#include <iostream>
-#include <exception>
+#include <vector>
+#include <complex>
+#include <cstring>
+#include <typeinfo>
 #include <cmath>
+#include <type_traits>
 #include "KMatrixHelpers.hpp"
+#include "KMatrixAllocator.hpp"
+#include "KMatrixKernels.hpp"
+#include "KMatrixStorage.hpp"
+#include "KMatrixStats.hpp"
+#include "KMatrixHalf.hpp"
 
+template <class T>
+class KLinMatrix;
+
+/*
+ Derived values a KMatrix remembers between calls (see KMatrixCache).
+ */
+enum KMatrixCached {
+    KCACHE_MAX = 1,
+    KCACHE_MIN = 2,
+    KCACHE_AVG = 4,
+    KCACHE_STDEV = 8,
+    KCACHE_DETERMINANT = 16
+};
+
+/*
+ Values computed from a matrix's elements, kept until the matrix changes. An item is valid
+ while its bit is set in 'valid' and the matrix's version() still equals 'version'; storing
+ an item at a newer version drops the others.
+ */
+template <class T>
+struct KMatrixCache {
+    unsigned long long version = 0;
+    unsigned int valid = 0;
+    T max_val{};
+    T min_val{};
+    T avg_val{};
+    T stdev_val{};
+    double det_val = 0;
+
+    bool has(KMatrixCached item, unsigned long long ver) const;
+    void set(KMatrixCached item, unsigned long long ver);
+};
+
+/*
+ Element-wise matrix. The '*' and '*=' operators multiply element by element. For
+ linear algebra (matrix multiplication) semantics, use KLinMatrix (KLinMatrix.hpp).
+
+ Element-wise operators (+ - * / and comparisons) broadcast like NumPy: a dimension of 1
+ is stretched to match the other operand, so a 1 x n row is applied to every row, an
+ m x 1 column to every column, and a 1 x 1 matrix to every element. Any other mismatch
+ throws matrix_multiplication_exception.
+
+ Matrices are row-major unless made column-major with setLayout() or the layout
+ constructors. Every operation accepts either layout; element-wise results take the layout
+ of their left operand. getMat() returns the storage as-is, so each vector in it is a row
+ of a row-major matrix and a column of a column-major one.
+
+ Copies are deep unless copy-on-write is enabled with setCopyOnWrite(). Copies of a
+ copy-on-write matrix (including by-value arguments and results) then share its storage
+ until one of them is written through operator(), a compound operator, the non-const
+ getMat() or any other modifying function, which first gives it a private copy. See
+ KMatrixStorage for the details.
+
+ max(), min(), avg(), stdev() and determinant() remember their results until the matrix is
+ next modified, so repeated calls on an unchanged matrix return at once. Modification is
+ tracked by version(), which every non-const access advances. Values written through a
+ reference kept from an earlier operator() or getMat() call are not tracked; call getMat()
+ again (or any other non-const function) after such writes. Because the reductions update
+ the cache they must not be called on one matrix from several threads at once.
+ */
 template <class T>
 class KMatrix {
 public:
 
+    typedef T value_type;
+    typedef std::vector<T, KMatrixAllocator<T> > row_type;
+
     //Initializers
     KMatrix();
     KMatrix(int rows, int cols);
     KMatrix(std::string init);
     KMatrix(T** init, int rows, int cols);
     KMatrix(T init, int rows, int cols);
-    KMatrix(std::vector<std::vector<T> > init);
+    KMatrix(std::vector<std::vector<T> > init, KMatrixLayout layout=KMAT_ROW_MAJOR);
+    KMatrix(const T* data, int rows, int cols, KMatrixLayout layout);
     KMatrix(const KMatrix<T>& init);
     ~KMatrix();
 
@@ -36,12 +107,15 @@ public:
     void clear(int rows, int cols);
 
     friend void swap(KMatrix<T>& first, KMatrix<T>& second);
+    template <class U>
+    friend void swapMat(KMatrix<U>& first, KMatrix<U>& second);
     
     //Operators
     KMatrix<T>& operator+=(const KMatrix<T>& rv);
     KMatrix<T>& operator*=(const KMatrix<T>& rv);
     KMatrix<T>& operator-=(const KMatrix<T>& rv);
     KMatrix<T>& operator/=(const KMatrix<T>& rv);
+    KMatrix<T>& operator*=(const KLinMatrix<T>& rv) = delete; //Mixed-mode multiplication is ambiguous
     KMatrix<T>& operator+=(const T& rv);
     KMatrix<T>& operator*=(const T& rv);
     KMatrix<T>& operator-=(const T& rv);
@@ -49,7 +123,7 @@ public:
     KMatrix<T>& operator=(KMatrix rh);
     T& operator()(int r, int c);
     T get(int r, int c) const;
-    std::vector<T> get_rowv(size_t row);
+    std::vector<T> get_rowv(size_t row) const;
     bool operator=(std::string rv);
 //    bool operator=(Eigen::MatrixXd rv);
     bool operator=(std::vector<std::vector<double> > rv);
@@ -84,17 +158,44 @@ public:
     static KMatrix zero(int rc);
     static KMatrix constant(T val, int r, int c);
     static KMatrix range(T start, T step_size, T end, int rows=1);
+    static KMatrix identity(int n);
+    static KMatrix diag(const std::vector<T>& v);
+    static KMatrix linspace(T start, T end, int n, int rows=1);
+    static KMatrix random(int r, int c, unsigned long long seed=0);
+    static KMatrix randn(int r, int c, unsigned long long seed=0);
 //    static std::vector<std::vector<double> > KMatrix_to_vector(KMatrix km);
 
+    //Storage
+    void setAlignment(size_t bytes);
+    size_t alignment() const;
+    size_t ld() const;
+    void setLayout(KMatrixLayout layout);
+    KMatrixLayout layout() const;
+    void setMemoryPolicy(int policy);
+    int memoryPolicy() const;
+    KMatrixAllocator<T> allocator() const;
+    void setCopyOnWrite(bool enable);
+    bool copyOnWrite() const;
+    bool sharesStorage() const;
+    unsigned long long version() const;
+
     //Other
-    void setElementMultMode(bool em);
-    std::vector<std::vector<T> >& getMat();
-    bool& getElementMultMode();
+    std::vector<row_type>& getMat();
+    const std::vector<row_type>& getMat() const;
     
 protected:
 
-    std::vector<std::vector<T> > mat;
-    bool element_mult_mode = true;
+    row_type new_row(size_t cols) const;
+    row_type new_row(const std::vector<T>& vals) const;
+    void fill_rows(size_t rows, size_t cols, const T& val);
+    void reserve_lines(size_t lines, size_t len);
+
+    KMatrixStorage<row_type> mat;
+    size_t row_align = 0;
+    int mem_policy = KMEM_DEFAULT;
+    std::shared_ptr<KMatrixArena> arena;
+    KMatrixLayout mat_layout = KMAT_ROW_MAJOR;
+    KMatrixCache<T> cache;
     
     matrix_bounds_excep mat_bnd_ex;
     matrix_multiplication_exception mat_mult_ex;
@@ -112,11 +213,74 @@ KMatrix<T> operator*(KMatrix<T> lv, const KMatrix<T>& rv);
 template <class T>
 KMatrix<T> operator/(KMatrix<T> lv, const KMatrix<T>& rv);
 
+template <class T>
+KMatrix<T> operator*(const KMatrix<T>& lv, const KLinMatrix<T>& rv) = delete; //Mixed-mode multiplication is ambiguous
+
+template <class T>
+KMatrix<T> operator+(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv);
+
+template <class T>
+KMatrix<T> operator+(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<T> operator-(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv);
+
+template <class T>
+KMatrix<T> operator-(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<T> operator*(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv);
+
+template <class T>
+KMatrix<T> operator*(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<T> operator/(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv);
+
+template <class T>
+KMatrix<T> operator/(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv);
+
+template <class T>
+void axpby(const typename KMatrix<T>::value_type& alpha, const KMatrix<T>& x, const typename KMatrix<T>::value_type& beta, KMatrix<T>& y);
+
+template <class U, class T>
+KMatrix<U> kmatrix_convert(const KMatrix<T>& a);
+
+template <class U, class T>
+std::vector<U> kmatrix_dense(const KMatrix<T>& a);
+
+template <class T>
+KMatrix<int> operator==(const KMatrix<T>& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<int> operator!=(const KMatrix<T>& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<int> operator<(const KMatrix<T>& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<int> operator>(const KMatrix<T>& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<int> operator<=(const KMatrix<T>& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<int> operator>=(const KMatrix<T>& lv, const KMatrix<T>& rv);
+
+template <class T>
+KMatrix<T> operator*(const KLinMatrix<T>& lv, const KMatrix<T>& rv) = delete; //Mixed-mode multiplication is ambiguous
+
 typedef KMatrix<double> KMat;
 
 template <class T>
 KMatrix<T> matrixMult(const KMatrix<T>& a, const KMatrix<T>& b);
 
+template <class T>
+KMatrix<T> matrixMult(const KMatrix<T>& a, const KMatrix<T>& b, const KMultPolicy& policy);
+
+template <class T>
+KMatrix<T> strassenMult(const KMatrix<T>& a, const KMatrix<T>& b, size_t crossover=KMATRIX_STRASSEN_CROSSOVER);
+
 template <class T>
 KMatrix<T> elementMult(const KMatrix<T>& a, const KMatrix<T>& b);
 
@@ -181,8 +345,11 @@ KMatrix<T>::KMatrix(std::string init){
 //        std::cout << "Wrong data type bruv (" << typeid(T).name() << ")" << std::endl;
 //    }else{
 //        std::vector<std::vector<double> mat_temp;
-    if (!matrixFromString(init, mat)){
-        mat.clear();
+    std::vector<std::vector<T> > temp;
+    if (matrixFromString(init, temp)){
+        for (size_t r = 0 ; r < temp.size() ; r++){
+            mat.push_back(new_row(temp[r]));
+        }
     }
 //    }
 
@@ -205,7 +372,7 @@ KMatrix<T>::KMatrix(T** init, int rows, int cols){
         for (int i = 0 ; i < cols ; i++){
             temp[i] = init[r][i];
         }
-        mat.push_back(temp);
+        mat.push_back(new_row(temp));
     }
     
 }
@@ -219,39 +386,31 @@ KMatrix<T>::KMatrix(T** init, int rows, int cols){
  */
 template <class T>
 KMatrix<T>::KMatrix(T init, int rows, int cols){
-    
-    KMatrix<T>::clear();
-	
-	std::vector<T> temp;
-	temp.resize(cols);
-	for (int i = 0 ; i < cols ; i++){
-		temp[i] = init;
-	}
-	
-    for (int r = 0 ; r < rows ; r++){	
-        mat.push_back(temp);
-    }
-    
+    fill_rows(rows, cols, init);
 }
 
 /*
- Populates a matrix from the 2D vector 'init'.
+ Populates a matrix from the 2D vector 'init'. Short vectors are padded with the type's
+ default value.
  
- init - vector from which to initialize matrix
+ init - vector from which to initialize matrix. Each inner vector is a row, or a column if
+        'layout' is KMAT_COL_MAJOR (the matrix is then stored column-major, without a transpose).
+ layout - layout of 'init' and of the matrix
  */
 template <class T>
-KMatrix<T>::KMatrix(std::vector<std::vector<T> > init){
+KMatrix<T>::KMatrix(std::vector<std::vector<T> > init, KMatrixLayout layout){
 
-    //Determine maximum number of columns
-    size_t max_len = -1;
+    //Determine maximum length of the inner vectors
+    size_t max_len = 0;
     for (int r = 0 ; r < init.size() ; r++){
         if (init[r].size() > max_len){
             max_len = init[r].size();
         }
     }
     
-    //Resize matrix
-    clear(init.size(), max_len);
+    //Resize storage
+    mat_layout = layout;
+    fill_rows(init.size(), max_len, T());
     
     //Populate matrix
     for (int r = 0; r < init.size() ; r++){
@@ -263,22 +422,47 @@ KMatrix<T>::KMatrix(std::vector<std::vector<T> > init){
 }
 
 /*
+ Initializes the matrix from a contiguous array, without transposing it.
  
+ data - 'rows'*'cols' values, row after row if 'layout' is KMAT_ROW_MAJOR or column after
+        column if it is KMAT_COL_MAJOR
+ rows - number of rows
+ cols - number of columns
+ layout - order of 'data', which becomes the layout of the matrix
  */
 template <class T>
-KMatrix<T>::KMatrix(const KMatrix<T>& init){
-
-    //Resize matrix
-    clear(init.rows(), init.cols());
+KMatrix<T>::KMatrix(const T* data, int rows, int cols, KMatrixLayout layout){
     
-    element_mult_mode = init.element_mult_mode;
+    mat_layout = layout;
+    size_t lines = (layout == KMAT_COL_MAJOR) ? cols : rows;
+    size_t len = (layout == KMAT_COL_MAJOR) ? rows : cols;
     
-    //Populate matrix
-    for (int r = 0; r < init.rows() ; r++){
-        for (int c = 0 ; c < init.cols() ; c++){
-            mat[r][c] = init.get(r, c);
+    std::vector<row_type>& m = mat.write();
+    m.resize(lines);
+    auto fill = [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++){
+            m[i] = row_type(data + i*len, data + (i+1)*len, allocator());
         }
+    };
+    
+    if (lines*len < KMATRIX_ELEMENTWISE_PARALLEL){
+        fill(0, lines);
+    }else{
+        KThreadPool::global().parallel_for(0, lines, fill);
     }
+}
+
+/*
+ Copies 'init', keeping its alignment, layout, copy-on-write mode and cached values. If
+ 'init' is copy-on-write the storage is shared rather than copied.
+ */
+template <class T>
+KMatrix<T>::KMatrix(const KMatrix<T>& init) : mat(init.mat), cache(init.cache){
+
+    row_align = init.row_align;
+    mem_policy = init.mem_policy;
+    arena = init.arena;
+    mat_layout = init.mat_layout;
     
 }
 
@@ -296,7 +480,7 @@ void KMatrix<T>::clear(){
 }
 
 /*
- Clears the matrix, and resizes the matrix to 'rows' x 'cols'. Each element is populated by the type's default constructor.
+ Clears the matrix, and resizes the matrix to 'rows' x 'cols'. Each element is populated by the type's default constructor. The layout is kept.
 
  rows - number of rows
  cols - number of columns per row
@@ -305,135 +489,336 @@ void KMatrix<T>::clear(){
  */
 template <class T>
 void KMatrix<T>::clear(int rows, int cols){
-
-    KMatrix<T>::clear();
-    for (int r = 0 ; r < rows ; r++){
-        std::vector<T> temp;
-        temp.resize(cols);
-        mat.push_back(temp);
+    if (mat_layout == KMAT_COL_MAJOR){
+        fill_rows(cols, rows, T());
+    }else{
+        fill_rows(rows, cols, T());
     }
 }
 
 template <class T>
 void swapMat(KMatrix<T>& first, KMatrix<T>& second){ //friend
-    std::swap(first.getMat(), second.getMat());
-    std::swap(first.getElementMultMode(), second.getElementMultMode());
+    first.mat.swap(second.mat); //Each keeps its own copy-on-write mode
+    std::swap(first.row_align, second.row_align);
+    std::swap(first.mem_policy, second.mem_policy);
+    std::swap(first.arena, second.arena);
+    std::swap(first.mat_layout, second.mat_layout);
+    std::swap(first.cache, second.cache);
 }
 
-//Operators
+//Broadcasting
 
-template <class T>
-KMatrix<T>& KMatrix<T>::operator+=(const KMatrix<T>& rv){
-    
-    int row_max = (rv.rows() > this->rows())? (int)rv.rows() : (int)this->rows();
-    int col_max = (rv.cols() > this->cols())? (int)rv.cols() : (int)this->cols();
-    
-    KMatrix out = zero(row_max, col_max);
-    
-    //Add origional matrix components
-    for (int r = 0 ; r < this->rows() ; r++){
-        for (int c = 0 ; c < this->cols() ; c++){
-            out(r, c) = this->operator()(r, c);
+/*
+ Determines the shape of an element-wise operation on 'a' and 'b'. Each dimension must be
+ equal or 1 in one of the operands (a 1 is stretched to the other's size). Throws
+ matrix_multiplication_exception otherwise.
+
+ a, b - operands
+ rows, cols - set to the result's dimensions
+
+ Void return
+ */
+template <class T, class U>
+void kmatrix_broadcast_shape(const KMatrix<T>& a, const KMatrix<U>& b, size_t& rows, size_t& cols){
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    auto dim = [&](size_t x, size_t y){
+        if (x == y || y == 1) return x;
+        if (x == 1) return y;
+        throw mat_mult_ex;
+    };
+
+    rows = dim(a.rows(), b.rows());
+    cols = dim(a.cols(), b.cols());
+}
+
+/*
+ Sets out(r, c) = op(a(r, c), b(r, c)) with broadcasting. A stretched dimension is read
+ with a stride of zero, so neither operand is ever expanded in memory. 'out' must already
+ have the result's shape, and may be 'a' or 'b' only if that operand is not stretched.
+ The loops run over the storage of 'out'; an operand in the other layout is first copied
+ into out's layout (the rule is the same for rows and columns, so it applies to storage
+ lines either way).
+
+ a, b - operands
+ out - result
+ op - callable taking (const T&, const T&)
+
+ Void return
+ */
+template <class T, class U, class Op>
+void kmatrix_broadcast_apply(const KMatrix<T>& a, const KMatrix<T>& b, KMatrix<U>& out, Op op){
+
+    if (a.layout() != out.layout()){
+        KMatrix<T> ac(a);
+        ac.setLayout(out.layout());
+        kmatrix_broadcast_apply(ac, b, out, op);
+        return;
+    }
+    if (b.layout() != out.layout()){
+        KMatrix<T> bc(b);
+        bc.setLayout(out.layout());
+        kmatrix_broadcast_apply(a, bc, out, op);
+        return;
+    }
+
+    const std::vector<typename KMatrix<T>::row_type>& am = a.getMat();
+    const std::vector<typename KMatrix<T>::row_type>& bm = b.getMat();
+    std::vector<typename KMatrix<U>::row_type>& om = out.getMat();
+
+    //Storage dimensions (rows of row-major matrices, columns of column-major ones)
+    size_t nr = om.size(), nc = (nr > 0) ? om[0].size() : 0;
+    if (nr == 0 || nc == 0) return;
+
+    bool ra = am.size() != 1, rb = bm.size() != 1;
+    bool sa = am[0].size() != 1, sb = bm[0].size() != 1;
+
+    auto rows = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            const T* x = am[ra ? r : 0].data();
+            const T* y = bm[rb ? r : 0].data();
+            U* o = om[r].data();
+
+            //Separate loops so the common cases vectorize
+            if (sa && sb){
+                for (size_t c = 0 ; c < nc ; c++) o[c] = op(x[c], y[c]);
+            }else if (sa){
+                const T y0 = y[0];
+                for (size_t c = 0 ; c < nc ; c++) o[c] = op(x[c], y0);
+            }else if (sb){
+                const T x0 = x[0];
+                for (size_t c = 0 ; c < nc ; c++) o[c] = op(x0, y[c]);
+            }else{
+                const U v = op(x[0], y[0]);
+                for (size_t c = 0 ; c < nc ; c++) o[c] = v;
+            }
         }
+    };
+
+    if (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL){
+        rows(0, nr);
+    }else{
+        KThreadPool::global().parallel_for(0, nr, rows);
     }
-    
-    //Add rv matrix components
-    for (int r = 0 ; r < rv.rows() ; r++){
-        for (int c = 0 ; c < rv.cols() ; c++){
-            out(r, c) += rv.get(r, c);
+}
+
+/*
+ Computes op(a, b) with broadcasting into a new matrix with a's alignment and layout. The
+ call is counted against 'stat' when instrumentation is enabled.
+
+ Returns the result
+ */
+template <class U, class T, class Op>
+KMatrix<U> kmatrix_broadcast(const KMatrix<T>& a, const KMatrix<T>& b, Op op, KMatrixOp stat = KOP_ELEMENTWISE){
+
+    size_t nr, nc;
+    kmatrix_broadcast_shape(a, b, nr, nc);
+    KMATRIX_STAT_SCOPE(stat, nr*nc, nr*nc*sizeof(U));
+    (void)stat; //Unused when instrumentation is compiled out
+
+    KMatrix<U> out;
+    out.setAlignment(a.alignment());
+    out.setMemoryPolicy(a.memoryPolicy());
+    out.setLayout(a.layout());
+    out.clear((int)nr, (int)nc);
+    kmatrix_broadcast_apply(a, b, out, op);
+
+    return out;
+}
+
+/*
+ Replaces 'a' with op(a, b), broadcasting. Works in place unless 'a' itself has to be
+ stretched. The call is counted against 'stat' when instrumentation is enabled.
+
+ Void return
+ */
+template <class T, class Op>
+void kmatrix_broadcast_assign(KMatrix<T>& a, const KMatrix<T>& b, Op op, KMatrixOp stat = KOP_ELEMENTWISE){
+
+    size_t nr, nc;
+    kmatrix_broadcast_shape(a, b, nr, nc);
+
+    if (nr == a.rows() && nc == a.cols()){
+        KMATRIX_STAT_SCOPE(stat, nr*nc, 0);
+        kmatrix_broadcast_apply(a, b, a, op);
+        return;
+    }
+
+    KMatrix<T> out = kmatrix_broadcast<T>(a, b, op, stat);
+    swapMat(a, out);
+}
+
+//Scalar operations
+
+/*
+ Replaces every element x of 'a' with op(x). Rows are split across the thread pool for
+ large matrices; the inner loop is a plain unit-stride loop so it vectorizes. Counted as
+ a scalar operation when instrumentation is enabled.
+
+ Void return
+ */
+template <class T, class Op>
+void kmatrix_apply(KMatrix<T>& a, Op op){
+
+    std::vector<typename KMatrix<T>::row_type>& am = a.getMat();
+    size_t nr = am.size(), nc = (nr > 0) ? am[0].size() : 0;
+    KMATRIX_STAT_SCOPE(KOP_SCALAR, nr*nc, 0);
+
+    auto rows = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            T* x = am[r].data();
+            for (size_t c = 0 ; c < nc ; c++) x[c] = op(x[c]);
+        }
+    };
+
+    if (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL){
+        rows(0, nr);
+    }else{
+        KThreadPool::global().parallel_for(0, nr, rows);
+    }
+}
+
+/*
+ Returns a new matrix (with a's alignment and layout) holding op(x) for every element x of
+ 'a'. Each row is copied and transformed while it is still in cache, so the source is read
+ once.
+ Counted as a scalar operation when instrumentation is enabled.
+ */
+template <class T, class Op>
+KMatrix<T> kmatrix_map(const KMatrix<T>& a, Op op){
+
+    const std::vector<typename KMatrix<T>::row_type>& am = a.getMat();
+    size_t nr = am.size(), nc = (nr > 0) ? am[0].size() : 0;
+    KMATRIX_STAT_SCOPE(KOP_SCALAR, nr*nc, nr*nc*sizeof(T));
+
+    //One empty storage line per row (or column) of 'a', filled below
+    KMatrix<T> out;
+    out.setAlignment(a.alignment());
+    out.setMemoryPolicy(a.memoryPolicy());
+    out.setLayout(a.layout());
+    if (a.layout() == KMAT_COL_MAJOR){
+        out.clear(0, (int)nr);
+    }else{
+        out.clear((int)nr, 0);
+    }
+
+    std::vector<typename KMatrix<T>::row_type>& om = out.getMat();
+
+    auto rows = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            om[r].assign(am[r].begin(), am[r].end());
+            T* x = om[r].data();
+            for (size_t c = 0 ; c < nc ; c++) x[c] = op(x[c]);
         }
+    };
+
+    if (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL){
+        rows(0, nr);
+    }else{
+        KThreadPool::global().parallel_for(0, nr, rows);
     }
 
-//    *this = out;
-    swapMat(*this, out);
-    
+    return out;
+}
+
+//Operators
+
+/*
+ Adds 'rv' element-wise, broadcasting either operand.
+ */
+template <class T>
+KMatrix<T>& KMatrix<T>::operator+=(const KMatrix<T>& rv){
+
+    kmatrix_broadcast_assign(*this, rv, [](const T& x, const T& y){ return x + y; });
+
     return *this;
 }
 
+/*
+ Multiplies the matrix element-wise by 'rv', broadcasting either operand. Matrix
+ multiplication is provided by KLinMatrix, so the choice is made by the type at compile time.
+ */
 template <class T>
 KMatrix<T>& KMatrix<T>::operator*=(const KMatrix<T>& rv){
 
-    if (element_mult_mode){ //Perform element-wise multiplication
-        *this = elementMult(*this, rv);
-        std::cout << "EM" << std::endl;
-    }else{ //Perform matrix multiplication
-        *this = matrixMult((*this), rv);
-        std::cout << "MM" << std::endl;
-    }
-    
+    kmatrix_broadcast_assign(*this, rv, [](const T& x, const T& y){ return x * y; }, KOP_ELEMENT_MULT);
+
     return *this;
 }
 
+/*
+ Subtracts 'rv' element-wise, broadcasting either operand.
+ */
 template <class T>
 KMatrix<T>& KMatrix<T>::operator-=(const KMatrix<T>& rv){
-    
-    int row_max = (rv.rows() > this->rows())? (int)rv.rows() : (int)this->rows();
-    int col_max = (rv.cols() > this->cols())? (int)rv.cols() : (int)this->cols();
-    
-    KMatrix out = zero(row_max, col_max);
-    
-    //Add origional matrix components
-    for (int r = 0 ; r < this->rows() ; r++){
-        for (int c = 0 ; c < this->cols() ; c++){
-            out(r, c) = this->operator()(r, c);
-        }
-    }
-    
-    //Add rv matrix components
-    for (int r = 0 ; r < rv.rows() ; r++){
-        for (int c = 0 ; c < rv.cols() ; c++){
-            out(r, c) -= rv.get(r, c);
-        }
-    }
-    
-    //    *this = out;
-    swapMat(*this, out);
-    
+
+    kmatrix_broadcast_assign(*this, rv, [](const T& x, const T& y){ return x - y; });
+
     return *this;
-    
 }
 
+/*
+ Divides element-wise by 'rv', broadcasting either operand.
+ */
 template <class T>
 KMatrix<T>& KMatrix<T>::operator/=(const KMatrix<T>& rv){
-    
-    //Check that the matricies' dimensions match
-    if (this->rows() != rv.rows() || this->cols() != rv.cols()){
-        throw mat_mult_ex;
-    }
-    
-    //Iterate through each element, calculate result
-    T sum;
-    for (unsigned int r = 0 ; r < this->rows() ; r++){
-        for (unsigned int c = 0 ; c < this->rows() ; c++){
-            
-            //Calculate product
-            this->operator()(r, c) /= rv.get(r, c);
-            
-        }
-    }
-    
+
+    kmatrix_broadcast_assign(*this, rv, [](const T& x, const T& y){ return x / y; });
+
     return *this;
 }
 
-//template <class T>
-//KMatrix<T>& KMatrix<T>::operator+=(const double& rv){
-//
-//}
+/*
+ Adds 'rv' to every element.
+ */
+template <class T>
+KMatrix<T>& KMatrix<T>::operator+=(const T& rv){
 
-//template <class T>
-//KMatrix<T>& KMatrix<T>::operator*=(const double& rv){
-//
-//}
+    kmatrix_apply(*this, [rv](const T& x){ return x + rv; });
 
-//template <class T>
-//KMatrix<T>& KMatrix<T>::operator-=(const double& rv){
-//
-//}
+    return *this;
+}
 
-//template <class T>
-//KMatrix<T>& KMatrix<T>::operator/=(const double& rv){
-//
-//}
+/*
+ Multiplies every element by 'rv'.
+ */
+template <class T>
+KMatrix<T>& KMatrix<T>::operator*=(const T& rv){
+
+    kmatrix_apply(*this, [rv](const T& x){ return x * rv; });
+
+    return *this;
+}
+
+/*
+ Subtracts 'rv' from every element.
+ */
+template <class T>
+KMatrix<T>& KMatrix<T>::operator-=(const T& rv){
+
+    kmatrix_apply(*this, [rv](const T& x){ return x - rv; });
+
+    return *this;
+}
+
+/*
+ Divides every element by 'rv'. Floating point and complex types multiply by the reciprocal
+ instead, which is much faster but may differ from true division in the last bit. Integer
+ and reduced-precision types (whose rounded reciprocal would cost a bit) divide.
+ */
+template <class T>
+KMatrix<T>& KMatrix<T>::operator/=(const T& rv){
+
+    if (std::is_integral<T>::value || !std::is_same<typename kmatrix_accum<T>::type, T>::value){
+        kmatrix_apply(*this, [rv](const T& x){ return x / rv; });
+    }else{
+        const T inv = T(1)/rv;
+        kmatrix_apply(*this, [inv](const T& x){ return x * inv; });
+    }
+
+    return *this;
+}
 
 template <class T>
 KMatrix<T>& KMatrix<T>::operator=(KMatrix rh){
@@ -448,50 +833,102 @@ T& KMatrix<T>::operator()(int r, int c){
         throw mat_bnd_ex;
     }
     
+    if (mat_layout == KMAT_COL_MAJOR){
+        return KMatrix<T>::mat[c][r];
+    }
     return KMatrix<T>::mat[r][c];
 }
 
 template <class T>
 T KMatrix<T>::get(int r, int c) const{
+    if (mat_layout == KMAT_COL_MAJOR){
+        return KMatrix<T>::mat[c][r];
+    }
     return KMatrix<T>::mat[r][c];
 }
 
 template <class T>
-std::vector<T> KMatrix<T>::get_rowv(size_t row){
+std::vector<T> KMatrix<T>::get_rowv(size_t row) const{
     
     //Check bounds, throw error if violated
-    if (row >= mat.size()){
+    if (row >= rows()){
         throw mat_bnd_ex;
     }
     
+    //Gather the row from each column
+    if (mat_layout == KMAT_COL_MAJOR){
+        std::vector<T> out(mat.size());
+        for (size_t c = 0 ; c < mat.size() ; c++){
+            out[c] = mat[c][row];
+        }
+        return out;
+    }
+    
     //Return row
-    return mat[row];
+    return std::vector<T>(mat[row].begin(), mat[row].end());
 }
 
+/*
+ Sets the matrix from a string. See KMatrix(std::string) for the format.
+ 
+ Returns true if the string was read successfully. If unsuccessful, the matrix is not altered.
+ */
 template <class T>
 bool KMatrix<T>::operator=(std::string rv){
-
-}
+    
+    std::vector<std::vector<T> > temp;
+    if (!matrixFromString(rv, temp)){
+        return false;
+    }
+    
+    KMatrix<T> out(temp);
+    swapMat(*this, out);
+    
+    return true;
+}
 
 //template <class T>
 //bool KMatrix<T>::operator=(Eigen::MatrixXd rv){
 //
 //}
 
+/*
+ Sets the matrix from a 2D vector of doubles, converting each value to the matrix's type.
+ 
+ Returns true
+ */
 template <class T>
 bool KMatrix<T>::operator=(std::vector<std::vector<double> > rv){
-
+    
+    std::vector<std::vector<T> > temp;
+    for (size_t r = 0 ; r < rv.size() ; r++){
+        temp.push_back(std::vector<T>(rv[r].begin(), rv[r].end()));
+    }
+    
+    KMatrix<T> out(temp);
+    swapMat(*this, out);
+    
+    return true;
 }
 
 //
 template <class T>
 size_t KMatrix<T>::rows() const{
+    
+    if (mat_layout == KMAT_COL_MAJOR){
+        return (mat.size() < 1) ? 0 : mat[0].size();
+    }
+    
     return mat.size();
 }
 
 template <class T>
 size_t KMatrix<T>::cols() const{
     
+    if (mat_layout == KMAT_COL_MAJOR){
+        return mat.size();
+    }
+    
     if (mat.size() < 1) return 0;
     
     return mat[0].size();
@@ -522,6 +959,8 @@ size_t KMatrix<T>::cols() const{
 template <class T>
 std::string KMatrix<T>::to_string(std::string options){
 
+    KMATRIX_STAT_SCOPE(KOP_TO_STRING, 0, 0);
+
     bool use_brackets = false; //flag = [ || ]
     bool use_pipe = false; //flag = | (pipe, not l or 1)
     bool one_line = true; //flag = o (multiline = m)
@@ -558,7 +997,7 @@ std::string KMatrix<T>::to_string(std::string options){
     
     std::string out;
     
-    for (int r = 0 ; r < KMatrix<T>::mat.size() ; r++){
+    for (int r = 0 ; r < rows() ; r++){
         
         //Add beginning of line character if output uses multiple lines
         if (!one_line){
@@ -570,27 +1009,29 @@ std::string KMatrix<T>::to_string(std::string options){
         }
         
         //Loop through each element of the row...
-        for (int c = 0 ; c < KMatrix<T>::mat[r].size() ; c++){
+        for (int c = 0 ; c < cols() ; c++){
             
-            if (strcmp(typeid(T).name(), "d") == 0 || strcmp(typeid(T).name(), "i") == 0 || strcmp(typeid(T).name(), "l") == 0 || strcmp(typeid(T).name(), "x") == 0 || strcmp(typeid(T).name(), "j") == 0 || strcmp(typeid(T).name(), "m") == 0 || strcmp(typeid(T).name(), "y") == 0 || strcmp(typeid(T).name(), "f") == 0 || strcmp(typeid(T).name(), "e") == 0 || strcmp(typeid(T).name(), "c") == 0 ){ //Values for which std::to_string() are defined
-                out = out + limited_template_to_string(KMatrix<T>::mat[r][c]); //Add next element
+            if (strcmp(typeid(T).name(), "d") == 0 || strcmp(typeid(T).name(), "i") == 0 || strcmp(typeid(T).name(), "l") == 0 || strcmp(typeid(T).name(), "x") == 0 || strcmp(typeid(T).name(), "j") == 0 || strcmp(typeid(T).name(), "m") == 0 || strcmp(typeid(T).name(), "y") == 0 || strcmp(typeid(T).name(), "f") == 0 || strcmp(typeid(T).name(), "e") == 0 || strcmp(typeid(T).name(), "c") == 0 || !std::is_same<typename kmatrix_accum<T>::type, T>::value){ //Values for which std::to_string() are defined (and 16-bit floats)
+                out = out + limited_template_to_string(get(r, c)); //Add next element
 //            }else if(strcmp(typeid(T).name(), "b") == 0){ //Bools
 //                out = out + bool_to_str(KMatrix<T>::mat[r][c], bool_uppercase); //Add next element
 //            }else if(strcmp(typeid(T).name(), "c") == 0){ //Chars
 //                out = out + std::to_string((int)(KMatrix<T>::mat[r][c])); //Add next element
+            }else if(typeid(T) == typeid(std::complex<double>)){
+                out = out + limited_template_to_string(get(r, c));
             }else if(strcmp(typeid(T).name(), "b") == 0 ){
                 if (bool_uppercase){
-                    out = out + to_uppercase(limited_template_to_string(KMatrix<T>::mat[r][c]));
+                    out = out + kmatrix_to_uppercase(limited_template_to_string(get(r, c)));
                 }else{
-                    out = out + limited_template_to_string(KMatrix<T>::mat[r][c]);
+                    out = out + limited_template_to_string(get(r, c));
                 }
             }else if(typeid(T) == typeid(std::string)){
                 if (quote_strings){
-                    out = out + '"' + limited_template_to_string(KMatrix<T>::mat[r][c]) +'"';
+                    out = out + '"' + limited_template_to_string(get(r, c)) +'"';
                 }else if (quote_strings){
-                    out = out + '\'' + limited_template_to_string(KMatrix<T>::mat[r][c]) +'\'';
+                    out = out + '\'' + limited_template_to_string(get(r, c)) +'\'';
                 }else{
-                    out = out + limited_template_to_string(KMatrix<T>::mat[r][c]);
+                    out = out + limited_template_to_string(get(r, c));
                 }
             }else{
                 out = out + "?";
@@ -598,7 +1039,7 @@ std::string KMatrix<T>::to_string(std::string options){
             
 //            out = out + limited_template_to_string(mat[r][c]); //Add next element
 
-            if (c+1 != KMatrix<T>::mat[r].size()){ //If not at end of row, add comma
+            if (c+1 != cols()){ //If not at end of row, add comma
                 out = out + ", ";
             }
         }
@@ -611,7 +1052,7 @@ std::string KMatrix<T>::to_string(std::string options){
                 out = out + " |";
             }
             out = out + '\n';
-        }else if(r+1 < mat.size()){
+        }else if(r+1 < rows()){
             out = out + " ; ";
         }
         
@@ -625,6 +1066,7 @@ std::string KMatrix<T>::to_string(std::string options){
             out = "| " + out + " |";
         }
     }
+    KMATRIX_STAT_ADD(0, out.size());
     
     return out;
 }
@@ -637,24 +1079,33 @@ std::string KMatrix<T>::to_string(std::string options){
 template <class T>
 T KMatrix<T>::max(){
     
+    if (cache.has(KCACHE_MAX, mat.version())) return cache.max_val;
+    
+    KMATRIX_STAT_SCOPE(KOP_MAX, rows()*cols(), 0);
+    
+    const std::vector<row_type>& m = mat.read(); //Reading never copies shared storage
+    
     T max_val{};
     
     //Ensure matrix has 1 or more cells
     if (rows() > 0 && cols() > 0){
-        max_val = mat[0][0];
+        max_val = m[0][0];
     }else{
         return max_val; //Else return max_val unaltered
     }
     
-    //Scan for greatesst value
-    for (int r = 0 ; r < rows() ; r++){
-        for (int c = 0 ; c < cols() ; c++){
-            if (mat[r][c] > max_val){
-                max_val = mat[r][c];
+    //Scan for greatesst value (in storage order, which is rows or columns depending on layout)
+    for (size_t r = 0 ; r < m.size() ; r++){
+        for (size_t c = 0 ; c < m[r].size() ; c++){
+            if (kmatrix_greater(m[r][c], max_val)){
+                max_val = m[r][c];
             }
         }
     }
     
+    cache.max_val = max_val;
+    cache.set(KCACHE_MAX, mat.version());
+    
     return max_val;
 }
 
@@ -665,24 +1116,34 @@ T KMatrix<T>::max(){
  */
 template <class T>
 T KMatrix<T>::min(){
+    
+    if (cache.has(KCACHE_MIN, mat.version())) return cache.min_val;
+    
+    KMATRIX_STAT_SCOPE(KOP_MIN, rows()*cols(), 0);
+    
+    const std::vector<row_type>& m = mat.read();
+    
     T min_val{};
     
     //Ensure matrix has 1 or more cells
     if (rows() > 0 && cols() > 0){
-        min_val = mat[0][0];
+        min_val = m[0][0];
     }else{
         return min_val; //Else return max_val unaltered
     }
     
-    //Scan for lowest value
-    for (int r = 0 ; r < rows() ; r++){
-        for (int c = 0 ; c < cols() ; c++){
-            if (mat[r][c] < min_val){
-                min_val = mat[r][c];
+    //Scan for lowest value (in storage order)
+    for (size_t r = 0 ; r < m.size() ; r++){
+        for (size_t c = 0 ; c < m[r].size() ; c++){
+            if (kmatrix_greater(min_val, m[r][c])){
+                min_val = m[r][c];
             }
         }
     }
     
+    cache.min_val = min_val;
+    cache.set(KCACHE_MIN, mat.version());
+    
     return min_val;
 }
 
@@ -698,40 +1159,63 @@ T KMatrix<T>::range(){
 
 /*
  Calculates the average value (arithmetic mean) of all the values contained in the matrix. (NOTE: This function may not work for all data types).
+ The sum is accumulated in kmatrix_accum<T>::type (float for KHalf and KBFloat16).
  */
 template <class T>
 T KMatrix<T>::avg(){
     
-    T sum = 0;
-    for (size_t r = 0 ; r < rows() ; r++){
-        for (size_t c = 0 ; c < cols() ; c++){
-            sum += get(r, c);
+    if (cache.has(KCACHE_AVG, mat.version())) return cache.avg_val;
+    
+    KMATRIX_STAT_SCOPE(KOP_AVG, rows()*cols(), 0);
+    
+    const std::vector<row_type>& m = mat.read();
+    
+    typedef typename kmatrix_accum<T>::type accum_type;
+    
+    accum_type sum = accum_type(0);
+    for (size_t r = 0 ; r < m.size() ; r++){
+        for (size_t c = 0 ; c < m[r].size() ; c++){
+            sum += accum_type(m[r][c]);
         }
     }
     
-    return sum/rows()/cols();
+    cache.avg_val = T(sum/((accum_type)(rows()*cols())));
+    cache.set(KCACHE_AVG, mat.version());
     
+    return cache.avg_val;
 }
 
 /*
- Calculates the standard deviation of the values in the matrix.
+ Calculates the standard deviation of the values in the matrix, accumulated in
+ kmatrix_accum<T>::type.
  
  Returns the standard deviation of the values in the matrix.
  */
 template <class T>
 T KMatrix<T>::stdev(){
     
-    T average = this->avg();
+    if (cache.has(KCACHE_STDEV, mat.version())) return cache.stdev_val;
+    
+    KMATRIX_STAT_SCOPE(KOP_STDEV, 3*rows()*cols(), 0);
+    
+    const std::vector<row_type>& m = mat.read();
+    
+    typedef typename kmatrix_accum<T>::type accum_type;
     
-    T sum = 0;
-    for (size_t r = 0 ; r < rows() ; r++){
-        for (size_t c = 0 ; c < cols() ; c++){
-            sum += (get(r, c)-average)*(get(r, c)-average);
+    accum_type average = accum_type(this->avg());
+    
+    accum_type sum = accum_type(0);
+    for (size_t r = 0 ; r < m.size() ; r++){
+        for (size_t c = 0 ; c < m[r].size() ; c++){
+            accum_type d = accum_type(m[r][c]) - average;
+            sum += d*d;
         }
     }
     
-    return sqrt(sum/rows()/cols());
+    cache.stdev_val = T(std::sqrt(sum/((accum_type)(rows()*cols()))));
+    cache.set(KCACHE_STDEV, mat.version());
     
+    return cache.stdev_val;
 }
 
 //Arithmetic Functions
@@ -746,9 +1230,19 @@ T KMatrix<T>::stdev(){
 //
 //}
 
+/*
+ Returns the transpose of the matrix. The transpose of a row-major matrix has the same
+ storage as a column-major matrix (and vice versa), so the storage is copied as-is and the
+ result has the opposite layout. Call setLayout() on the result if a particular layout is
+ needed.
+ */
 template <class T>
 KMatrix<T> KMatrix<T>::transpose(){
 
+    KMatrix<T> out(*this);
+    out.mat_layout = (mat_layout == KMAT_COL_MAJOR) ? KMAT_ROW_MAJOR : KMAT_COL_MAJOR;
+
+    return out;
 }
 
 template <class T>
@@ -761,14 +1255,66 @@ KMatrix<T> KMatrix<T>::adjoint(){ //Conjugate transpose
 
 }
 
+/*
+ Returns the inverse of the matrix, from an LU factorization with partial pivoting computed
+ in kmatrix_solve<T>::type (double for integer matrices, whose inverse is then truncated).
+ The result has the matrix's layout and alignment. Throws matrix_multiplication_exception if
+ the matrix is not square and matrix_factorization_exception if it is singular (see
+ is_invertable()). To keep an inverse current while the matrix changes, see KInverse.
+ */
 template <class T>
 KMatrix<T> KMatrix<T>::inverse(){
-
+    
+    typedef typename kmatrix_solve<T>::type W;
+    
+    if (rows() != cols()){
+        throw mat_mult_ex;
+    }
+    
+    size_t n = rows();
+    KMATRIX_STAT_SCOPE(KOP_INVERSE, kmatrix_lu_work(n, 0, n) + kmatrix_lu_solve_work(n, n), 0);
+    
+    std::vector<W> lu = kmatrix_dense<W>(*this);
+    std::vector<size_t> piv(n);
+    if (kmatrix_lu(lu.data(), n, piv.data(), kmatrix_lu_tolerance(lu.data(), n)) < n){
+        throw matrix_factorization_exception();
+    }
+    
+    std::vector<W> x(n*n, W(0));
+    for (size_t i = 0 ; i < n ; i++) x[i*n + i] = W(1);
+    kmatrix_lu_solve(lu.data(), piv.data(), n, x.data(), n, n);
+    
+    KMatrix<T> out;
+    out.setAlignment(row_align);
+    out.setMemoryPolicy(mem_policy);
+    out.clear((int)n, (int)n);
+    std::vector<row_type>& om = out.getMat();
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c < n ; c++){
+            om[r][c] = T(x[r*n + c]);
+        }
+    }
+    out.setLayout(mat_layout);
+    
+    return out;
 }
 
+/*
+ Returns true if the matrix is square and its LU factorization has no pivot smaller than
+ n*epsilon times its largest element, ie. it is not singular to working precision.
+ */
 template <class T>
 bool KMatrix<T>::is_invertable(){
-
+    
+    typedef typename kmatrix_solve<T>::type W;
+    
+    if (rows() != cols()) return false;
+    
+    size_t n = rows();
+    std::vector<W> lu = kmatrix_dense<W>(*this);
+    std::vector<size_t> piv(n);
+    
+    return kmatrix_lu(lu.data(), n, piv.data(), kmatrix_lu_tolerance(lu.data(), n)) == n;
 }
 
 template <class T>
@@ -776,9 +1322,45 @@ KMatrix<T> KMatrix<T>::pseudoinverse(){ //Moore-penrose //DO THIS
 
 }
 
+/*
+ Returns the determinant, the product of the pivots of an LU factorization with partial
+ pivoting (computed in kmatrix_solve<T>::type). It is 0 only if a pivot is exactly zero; a
+ nearly singular matrix has a small determinant instead. Throws
+ matrix_multiplication_exception if the matrix is not square, and matrix_domain_exception
+ for a complex matrix, whose determinant a double cannot hold (use KLU::determinant()).
+ */
 template <class T>
 double KMatrix<T>::determinant(){
-
+    
+    typedef typename kmatrix_solve<T>::type W;
+    
+    if (rows() != cols()){
+        throw mat_mult_ex;
+    }
+    if (!std::is_same<typename kmatrix_real<T>::type, T>::value){
+        throw matrix_domain_exception();
+    }
+    if (cache.has(KCACHE_DETERMINANT, mat.version())) return cache.det_val;
+    
+    size_t n = rows();
+    KMATRIX_STAT_SCOPE(KOP_DETERMINANT, kmatrix_lu_work(n, 0, n), 0);
+    
+    std::vector<W> lu = kmatrix_dense<W>(*this);
+    std::vector<size_t> piv(n);
+    
+    W det = W(0);
+    if (kmatrix_lu(lu.data(), n, piv.data(), 0) == n){
+        det = W(1);
+        for (size_t i = 0 ; i < n ; i++){
+            det *= lu[i*n + i];
+            if (piv[i] != i) det = -det;
+        }
+    }
+    
+    cache.det_val = (double)std::real(det);
+    cache.set(KCACHE_DETERMINANT, mat.version());
+    
+    return cache.det_val;
 }
 
 //Static Functions
@@ -793,17 +1375,19 @@ double KMatrix<T>::determinant(){
  */
 template <class T>
 KMatrix<T> KMatrix<T>::zero(int r, int c){
+    return KMatrix(r, c);
+}
 
-    KMatrix out;
-    
-    out.clear(r, c);
-    for (int rr = 0 ; rr < r ; rr++){
-        for (int cc = 0 ; cc < c ; cc++){
-            out(rr, cc) = 0;
-        }
-    }
-    
-    return out;
+/*
+ Creates a KMatrix of size 'rc'x'rc' with every element set to zero.
+
+ rc - number of rows and columns
+
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> KMatrix<T>::zero(int rc){
+    return KMatrix(rc, rc);
 }
 
 /*
@@ -817,17 +1401,7 @@ KMatrix<T> KMatrix<T>::zero(int r, int c){
  */
 template <class T>
 KMatrix<T> KMatrix<T>::constant(T val, int r, int c){
-    
-    KMatrix out;
-    
-    out.clear(r, c);
-    for (int rr = 0 ; rr < r ; rr++){
-        for (int cc = 0 ; cc < c ; cc++){
-            out(rr, cc) = val;
-        }
-    }
-    
-    return out;
+    return KMatrix(val, r, c);
 }
 
 /*
@@ -843,36 +1417,156 @@ KMatrix<T> KMatrix<T>::constant(T val, int r, int c){
 template <class T>
 KMatrix<T> KMatrix<T>::range(T start, T step_size, T end, int rows){
 
-//    unsigned int idx;
-    std::vector<std::vector<T> > vals;
-    std::vector<T> temp_vals;
-    for (T i = start ; i <= end ; i += step_size){
-        temp_vals.push_back(i);
+    std::vector<T> vals;
+    for (T i = start ; !kmatrix_greater(i, end) ; i += step_size){
+        vals.push_back(i);
     }
-    
-    for (int i = 0 ; i < rows ; i++){
-        vals.push_back(temp_vals);
+
+    KMatrix result;
+    for (int r = 0 ; r < rows ; r++){
+        result.mat.push_back(result.new_row(vals));
     }
-    
-    KMatrix result(vals);
-    
-    return vals;
+
+    return result;
+}
+
+/*
+ Creates an 'n'x'n' identity matrix.
+
+ n - number of rows and columns
+
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> KMatrix<T>::identity(int n){
+
+    KMatrix out(n, n);
+    for (int i = 0 ; i < n ; i++){
+        out.mat[i][i] = T(1);
+    }
+
+    return out;
+}
+
+/*
+ Creates a square matrix with 'v' on the diagonal and zeros elsewhere.
+
+ v - diagonal values
+
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> KMatrix<T>::diag(const std::vector<T>& v){
+
+    KMatrix out((int)v.size(), (int)v.size());
+    for (size_t i = 0 ; i < v.size() ; i++){
+        out.mat[i][i] = v[i];
+    }
+
+    return out;
 }
 
 /*
- Set if matrix operates in linear algebrea mode (how matricies are multiplied by eachother)
+ Creates a KMatrix with 'n' evenly spaced values from 'start' to 'end' (inclusive) in each
+ row. Each value is computed from its index rather than by accumulating a step, so there is
+ no rounding drift.
+
+ start - first value
+ end - last value
+ n - number of values per row
+ rows - number of rows. Each row will have identical contents
 
- lin_alg - if true, multiplies as matrix, else element-wise multiplication
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> KMatrix<T>::linspace(T start, T end, int n, int rows){
+
+    std::vector<T> vals(n > 0 ? n : 0);
+    for (int i = 0 ; i < n ; i++){
+        vals[i] = (n == 1) ? start : start + (end - start)*T(i)/T(n - 1);
+    }
+    if (n > 1) vals[n-1] = end;
+
+    KMatrix result;
+    for (int r = 0 ; r < rows ; r++){
+        result.mat.push_back(result.new_row(vals));
+    }
+
+    return result;
+}
+
+/*
+ Fills 'out' from independent random streams, one per row and per KMATRIX_RANDOM_BLOCK
+ columns. The streams depend only on 'seed' and the element's position, so the result is
+ the same for any number of threads.
 
  Void return
  */
 template <class T>
-void KMatrix<T>::setElementMultMode(bool em){
-    KMatrix<T>::element_mult_mode = em;
+void kmatrix_fill_random(KMatrix<T>& out, unsigned long long seed, bool normal){
+
+    size_t nr = out.rows(), nc = out.cols();
+    size_t blocks = (nc + KMATRIX_RANDOM_BLOCK - 1)/KMATRIX_RANDOM_BLOCK;
+    std::vector<typename KMatrix<T>::row_type>& om = out.getMat();
+
+    KThreadPool::global().parallel_for(0, nr*blocks, [&](size_t lo, size_t hi){
+        for (size_t task = lo ; task < hi ; task++){
+            size_t r = task/blocks;
+            size_t c0 = (task % blocks)*KMATRIX_RANDOM_BLOCK;
+            size_t c1 = (c0 + KMATRIX_RANDOM_BLOCK < nc) ? c0 + KMATRIX_RANDOM_BLOCK : nc;
+            KMatrixRNG gen(seed, task);
+            T* row = om[r].data();
+            for (size_t c = c0 ; c < c1 ; c++){
+                row[c] = kmatrix_random_value(gen, normal, (T*)NULL);
+            }
+        }
+    }, (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL) ? nr*blocks : 1);
+}
+
+/*
+ Creates an 'r'x'c' matrix of values drawn uniformly from [0, 1). For complex types the real
+ and imaginary parts are drawn independently; integer types are drawn uniformly from
+ [0, max] of the type. Rows are filled in parallel; the result depends only on 'seed' and the
+ matrix size (not on the number of threads).
+
+ r - number of rows
+ c - number of columns
+ seed - random seed
+
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> KMatrix<T>::random(int r, int c, unsigned long long seed){
+
+    KMatrix out(r, c);
+    kmatrix_fill_random(out, seed, false);
+
+    return out;
 }
 
 /*
- Multiply two matricies using matrix multiplication.
+ Creates an 'r'x'c' matrix of values drawn from the standard normal distribution. For complex
+ types the real and imaginary parts each have variance 1/2; for integer types values are
+ rounded to the nearest integer. Reproducible as for random().
+
+ r - number of rows
+ c - number of columns
+ seed - random seed
+
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> KMatrix<T>::randn(int r, int c, unsigned long long seed){
+
+    KMatrix out(r, c);
+    kmatrix_fill_random(out, seed, true);
+
+    return out;
+}
+
+/*
+ Multiply two matricies using matrix multiplication. The algorithm is chosen by the global
+ policy returned by kmatrix_mult_policy() (the blocked kernel unless Strassen is enabled).
  
  a - left matrix
  b - right matrix
@@ -881,67 +1575,177 @@ void KMatrix<T>::setElementMultMode(bool em){
  */
 template <class T>
 KMatrix<T> matrixMult(const KMatrix<T>& a, const KMatrix<T>& b){
+    return matrixMult(a, b, kmatrix_mult_policy());
+}
+
+/*
+ Multiply two matricies using matrix multiplication, choosing the algorithm with 'policy'
+ instead of the global policy. Strassen is only used for square matrices larger than the
+ policy's crossover; everything else uses the cache-blocked kernels (kmatrix_gemm and its
+ transposed variants), which read either layout in place. The result is column-major if
+ both operands are, and row-major otherwise.
+ 
+ a - left matrix
+ b - right matrix
+ policy - algorithm selection
+ 
+ Returns the result matrix
+ */
+template <class T>
+KMatrix<T> matrixMult(const KMatrix<T>& a, const KMatrix<T>& b, const KMultPolicy& policy){
     
     matrix_multiplication_exception mat_mult_ex;
     
     //Check that the matricies can be multiplied
-    if (a.rows() != b.cols()){
+    if (a.cols() != b.rows()){
         throw mat_mult_ex;
     }
     
-    KMatrix<T> result(b.rows(), a.cols());
+    //Reduced-precision types are multiplied in their accumulator type and rounded once
+    typedef typename kmatrix_accum<T>::type accum_type;
+    if constexpr (!std::is_same<accum_type, T>::value){
+        KMatrix<accum_type> product = matrixMult(kmatrix_convert<accum_type>(a), kmatrix_convert<accum_type>(b), policy);
+        return kmatrix_convert<T>(product);
+    }
     
-    //Iterate through each element, calculate result
-    T sum;
-    for (unsigned int r = 0 ; r < result.rows() ; r++){
-        for (unsigned int c = 0 ; c < result.rows() ; c++){
-            
-            //Calculate sum of products
-            sum = 0;
-            for (unsigned int i = 0 ; i < result.rows() ; i++){
-                sum += a.get(r, i) * b.get(i, c);
-            }
-            result(r, c) = sum;
-            
-        }
+    if (policy.use_strassen && a.rows() == a.cols() && b.rows() == b.cols() && a.rows() > policy.strassen_crossover){
+        return strassenMult(a, b, policy.strassen_crossover);
+    }
+    
+    KMATRIX_STAT_SCOPE(KOP_MATRIX_MULT, 2.0*a.rows()*a.cols()*b.cols(), a.rows()*b.cols()*sizeof(T));
+    
+    bool acol = (a.layout() == KMAT_COL_MAJOR);
+    bool bcol = (b.layout() == KMAT_COL_MAJOR);
+    
+    //Column-major times column-major stays column-major; any other product is row-major
+    KMatrix<T> result;
+    result.setAlignment(a.alignment());
+    result.setMemoryPolicy(a.memoryPolicy());
+    result.setLayout((acol && bcol) ? KMAT_COL_MAJOR : KMAT_ROW_MAJOR);
+    result.clear(a.rows(), b.cols());
+    
+    const std::vector<typename KMatrix<T>::row_type>& am = a.getMat();
+    const std::vector<typename KMatrix<T>::row_type>& bm = b.getMat();
+    std::vector<typename KMatrix<T>::row_type>& cm = result.getMat();
+    auto arow = [&](size_t r){ return am[r].data(); };
+    auto brow = [&](size_t r){ return bm[r].data(); };
+    auto crow = [&](size_t r){ return cm[r].data(); };
+    
+    //The storage of a column-major matrix is the row-major storage of its transpose, so every
+    //combination runs on the stored vectors without copying an operand
+    if (!acol && !bcol){
+        kmatrix_gemm<T>(a.rows(), a.cols(), b.cols(), arow, brow, crow);
+    }else if (acol && bcol){
+        kmatrix_gemm<T>(b.cols(), a.cols(), a.rows(), brow, arow, crow); //C^T = B^T*A^T
+    }else if (!acol){
+        kmatrix_gemm_nt<T>(a.rows(), a.cols(), b.cols(), arow, brow, crow);
+    }else{
+        kmatrix_gemm_tn<T>(a.rows(), a.cols(), b.cols(), arow, brow, crow);
     }
     
     return result;
 }
 
 /*
- Multiply two matricies using element-wise multiplication.
+ Multiply two square matricies using the Strassen-Winograd algorithm (7 half-size products
+ per level instead of 8), finishing with the blocked kernel once blocks are 'crossover' or
+ smaller. A size that does not halve evenly down to the crossover is zero-padded to the
+ next multiple of 2^levels, which adds at most 2^levels - 1 rows and columns.
  
- a - left matrix
- b - right matrix
+ Error bound: with max-norm ||A|| = max|a_ij|, unit roundoff u and d levels of recursion
+ (n = 2^d * n0, n0 <= crossover), the computed product satisfies
+     ||C - fl(C)|| <= [ (n/n0)^log2(18) * (n0^2 + 6*n0) - 6*n ] * u * ||A|| * ||B|| + O(u^2)
+ (Higham, Accuracy and Stability of Numerical Algorithms, 2nd ed., section 23.2.2). This is a
+ normwise bound, unlike the componentwise |C - fl(C)| <= n*u*|A|*|B| of the standard kernel,
+ so elements of C much smaller than ||A||*||B|| can lose relative accuracy. Keep the
+ crossover large (hundreds) to limit the depth, and avoid Strassen where small elements of
+ the product matter.
  
- Returns the product matrix
+ a - left matrix (n x n)
+ b - right matrix (n x n)
+ crossover - largest size multiplied directly by the blocked kernel
+ 
+ Returns the result matrix, laid out as matrixMult() lays out its result
  */
 template <class T>
-KMatrix<T> elementMult(const KMatrix<T>& a, const KMatrix<T>& b){
-
+KMatrix<T> strassenMult(const KMatrix<T>& a, const KMatrix<T>& b, size_t crossover){
+    
     matrix_multiplication_exception mat_mult_ex;
     
-    //Check that the matricies' dimensions match
-    if (a.rows() != b.rows() || a.cols() != b.cols()){
+    //Check that the matricies are square and the same size
+    if (a.rows() != a.cols() || b.rows() != b.cols() || a.cols() != b.rows()){
         throw mat_mult_ex;
     }
+    if (crossover < 1){
+        crossover = 1;
+    }
     
-    KMatrix<T> result(a.rows(), a.cols());
+    typedef typename kmatrix_accum<T>::type accum_type;
+    if constexpr (!std::is_same<accum_type, T>::value){
+        KMatrix<accum_type> product = strassenMult(kmatrix_convert<accum_type>(a), kmatrix_convert<accum_type>(b), crossover);
+        return kmatrix_convert<T>(product);
+    }
     
-    //Iterate through each element, calculate result
-    T sum;
-    for (unsigned int r = 0 ; r < result.rows() ; r++){
-        for (unsigned int c = 0 ; c < result.rows() ; c++){
-            
-            //Calculate product
-            result(r, c) = a.get(r, c) * b.get(r, c);
-            
+    //Determine recursion depth and padded size
+    size_t n = a.rows();
+    size_t levels = 0;
+    while (((n + ((size_t)1 << levels) - 1) >> levels) > crossover){
+        levels++;
+    }
+    size_t block = (n + ((size_t)1 << levels) - 1) >> levels;
+    size_t m = block << levels;
+    
+    if (levels == 0){
+        KMultPolicy standard;
+        return matrixMult(a, b, standard);
+    }
+    
+    KMATRIX_STAT_SCOPE(KOP_STRASSEN_MULT, kmatrix_strassen_flops(m, block), (3*m*m + n*n)*sizeof(T));
+    
+    //Copy into zero-padded contiguous buffers
+    std::vector<T> abuf(m*m, T(0));
+    std::vector<T> bbuf(m*m, T(0));
+    std::vector<T> cbuf(m*m);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c < n ; c++){
+            abuf[r*m + c] = a.get(r, c);
+            bbuf[r*m + c] = b.get(r, c);
         }
     }
     
-    return result;
+    kmatrix_strassen(abuf.data(), m, bbuf.data(), m, cbuf.data(), m, m, block);
+    
+    //Column-major times column-major stays column-major; any other product is row-major
+    bool ccol = (a.layout() == KMAT_COL_MAJOR && b.layout() == KMAT_COL_MAJOR);
+    KMatrix<T> result;
+    result.setAlignment(a.alignment());
+    result.setMemoryPolicy(a.memoryPolicy());
+    result.setLayout(ccol ? KMAT_COL_MAJOR : KMAT_ROW_MAJOR);
+    result.clear(n, n);
+    std::vector<typename KMatrix<T>::row_type>& cm = result.getMat();
+    for (size_t i = 0 ; i < n ; i++){
+        T* line = cm[i].data();
+        if (ccol){
+            for (size_t r = 0 ; r < n ; r++) line[r] = cbuf[r*m + i];
+        }else{
+            std::copy(cbuf.begin() + i*m, cbuf.begin() + i*m + n, line);
+        }
+    }
     
+    return result;
+}
+
+/*
+ Multiply two matricies using element-wise multiplication, broadcasting either operand.
+ 
+ a - left matrix
+ b - right matrix
+ 
+ Returns the product matrix
+ */
+template <class T>
+KMatrix<T> elementMult(const KMatrix<T>& a, const KMatrix<T>& b){
+    return kmatrix_broadcast<T>(a, b, [](const T& x, const T& y){ return x * y; }, KOP_ELEMENT_MULT);
 }
 
 /*
@@ -954,14 +1758,19 @@ KMatrix<T> elementMult(const KMatrix<T>& a, const KMatrix<T>& b){
  */
 template <class T>
 KMatrix<T> sin(const KMatrix<T>& a){
-
+	
+	KMATRIX_STAT_SCOPE(KOP_SIN, a.rows()*a.cols(), a.rows()*a.cols()*sizeof(T));
+	
 	//Declare KMatrix
-	KMatrix<T> out(a.rows(), a.cols());
+	KMatrix<T> out;
+	out.setAlignment(a.alignment());
+	out.setMemoryPolicy(a.memoryPolicy());
+	out.clear(a.rows(), a.cols());
 	
 	//populate with new values
 	for (size_t r = 0; r < a.rows() ; r++){
 		for (size_t c = 0 ; c < a.cols() ; c++){
-			out(r, c) = sin(a(r, c));
+			out(r, c) = std::sin(a.get(r, c));
 		}
 	}
 	
@@ -979,13 +1788,18 @@ KMatrix<T> sin(const KMatrix<T>& a){
 template <class T>
 KMatrix<T> cos(const KMatrix<T>& a){
 	
+	KMATRIX_STAT_SCOPE(KOP_COS, a.rows()*a.cols(), a.rows()*a.cols()*sizeof(T));
+	
 	//Declare KMatrix
-	KMatrix<T> out(a.rows(), a.cols());
+	KMatrix<T> out;
+	out.setAlignment(a.alignment());
+	out.setMemoryPolicy(a.memoryPolicy());
+	out.clear(a.rows(), a.cols());
 	
 	//populate with new values
 	for (size_t r = 0; r < a.rows() ; r++){
 		for (size_t c = 0 ; c < a.cols() ; c++){
-			out(r, c) = cos(a(r, c));
+			out(r, c) = std::cos(a.get(r, c));
 		}
 	}
 	
@@ -1003,13 +1817,18 @@ KMatrix<T> cos(const KMatrix<T>& a){
 template <class T>
 KMatrix<T> tan(const KMatrix<T>& a){
 	
+	KMATRIX_STAT_SCOPE(KOP_TAN, a.rows()*a.cols(), a.rows()*a.cols()*sizeof(T));
+	
 	//Declare KMatrix
-	KMatrix<T> out(a.rows(), a.cols());
+	KMatrix<T> out;
+	out.setAlignment(a.alignment());
+	out.setMemoryPolicy(a.memoryPolicy());
+	out.clear(a.rows(), a.cols());
 	
 	//populate with new values
 	for (size_t r = 0; r < a.rows() ; r++){
 		for (size_t c = 0 ; c < a.cols() ; c++){
-			out(r, c) = tan(a(r, c));
+			out(r, c) = std::tan(a.get(r, c));
 		}
 	}
 	
@@ -1027,13 +1846,18 @@ KMatrix<T> tan(const KMatrix<T>& a){
 template <class T>
 KMatrix<T> asin(const KMatrix<T>& a){
 	
+	KMATRIX_STAT_SCOPE(KOP_ASIN, a.rows()*a.cols(), a.rows()*a.cols()*sizeof(T));
+	
 	//Declare KMatrix
-	KMatrix<T> out(a.rows(), a.cols());
+	KMatrix<T> out;
+	out.setAlignment(a.alignment());
+	out.setMemoryPolicy(a.memoryPolicy());
+	out.clear(a.rows(), a.cols());
 	
 	//populate with new values
 	for (size_t r = 0; r < a.rows() ; r++){
 		for (size_t c = 0 ; c < a.cols() ; c++){
-			out(r, c) = asin(a(r, c));
+			out(r, c) = std::asin(a.get(r, c));
 		}
 	}
 	
@@ -1051,13 +1875,18 @@ KMatrix<T> asin(const KMatrix<T>& a){
 template <class T>
 KMatrix<T> acos(const KMatrix<T>& a){
 	
+	KMATRIX_STAT_SCOPE(KOP_ACOS, a.rows()*a.cols(), a.rows()*a.cols()*sizeof(T));
+	
 	//Declare KMatrix
-	KMatrix<T> out(a.rows(), a.cols());
+	KMatrix<T> out;
+	out.setAlignment(a.alignment());
+	out.setMemoryPolicy(a.memoryPolicy());
+	out.clear(a.rows(), a.cols());
 	
 	//populate with new values
 	for (size_t r = 0; r < a.rows() ; r++){
 		for (size_t c = 0 ; c < a.cols() ; c++){
-			out(r, c) = acos(a(r, c));
+			out(r, c) = std::acos(a.get(r, c));
 		}
 	}
 	
@@ -1075,37 +1904,346 @@ KMatrix<T> acos(const KMatrix<T>& a){
 template <class T>
 KMatrix<T> atan(const KMatrix<T>& a){
 	
+	KMATRIX_STAT_SCOPE(KOP_ATAN, a.rows()*a.cols(), a.rows()*a.cols()*sizeof(T));
+	
 	//Declare KMatrix
-	KMatrix<T> out(a.rows(), a.cols());
+	KMatrix<T> out;
+	out.setAlignment(a.alignment());
+	out.setMemoryPolicy(a.memoryPolicy());
+	out.clear(a.rows(), a.cols());
 	
 	//populate with new values
 	for (size_t r = 0; r < a.rows() ; r++){
 		for (size_t c = 0 ; c < a.cols() ; c++){
-			out(r, c) = atan(a(r, c));
+			out(r, c) = std::atan(a.get(r, c));
 		}
 	}
 	
 	return out;
 }
 
+/*
+ Sets the alignment of the matrix's rows. Each row is allocated separately; with a non-zero
+ alignment every row starts on a 'bytes' boundary and its storage is padded to a whole
+ multiple of 'bytes' (see ld()). Use KMATRIX_CACHE_LINE for cache-line aligned rows. The
+ alignment is kept by clear(), copies and compound operators, and results of element-wise
+ operations and matrixMult take the alignment of their left operand. Existing values are
+ preserved.
+ 
+ Alignments no greater than that of operator new are always met and select the normal,
+ unpadded storage.
+ 
+ bytes - row alignment in bytes. Must be 0 or a power of two.
+ 
+ Void return
+ */
+template <class T>
+void KMatrix<T>::setAlignment(size_t bytes){
+    
+    if ((bytes & (bytes - 1)) != 0){
+        throw matrix_alignment_exception();
+    }
+    
+    if (bytes <= __STDCPP_DEFAULT_NEW_ALIGNMENT__){
+        bytes = 0;
+    }
+    
+    if (bytes == row_align) return;
+    row_align = bytes;
+    
+    //Reallocate each row with the new alignment
+    for (size_t r = 0 ; r < mat.size() ; r++){
+        row_type temp(mat[r].begin(), mat[r].end(), allocator());
+        mat[r].swap(temp);
+    }
+}
+
+/*
+ Returns the alignment in bytes guaranteed for the start of every row.
+ */
+template <class T>
+size_t KMatrix<T>::alignment() const{
+    
+    if (row_align == 0){
+        return __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+    
+    return row_align;
+}
+
+/*
+ Sets how the matrix's rows are placed in memory: NUMA placement and huge pages (see
+ KMatrixMemoryPolicy). Any policy other than KMEM_DEFAULT gives the matrix its own
+ KMatrixArena. Existing values are preserved by reallocating the rows under the new policy,
+ in parallel for large matrices or KMEM_FIRST_TOUCH. Like the alignment, the policy is kept
+ by clear(), copies (which share the arena) and compound operators, and results of
+ element-wise operations and matrixMult take the policy of their left operand.
+
+ policy - KMatrixMemoryPolicy flags combined with |
+
+ Void return
+ */
+template <class T>
+void KMatrix<T>::setMemoryPolicy(int policy){
+
+    if (policy == mem_policy) return;
+    mem_policy = policy;
+    arena = (policy == KMEM_DEFAULT) ? std::shared_ptr<KMatrixArena>() : std::make_shared<KMatrixArena>(policy);
+
+    const std::vector<row_type>& src = mat.read();
+    if (src.empty()) return;
+
+    size_t len = src[0].size();
+    reserve_lines(src.size(), len);
+    std::vector<row_type> lines(src.size());
+    auto copy = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            lines[r] = row_type(src[r].begin(), src[r].end(), allocator());
+        }
+    };
+
+    if (src.size()*len < KMATRIX_ELEMENTWISE_PARALLEL && (mem_policy & KMEM_FIRST_TOUCH) == 0){
+        copy(0, src.size());
+    }else{
+        KThreadPool::global().parallel_for(0, src.size(), copy);
+    }
+
+    mat.assign(std::move(lines));
+}
+
+/*
+ Returns the KMatrixMemoryPolicy flags set with setMemoryPolicy()
+ */
+template <class T>
+int KMatrix<T>::memoryPolicy() const{
+    return mem_policy;
+}
+
+/*
+ Returns the allocator new rows (or columns) of this matrix are created with, which carries
+ its alignment and memory policy
+ */
+template <class T>
+KMatrixAllocator<T> KMatrix<T>::allocator() const{
+    return KMatrixAllocator<T>(row_align, arena);
+}
+
+/*
+ Returns the leading dimension: the number of elements of storage behind each row (each
+ column if column-major), including alignment padding. Equal to the row (column) length
+ unless an alignment was set with setAlignment(). Elements past the end of the row up to
+ ld() are padding and are not initialized.
+ */
+template <class T>
+size_t KMatrix<T>::ld() const{
+    return KMatrixAllocator<T>(row_align).padded((mat_layout == KMAT_COL_MAJOR) ? rows() : cols());
+}
+
+//Rows (or columns) per tile when setLayout() transposes the storage
+#define KMATRIX_TRANSPOSE_TILE 32
+
+/*
+ Changes the storage layout. The values of the matrix are unchanged; they are moved into
+ rows (KMAT_ROW_MAJOR) or columns (KMAT_COL_MAJOR) with a tiled transpose, split across
+ the thread pool for large matrices. Nothing is copied if the matrix already has 'layout'.
+ 
+ layout - new storage layout
+ 
+ Void return
+ */
+template <class T>
+void KMatrix<T>::setLayout(KMatrixLayout layout){
+    
+    if (layout == mat_layout) return;
+    
+    const std::vector<row_type>& src = mat.read();
+    size_t lines = src.size();
+    size_t len = (lines > 0) ? src[0].size() : 0;
+    
+    //Storage lines of the new layout (one per element of the old lines)
+    std::vector<row_type> out(len);
+    auto transpose_lines = [&](size_t lo, size_t hi){
+        for (size_t j = lo ; j < hi ; j++){
+            out[j] = row_type(lines, T(), allocator());
+        }
+        for (size_t ii = 0 ; ii < lines ; ii += KMATRIX_TRANSPOSE_TILE){
+            size_t iend = (ii + KMATRIX_TRANSPOSE_TILE < lines) ? ii + KMATRIX_TRANSPOSE_TILE : lines;
+            for (size_t jj = lo ; jj < hi ; jj += KMATRIX_TRANSPOSE_TILE){
+                size_t jend = (jj + KMATRIX_TRANSPOSE_TILE < hi) ? jj + KMATRIX_TRANSPOSE_TILE : hi;
+                for (size_t j = jj ; j < jend ; j++){
+                    T* o = out[j].data();
+                    for (size_t i = ii ; i < iend ; i++){
+                        o[i] = src[i][j];
+                    }
+                }
+            }
+        }
+    };
+    
+    if (lines*len < KMATRIX_ELEMENTWISE_PARALLEL){
+        transpose_lines(0, len);
+    }else{
+        KThreadPool::global().parallel_for(0, len, transpose_lines, KMATRIX_TRANSPOSE_TILE);
+    }
+    
+    mat.assign(std::move(out));
+    mat_layout = layout;
+}
+
+/*
+ Returns the storage layout (KMAT_ROW_MAJOR or KMAT_COL_MAJOR).
+ */
+template <class T>
+KMatrixLayout KMatrix<T>::layout() const{
+    return mat_layout;
+}
+
+/*
+ Enables or disables copy-on-write. While enabled, copies of the matrix share its storage
+ until one of them is modified. Disabling it gives the matrix a private copy if its storage
+ is shared. The mode is kept when the matrix is assigned to, and passed on to its copies.
+ 
+ enable - true to share storage between copies
+ 
+ Void return
+ */
+template <class T>
+void KMatrix<T>::setCopyOnWrite(bool enable){
+    mat.setCopyOnWrite(enable);
+}
+
+/*
+ Returns true if copy-on-write is enabled
+ */
+template <class T>
+bool KMatrix<T>::copyOnWrite() const{
+    return mat.copyOnWrite();
+}
+
+/*
+ Returns true if the storage is currently shared with a copy (the next write will copy it)
+ */
+template <class T>
+bool KMatrix<T>::sharesStorage() const{
+    return mat.shared();
+}
+
+/*
+ Returns the version of the matrix's contents. It changes whenever the matrix may have been
+ modified: on every non-const access, including operator(), clear(), the compound operators
+ and the non-const getMat().
+ */
+template <class T>
+unsigned long long KMatrix<T>::version() const{
+    return mat.version();
+}
+
+/*----------------------------------------------------------------
+-------------------------- KMATRIXCACHE --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns true if 'item' was stored at version 'ver'
+ */
+template <class T>
+bool KMatrixCache<T>::has(KMatrixCached item, unsigned long long ver) const{
+    return version == ver && (valid & item) != 0;
+}
+
+/*
+ Marks 'item' (whose value the caller has just stored) as valid at version 'ver'. Items
+ stored at an older version are dropped.
+
+ Void return
+ */
+template <class T>
+void KMatrixCache<T>::set(KMatrixCached item, unsigned long long ver){
+
+    if (version != ver){
+        version = ver;
+        valid = 0;
+    }
+    valid |= item;
+}
+
+/*
+ Creates an empty row of 'cols' value-initialized elements using this matrix's alignment.
+ */
+template <class T>
+typename KMatrix<T>::row_type KMatrix<T>::new_row(size_t cols) const{
+    return row_type(cols, T(), allocator());
+}
+
+/*
+ Creates a row containing 'vals' using this matrix's alignment.
+ */
+template <class T>
+typename KMatrix<T>::row_type KMatrix<T>::new_row(const std::vector<T>& vals) const{
+    return row_type(vals.begin(), vals.end(), allocator());
+}
+
+/*
+ Resizes the storage to 'rows' lines of 'cols' elements (rows x cols for a row-major matrix,
+ its transpose for a column-major one) with every element set to 'val'. Each row is allocated
+ once and filled directly; large matrices (and any with KMEM_FIRST_TOUCH) are filled in
+ parallel, which also places each row's pages with the thread that filled it.
+
+ Void return
+ */
+template <class T>
+void KMatrix<T>::fill_rows(size_t rows, size_t cols, const T& val){
+
+    mat.clear();
+    reserve_lines(rows, cols);
+    std::vector<row_type>& m = mat.write();
+    m.resize(rows);
+
+    auto fill = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            m[r] = row_type(cols, val, allocator());
+        }
+    };
+
+    if (rows*cols < KMATRIX_ELEMENTWISE_PARALLEL && (mem_policy & KMEM_FIRST_TOUCH) == 0){
+        fill(0, rows);
+    }else{
+        KThreadPool::global().parallel_for(0, rows, fill);
+    }
+}
+
+/*
+ Makes sure the arena, if the matrix has one, can hold 'lines' storage lines of 'len'
+ elements in one chunk before they are allocated.
+
+ Void return
+ */
+template <class T>
+void KMatrix<T>::reserve_lines(size_t lines, size_t len){
+
+    if (!arena) return;
+
+    size_t unit = (row_align > KMATRIX_CACHE_LINE) ? row_align : KMATRIX_CACHE_LINE;
+    size_t bytes = (allocator().padded(len)*sizeof(T) + unit - 1)/unit*unit;
+    arena->reserve(lines*bytes);
+}
+
 /*
  Access a reference to the 2D vector containing the matrix's data
  
  Retuns a reference to the matrix's vector.
  */
 template <class T>
-std::vector<std::vector<T> >& KMatrix<T>::getMat(){
-    return mat;
+std::vector<typename KMatrix<T>::row_type>& KMatrix<T>::getMat(){
+    return mat.write();
 }
 
 /*
- Returns the 'multiplying mode' of the matrix.
- 
- Returns true if matrix set to multiply in element-wise fashion, false if set to matrix multiplication.
+ Read-only access to the matrix's data. Unlike the non-const getMat(), this never copies
+ storage shared by a copy-on-write matrix.
  */
 template <class T>
-bool& KMatrix<T>::getElementMultMode(){
-    return element_mult_mode;
+const std::vector<typename KMatrix<T>::row_type>& KMatrix<T>::getMat() const{
+    return mat.read();
 }
 
 /*
@@ -1137,7 +2275,7 @@ KMatrix<T> operator-(KMatrix<T> lv, const KMatrix<T>& rv){
 }
 
 /*
- Multiplies lv and rv. Multiplication mode (matrix multiplication or element-wise multiplication) determined by set_matrix_mult().
+ Multiplies lv and rv element-wise. (Use KLinMatrix for matrix multiplication).
  
  lv - left matrix value
  rv - right matrix value
@@ -1164,6 +2302,217 @@ KMatrix<T> operator/(KMatrix<T> lv, const KMatrix<T>& rv){
     return lv;
 }
 
+/*
+ Scalar arithmetic. The scalar is applied to every element of the matrix; its type only has
+ to convert to T (eg. 2*km for a KMatrix<double>). Division by a scalar multiplies by the
+ reciprocal for floating point and complex types.
+
+ lv - left value
+ rv - right value
+
+ Returns the resulting matrix
+ */
+template <class T>
+KMatrix<T> operator+(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv){
+    return kmatrix_map(lv, [rv](const T& x){ return x + rv; });
+}
+
+template <class T>
+KMatrix<T> operator+(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv){
+    return kmatrix_map(rv, [lv](const T& x){ return lv + x; });
+}
+
+template <class T>
+KMatrix<T> operator-(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv){
+    return kmatrix_map(lv, [rv](const T& x){ return x - rv; });
+}
+
+template <class T>
+KMatrix<T> operator-(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv){
+    return kmatrix_map(rv, [lv](const T& x){ return lv - x; });
+}
+
+template <class T>
+KMatrix<T> operator*(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv){
+    return kmatrix_map(lv, [rv](const T& x){ return x * rv; });
+}
+
+template <class T>
+KMatrix<T> operator*(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv){
+    return kmatrix_map(rv, [lv](const T& x){ return lv * x; });
+}
+
+template <class T>
+KMatrix<T> operator/(const KMatrix<T>& lv, const typename KMatrix<T>::value_type& rv){
+
+    if (std::is_integral<T>::value || !std::is_same<typename kmatrix_accum<T>::type, T>::value){
+        return kmatrix_map(lv, [rv](const T& x){ return x / rv; });
+    }
+
+    const T inv = T(1)/rv;
+    return kmatrix_map(lv, [inv](const T& x){ return x * inv; });
+}
+
+template <class T>
+KMatrix<T> operator/(const typename KMatrix<T>::value_type& lv, const KMatrix<T>& rv){
+    return kmatrix_map(rv, [lv](const T& x){ return lv / x; });
+}
+
+/*
+ Copies 'a' into a contiguous row-major array, converting each element to U.
+
+ a - matrix to copy (either layout)
+
+ Returns the rows()*cols() elements, row after row
+ */
+template <class U, class T>
+std::vector<U> kmatrix_dense(const KMatrix<T>& a){
+
+    const std::vector<typename KMatrix<T>::row_type>& am = a.getMat();
+    size_t nr = a.rows(), nc = a.cols();
+    std::vector<U> out(nr*nc);
+
+    for (size_t r = 0 ; r < nr ; r++){
+        for (size_t c = 0 ; c < nc ; c++){
+            out[r*nc + c] = U((a.layout() == KMAT_COL_MAJOR) ? am[c][r] : am[r][c]);
+        }
+    }
+
+    return out;
+}
+
+/*
+ Converts every element of 'a' to U, keeping a's shape, layout and alignment. Use it to move
+ between storage precisions, eg. kmatrix_convert<KHalf>(km) to store a KMatrix<float> in
+ half the memory, or kmatrix_convert<float>(kh) to read it back.
+
+ a - matrix to convert
+
+ Returns the converted matrix
+ */
+template <class U, class T>
+KMatrix<U> kmatrix_convert(const KMatrix<T>& a){
+
+    const std::vector<typename KMatrix<T>::row_type>& am = a.getMat();
+    size_t nr = am.size(), nc = (nr > 0) ? am[0].size() : 0;
+
+    KMatrix<U> out;
+    out.setAlignment(a.alignment());
+    out.setMemoryPolicy(a.memoryPolicy());
+    out.setLayout(a.layout());
+    out.clear((int)a.rows(), (int)a.cols());
+    std::vector<typename KMatrix<U>::row_type>& om = out.getMat();
+
+    auto rows = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            const T* x = am[r].data();
+            U* o = om[r].data();
+            for (size_t c = 0 ; c < nc ; c++) o[c] = U(x[c]);
+        }
+    };
+
+    if (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL){
+        rows(0, nr);
+    }else{
+        KThreadPool::global().parallel_for(0, nr, rows);
+    }
+
+    return out;
+}
+
+/*
+ Scale-and-add, y = alpha*x + beta*y, in a single pass over x and y. If beta is zero, y is
+ not read (so NaNs in y are not propagated). Throws matrix_multiplication_exception if x
+ and y are not the same size.
+
+ alpha - scale of x
+ x - matrix to add
+ beta - scale of y
+ y - matrix to update
+
+ Void return
+ */
+template <class T>
+void axpby(const typename KMatrix<T>::value_type& alpha, const KMatrix<T>& x, const typename KMatrix<T>::value_type& beta, KMatrix<T>& y){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (x.rows() != y.rows() || x.cols() != y.cols()){
+        throw mat_mult_ex;
+    }
+
+    if (x.layout() != y.layout()){
+        KMatrix<T> xc(x);
+        xc.setLayout(y.layout());
+        axpby(alpha, xc, beta, y);
+        return;
+    }
+
+    //Storage dimensions, the same for both since the layouts match
+    const std::vector<typename KMatrix<T>::row_type>& xm = x.getMat();
+    std::vector<typename KMatrix<T>::row_type>& ym = y.getMat();
+    size_t nr = ym.size(), nc = (nr > 0) ? ym[0].size() : 0;
+    KMATRIX_STAT_SCOPE(KOP_SCALAR, 3*nr*nc, 0);
+
+    auto rows = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            const T* xr = xm[r].data();
+            T* yr = ym[r].data();
+            if (beta == T(0)){
+                for (size_t c = 0 ; c < nc ; c++) yr[c] = alpha*xr[c];
+            }else if (beta == T(1)){
+                for (size_t c = 0 ; c < nc ; c++) yr[c] += alpha*xr[c];
+            }else{
+                for (size_t c = 0 ; c < nc ; c++) yr[c] = alpha*xr[c] + beta*yr[c];
+            }
+        }
+    };
+
+    if (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL){
+        rows(0, nr);
+    }else{
+        KThreadPool::global().parallel_for(0, nr, rows);
+    }
+}
+
+/*
+ Element-wise comparisons, broadcasting either operand. Complex values are ordered by
+ magnitude (as in max() and min()).
+
+ lv - left matrix value
+ rv - right matrix value
+
+ Returns a matrix of 1 where the comparison holds and 0 elsewhere
+ */
+template <class T>
+KMatrix<int> operator==(const KMatrix<T>& lv, const KMatrix<T>& rv){
+    return kmatrix_broadcast<int>(lv, rv, [](const T& x, const T& y){ return (int)(x == y); }, KOP_COMPARE);
+}
+
+template <class T>
+KMatrix<int> operator!=(const KMatrix<T>& lv, const KMatrix<T>& rv){
+    return kmatrix_broadcast<int>(lv, rv, [](const T& x, const T& y){ return (int)(x != y); }, KOP_COMPARE);
+}
+
+template <class T>
+KMatrix<int> operator<(const KMatrix<T>& lv, const KMatrix<T>& rv){
+    return kmatrix_broadcast<int>(lv, rv, [](const T& x, const T& y){ return (int)kmatrix_greater(y, x); }, KOP_COMPARE);
+}
+
+template <class T>
+KMatrix<int> operator>(const KMatrix<T>& lv, const KMatrix<T>& rv){
+    return kmatrix_broadcast<int>(lv, rv, [](const T& x, const T& y){ return (int)kmatrix_greater(x, y); }, KOP_COMPARE);
+}
+
+template <class T>
+KMatrix<int> operator<=(const KMatrix<T>& lv, const KMatrix<T>& rv){
+    return kmatrix_broadcast<int>(lv, rv, [](const T& x, const T& y){ return (int)!kmatrix_greater(x, y); }, KOP_COMPARE);
+}
+
+template <class T>
+KMatrix<int> operator>=(const KMatrix<T>& lv, const KMatrix<T>& rv){
+    return kmatrix_broadcast<int>(lv, rv, [](const T& x, const T& y){ return (int)!kmatrix_greater(y, x); }, KOP_COMPARE);
+}
+
 
 
 
@@ -1247,6 +2596,52 @@ KMatrix<T> operator/(KMatrix<T> lv, const KMatrix<T>& rv){
 //}
 
 
-
+/*
+ Explicit instantiations of KMatrix for float, double, int and std::complex<double> are
+ compiled into the KMatrix library (KMatrixInstances.cpp). Declaring them extern here
+ keeps every translation unit that includes KMatrix.hpp from instantiating them again.
+ Define KMATRIX_HEADER_ONLY before including to instantiate from the headers instead.
+ */
+#define KMATRIX_INSTANTIATE(EXTERN, T) \
+    EXTERN template class KMatrix<T>; \
+    EXTERN template void swapMat(KMatrix<T>& first, KMatrix<T>& second); \
+    EXTERN template KMatrix<T> operator+(KMatrix<T> lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator-(KMatrix<T> lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator*(KMatrix<T> lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator/(KMatrix<T> lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator+(const KMatrix<T>& lv, const T& rv); \
+    EXTERN template KMatrix<T> operator+(const T& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator-(const KMatrix<T>& lv, const T& rv); \
+    EXTERN template KMatrix<T> operator-(const T& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator*(const KMatrix<T>& lv, const T& rv); \
+    EXTERN template KMatrix<T> operator*(const T& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> operator/(const KMatrix<T>& lv, const T& rv); \
+    EXTERN template KMatrix<T> operator/(const T& lv, const KMatrix<T>& rv); \
+    EXTERN template void axpby(const T& alpha, const KMatrix<T>& x, const T& beta, KMatrix<T>& y); \
+    EXTERN template KMatrix<int> operator==(const KMatrix<T>& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<int> operator!=(const KMatrix<T>& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<int> operator<(const KMatrix<T>& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<int> operator>(const KMatrix<T>& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<int> operator<=(const KMatrix<T>& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<int> operator>=(const KMatrix<T>& lv, const KMatrix<T>& rv); \
+    EXTERN template KMatrix<T> matrixMult(const KMatrix<T>& a, const KMatrix<T>& b); \
+    EXTERN template KMatrix<T> matrixMult(const KMatrix<T>& a, const KMatrix<T>& b, const KMultPolicy& policy); \
+    EXTERN template KMatrix<T> strassenMult(const KMatrix<T>& a, const KMatrix<T>& b, size_t crossover); \
+    EXTERN template KMatrix<T> elementMult(const KMatrix<T>& a, const KMatrix<T>& b); \
+    EXTERN template KMatrix<T> sin(const KMatrix<T>& a); \
+    EXTERN template KMatrix<T> cos(const KMatrix<T>& a); \
+    EXTERN template KMatrix<T> tan(const KMatrix<T>& a); \
+    EXTERN template KMatrix<T> asin(const KMatrix<T>& a); \
+    EXTERN template KMatrix<T> acos(const KMatrix<T>& a); \
+    EXTERN template KMatrix<T> atan(const KMatrix<T>& a);
+
+#ifndef KMATRIX_HEADER_ONLY
+KMATRIX_INSTANTIATE(extern, float)
+KMATRIX_INSTANTIATE(extern, double)
+KMATRIX_INSTANTIATE(extern, int)
+KMATRIX_INSTANTIATE(extern, std::complex<double>)
+KMATRIX_INSTANTIATE(extern, KHalf)
+KMATRIX_INSTANTIATE(extern, KBFloat16)
+#endif
 
 #endif /* KMatrix_hpp */
@@ -0,0 +1,304 @@
+//
+//  KMatrixAllocator.cpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#include "KMatrixAllocator.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#define KMATRIX_HAVE_MEMPOLICY
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//Interleave mode of mbind() (linux/mempolicy.h)
+#define KMATRIX_MPOL_INTERLEAVE 3
+#endif
+
+//Alignment of chunks where mmap is not available
+#define KMATRIX_CHUNK_ALIGN 4096
+
+namespace {
+
+    size_t round_up(size_t n, size_t m){
+        return (n + m - 1)/m*m;
+    }
+
+#ifdef KMATRIX_HAVE_MEMPOLICY
+    /*
+     Returns a bit mask of the online NUMA nodes (the first 64), or 0 if it can not be read
+     */
+    unsigned long online_nodes(){
+
+        std::ifstream file("/sys/devices/system/node/online");
+        std::string list;
+        if (!(file >> list)) return 0;
+
+        //A list of ranges such as "0-1,4"
+        unsigned long mask = 0;
+        try{
+            size_t pos = 0;
+            while (pos < list.size()){
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                std::string part = list.substr(pos, comma - pos);
+                size_t dash = part.find('-');
+                unsigned long lo = std::stoul(part.substr(0, dash));
+                unsigned long hi = (dash == std::string::npos) ? lo : std::stoul(part.substr(dash + 1));
+                for (unsigned long node = lo ; node <= hi && node < 64 ; node++) mask |= 1UL << node;
+                pos = comma + 1;
+            }
+        }catch(...){
+            return 0;
+        }
+
+        return mask;
+    }
+#endif
+
+}
+
+/*
+ Creates an empty arena. Nothing is mapped until the first allocation or reserve().
+
+ policy - KMatrixMemoryPolicy flags applied to each chunk
+ */
+KMatrixArena::KMatrixArena(int policy) : pol(policy), live(0), free_bytes(0){
+
+}
+
+/*
+ Unmaps every chunk. Any rows still allocated from the arena become invalid.
+ */
+KMatrixArena::~KMatrixArena(){
+
+    for (size_t i = 0 ; i < chunks.size() ; i++){
+#ifdef KMATRIX_HAVE_MEMPOLICY
+        munmap(chunks[i].base, chunks[i].size);
+#else
+        ::operator delete(chunks[i].base, std::align_val_t(KMATRIX_CHUNK_ALIGN));
+#endif
+    }
+}
+
+/*
+ Allocates 'bytes' aligned to 'align' (at least a cache line). Reuses a freed block of the
+ same size if there is one, otherwise carves a new one, mapping another chunk (at least as
+ large as all the others together) if none has room.
+
+ Returns pointer to the storage. Throws std::bad_alloc if the OS refuses more memory.
+ */
+void* KMatrixArena::allocate(size_t bytes, size_t align){
+
+    if (align < KMATRIX_CACHE_LINE) align = KMATRIX_CACHE_LINE;
+    size_t size = round_up((bytes > 0) ? bytes : 1, KMATRIX_CACHE_LINE);
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    std::unordered_map<size_t, std::vector<void*> >::iterator it = free_blocks.find(size);
+    if (it != free_blocks.end()){
+        std::vector<void*>& blocks = it->second;
+        for (size_t i = blocks.size() ; i-- > 0 ; ){
+            if ((uintptr_t)blocks[i] % align == 0){
+                void* p = blocks[i];
+                blocks[i] = blocks.back();
+                blocks.pop_back();
+                free_bytes -= size;
+                live++;
+                return p;
+            }
+        }
+    }
+
+    void* p = carve(size, align);
+    if (p == NULL){
+        size_t mapped = 0;
+        for (size_t i = 0 ; i < chunks.size() ; i++) mapped += chunks[i].size;
+        map_chunk((mapped > size + align) ? mapped : size + align);
+        p = carve(size, align);
+    }
+    live++;
+
+    return p;
+}
+
+/*
+ Returns a block from allocate() to the arena. When it was the last one in use, the arena
+ is reset (see the class description).
+
+ Void return
+ */
+void KMatrixArena::deallocate(void* p, size_t bytes){
+
+    size_t size = round_up((bytes > 0) ? bytes : 1, KMATRIX_CACHE_LINE);
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    live--;
+    if (live == 0){
+        reset();
+        return;
+    }
+
+    try{
+        free_blocks[size].push_back(p);
+        free_bytes += size;
+    }catch(...){
+        //The block is only lost until the next reset
+    }
+}
+
+/*
+ Maps a chunk large enough for 'bytes' unless freed blocks or an existing chunk's unused
+ space already cover it, so that the rows of a matrix about to be filled share one
+ contiguous (and for the huge page policies, huge-page backed) chunk.
+
+ Void return
+ */
+void KMatrixArena::reserve(size_t bytes){
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (free_bytes >= bytes) return;
+    for (size_t i = 0 ; i < chunks.size() ; i++){
+        if (chunks[i].size - chunks[i].used >= bytes) return;
+    }
+
+    map_chunk(bytes);
+}
+
+int KMatrixArena::policy() const{
+    return pol;
+}
+
+/*
+ Returns the number of bytes mapped from the OS
+ */
+size_t KMatrixArena::mappedBytes() const{
+
+    std::lock_guard<std::mutex> lock(mtx);
+
+    size_t mapped = 0;
+    for (size_t i = 0 ; i < chunks.size() ; i++) mapped += chunks[i].size;
+
+    return mapped;
+}
+
+/*
+ Takes 'size' bytes aligned to 'align' from the unused end of the first chunk with room.
+
+ Returns the block, or NULL if no chunk has room
+ */
+void* KMatrixArena::carve(size_t size, size_t align){
+
+    for (size_t i = 0 ; i < chunks.size() ; i++){
+        Chunk& c = chunks[i];
+        size_t start = round_up((uintptr_t)(c.base + c.used), align) - (uintptr_t)c.base;
+        if (start + size <= c.size){
+            c.used = start + size;
+            return c.base + start;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ Maps a chunk of at least 'bytes' and applies the policy to it. Mapping alone does not
+ place any pages; that happens when they are first written.
+
+ Void return. Throws std::bad_alloc if the mapping fails.
+ */
+void KMatrixArena::map_chunk(size_t bytes){
+
+    Chunk c;
+    c.used = 0;
+    c.hugetlb = false;
+
+#ifdef KMATRIX_HAVE_MEMPOLICY
+    bool huge = (pol & (KMEM_HUGE_PAGES | KMEM_HUGETLB)) != 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    c.size = round_up((bytes > 0) ? bytes : 1, huge ? KMATRIX_HUGE_PAGE : page);
+    c.base = NULL;
+
+    if (pol & KMEM_HUGETLB){
+        void* p = mmap(NULL, c.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED){
+            c.base = (char*)p;
+            c.hugetlb = true;
+        }
+    }
+
+    if (c.base == NULL){
+        //Transparent huge pages need huge-page aligned memory, so map one extra huge page and
+        //trim the ends
+        size_t extra = huge ? KMATRIX_HUGE_PAGE : 0;
+        void* p = mmap(NULL, c.size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED){
+            throw std::bad_alloc();
+        }
+
+        char* raw = (char*)p;
+        c.base = raw;
+        if (huge){
+            c.base = (char*)round_up((uintptr_t)raw, KMATRIX_HUGE_PAGE);
+            if (c.base > raw) munmap(raw, (size_t)(c.base - raw));
+            size_t tail = (size_t)((raw + c.size + extra) - (c.base + c.size));
+            if (tail > 0) munmap(c.base + c.size, tail);
+            madvise(c.base, c.size, MADV_HUGEPAGE);
+        }
+    }
+
+    if (pol & KMEM_INTERLEAVE){
+        unsigned long nodes = online_nodes();
+        if ((nodes & (nodes - 1)) != 0){ //More than one node
+            syscall(SYS_mbind, c.base, c.size, KMATRIX_MPOL_INTERLEAVE, &nodes, 8*sizeof(nodes) + 1, 0);
+        }
+    }
+#else
+    c.size = round_up((bytes > 0) ? bytes : 1, KMATRIX_CHUNK_ALIGN);
+    c.base = (char*)::operator new(c.size, std::align_val_t(KMATRIX_CHUNK_ALIGN));
+#endif
+
+    try{
+        chunks.push_back(c);
+    }catch(...){
+#ifdef KMATRIX_HAVE_MEMPOLICY
+        munmap(c.base, c.size);
+#else
+        ::operator delete(c.base, std::align_val_t(KMATRIX_CHUNK_ALIGN));
+#endif
+        throw;
+    }
+}
+
+/*
+ Forgets every block and hands the used pages back to the OS (they read as zero and are
+ placed again when next written). The chunks stay mapped with their policy.
+
+ Void return
+ */
+void KMatrixArena::reset(){
+
+    free_blocks.clear();
+    free_bytes = 0;
+
+    for (size_t i = 0 ; i < chunks.size() ; i++){
+        Chunk& c = chunks[i];
+#ifdef KMATRIX_HAVE_MEMPOLICY
+        if (c.used > 0 && !c.hugetlb){
+            //Whole huge pages, so transparent huge pages are not split
+            bool huge = (pol & (KMEM_HUGE_PAGES | KMEM_HUGETLB)) != 0;
+            size_t unit = huge ? KMATRIX_HUGE_PAGE : (size_t)sysconf(_SC_PAGESIZE);
+            madvise(c.base, round_up(c.used, unit), MADV_DONTNEED);
+        }
+#endif
+        c.used = 0;
+    }
+}
@@ -0,0 +1,257 @@
+//
+//  KMatrixAllocator.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixAllocator_hpp
+#define KMatrixAllocator_hpp
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "KMatrixStats.hpp"
+
+#define KMATRIX_CACHE_LINE 64
+
+//Bytes in a (transparent or explicit) huge page. Memory for the huge page policies is mapped
+//in whole, aligned huge pages.
+#define KMATRIX_HUGE_PAGE (2*1024*1024)
+
+/*
+ How the storage of a matrix's rows is placed in memory (see KMatrix::setMemoryPolicy()).
+ The flags can be combined with |. Any policy other than KMEM_DEFAULT allocates the rows
+ from a KMatrixArena of freshly mapped memory instead of operator new.
+
+ KMEM_DEFAULT - operator new. Large matrices are still filled in parallel.
+ KMEM_FIRST_TOUCH - rows are always created and filled in parallel, each by the thread-pool
+                    worker that parallel kernels hand the same rows to. The OS puts a page on
+                    the NUMA node of the thread that first writes it, so each worker's rows
+                    end up in its own node's memory.
+ KMEM_INTERLEAVE - pages are spread round-robin across all NUMA nodes (takes precedence over
+                   KMEM_FIRST_TOUCH), so access from any socket sees the combined bandwidth
+                   of all of them.
+ KMEM_HUGE_PAGES - memory is mapped in huge-page aligned chunks and marked for transparent
+                   huge pages, which cuts TLB misses on large matrices.
+ KMEM_HUGETLB - memory comes from the kernel's reserved huge page pool, falling back to
+                transparent huge pages if the pool is empty.
+
+ Placement and huge pages are only available on Linux; elsewhere the policies still use an
+ arena and parallel first-touch filling, but the OS decides placement.
+ */
+enum KMatrixMemoryPolicy {
+    KMEM_DEFAULT = 0,
+    KMEM_FIRST_TOUCH = 1,
+    KMEM_INTERLEAVE = 2,
+    KMEM_HUGE_PAGES = 4,
+    KMEM_HUGETLB = 8
+};
+
+/*
+ Memory that the rows of one matrix (and its copies) are allocated from, mapped directly
+ from the OS in chunks with a KMatrixMemoryPolicy applied.
+
+ Rows are carved out of the chunks in order. A freed row is kept for the next row of the
+ same size, which is how a matrix's rows are usually replaced. Once every row has been
+ freed (as when a matrix is cleared and refilled), the pages are handed back to the OS
+ and the chunks reused from the start, so the next rows are placed by whoever touches them
+ first. Chunks are unmapped when the arena is destroyed, which happens after the last row
+ allocated from it is freed.
+
+ Allocation and deallocation are thread-safe.
+ */
+class KMatrixArena {
+public:
+
+    KMatrixArena(int policy);
+    ~KMatrixArena();
+    KMatrixArena(const KMatrixArena&) = delete;
+    KMatrixArena& operator=(const KMatrixArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align);
+    void deallocate(void* p, size_t bytes);
+    void reserve(size_t bytes);
+
+    int policy() const;
+    size_t mappedBytes() const;
+
+private:
+
+    struct Chunk {
+        char* base;
+        size_t size;
+        size_t used;
+        bool hugetlb;
+    };
+
+    void* carve(size_t size, size_t align);
+    void map_chunk(size_t bytes);
+    void reset();
+
+    int pol;
+    size_t live;
+    size_t free_bytes;
+    std::vector<Chunk> chunks;
+    std::unordered_map<size_t, std::vector<void*> > free_blocks;
+    mutable std::mutex mtx;
+};
+
+/*
+ Allocator used for each row of a KMatrix. With an alignment of 0 it behaves like
+ std::allocator. With a non-zero alignment (a power of two, in bytes) every allocation
+ starts on an 'alignment' boundary and is padded to a whole multiple of 'alignment'
+ bytes, so a row never shares a cache line (or SIMD load) with anything else.
+
+ Given a KMatrixArena, allocations come from it instead of operator new.
+
+ The alignment and arena are part of the allocator's state, so they are carried along when
+ rows are copied, moved or swapped.
+ */
+template <class T>
+class KMatrixAllocator {
+public:
+
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    KMatrixAllocator() noexcept;
+    KMatrixAllocator(size_t alignment) noexcept;
+    KMatrixAllocator(size_t alignment, std::shared_ptr<KMatrixArena> arena) noexcept;
+    template <class U>
+    KMatrixAllocator(const KMatrixAllocator<U>& other) noexcept;
+
+    T* allocate(size_t n);
+    void deallocate(T* p, size_t n) noexcept;
+
+    size_t alignment() const noexcept;
+    size_t padded(size_t n) const noexcept;
+    const std::shared_ptr<KMatrixArena>& arena() const noexcept;
+
+private:
+
+    size_t align;
+    std::shared_ptr<KMatrixArena> pool;
+};
+
+template <class T, class U>
+bool operator==(const KMatrixAllocator<T>& a, const KMatrixAllocator<U>& b);
+
+template <class T, class U>
+bool operator!=(const KMatrixAllocator<T>& a, const KMatrixAllocator<U>& b);
+
+/*
+ Creates an allocator with no alignment requirement beyond that of operator new.
+ */
+template <class T>
+KMatrixAllocator<T>::KMatrixAllocator() noexcept : align(0){
+
+}
+
+/*
+ Creates an allocator that aligns and pads every allocation to 'alignment' bytes.
+
+ alignment - alignment in bytes. Must be 0 or a power of two.
+ */
+template <class T>
+KMatrixAllocator<T>::KMatrixAllocator(size_t alignment) noexcept : align(alignment){
+
+}
+
+/*
+ Creates an allocator that aligns and pads every allocation to 'alignment' bytes and takes
+ the memory from 'arena' (operator new if it is NULL).
+ */
+template <class T>
+KMatrixAllocator<T>::KMatrixAllocator(size_t alignment, std::shared_ptr<KMatrixArena> arena) noexcept : align(alignment), pool(std::move(arena)){
+
+}
+
+template <class T>
+template <class U>
+KMatrixAllocator<T>::KMatrixAllocator(const KMatrixAllocator<U>& other) noexcept : align(other.alignment()), pool(other.arena()){
+
+}
+
+/*
+ Allocates storage for 'n' elements.
+
+ Returns pointer to the (uninitialized) storage
+ */
+template <class T>
+T* KMatrixAllocator<T>::allocate(size_t n){
+
+    KMATRIX_STAT_COUNT(KOP_ALLOCATE, 0, n*sizeof(T));
+
+    if (pool){
+        size_t bytes = (align == 0) ? n*sizeof(T) : (n*sizeof(T) + align - 1)/align*align;
+        return static_cast<T*>(pool->allocate(bytes, (align > alignof(T)) ? align : alignof(T)));
+    }
+
+    if (align == 0){
+        return static_cast<T*>(::operator new(n*sizeof(T)));
+    }
+
+    //Pad to a whole number of alignment blocks
+    size_t bytes = (n*sizeof(T) + align - 1)/align*align;
+    return static_cast<T*>(::operator new(bytes, std::align_val_t(align)));
+}
+
+template <class T>
+void KMatrixAllocator<T>::deallocate(T* p, size_t n) noexcept{
+
+    if (pool){
+        pool->deallocate(p, (align == 0) ? n*sizeof(T) : (n*sizeof(T) + align - 1)/align*align);
+    }else if (align == 0){
+        ::operator delete(p);
+    }else{
+        ::operator delete(p, std::align_val_t(align));
+    }
+}
+
+/*
+ Returns the alignment in bytes (0 if allocations only have operator new's alignment).
+ */
+template <class T>
+size_t KMatrixAllocator<T>::alignment() const noexcept{
+    return align;
+}
+
+/*
+ Returns the number of elements of storage actually reserved when 'n' elements are
+ requested (ie. 'n' rounded up to fill the last alignment block).
+ */
+template <class T>
+size_t KMatrixAllocator<T>::padded(size_t n) const noexcept{
+
+    if (align == 0) return n;
+
+    return (n*sizeof(T) + align - 1)/align*align/sizeof(T);
+}
+
+/*
+ Returns the arena allocations come from (NULL for operator new)
+ */
+template <class T>
+const std::shared_ptr<KMatrixArena>& KMatrixAllocator<T>::arena() const noexcept{
+    return pool;
+}
+
+template <class T, class U>
+bool operator==(const KMatrixAllocator<T>& a, const KMatrixAllocator<U>& b){
+    return a.alignment() == b.alignment() && a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const KMatrixAllocator<T>& a, const KMatrixAllocator<U>& b){
+    return !(a == b);
+}
+
+#endif /* KMatrixAllocator_hpp */
@@ -0,0 +1,373 @@
+//
+//  KMatrixAsync.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixAsync_hpp
+#define KMatrixAsync_hpp
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <utility>
+#include "KMatrix.hpp"
+#include "KMatrixFactor.hpp"
+#include "KMatrixKernels.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Asynchronous versions of the long-running operations. Each returns a KMatrixTask at once
+ and is queued on KThreadPool::drivers(), whose workers each drive one operation and hand
+ its parallel parts to the library thread pool (global()) as the blocking call would. The
+ driver pool's size (KMATRIX_ASYNC_THREADS) bounds how many operations run at once; the rest
+ wait in its queue. (The drivers are not global() workers: work started from a global()
+ worker runs serially, which would leave one core doing the whole product.)
+
+ An operation may itself start operations and wait for them. When get(), wait() or the
+ destructor of a KMatrixTask is called on a driver, the driver runs queued operations
+ itself until the one it waits for has finished, so the waits cannot deadlock however few
+ drivers there are. (wait_for() does not help in this way and only waits.)
+
+ Operands are taken by value, so the caller may modify or destroy its matrices while the
+ task runs; pass them with std::move to avoid the copy. The optional progress callback is
+ called with the completed fraction as the task advances (see KTaskControl).
+ */
+
+/*
+ Handle to a running operation returning R. Move-only, like std::future. Destroying a task
+ that has not finished cancels it and blocks until it stops. An operation still queued
+ stops as soon as a driver takes it up. A running one stops at its next
+ kmatrix_checkpoint(): within one kernel block for the multiplication kernels and
+ factorizations. Operations without checkpoints (eg. the eigensolvers, or any callable
+ given to kmatrix_async() that does not call it) cannot be interrupted, so the destructor
+ waits for them to finish.
+ */
+template <class R>
+class KMatrixTask {
+public:
+
+    KMatrixTask();
+    KMatrixTask(std::future<R>&& result, std::shared_ptr<KTaskControl> control);
+    ~KMatrixTask();
+
+    KMatrixTask(KMatrixTask&& other) = default;
+    KMatrixTask& operator=(KMatrixTask&& other);
+
+    R get();
+    void wait() const;
+    template <class Rep, class Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const;
+    bool ready() const;
+    bool valid() const;
+
+    void cancel();
+    bool cancelled() const;
+    double progress() const;
+
+private:
+
+    std::future<R> result;
+    std::shared_ptr<KTaskControl> control;
+};
+
+template <class F>
+KMatrixTask<decltype(std::declval<F&>()())> kmatrix_async(F fn, double work, KProgressCallback progress = KProgressCallback());
+
+template <class T>
+double kmatrix_mult_work(const KMatrix<T>& a, const KMatrix<T>& b, const KMultPolicy& policy);
+
+template <class T>
+KMatrixTask<KMatrix<T> > matrixMultAsync(KMatrix<T> a, KMatrix<T> b, KProgressCallback progress = KProgressCallback());
+
+template <class T>
+KMatrixTask<KMatrix<T> > matrixMultAsync(KMatrix<T> a, KMatrix<T> b, const KMultPolicy& policy, KProgressCallback progress = KProgressCallback());
+
+template <class T>
+KMatrixTask<KQR<T> > qrAsync(KMatrix<T> a, KProgressCallback progress = KProgressCallback());
+
+template <class T>
+KMatrixTask<KCholesky<T> > choleskyAsync(KMatrix<T> a, KProgressCallback progress = KProgressCallback());
+
+template <class T>
+KMatrixTask<KMatrix<T> > inverseAsync(KMatrix<T> a, KProgressCallback progress = KProgressCallback());
+
+/*----------------------------------------------------------------
+--------------------------- KMATRIXTASK --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to an empty task (valid() is false).
+ */
+template <class R>
+KMatrixTask<R>::KMatrixTask(){
+
+}
+
+/*
+ Wraps a running operation.
+
+ result - future for the operation's result
+ control - the operation's KTaskControl
+ */
+template <class R>
+KMatrixTask<R>::KMatrixTask(std::future<R>&& result, std::shared_ptr<KTaskControl> control) : result(std::move(result)), control(control){
+
+}
+
+template <class R>
+KMatrixTask<R>::~KMatrixTask(){
+    if (result.valid()){
+        control->cancel();
+        wait();
+    }
+}
+
+template <class R>
+KMatrixTask<R>& KMatrixTask<R>::operator=(KMatrixTask&& other){
+
+    if (this != &other){
+        if (result.valid()){
+            control->cancel();
+            wait();
+        }
+        result = std::move(other.result);
+        control = std::move(other.control);
+    }
+
+    return *this;
+}
+
+/*
+ Waits for the operation and returns its result. Rethrows any exception it threw, including
+ matrix_cancelled_exception if it was cancelled. Can be called once; afterwards valid() is
+ false.
+
+ Returns the result
+ */
+template <class R>
+R KMatrixTask<R>::get(){
+    wait();
+    return result.get();
+}
+
+/*
+ Waits for the operation to finish. Called on a driver, runs queued operations while it
+ waits (see above).
+
+ Void return
+ */
+template <class R>
+void KMatrixTask<R>::wait() const{
+
+    KThreadPool& drivers = KThreadPool::drivers();
+    if (drivers.on_worker()){
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+            if (!drivers.run_queued()){
+                result.wait_for(std::chrono::milliseconds(1)); //What it waits for is running elsewhere
+            }
+        }
+    }
+
+    result.wait();
+}
+
+/*
+ Waits for the operation to finish or for 'timeout' to pass.
+
+ Returns true if the operation has finished
+ */
+template <class R>
+template <class Rep, class Period>
+bool KMatrixTask<R>::wait_for(const std::chrono::duration<Rep, Period>& timeout) const{
+    return result.wait_for(timeout) == std::future_status::ready;
+}
+
+/*
+ Returns true if the operation has finished (get() will not block)
+ */
+template <class R>
+bool KMatrixTask<R>::ready() const{
+    return result.valid() && result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/*
+ Returns true if the task refers to an operation whose result has not been taken with get()
+ */
+template <class R>
+bool KMatrixTask<R>::valid() const{
+    return result.valid();
+}
+
+/*
+ Asks the operation to stop. It throws matrix_cancelled_exception (rethrown by get()) at
+ its next checkpoint, unless it finishes first.
+
+ Void return
+ */
+template <class R>
+void KMatrixTask<R>::cancel(){
+    if (control) control->cancel();
+}
+
+template <class R>
+bool KMatrixTask<R>::cancelled() const{
+    return control && control->cancelled();
+}
+
+/*
+ Returns the fraction of the operation completed, from 0 to 1
+ */
+template <class R>
+double KMatrixTask<R>::progress() const{
+    return control ? control->progress() : 0;
+}
+
+/*----------------------------------------------------------------
+--------------------------- FUNCTIONS ----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Runs 'fn' as a task on the driver pool (see above). Any KMatrix operation can be run this
+ way; the ones that call kmatrix_checkpoint() (the multiplication kernels and
+ factorizations) report progress and stop early when cancelled, and the rest are only
+ cancelled before they start.
+
+ fn - callable taking no arguments. It should own (capture by value) everything it uses.
+ work - total work fn will pass to kmatrix_checkpoint(), used to compute progress
+ progress - progress callback (may be empty)
+
+ Returns the task
+ */
+template <class F>
+KMatrixTask<decltype(std::declval<F&>()())> kmatrix_async(F fn, double work, KProgressCallback progress){
+
+    typedef decltype(std::declval<F&>()()) R;
+
+    std::shared_ptr<KTaskControl> control = std::make_shared<KTaskControl>(work, progress);
+
+    std::future<R> result = KThreadPool::drivers().submit([control, fn]() mutable {
+        KTaskControl::Scope scope(control.get());
+        kmatrix_checkpoint(0); //Cancelled before starting
+        R out = fn();
+        control->finish();
+        return out;
+    });
+
+    return KMatrixTask<R>(std::move(result), control);
+}
+
+/*
+ Work that matrixMult(a, b, policy) passes to kmatrix_checkpoint(): 2*m*k*n for the blocked
+ kernels, or the Strassen operation count when 'policy' selects Strassen.
+ */
+template <class T>
+double kmatrix_mult_work(const KMatrix<T>& a, const KMatrix<T>& b, const KMultPolicy& policy){
+
+    size_t n = a.rows();
+    size_t crossover = (policy.strassen_crossover < 1) ? 1 : policy.strassen_crossover;
+    if (!(policy.use_strassen && a.rows() == a.cols() && b.rows() == b.cols() && a.cols() == b.rows() && n > crossover)){
+        return 2.0*a.rows()*a.cols()*b.cols();
+    }
+
+    //Same depth and padding as strassenMult()
+    size_t levels = 0;
+    while (((n + ((size_t)1 << levels) - 1) >> levels) > crossover){
+        levels++;
+    }
+    size_t block = (n + ((size_t)1 << levels) - 1) >> levels;
+
+    return kmatrix_strassen_flops(block << levels, block);
+}
+
+/*
+ Asynchronous matrixMult(a, b), using the global multiplication policy at the time of the call.
+
+ a - left matrix
+ b - right matrix
+ progress - progress callback (may be empty)
+
+ Returns the task, whose result is the product
+ */
+template <class T>
+KMatrixTask<KMatrix<T> > matrixMultAsync(KMatrix<T> a, KMatrix<T> b, KProgressCallback progress){
+    return matrixMultAsync(std::move(a), std::move(b), kmatrix_mult_policy(), progress);
+}
+
+/*
+ Asynchronous matrixMult(a, b, policy).
+
+ a - left matrix
+ b - right matrix
+ policy - algorithm selection
+ progress - progress callback (may be empty)
+
+ Returns the task, whose result is the product
+ */
+template <class T>
+KMatrixTask<KMatrix<T> > matrixMultAsync(KMatrix<T> a, KMatrix<T> b, const KMultPolicy& policy, KProgressCallback progress){
+
+    double work = kmatrix_mult_work(a, b, policy);
+    std::shared_ptr<KMatrix<T> > ap = std::make_shared<KMatrix<T> >(std::move(a));
+    std::shared_ptr<KMatrix<T> > bp = std::make_shared<KMatrix<T> >(std::move(b));
+
+    return kmatrix_async([ap, bp, policy](){ return matrixMult(*ap, *bp, policy); }, work, progress);
+}
+
+/*
+ Asynchronous QR factorization (see KQR).
+
+ a - matrix to factor
+ progress - progress callback (may be empty)
+
+ Returns the task, whose result is the factorization
+ */
+template <class T>
+KMatrixTask<KQR<T> > qrAsync(KMatrix<T> a, KProgressCallback progress){
+
+    size_t kmax = (a.rows() < a.cols()) ? a.rows() : a.cols();
+    double work = kmatrix_qr_work(a.rows(), a.cols(), 0, kmax);
+    std::shared_ptr<KMatrix<T> > ap = std::make_shared<KMatrix<T> >(std::move(a));
+
+    return kmatrix_async([ap](){ return KQR<T>(*ap); }, work, progress);
+}
+
+/*
+ Asynchronous Cholesky factorization (see KCholesky). A matrix that is not positive definite
+ makes get() throw matrix_factorization_exception.
+
+ a - symmetric (Hermitian) positive definite matrix
+ progress - progress callback (may be empty)
+
+ Returns the task, whose result is the factorization
+ */
+template <class T>
+KMatrixTask<KCholesky<T> > choleskyAsync(KMatrix<T> a, KProgressCallback progress){
+
+    double work = kmatrix_cholesky_work(a.rows(), 0, a.rows());
+    std::shared_ptr<KMatrix<T> > ap = std::make_shared<KMatrix<T> >(std::move(a));
+
+    return kmatrix_async([ap](){ return KCholesky<T>(*ap); }, work, progress);
+}
+
+/*
+ Asynchronous a.inverse(). A singular matrix makes get() throw
+ matrix_factorization_exception.
+
+ a - square matrix to invert
+ progress - progress callback (may be empty)
+
+ Returns the task, whose result is the inverse
+ */
+template <class T>
+KMatrixTask<KMatrix<T> > inverseAsync(KMatrix<T> a, KProgressCallback progress){
+
+    double work = kmatrix_lu_work(a.rows(), 0, a.rows()) + kmatrix_lu_solve_work(a.rows(), a.rows());
+    std::shared_ptr<KMatrix<T> > ap = std::make_shared<KMatrix<T> >(std::move(a));
+
+    return kmatrix_async([ap](){ return ap->inverse(); }, work, progress);
+}
+
+#endif /* KMatrixAsync_hpp */
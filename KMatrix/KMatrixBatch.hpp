@@ -0,0 +1,636 @@
+//
+//  KMatrixBatch.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixBatch_hpp
+#define KMatrixBatch_hpp
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include "KMatrix.hpp"
+#include "KVector.hpp"
+#include "KMatrixAllocator.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Smallest number of matrices handed to one thread by the batch functions. Batches smaller
+ than this run on the calling thread.
+ */
+#define KMATRIX_BATCH_GRAIN 1024
+
+/*
+ A batch of 'count' matrices that all have the same size. The matrices are stored
+ interleaved in one cache-line aligned buffer: element (r, c) of every matrix in the batch
+ is stored contiguously, followed by element (r, c+1) of every matrix, and so on. The batch
+ functions below loop over the batch index innermost, so each step of the math is applied
+ to many matrices at once with unit-stride (vectorizable) loads, and split the batch across
+ the library thread pool.
+ */
+template <class T>
+class KMatrixBatch {
+public:
+
+    //Initializers
+    KMatrixBatch();
+    KMatrixBatch(size_t count, int rows, int cols);
+    KMatrixBatch(const std::vector<KMatrix<T> >& init);
+
+    void clear();
+    void clear(size_t count, int rows, int cols);
+
+    //Access
+    T& operator()(size_t idx, int r, int c);
+    T get(size_t idx, int r, int c) const;
+    KMatrix<T> getMatrix(size_t idx) const;
+    void setMatrix(size_t idx, const KMatrix<T>& km);
+
+    T* lane(int r, int c);
+    const T* lane(int r, int c) const;
+
+    size_t count() const;
+    size_t rows() const;
+    size_t cols() const;
+
+    //Element-wise operators
+    KMatrixBatch<T>& operator+=(const KMatrixBatch<T>& rv);
+    KMatrixBatch<T>& operator-=(const KMatrixBatch<T>& rv);
+    KMatrixBatch<T>& operator*=(const KMatrixBatch<T>& rv);
+    KMatrixBatch<T>& operator/=(const KMatrixBatch<T>& rv);
+
+private:
+
+    std::vector<T, KMatrixAllocator<T> > data;
+    size_t n;
+    size_t nr;
+    size_t nc;
+
+    matrix_bounds_excep mat_bnd_ex;
+    matrix_multiplication_exception mat_mult_ex;
+};
+
+template <class T>
+KMatrixBatch<T> batchMult(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b);
+
+template <class T>
+KMatrixBatch<T> batchElementMult(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b);
+
+template <class T>
+KMatrixBatch<T> batchAdd(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b);
+
+template <class T>
+KMatrixBatch<T> batchSubtract(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b);
+
+template <class T>
+KMatrixBatch<T> batchDivide(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b);
+
+template <class T, class F>
+KMatrixBatch<T> batchApply(const KMatrixBatch<T>& a, F fn);
+
+template <class T>
+KMatrixBatch<T> batchInverse(const KMatrixBatch<T>& a, std::vector<bool>* singular=NULL);
+
+template <class T>
+KVector<T> batchDeterminant(const KMatrixBatch<T>& a);
+
+typedef KMatrixBatch<double> KMatBatch;
+
+/*----------------------------------------------------------------
+-------------------------- INITIALIZERS --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to an empty batch.
+ */
+template <class T>
+KMatrixBatch<T>::KMatrixBatch() : data(KMatrixAllocator<T>(KMATRIX_CACHE_LINE)), n(0), nr(0), nc(0){
+
+}
+
+/*
+ Initializes a batch of 'count' matrices of size 'rows'x'cols'. Each element is value-initialized.
+
+ count - number of matrices
+ rows - number of rows in each matrix
+ cols - number of columns in each matrix
+ */
+template <class T>
+KMatrixBatch<T>::KMatrixBatch(size_t count, int rows, int cols) : data(KMatrixAllocator<T>(KMATRIX_CACHE_LINE)), n(0), nr(0), nc(0){
+    clear(count, rows, cols);
+}
+
+/*
+ Initializes a batch from a list of matrices. All matrices must be the same size as the first.
+
+ init - matrices to copy into the batch
+ */
+template <class T>
+KMatrixBatch<T>::KMatrixBatch(const std::vector<KMatrix<T> >& init) : data(KMatrixAllocator<T>(KMATRIX_CACHE_LINE)), n(0), nr(0), nc(0){
+
+    if (init.size() < 1) return;
+
+    clear(init.size(), (int)init[0].rows(), (int)init[0].cols());
+    for (size_t i = 0 ; i < init.size() ; i++){
+        setMatrix(i, init[i]);
+    }
+}
+
+/*
+ Clears the batch, resulting in 0 matrices of size 0x0
+ */
+template <class T>
+void KMatrixBatch<T>::clear(){
+    data.clear();
+    n = 0;
+    nr = 0;
+    nc = 0;
+}
+
+/*
+ Clears the batch and resizes it to 'count' matrices of size 'rows'x'cols'. Each element
+ is value-initialized.
+
+ Void return
+ */
+template <class T>
+void KMatrixBatch<T>::clear(size_t count, int rows, int cols){
+    data.assign(count*rows*cols, T());
+    n = count;
+    nr = rows;
+    nc = cols;
+}
+
+//Access
+
+template <class T>
+T& KMatrixBatch<T>::operator()(size_t idx, int r, int c){
+
+    if (idx >= n || r >= (int)nr || c >= (int)nc){
+        throw mat_bnd_ex;
+    }
+
+    return data[(r*nc + c)*n + idx];
+}
+
+template <class T>
+T KMatrixBatch<T>::get(size_t idx, int r, int c) const{
+    return data[(r*nc + c)*n + idx];
+}
+
+/*
+ Copies matrix 'idx' out of the batch.
+
+ Returns the matrix
+ */
+template <class T>
+KMatrix<T> KMatrixBatch<T>::getMatrix(size_t idx) const{
+
+    if (idx >= n){
+        throw mat_bnd_ex;
+    }
+
+    KMatrix<T> out((int)nr, (int)nc);
+    for (size_t r = 0 ; r < nr ; r++){
+        for (size_t c = 0 ; c < nc ; c++){
+            out(r, c) = get(idx, r, c);
+        }
+    }
+
+    return out;
+}
+
+/*
+ Copies 'km' into slot 'idx' of the batch. 'km' must be the same size as the batch's matrices.
+
+ Void return
+ */
+template <class T>
+void KMatrixBatch<T>::setMatrix(size_t idx, const KMatrix<T>& km){
+
+    if (idx >= n){
+        throw mat_bnd_ex;
+    }
+    if (km.rows() != nr || km.cols() != nc){
+        throw mat_mult_ex;
+    }
+
+    for (size_t r = 0 ; r < nr ; r++){
+        for (size_t c = 0 ; c < nc ; c++){
+            data[(r*nc + c)*n + idx] = km.get(r, c);
+        }
+    }
+}
+
+/*
+ Returns a pointer to element (r, c) of the first matrix. Element (r, c) of matrix 'i' is at
+ lane(r, c)[i].
+ */
+template <class T>
+T* KMatrixBatch<T>::lane(int r, int c){
+    return data.data() + (r*nc + c)*n;
+}
+
+template <class T>
+const T* KMatrixBatch<T>::lane(int r, int c) const{
+    return data.data() + (r*nc + c)*n;
+}
+
+/*
+ Returns the number of matrices in the batch
+ */
+template <class T>
+size_t KMatrixBatch<T>::count() const{
+    return n;
+}
+
+template <class T>
+size_t KMatrixBatch<T>::rows() const{
+    return nr;
+}
+
+template <class T>
+size_t KMatrixBatch<T>::cols() const{
+    return nc;
+}
+
+//Element-wise operators. The storage is identical for both operands, so these are flat loops.
+
+template <class T>
+KMatrixBatch<T>& KMatrixBatch<T>::operator+=(const KMatrixBatch<T>& rv){
+
+    if (n != rv.n || nr != rv.nr || nc != rv.nc){
+        throw mat_mult_ex;
+    }
+
+    T* out = data.data();
+    const T* in = rv.data.data();
+    KThreadPool::global().parallel_for(0, data.size(), [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++) out[i] += in[i];
+    }, KMATRIX_BATCH_GRAIN);
+
+    return *this;
+}
+
+template <class T>
+KMatrixBatch<T>& KMatrixBatch<T>::operator-=(const KMatrixBatch<T>& rv){
+
+    if (n != rv.n || nr != rv.nr || nc != rv.nc){
+        throw mat_mult_ex;
+    }
+
+    T* out = data.data();
+    const T* in = rv.data.data();
+    KThreadPool::global().parallel_for(0, data.size(), [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++) out[i] -= in[i];
+    }, KMATRIX_BATCH_GRAIN);
+
+    return *this;
+}
+
+template <class T>
+KMatrixBatch<T>& KMatrixBatch<T>::operator*=(const KMatrixBatch<T>& rv){
+
+    if (n != rv.n || nr != rv.nr || nc != rv.nc){
+        throw mat_mult_ex;
+    }
+
+    T* out = data.data();
+    const T* in = rv.data.data();
+    KThreadPool::global().parallel_for(0, data.size(), [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++) out[i] *= in[i];
+    }, KMATRIX_BATCH_GRAIN);
+
+    return *this;
+}
+
+template <class T>
+KMatrixBatch<T>& KMatrixBatch<T>::operator/=(const KMatrixBatch<T>& rv){
+
+    if (n != rv.n || nr != rv.nr || nc != rv.nc){
+        throw mat_mult_ex;
+    }
+
+    T* out = data.data();
+    const T* in = rv.data.data();
+    KThreadPool::global().parallel_for(0, data.size(), [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++) out[i] /= in[i];
+    }, KMATRIX_BATCH_GRAIN);
+
+    return *this;
+}
+
+/*----------------------------------------------------------------
+------------------------ BATCH FUNCTIONS -------------------------
+----------------------------------------------------------------*/
+
+/*
+ Multiplies each matrix in 'a' by the matching matrix in 'b' using matrix multiplication.
+
+ a - batch of left matrices
+ b - batch of right matrices (same count as 'a')
+
+ Returns the batch of products
+ */
+template <class T>
+KMatrixBatch<T> batchMult(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b){
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.cols() != b.rows() || a.count() != b.count()){
+        throw mat_mult_ex;
+    }
+
+    KMatrixBatch<T> result(a.count(), (int)a.rows(), (int)b.cols());
+
+    KThreadPool::global().parallel_for(0, a.count(), [&](size_t lo, size_t hi){
+        for (size_t r = 0 ; r < a.rows() ; r++){
+            for (size_t c = 0 ; c < b.cols() ; c++){
+                T* out = result.lane(r, c);
+                for (size_t i = 0 ; i < a.cols() ; i++){
+                    const T* x = a.lane(r, i);
+                    const T* y = b.lane(i, c);
+                    for (size_t k = lo ; k < hi ; k++){
+                        out[k] += x[k] * y[k];
+                    }
+                }
+            }
+        }
+    }, KMATRIX_BATCH_GRAIN);
+
+    return result;
+}
+
+/*
+ Multiplies each matrix in 'a' by the matching matrix in 'b' element-wise.
+
+ Returns the batch of products
+ */
+template <class T>
+KMatrixBatch<T> batchElementMult(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b){
+    KMatrixBatch<T> result(a);
+    result *= b;
+    return result;
+}
+
+/*
+ Adds each matrix in 'a' to the matching matrix in 'b'.
+
+ Returns the batch of sums
+ */
+template <class T>
+KMatrixBatch<T> batchAdd(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b){
+    KMatrixBatch<T> result(a);
+    result += b;
+    return result;
+}
+
+/*
+ Subtracts each matrix in 'b' from the matching matrix in 'a'.
+
+ Returns the batch of differences
+ */
+template <class T>
+KMatrixBatch<T> batchSubtract(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b){
+    KMatrixBatch<T> result(a);
+    result -= b;
+    return result;
+}
+
+/*
+ Divides each matrix in 'a' by the matching matrix in 'b' element-wise.
+
+ Returns the batch of quotients
+ */
+template <class T>
+KMatrixBatch<T> batchDivide(const KMatrixBatch<T>& a, const KMatrixBatch<T>& b){
+    KMatrixBatch<T> result(a);
+    result /= b;
+    return result;
+}
+
+/*
+ Applies 'fn' to every element of every matrix in the batch (eg. batchApply(a, [](double x){ return std::sin(x); })).
+
+ a - input batch
+ fn - callable taking and returning T
+
+ Returns the batch of results
+ */
+template <class T, class F>
+KMatrixBatch<T> batchApply(const KMatrixBatch<T>& a, F fn){
+
+    KMatrixBatch<T> result(a);
+
+    T* out = result.lane(0, 0);
+    size_t total = a.count()*a.rows()*a.cols();
+    KThreadPool::global().parallel_for(0, total, [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++) out[i] = fn(out[i]);
+    }, KMATRIX_BATCH_GRAIN);
+
+    return result;
+}
+
+/*
+ Swaps rows 'r1' and 'r2' of matrix 'k' in a batch. Used for per-matrix pivoting.
+ */
+template <class T>
+void batchSwapRows(KMatrixBatch<T>& a, size_t k, size_t r1, size_t r2){
+    for (size_t c = 0 ; c < a.cols() ; c++){
+        T temp = a.lane(r1, c)[k];
+        a.lane(r1, c)[k] = a.lane(r2, c)[k];
+        a.lane(r2, c)[k] = temp;
+    }
+}
+
+/*
+ Inverts every matrix in the batch by Gauss-Jordan elimination with partial pivoting.
+ Pivot rows are chosen (and swapped) separately for each matrix; the eliminations are then
+ identical for every matrix and run across the batch. A matrix is singular if one of its
+ pivots is no larger than dim*epsilon times its largest element, as for KMatrix::inverse().
+ Only floating point and complex element types can be inverted.
+
+ a - batch of square matrices
+ singular - if not NULL, set to one flag per matrix, true where the matrix is singular. Its
+            slot of the result is then left as the identity. If NULL, a singular matrix
+            throws instead.
+
+ Returns the batch of inverses. Throws matrix_multiplication_exception if the matrices are not
+ square and, when 'singular' is NULL, matrix_factorization_exception if any is singular.
+ */
+template <class T>
+KMatrixBatch<T> batchInverse(const KMatrixBatch<T>& a, std::vector<bool>* singular){
+
+    static_assert(!std::is_integral<T>::value, "batchInverse() needs a floating point or complex element type");
+
+    typedef typename kmatrix_accum<typename kmatrix_real<T>::type>::type R;
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    size_t dim = a.rows();
+    KMatrixBatch<T> work(a);
+    KMatrixBatch<T> result(a.count(), (int)dim, (int)dim);
+    std::vector<char> failed(a.count(), 0);
+
+    KThreadPool::global().parallel_for(0, a.count(), [&](size_t lo, size_t hi){
+
+        std::vector<T> factor(hi - lo);
+        std::vector<double> tol(hi - lo, 0.0);
+
+        //Start from the identity
+        for (size_t d = 0 ; d < dim ; d++){
+            T* out = result.lane(d, d);
+            for (size_t k = lo ; k < hi ; k++) out[k] = 1;
+        }
+
+        //Singularity threshold of each matrix
+        for (size_t r = 0 ; r < dim ; r++){
+            for (size_t c = 0 ; c < dim ; c++){
+                const T* in = a.lane(r, c);
+                for (size_t k = lo ; k < hi ; k++){
+                    double x = std::abs(in[k]);
+                    if (x > tol[k-lo]) tol[k-lo] = x;
+                }
+            }
+        }
+        for (size_t k = lo ; k < hi ; k++) tol[k-lo] *= dim*(double)std::numeric_limits<R>::epsilon();
+
+        for (size_t p = 0 ; p < dim ; p++){
+
+            //Choose and swap in the pivot for each matrix
+            for (size_t k = lo ; k < hi ; k++){
+                size_t best = p;
+                for (size_t r = p+1 ; r < dim ; r++){
+                    if (std::abs(work.lane(r, p)[k]) > std::abs(work.lane(best, p)[k])) best = r;
+                }
+                if (best != p){
+                    batchSwapRows(work, k, p, best);
+                    batchSwapRows(result, k, p, best);
+                }
+            }
+
+            //Scale pivot row. A singular matrix (and its result) is replaced by the identity,
+            //which the remaining steps leave unchanged, so it carries no infinities.
+            for (size_t k = lo ; k < hi ; k++){
+                if (!failed[k] && !(std::abs(work.lane(p, p)[k]) > tol[k-lo])){
+                    failed[k] = 1;
+                    for (size_t r = 0 ; r < dim ; r++){
+                        for (size_t c = 0 ; c < dim ; c++){
+                            work.lane(r, c)[k] = (r == c) ? T(1) : T(0);
+                            result.lane(r, c)[k] = (r == c) ? T(1) : T(0);
+                        }
+                    }
+                }
+                factor[k-lo] = T(1)/work.lane(p, p)[k];
+            }
+            for (size_t c = 0 ; c < dim ; c++){
+                T* w = work.lane(p, c);
+                T* o = result.lane(p, c);
+                for (size_t k = lo ; k < hi ; k++){
+                    w[k] *= factor[k-lo];
+                    o[k] *= factor[k-lo];
+                }
+            }
+
+            //Eliminate column 'p' from every other row
+            for (size_t r = 0 ; r < dim ; r++){
+                if (r == p) continue;
+                const T* col = work.lane(r, p);
+                for (size_t k = lo ; k < hi ; k++) factor[k-lo] = col[k];
+                for (size_t c = 0 ; c < dim ; c++){
+                    T* w = work.lane(r, c);
+                    T* o = result.lane(r, c);
+                    const T* wp = work.lane(p, c);
+                    const T* op = result.lane(p, c);
+                    for (size_t k = lo ; k < hi ; k++){
+                        w[k] -= factor[k-lo]*wp[k];
+                        o[k] -= factor[k-lo]*op[k];
+                    }
+                }
+            }
+        }
+
+    }, KMATRIX_BATCH_GRAIN);
+
+    if (singular != NULL){
+        singular->assign(failed.begin(), failed.end());
+    }else if (std::find(failed.begin(), failed.end(), 1) != failed.end()){
+        throw matrix_factorization_exception();
+    }
+
+    return result;
+}
+
+/*
+ Calculates the determinant of every matrix in the batch by LU decomposition with partial
+ pivoting (pivots chosen per matrix, eliminations run across the batch).
+
+ a - batch of square matrices
+
+ Returns a KVector with the determinant of matrix 'i' in element 'i'
+ */
+template <class T>
+KVector<T> batchDeterminant(const KMatrixBatch<T>& a){
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    size_t dim = a.rows();
+    KMatrixBatch<T> work(a);
+    std::vector<T> det(a.count(), T(1));
+
+    KThreadPool::global().parallel_for(0, a.count(), [&](size_t lo, size_t hi){
+
+        std::vector<T> factor(hi - lo);
+
+        for (size_t p = 0 ; p < dim ; p++){
+
+            //Choose and swap in the pivot for each matrix
+            for (size_t k = lo ; k < hi ; k++){
+                size_t best = p;
+                for (size_t r = p+1 ; r < dim ; r++){
+                    if (std::abs(work.lane(r, p)[k]) > std::abs(work.lane(best, p)[k])) best = r;
+                }
+                if (best != p){
+                    batchSwapRows(work, k, p, best);
+                    det[k] = -det[k];
+                }
+            }
+
+            //Accumulate pivot, then eliminate below it
+            const T* piv = work.lane(p, p);
+            for (size_t k = lo ; k < hi ; k++){
+                det[k] *= piv[k];
+                factor[k-lo] = (piv[k] == T(0)) ? T(0) : T(1)/piv[k];
+            }
+            for (size_t r = p+1 ; r < dim ; r++){
+                T* col = work.lane(r, p);
+                for (size_t k = lo ; k < hi ; k++) col[k] *= factor[k-lo];
+                for (size_t c = p+1 ; c < dim ; c++){
+                    T* w = work.lane(r, c);
+                    const T* wp = work.lane(p, c);
+                    for (size_t k = lo ; k < hi ; k++){
+                        w[k] -= col[k]*wp[k];
+                    }
+                }
+            }
+        }
+
+    }, KMATRIX_BATCH_GRAIN);
+
+    return KVector<T>(det);
+}
+
+#endif /* KMatrixBatch_hpp */
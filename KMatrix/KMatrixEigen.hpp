@@ -0,0 +1,1628 @@
+//
+//  KMatrixEigen.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixEigen_hpp
+#define KMatrixEigen_hpp
+
+#include <vector>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include "KMatrix.hpp"
+#include "KVector.hpp"
+#include "KMatrixKernels.hpp"
+#include "KMatrixFactor.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Eigenvalue decompositions of KMatrix objects.
+
+ KSymEigen - all eigenpairs of a symmetric (Hermitian) matrix. Householder reduction to real
+             tridiagonal form, then Cuppen's divide-and-conquer (or QL if only eigenvalues
+             are requested).
+ KEigen - all eigenpairs of a general matrix. Householder reduction to Hessenberg form, then
+          shifted complex QR to Schur form. Results are complex even for real input.
+ KLanczos - a few eigenpairs of a large symmetric (Hermitian) matrix.
+ KArnoldi - a few eigenpairs of a large general matrix.
+
+ Lanczos and Arnoldi only touch the matrix through products A*x, so they can also be given a
+ function in place of a KMatrix.
+ */
+
+//Tridiagonal problems at or below this size are solved directly by QL in divide-and-conquer
+#define KMATRIX_DC_CUTOFF 25
+
+//Maximum QR/QL iterations per eigenvalue before giving up
+#define KMATRIX_EIGEN_MAXITER 100
+
+//Maximum restarts of KLanczos and KArnoldi before giving up
+#define KMATRIX_KRYLOV_RESTARTS 500
+
+//Which eigenvalues KLanczos and KArnoldi look for. Complex values are ordered by real part.
+enum KEigenWhich {
+    KEIG_LARGEST_MAGNITUDE,
+    KEIG_LARGEST,
+    KEIG_SMALLEST
+};
+
+/*
+ All eigenvalues (ascending) and optionally eigenvectors (as columns) of a symmetric or
+ Hermitian matrix. Only the lower triangle is read.
+ */
+template <class T>
+class KSymEigen {
+public:
+
+    typedef typename kmatrix_real<T>::type real_type;
+
+    KSymEigen();
+    KSymEigen(const KMatrix<T>& a, bool vectors = true);
+
+    void compute(const KMatrix<T>& a, bool vectors = true);
+
+    KVector<real_type> values() const;
+    KMatrix<T> vectors() const;
+
+    size_t size() const;
+
+private:
+
+    std::vector<real_type> vals;
+    std::vector<T> vecs;
+    size_t n;
+};
+
+/*
+ All eigenvalues and optionally eigenvectors (as unit-length columns) of a general square
+ matrix. Eigenvalues are in the order they appear on the diagonal of the Schur form.
+ */
+template <class T>
+class KEigen {
+public:
+
+    typedef typename kmatrix_complex<T>::type complex_type;
+
+    KEigen();
+    KEigen(const KMatrix<T>& a, bool vectors = true);
+
+    void compute(const KMatrix<T>& a, bool vectors = true);
+
+    KVector<complex_type> values() const;
+    KMatrix<complex_type> vectors() const;
+    KMatrix<complex_type> getSchur() const;
+    KMatrix<complex_type> getSchurVectors() const;
+
+    size_t size() const;
+
+private:
+
+    std::vector<complex_type> schur;
+    std::vector<complex_type> z;
+    std::vector<complex_type> vecs;
+    size_t n;
+};
+
+/*
+ 'k' eigenpairs of a symmetric (Hermitian) operator by the thick-restart Lanczos method with
+ full reorthogonalization. The Krylov basis grows to at most 'max_basis' vectors (default:
+ min(n, max(2k+40, 4k))). If the selected Ritz pairs have not converged by then, the basis is
+ compressed to the best Ritz vectors (k plus half the remaining room) and extended again.
+ Throws matrix_convergence_exception if they have still not converged after
+ KMATRIX_KRYLOV_RESTARTS restarts.
+ */
+template <class T>
+class KLanczos {
+public:
+
+    typedef typename kmatrix_real<T>::type real_type;
+
+    KLanczos();
+    KLanczos(const KMatrix<T>& a, size_t k, KEigenWhich which = KEIG_LARGEST_MAGNITUDE, double tol = 1e-10, size_t max_basis = 0);
+    KLanczos(std::function<void(const T*, T*)> op, size_t n, size_t k, KEigenWhich which = KEIG_LARGEST_MAGNITUDE, double tol = 1e-10, size_t max_basis = 0);
+
+    void compute(std::function<void(const T*, T*)> op, size_t n, size_t k, KEigenWhich which = KEIG_LARGEST_MAGNITUDE, double tol = 1e-10, size_t max_basis = 0);
+
+    KVector<real_type> values() const;
+    KMatrix<T> vectors() const;
+
+    bool converged() const;
+    size_t basisSize() const;
+    size_t restarts() const;
+
+private:
+
+    std::vector<real_type> vals;
+    KMatrix<T> vecs;
+    bool conv;
+    size_t basis;
+    size_t nrestart;
+};
+
+/*
+ 'k' eigenpairs of a general operator by the Arnoldi method with full reorthogonalization,
+ restarted in Krylov-Schur form. The Krylov basis grows to at most 'max_basis' vectors
+ (default: min(n, max(2k+40, 4k))). If the selected Ritz pairs have not converged by then,
+ the Schur form of the projected matrix is reordered to put them first and the basis is
+ compressed to the leading Schur vectors (k plus half the remaining room), then extended
+ again. Throws matrix_convergence_exception if they have still not converged after
+ KMATRIX_KRYLOV_RESTARTS restarts.
+ */
+template <class T>
+class KArnoldi {
+public:
+
+    typedef typename kmatrix_complex<T>::type complex_type;
+
+    KArnoldi();
+    KArnoldi(const KMatrix<T>& a, size_t k, KEigenWhich which = KEIG_LARGEST_MAGNITUDE, double tol = 1e-10, size_t max_basis = 0);
+    KArnoldi(std::function<void(const complex_type*, complex_type*)> op, size_t n, size_t k, KEigenWhich which = KEIG_LARGEST_MAGNITUDE, double tol = 1e-10, size_t max_basis = 0);
+
+    void compute(std::function<void(const complex_type*, complex_type*)> op, size_t n, size_t k, KEigenWhich which = KEIG_LARGEST_MAGNITUDE, double tol = 1e-10, size_t max_basis = 0);
+
+    KVector<complex_type> values() const;
+    KMatrix<complex_type> vectors() const;
+
+    bool converged() const;
+    size_t basisSize() const;
+    size_t restarts() const;
+
+private:
+
+    std::vector<complex_type> vals;
+    KMatrix<complex_type> vecs;
+    bool conv;
+    size_t basis;
+    size_t nrestart;
+};
+
+/*----------------------------------------------------------------
+----------------------- TRIDIAGONAL SOLVERS ----------------------
+----------------------------------------------------------------*/
+
+/*
+ Implicit QL on a real symmetric tridiagonal matrix. On return 'd' holds the eigenvalues
+ (unsorted) and, if 'vectors', the columns of 'z' have been rotated by the eigenvectors (so
+ starting from the identity they become the eigenvectors).
+
+ n - dimension
+ d - diagonal (length n)
+ e - subdiagonal, e[i] between rows i and i+1 (length n, e[n-1] is workspace). Destroyed.
+ z - row-major n x n matrix with leading dimension 'ldz'
+
+ Void return
+ */
+template <class R>
+void kmatrix_tridiag_ql(size_t n, R* d, R* e, R* z, size_t ldz, bool vectors){
+
+    matrix_convergence_exception conv_ex;
+    const R eps = std::numeric_limits<R>::epsilon();
+
+    if (n == 0) return;
+    e[n-1] = 0;
+
+    for (long l = 0 ; l < (long)n ; l++){
+        size_t iter = 0;
+        long m;
+        do{
+            for (m = l ; m < (long)n-1 ; m++){
+                R dd = std::abs(d[m]) + std::abs(d[m+1]);
+                if (std::abs(e[m]) <= eps*dd) break;
+            }
+            if (m == l) break;
+
+            if (iter++ == KMATRIX_EIGEN_MAXITER){
+                throw conv_ex;
+            }
+
+            R g = (d[l+1] - d[l])/(2*e[l]);
+            R r = std::hypot(g, R(1));
+            g = d[m] - d[l] + e[l]/(g + ((g >= 0) ? r : -r));
+            R s = 1, c = 1, p = 0;
+            long i;
+            bool underflow = false;
+            for (i = m-1 ; i >= l ; i--){
+                R f = s*e[i];
+                R b = c*e[i];
+                r = std::hypot(f, g);
+                e[i+1] = r;
+                if (r == 0){
+                    d[i+1] -= p;
+                    e[m] = 0;
+                    underflow = true;
+                    break;
+                }
+                s = f/r;
+                c = g/r;
+                g = d[i+1] - p;
+                r = (d[i] - g)*s + 2*c*b;
+                p = s*r;
+                d[i+1] = g + p;
+                g = c*r - b;
+                if (vectors){
+                    for (size_t k = 0 ; k < n ; k++){
+                        R* zk = z + k*ldz;
+                        f = zk[i+1];
+                        zk[i+1] = s*zk[i] + c*f;
+                        zk[i] = c*zk[i] - s*f;
+                    }
+                }
+            }
+            if (underflow) continue;
+            d[l] -= p;
+            e[l] = g;
+            e[m] = 0;
+        }while (true);
+    }
+}
+
+/*
+ Solves the secular equation of the rank-one update diag(d) + rho*z*z^T for all its
+ eigenvalues. 'd' must be strictly ascending and rho > 0. Each root is found relative to its
+ nearest pole so that d[j] - lambda[i] is accurate.
+
+ k - dimension
+ d, z - poles and update vector
+ rho - update weight
+ lam - output eigenvalues (ascending)
+ del - output k x k matrix, del[i*k + j] = d[j] - lam[i]
+
+ Void return
+ */
+template <class R>
+void kmatrix_secular(size_t k, const R* d, const R* z, R rho, R* lam, R* del){
+
+    const R eps = std::numeric_limits<R>::epsilon();
+
+    R znorm = 0;
+    for (size_t j = 0 ; j < k ; j++) znorm += z[j]*z[j];
+
+    KThreadPool::global().parallel_for(0, k, [&](size_t ilo, size_t ihi){
+
+        std::vector<R> sd(k);
+        for (size_t i = ilo ; i < ihi ; i++){
+
+            //Bracket root and choose the closer pole as origin
+            R width = (i + 1 < k) ? d[i+1] - d[i] : rho*znorm;
+            size_t org = i;
+            if (i + 1 < k){
+                R mid = d[i] + width/2;
+                R f = 1;
+                for (size_t j = 0 ; j < k ; j++) f += rho*z[j]*z[j]/(d[j] - mid);
+                if (f < 0) org = i+1;
+            }
+
+            for (size_t j = 0 ; j < k ; j++) sd[j] = d[j] - d[org];
+
+            //Bracket is the whole interval between poles, since rounding in the midpoint test
+            //can pick the wrong half when the root sits at the middle
+            R tlo, thi, t;
+            if (org == i){
+                tlo = 0;
+                thi = width;
+                t = (i + 1 < k) ? width/4 : width/2;
+            }else{
+                tlo = -width;
+                thi = 0;
+                t = -width/4;
+            }
+
+            //Safeguarded Newton on g(t) = 1 + rho*sum(z^2/(sd - t)), which increases with t
+            for (size_t iter = 0 ; iter < 400 ; iter++){
+                R g = 1, dg = 0, gabs = 1;
+                for (size_t j = 0 ; j < k ; j++){
+                    R q = z[j]/(sd[j] - t);
+                    R term = rho*z[j]*q;
+                    g += term;
+                    gabs += std::abs(term);
+                    dg += rho*q*q;
+                }
+
+                if (g == 0 || std::abs(g) <= eps*gabs) break;
+                if (g < 0) tlo = t; else thi = t;
+                if (thi - tlo <= 2*eps*std::max(std::abs(tlo), std::abs(thi))) break;
+
+                R tn = t - g/dg;
+                if (iter % 4 == 3 || !(tn > tlo && tn < thi)) tn = (tlo + thi)/2;
+                if (tn == t) break;
+                t = tn;
+            }
+
+            lam[i] = d[org] + t;
+            for (size_t j = 0 ; j < k ; j++) del[i*k + j] = sd[j] - t;
+        }
+    }, 8);
+}
+
+/*
+ Cuppen's divide-and-conquer for a real symmetric tridiagonal matrix. On return 'd' holds
+ the eigenvalues in ascending order and the n x n block of 'q' holds the eigenvectors as
+ columns. The matrix is torn into two halves by a rank-one correction, both halves are solved
+ recursively (in parallel), and the rank-one update is solved by deflation and the secular
+ equation, recomputing the update vector (Gu and Eisenstat) so the eigenvectors stay
+ orthogonal.
+
+ n - dimension
+ d - diagonal (length n)
+ e - subdiagonal, e[i] between rows i and i+1 (length n-1)
+ q - row-major output with leading dimension 'ldq'
+
+ Void return
+ */
+template <class R>
+void kmatrix_tridiag_dc(size_t n, R* d, const R* e, R* q, size_t ldq){
+
+    const R eps = std::numeric_limits<R>::epsilon();
+
+    if (n == 0) return;
+
+    //Small problems: QL from the identity
+    if (n <= KMATRIX_DC_CUTOFF){
+        for (size_t r = 0 ; r < n ; r++){
+            for (size_t c = 0 ; c < n ; c++) q[r*ldq + c] = (r == c) ? R(1) : R(0);
+        }
+        std::vector<R> ework(e, e + n - 1);
+        ework.push_back(0);
+        kmatrix_tridiag_ql(n, d, ework.data(), q, ldq, true);
+
+        //Sort ascending
+        std::vector<size_t> perm(n);
+        for (size_t i = 0 ; i < n ; i++) perm[i] = i;
+        std::sort(perm.begin(), perm.end(), [&](size_t x, size_t y){ return d[x] < d[y]; });
+        std::vector<R> ds(n), qs(n*n);
+        for (size_t i = 0 ; i < n ; i++){
+            ds[i] = d[perm[i]];
+            for (size_t r = 0 ; r < n ; r++) qs[r*n + i] = q[r*ldq + perm[i]];
+        }
+        for (size_t i = 0 ; i < n ; i++){
+            d[i] = ds[i];
+            for (size_t c = 0 ; c < n ; c++) q[i*ldq + c] = qs[i*n + c];
+        }
+        return;
+    }
+
+    //Tear: T = diag(T1, T2) + rho*u*u^T with u = e_(k-1) + e_k
+    size_t k = n/2;
+    R rho = e[k-1];
+    d[k-1] -= rho;
+    d[k] -= rho;
+
+    for (size_t r = 0 ; r < k ; r++){
+        for (size_t c = k ; c < n ; c++) q[r*ldq + c] = 0;
+    }
+    for (size_t r = k ; r < n ; r++){
+        for (size_t c = 0 ; c < k ; c++) q[r*ldq + c] = 0;
+    }
+
+    KThreadPool::global().parallel_for(0, 2, [&](size_t lo, size_t hi){
+        for (size_t h = lo ; h < hi ; h++){
+            if (h == 0){
+                kmatrix_tridiag_dc(k, d, e, q, ldq);
+            }else{
+                kmatrix_tridiag_dc(n - k, d + k, e + k, q + k*ldq + k, ldq);
+            }
+        }
+    });
+
+    //z = Q^T u, scaled to unit length
+    std::vector<R> z(n);
+    for (size_t j = 0 ; j < k ; j++) z[j] = q[(k-1)*ldq + j]/std::sqrt(R(2));
+    for (size_t j = k ; j < n ; j++) z[j] = q[k*ldq + j]/std::sqrt(R(2));
+    rho *= 2;
+
+    if (rho == 0){
+        //Halves are decoupled; just sort
+        std::vector<R> ework(n-1, R(0));
+        std::vector<size_t> perm(n);
+        for (size_t i = 0 ; i < n ; i++) perm[i] = i;
+        std::sort(perm.begin(), perm.end(), [&](size_t x, size_t y){ return d[x] < d[y]; });
+        std::vector<R> ds(n), qs(n*n);
+        for (size_t i = 0 ; i < n ; i++){
+            ds[i] = d[perm[i]];
+            for (size_t r = 0 ; r < n ; r++) qs[r*n + i] = q[r*ldq + perm[i]];
+        }
+        for (size_t i = 0 ; i < n ; i++){
+            d[i] = ds[i];
+            for (size_t c = 0 ; c < n ; c++) q[i*ldq + c] = qs[i*n + c];
+        }
+        return;
+    }
+
+    //Sort poles ascending, permuting Q's columns to match
+    std::vector<size_t> perm(n);
+    for (size_t i = 0 ; i < n ; i++) perm[i] = i;
+    std::sort(perm.begin(), perm.end(), [&](size_t x, size_t y){ return d[x] < d[y]; });
+
+    std::vector<R> ds(n), zs(n), qp(n*n);
+    for (size_t i = 0 ; i < n ; i++){
+        ds[i] = d[perm[i]];
+        zs[i] = z[perm[i]];
+    }
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t i = 0 ; i < n ; i++) qp[r*n + i] = q[r*ldq + perm[i]];
+    }
+
+    //Deflation: drop negligible z, and rotate away one of each pair of close poles
+    R dmax = 0;
+    for (size_t i = 0 ; i < n ; i++) dmax = std::max(dmax, std::abs(ds[i]));
+    R tol = 8*eps*std::max(dmax, std::abs(rho));
+
+    std::vector<size_t> nd;
+    for (size_t j = 0 ; j < n ; j++){
+
+        if (std::abs(rho*zs[j]) <= tol) continue;
+
+        if (!nd.empty()){
+            size_t p = nd.back();
+            R r = std::hypot(zs[p], zs[j]);
+            R c = zs[j]/r;
+            R s = zs[p]/r;
+            if (std::abs(c*s*(ds[p] - ds[j])) <= tol){
+                R dp = c*c*ds[p] + s*s*ds[j];
+                R dj = s*s*ds[p] + c*c*ds[j];
+                ds[p] = dp;
+                ds[j] = dj;
+                zs[p] = 0;
+                zs[j] = r;
+                for (size_t row = 0 ; row < n ; row++){
+                    R a = qp[row*n + p];
+                    R b = qp[row*n + j];
+                    qp[row*n + p] = c*a - s*b;
+                    qp[row*n + j] = s*a + c*b;
+                }
+                nd.pop_back();
+            }
+        }
+        nd.push_back(j);
+    }
+    std::sort(nd.begin(), nd.end(), [&](size_t x, size_t y){ return ds[x] < ds[y]; });
+
+    //Secular equation on the non-deflated part (flipped so that rho > 0)
+    size_t kk = nd.size();
+    bool flip = rho < 0;
+    std::vector<R> dd(kk), zz(kk), lam(kk), del(kk*kk);
+    for (size_t m = 0 ; m < kk ; m++){
+        size_t src = flip ? nd[kk-1-m] : nd[m];
+        dd[m] = flip ? -ds[src] : ds[src];
+        zz[m] = zs[src];
+    }
+    R arho = std::abs(rho);
+    kmatrix_secular(kk, dd.data(), zz.data(), arho, lam.data(), del.data());
+
+    //Recompute z from the computed eigenvalues (Gu and Eisenstat), then form eigenvectors
+    std::vector<R> zhat(kk);
+    for (size_t j = 0 ; j < kk ; j++){
+        R prod = -del[(kk-1)*kk + j];
+        for (size_t i = 0 ; i < j ; i++) prod *= -del[i*kk + j]/(dd[i] - dd[j]);
+        for (size_t i = j+1 ; i < kk ; i++) prod *= -del[(i-1)*kk + j]/(dd[i] - dd[j]);
+        R mag = std::sqrt(std::max(prod, R(0))/arho);
+        zhat[j] = (zz[j] < 0) ? -mag : mag;
+    }
+
+    //V (kk x kk), rows in 'nd' order
+    std::vector<R> v(kk*kk);
+    for (size_t i = 0 ; i < kk ; i++){
+        R nrm = 0;
+        for (size_t j = 0 ; j < kk ; j++){
+            R x = zhat[j]/del[i*kk + j];
+            size_t row = flip ? kk-1-j : j;
+            v[row*kk + i] = x;
+            nrm += x*x;
+        }
+        nrm = std::sqrt(nrm);
+        for (size_t j = 0 ; j < kk ; j++) v[j*kk + i] /= nrm;
+    }
+
+    //New eigenvectors: Q[:, nd] * V
+    std::vector<R> qnd(n*kk), w(n*kk);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t m = 0 ; m < kk ; m++) qnd[r*kk + m] = qp[r*n + nd[m]];
+    }
+    kmatrix_gemm<R>(n, kk, kk,
+        [&](size_t r){ return qnd.data() + r*kk; },
+        [&](size_t r){ return (const R*)v.data() + r*kk; },
+        [&](size_t r){ return w.data() + r*kk; });
+
+    std::vector<R> outval(n);
+    std::vector<char> is_nd(n, 0);
+    for (size_t m = 0 ; m < kk ; m++){
+        is_nd[nd[m]] = 1;
+        size_t dst = nd[m];
+        outval[dst] = flip ? -lam[m] : lam[m];
+        for (size_t r = 0 ; r < n ; r++) qp[r*n + dst] = w[r*kk + m];
+    }
+    for (size_t j = 0 ; j < n ; j++){
+        if (!is_nd[j]) outval[j] = ds[j];
+    }
+
+    //Sort ascending and write back
+    for (size_t i = 0 ; i < n ; i++) perm[i] = i;
+    std::sort(perm.begin(), perm.end(), [&](size_t x, size_t y){ return outval[x] < outval[y]; });
+    for (size_t i = 0 ; i < n ; i++){
+        d[i] = outval[perm[i]];
+        for (size_t r = 0 ; r < n ; r++) q[r*ldq + i] = qp[r*n + perm[i]];
+    }
+}
+
+/*
+ Sorts indices [0, n) so the values selected by 'which' come first.
+ */
+template <class V>
+std::vector<size_t> kmatrix_eigen_order(const std::vector<V>& vals, KEigenWhich which){
+
+    std::vector<size_t> idx(vals.size());
+    for (size_t i = 0 ; i < idx.size() ; i++) idx[i] = i;
+
+    std::stable_sort(idx.begin(), idx.end(), [&](size_t x, size_t y){
+        switch (which){
+            case KEIG_LARGEST:
+                return std::real(vals[x]) > std::real(vals[y]);
+            case KEIG_SMALLEST:
+                return std::real(vals[x]) < std::real(vals[y]);
+            default:
+                return std::abs(vals[x]) > std::abs(vals[y]);
+        }
+    });
+
+    return idx;
+}
+
+/*----------------------------------------------------------------
+------------------------ HESSENBERG / QR -------------------------
+----------------------------------------------------------------*/
+
+/*
+ Reduces the dense n x n row-major matrix 'h' to upper Hessenberg form by Householder
+ similarity transforms, and multiplies them into 'z' (z <- z*Q).
+
+ Void return
+ */
+template <class C>
+void kmatrix_hessenberg(size_t n, C* h, C* z){
+
+    std::vector<C> v(n);
+
+    for (size_t k = 0 ; k + 2 < n ; k++){
+
+        size_t len = n - k - 1;
+        for (size_t i = 0 ; i < len ; i++) v[i] = h[(k+1+i)*n + k];
+        C tau = kmatrix_householder(len, v.data());
+        h[(k+1)*n + k] = v[0];
+        for (size_t i = 1 ; i < len ; i++) h[(k+1+i)*n + k] = C(0);
+        if (tau == C(0)) continue;
+        v[0] = C(1);
+
+        //Left: rows k+1.. <- H^H * rows, over columns k+1..n-1
+        KThreadPool::global().parallel_for(k+1, n, [&](size_t lo, size_t hi){
+            std::vector<C> w(hi - lo, C(0));
+            for (size_t i = 0 ; i < len ; i++){
+                const C vi = kmatrix_conj(v[i]);
+                const C* row = h + (k+1+i)*n;
+                for (size_t c = lo ; c < hi ; c++) w[c - lo] += vi*row[c];
+            }
+            for (size_t c = lo ; c < hi ; c++) w[c - lo] *= kmatrix_conj(tau);
+            for (size_t i = 0 ; i < len ; i++){
+                C* row = h + (k+1+i)*n;
+                for (size_t c = lo ; c < hi ; c++) row[c] -= v[i]*w[c - lo];
+            }
+        }, 16);
+
+        //Right: every row of h and z <- row * H
+        auto right = [&](C* mat){
+            KThreadPool::global().parallel_for(0, n, [&](size_t lo, size_t hi){
+                for (size_t r = lo ; r < hi ; r++){
+                    C* row = mat + r*n + k + 1;
+                    C w = C(0);
+                    for (size_t i = 0 ; i < len ; i++) w += row[i]*v[i];
+                    w *= tau;
+                    for (size_t i = 0 ; i < len ; i++) row[i] -= w*kmatrix_conj(v[i]);
+                }
+            }, 16);
+        };
+        right(h);
+        right(z);
+    }
+}
+
+/*
+ Reduces the upper Hessenberg n x n row-major matrix 'h' to upper triangular (Schur) form by
+ the shifted QR algorithm with Wilkinson shifts, and multiplies the rotations into 'z'.
+ Throws matrix_convergence_exception if an eigenvalue fails to converge.
+
+ Void return
+ */
+template <class C>
+void kmatrix_hessenberg_qr(size_t n, C* h, C* z){
+
+    typedef typename kmatrix_real<C>::type R;
+    const R eps = std::numeric_limits<R>::epsilon();
+    matrix_convergence_exception conv_ex;
+
+    R hnorm = 0;
+    for (size_t i = 0 ; i < n*n ; i++) hnorm = std::max(hnorm, std::abs(h[i]));
+
+    size_t iter = 0;
+    long hi = (long)n - 1;
+    while (hi > 0){
+
+        //Look for a negligible subdiagonal
+        long l;
+        for (l = hi ; l > 0 ; l--){
+            R s = std::abs(h[l*n + l]) + std::abs(h[(l-1)*n + l-1]);
+            if (s == 0) s = hnorm;
+            if (std::abs(h[l*n + l-1]) <= eps*s){
+                h[l*n + l-1] = C(0);
+                break;
+            }
+        }
+
+        if (l == hi){
+            hi--;
+            iter = 0;
+            continue;
+        }
+
+        if (++iter > KMATRIX_EIGEN_MAXITER){
+            throw conv_ex;
+        }
+
+        //Wilkinson shift from the trailing 2x2, with an exceptional shift every 10 iterations
+        C a = h[(hi-1)*n + hi-1], b = h[(hi-1)*n + hi], c = h[hi*n + hi-1], d = h[hi*n + hi];
+        C mu;
+        if (iter % 10 == 0){
+            mu = d + C(R(0.75)*std::abs(std::real(c)));
+        }else{
+            C half = (a - d)/C(2);
+            C disc = std::sqrt(half*half + b*c);
+            C mu1 = (a + d)/C(2) + disc;
+            C mu2 = (a + d)/C(2) - disc;
+            mu = (std::abs(mu1 - d) < std::abs(mu2 - d)) ? mu1 : mu2;
+        }
+
+        //Implicit single-shift QR sweep over [l, hi]
+        C x = h[l*n + l] - mu;
+        C y = h[(l+1)*n + l];
+        for (long k = l ; k < hi ; k++){
+
+            if (k > l){
+                x = h[k*n + k-1];
+                y = h[(k+1)*n + k-1];
+            }
+
+            R ax = std::abs(x), r = std::hypot(ax, std::abs(y));
+            if (r == 0) continue;
+            R cs;
+            C sn;
+            if (ax == 0){
+                cs = 0;
+                sn = kmatrix_conj(y)/C(std::abs(y));
+            }else{
+                cs = ax/r;
+                sn = (x/C(ax))*kmatrix_conj(y)/C(r);
+            }
+
+            //Rows k, k+1
+            for (size_t j = (k > l) ? k-1 : k ; j < n ; j++){
+                C p = h[k*n + j], q = h[(k+1)*n + j];
+                h[k*n + j] = C(cs)*p + sn*q;
+                h[(k+1)*n + j] = C(cs)*q - kmatrix_conj(sn)*p;
+            }
+            if (k > l) h[(k+1)*n + k-1] = C(0);
+
+            //Columns k, k+1
+            size_t rmax = std::min((size_t)k+2, (size_t)hi);
+            for (size_t i = 0 ; i <= rmax ; i++){
+                C p = h[i*n + k], q = h[i*n + k+1];
+                h[i*n + k] = C(cs)*p + kmatrix_conj(sn)*q;
+                h[i*n + k+1] = C(cs)*q - sn*p;
+            }
+            for (size_t i = 0 ; i < n ; i++){
+                C p = z[i*n + k], q = z[i*n + k+1];
+                z[i*n + k] = C(cs)*p + kmatrix_conj(sn)*q;
+                z[i*n + k+1] = C(cs)*q - sn*p;
+            }
+        }
+    }
+}
+
+/*
+ Eigenvectors of A = Z*T*Z^H from its Schur form: back substitution on the upper triangular
+ 'tri' for each eigenvalue, then multiplication by 'z'. Columns of 'out' are unit length.
+
+ Void return
+ */
+template <class C>
+void kmatrix_schur_vectors(size_t n, const C* tri, const C* z, C* out){
+
+    typedef typename kmatrix_real<C>::type R;
+    const R eps = std::numeric_limits<R>::epsilon();
+
+    R tnorm = 0;
+    for (size_t i = 0 ; i < n*n ; i++) tnorm = std::max(tnorm, std::abs(tri[i]));
+    R small = std::max(eps*tnorm, std::numeric_limits<R>::min());
+
+    KThreadPool::global().parallel_for(0, n, [&](size_t lo, size_t hi){
+        std::vector<C> x(n);
+        for (size_t k = lo ; k < hi ; k++){
+
+            const C lam = tri[k*n + k];
+            std::fill(x.begin(), x.end(), C(0));
+            x[k] = C(1);
+            for (size_t i = k ; i-- > 0 ; ){
+                C s = C(0);
+                for (size_t j = i+1 ; j <= k ; j++) s += tri[i*n + j]*x[j];
+                C den = tri[i*n + i] - lam;
+                if (std::abs(den) < small) den = C(small);
+                x[i] = -s/den;
+            }
+
+            R nrm = 0;
+            for (size_t r = 0 ; r < n ; r++){
+                C s = C(0);
+                for (size_t j = 0 ; j <= k ; j++) s += z[r*n + j]*x[j];
+                out[r*n + k] = s;
+                nrm += std::norm(s);
+            }
+            nrm = std::sqrt(nrm);
+            for (size_t r = 0 ; r < n ; r++) out[r*n + k] /= C(nrm);
+        }
+    });
+}
+
+/*----------------------------------------------------------------
+---------------------------- KSymEigen ---------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KSymEigen<T>::KSymEigen() : n(0){
+
+}
+
+/*
+ Computes the decomposition of 'a'. See compute().
+ */
+template <class T>
+KSymEigen<T>::KSymEigen(const KMatrix<T>& a, bool vectors) : n(0){
+    compute(a, vectors);
+}
+
+/*
+ Computes the eigenvalues and optionally eigenvectors of 'a'. Throws
+ matrix_multiplication_exception if 'a' is not square.
+
+ a - symmetric (Hermitian) matrix. Only the lower triangle is read.
+ vectors - also compute eigenvectors
+
+ Void return
+ */
+template <class T>
+void KSymEigen<T>::compute(const KMatrix<T>& a, bool vectors){
+
+    typedef real_type R;
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    n = a.rows();
+    vals.assign(n, R(0));
+    vecs.clear();
+    if (n == 0) return;
+
+    //Dense copy, filling the upper triangle from the lower
+    std::vector<T> h(n*n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c <= r ; c++){
+            h[r*n + c] = a.get(r, c);
+            h[c*n + r] = kmatrix_conj(a.get(r, c));
+        }
+    }
+
+    //Householder tridiagonalization, A <- H^H*A*H. Reflector k is stored below the subdiagonal
+    //of column k.
+    std::vector<R> d(n), e(n, R(0));
+    std::vector<T> tau(n, T(0));
+    std::vector<T> v(n), p(n);
+    for (size_t k = 0 ; k + 1 < n ; k++){
+
+        size_t len = n - k - 1;
+        for (size_t i = 0 ; i < len ; i++) v[i] = h[(k+1+i)*n + k];
+        tau[k] = kmatrix_householder(len, v.data());
+        e[k] = std::real(v[0]);
+        for (size_t i = 1 ; i < len ; i++) h[(k+1+i)*n + k] = v[i];
+        if (tau[k] == T(0)) continue;
+        v[0] = T(1);
+
+        //p = tau*A*v
+        T* sub = h.data() + (k+1)*n + k + 1;
+        KThreadPool::global().parallel_for(0, len, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                const T* row = sub + i*n;
+                T s = T(0);
+                for (size_t j = 0 ; j < len ; j++) s += row[j]*v[j];
+                p[i] = tau[k]*s;
+            }
+        }, 16);
+
+        //w = p - (1/2)*conj(tau)*(v^H p)*v, then A <- A - v*w^H - w*v^H
+        T vp = T(0);
+        for (size_t i = 0 ; i < len ; i++) vp += kmatrix_conj(v[i])*p[i];
+        T alpha = T(-0.5)*kmatrix_conj(tau[k])*vp;
+        for (size_t i = 0 ; i < len ; i++) p[i] += alpha*v[i];
+
+        KThreadPool::global().parallel_for(0, len, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                T* row = sub + i*n;
+                const T vi = v[i], wi = p[i];
+                for (size_t j = 0 ; j < len ; j++){
+                    row[j] -= vi*kmatrix_conj(p[j]) + wi*kmatrix_conj(v[j]);
+                }
+            }
+        }, 16);
+    }
+    for (size_t k = 0 ; k < n ; k++) d[k] = std::real(h[k*n + k]);
+
+    if (!vectors){
+        kmatrix_tridiag_ql(n, d.data(), e.data(), (R*)NULL, 0, false);
+        std::sort(d.begin(), d.end());
+        vals = d;
+        return;
+    }
+
+    std::vector<R> q(n*n);
+    kmatrix_tridiag_dc(n, d.data(), e.data(), q.data(), n);
+    vals = d;
+
+    //Back-transform: X = H_0*H_1*...*H_(n-2)*Q
+    vecs.resize(n*n);
+    for (size_t i = 0 ; i < n*n ; i++) vecs[i] = T(q[i]);
+
+    for (size_t k = n - 1 ; k-- > 0 ; ){
+        if (tau[k] == T(0)) continue;
+        size_t len = n - k - 1;
+        v[0] = T(1);
+        for (size_t i = 1 ; i < len ; i++) v[i] = h[(k+1+i)*n + k];
+
+        KThreadPool::global().parallel_for(0, n, [&](size_t lo, size_t hi){
+            std::vector<T> w(hi - lo, T(0));
+            for (size_t i = 0 ; i < len ; i++){
+                const T vi = kmatrix_conj(v[i]);
+                const T* row = vecs.data() + (k+1+i)*n;
+                for (size_t c = lo ; c < hi ; c++) w[c - lo] += vi*row[c];
+            }
+            for (size_t c = lo ; c < hi ; c++) w[c - lo] *= tau[k];
+            for (size_t i = 0 ; i < len ; i++){
+                T* row = vecs.data() + (k+1+i)*n;
+                for (size_t c = lo ; c < hi ; c++) row[c] -= v[i]*w[c - lo];
+            }
+        }, 16);
+    }
+}
+
+/*
+ Returns the eigenvalues in ascending order
+ */
+template <class T>
+KVector<typename KSymEigen<T>::real_type> KSymEigen<T>::values() const{
+    return KVector<real_type>(vals);
+}
+
+/*
+ Returns the eigenvectors as the columns of an n x n matrix (empty if not computed)
+ */
+template <class T>
+KMatrix<T> KSymEigen<T>::vectors() const{
+
+    if (vecs.empty()) return KMatrix<T>();
+
+    KMatrix<T> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c < n ; c++) out(r, c) = vecs[r*n + c];
+    }
+
+    return out;
+}
+
+template <class T>
+size_t KSymEigen<T>::size() const{
+    return n;
+}
+
+/*----------------------------------------------------------------
+----------------------------- KEigen -----------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KEigen<T>::KEigen() : n(0){
+
+}
+
+/*
+ Computes the decomposition of 'a'. See compute().
+ */
+template <class T>
+KEigen<T>::KEigen(const KMatrix<T>& a, bool vectors) : n(0){
+    compute(a, vectors);
+}
+
+/*
+ Computes the eigenvalues and optionally eigenvectors of 'a'. Throws
+ matrix_multiplication_exception if 'a' is not square, and matrix_convergence_exception if
+ the QR iteration fails.
+
+ a - square matrix
+ vectors - also compute eigenvectors
+
+ Void return
+ */
+template <class T>
+void KEigen<T>::compute(const KMatrix<T>& a, bool vectors){
+
+    typedef complex_type C;
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    n = a.rows();
+    schur.assign(n*n, C(0));
+    z.assign(n*n, C(0));
+    vecs.clear();
+
+    for (size_t r = 0 ; r < n ; r++){
+        z[r*n + r] = C(1);
+        for (size_t c = 0 ; c < n ; c++) schur[r*n + c] = C(a.get(r, c));
+    }
+
+    kmatrix_hessenberg(n, schur.data(), z.data());
+    kmatrix_hessenberg_qr(n, schur.data(), z.data());
+
+    if (vectors){
+        vecs.resize(n*n);
+        kmatrix_schur_vectors(n, schur.data(), z.data(), vecs.data());
+    }
+}
+
+/*
+ Returns the eigenvalues
+ */
+template <class T>
+KVector<typename KEigen<T>::complex_type> KEigen<T>::values() const{
+
+    std::vector<complex_type> out(n);
+    for (size_t i = 0 ; i < n ; i++) out[i] = schur[i*n + i];
+
+    return KVector<complex_type>(out);
+}
+
+/*
+ Returns the eigenvectors as the columns of an n x n matrix (empty if not computed)
+ */
+template <class T>
+KMatrix<typename KEigen<T>::complex_type> KEigen<T>::vectors() const{
+
+    if (vecs.empty()) return KMatrix<complex_type>();
+
+    KMatrix<complex_type> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c < n ; c++) out(r, c) = vecs[r*n + c];
+    }
+
+    return out;
+}
+
+/*
+ Returns the upper triangular Schur form T, where A = Z*T*Z^H
+ */
+template <class T>
+KMatrix<typename KEigen<T>::complex_type> KEigen<T>::getSchur() const{
+
+    KMatrix<complex_type> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = r ; c < n ; c++) out(r, c) = schur[r*n + c];
+    }
+
+    return out;
+}
+
+/*
+ Returns the unitary Schur vectors Z, where A = Z*T*Z^H
+ */
+template <class T>
+KMatrix<typename KEigen<T>::complex_type> KEigen<T>::getSchurVectors() const{
+
+    KMatrix<complex_type> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c < n ; c++) out(r, c) = z[r*n + c];
+    }
+
+    return out;
+}
+
+template <class T>
+size_t KEigen<T>::size() const{
+    return n;
+}
+
+/*----------------------------------------------------------------
+------------------------- KRYLOV HELPERS -------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns a function computing y = A*x for 'a', split across the thread pool by rows. A
+ column-major 'a' is copied to row-major once, when the function is created.
+ */
+template <class T, class X>
+std::function<void(const X*, X*)> kmatrix_matvec(const KMatrix<T>& a){
+
+    const KMatrix<T>* ap = &a;
+    std::shared_ptr<KMatrix<T> > copy;
+    if (a.layout() != KMAT_ROW_MAJOR){
+        copy = std::make_shared<KMatrix<T> >(a);
+        copy->setLayout(KMAT_ROW_MAJOR);
+        ap = copy.get();
+    }
+    return [ap, copy](const X* x, X* y){
+        const std::vector<typename KMatrix<T>::row_type>& m = ap->getMat();
+        size_t nc = ap->cols();
+        KThreadPool::global().parallel_for(0, ap->rows(), [&](size_t lo, size_t hi){
+            for (size_t r = lo ; r < hi ; r++){
+                const T* row = m[r].data();
+                X s = X(0);
+                for (size_t c = 0 ; c < nc ; c++) s += X(row[c])*x[c];
+                y[r] = s;
+            }
+        }, 64);
+    };
+}
+
+/*
+ Orthogonalizes 'w' against the first 'm' basis vectors (classical Gram-Schmidt, applied
+ twice). The projection coefficients are added to 'h' if it is not NULL.
+
+ Returns the norm of the orthogonalized 'w'
+ */
+template <class X>
+typename kmatrix_real<X>::type kmatrix_reorthogonalize(const std::vector<std::vector<X> >& basis, size_t m, std::vector<X>& w, X* h){
+
+    typedef typename kmatrix_real<X>::type R;
+    size_t n = w.size();
+
+    for (int pass = 0 ; pass < 2 ; pass++){
+        std::vector<X> coef(m, X(0));
+        KThreadPool::global().parallel_for(0, m, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                X s = X(0);
+                for (size_t r = 0 ; r < n ; r++) s += kmatrix_conj(basis[i][r])*w[r];
+                coef[i] = s;
+            }
+        }, 4);
+        for (size_t i = 0 ; i < m ; i++){
+            for (size_t r = 0 ; r < n ; r++) w[r] -= coef[i]*basis[i][r];
+            if (h != NULL) h[i] += coef[i];
+        }
+    }
+
+    R nrm = 0;
+    for (size_t r = 0 ; r < n ; r++) nrm += std::norm(w[r]);
+
+    return std::sqrt(nrm);
+}
+
+/*
+ Fills 'w' with a reproducible pseudo-random starting vector.
+ */
+template <class X>
+void kmatrix_krylov_start(std::vector<X>& w, unsigned seed){
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (size_t i = 0 ; i < w.size() ; i++) w[i] = X(dist(gen));
+}
+
+/*
+ Combines the 'm' basis vectors in 'v' into new ones: new vector i is the sum over j of
+ v[j]*y[j*m + cols[i]]. Split across the thread pool by rows.
+
+ Returns the new vectors
+ */
+template <class X>
+std::vector<std::vector<X> > kmatrix_krylov_combine(const std::vector<std::vector<X> >& v, const X* y, size_t m, const std::vector<size_t>& cols){
+
+    size_t n = v[0].size();
+    std::vector<std::vector<X> > out(cols.size(), std::vector<X>(n));
+
+    KThreadPool::global().parallel_for(0, n, [&](size_t lo, size_t hi){
+        for (size_t i = 0 ; i < cols.size() ; i++){
+            for (size_t r = lo ; r < hi ; r++){
+                X x = X(0);
+                for (size_t j = 0 ; j < m ; j++) x += v[j][r]*y[j*m + cols[i]];
+                out[i][r] = x;
+            }
+        }
+    }, 256);
+
+    return out;
+}
+
+/*
+ Reorders the complex Schur form T of an n x n row-major matrix so that the diagonal
+ entries listed in 'first' (indices into the current diagonal) lead it, in that order. Each
+ move swaps two adjacent diagonal entries with a Givens rotation, which is also applied to
+ the columns of 'z', so Z*T*Z^H is unchanged.
+
+ Void return
+ */
+template <class C>
+void kmatrix_schur_reorder(size_t n, C* t, C* z, const std::vector<size_t>& first){
+
+    typedef typename kmatrix_real<C>::type R;
+
+    std::vector<size_t> at(n); //Original index of the entry now at each position
+    for (size_t i = 0 ; i < n ; i++) at[i] = i;
+
+    for (size_t j = 0 ; j < first.size() ; j++){
+        size_t q = std::find(at.begin(), at.end(), first[j]) - at.begin();
+        for (size_t k = q ; k-- > j ; ){
+
+            //Rotation taking [t(k,k+1), t(k+1,k+1) - t(k,k)] to [r, 0]
+            C t11 = t[k*n + k], t22 = t[(k+1)*n + k+1];
+            C f = t[k*n + k+1], g = t22 - t11;
+            R af = std::abs(f), r = std::hypot(af, std::abs(g));
+            if (r == 0) continue;
+            R cs;
+            C sn;
+            if (af == 0){
+                cs = 0;
+                sn = kmatrix_conj(g)/C(std::abs(g));
+            }else{
+                cs = af/r;
+                sn = (f/C(af))*kmatrix_conj(g)/C(r);
+            }
+
+            for (size_t c = k+2 ; c < n ; c++){
+                C p = t[k*n + c], q2 = t[(k+1)*n + c];
+                t[k*n + c] = C(cs)*p + sn*q2;
+                t[(k+1)*n + c] = C(cs)*q2 - kmatrix_conj(sn)*p;
+            }
+            for (size_t i = 0 ; i < k ; i++){
+                C p = t[i*n + k], q2 = t[i*n + k+1];
+                t[i*n + k] = C(cs)*p + kmatrix_conj(sn)*q2;
+                t[i*n + k+1] = C(cs)*q2 - sn*p;
+            }
+            for (size_t i = 0 ; i < n ; i++){
+                C p = z[i*n + k], q2 = z[i*n + k+1];
+                z[i*n + k] = C(cs)*p + kmatrix_conj(sn)*q2;
+                z[i*n + k+1] = C(cs)*q2 - sn*p;
+            }
+            t[k*n + k] = t22;
+            t[(k+1)*n + k+1] = t11;
+            std::swap(at[k], at[k+1]);
+        }
+    }
+}
+
+/*----------------------------------------------------------------
+---------------------------- KLanczos ----------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KLanczos<T>::KLanczos() : conv(false), basis(0), nrestart(0){
+
+}
+
+/*
+ Computes 'k' eigenpairs of 'a' (symmetric or Hermitian). See compute().
+ */
+template <class T>
+KLanczos<T>::KLanczos(const KMatrix<T>& a, size_t k, KEigenWhich which, double tol, size_t max_basis) : conv(false), basis(0), nrestart(0){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    compute(kmatrix_matvec<T, T>(a), a.rows(), k, which, tol, max_basis);
+}
+
+/*
+ Computes 'k' eigenpairs of the operator 'op'. See compute().
+ */
+template <class T>
+KLanczos<T>::KLanczos(std::function<void(const T*, T*)> op, size_t n, size_t k, KEigenWhich which, double tol, size_t max_basis) : conv(false), basis(0), nrestart(0){
+    compute(op, n, k, which, tol, max_basis);
+}
+
+/*
+ Computes 'k' eigenpairs of a symmetric (Hermitian) operator.
+
+ op - computes y = A*x for length-n arrays x and y
+ n - dimension
+ k - number of eigenpairs
+ which - which end of the spectrum to find
+ tol - convergence tolerance on the relative residual ||A*x - lambda*x||
+ max_basis - largest Krylov basis to build (0 for the default)
+
+ Void return
+ */
+template <class T>
+void KLanczos<T>::compute(std::function<void(const T*, T*)> op, size_t n, size_t k, KEigenWhich which, double tol, size_t max_basis){
+
+    typedef real_type R;
+    const R eps = std::numeric_limits<R>::epsilon();
+    matrix_convergence_exception conv_ex;
+
+    if (k > n) k = n;
+    if (max_basis == 0) max_basis = std::max(2*k + 40, 4*k);
+    if (max_basis < k + 2) max_basis = k + 2; //Room to restart
+    if (max_basis > n) max_basis = n;
+    size_t keep = std::min(k + (max_basis - k)/2, max_basis - 1);
+
+    conv = false;
+    vals.clear();
+    vecs = KMatrix<T>();
+    basis = 0;
+    nrestart = 0;
+    if (k == 0) return;
+
+    //Projected matrix V^H*A*V, row-major with leading dimension max_basis. Only its lower
+    //triangle is kept: the diagonal, the subdiagonal and, after a restart, the row coupling
+    //the kept Ritz vectors to the next basis vector.
+    std::vector<std::vector<T> > v;
+    std::vector<T> h((max_basis+1)*max_basis, T(0));
+    std::vector<T> w(n), coef(max_basis);
+    R anorm = 0;
+
+    kmatrix_krylov_start(w, 1);
+    R nrm = kmatrix_reorthogonalize(v, 0, w, (T*)NULL);
+
+    std::vector<R> theta;
+    std::vector<T> s;
+    std::vector<size_t> order;
+    size_t m = 0;
+    while (true){
+
+        //Next basis vector
+        v.push_back(w);
+        for (size_t r = 0 ; r < n ; r++) v[m][r] /= T(nrm);
+
+        //w = A*v_m, orthogonalized against the whole basis
+        op(v[m].data(), w.data());
+        std::fill(coef.begin(), coef.begin() + m + 1, T(0));
+        nrm = kmatrix_reorthogonalize(v, m+1, w, coef.data());
+        h[m*max_basis + m] = T(std::real(coef[m]));
+        for (size_t i = 0 ; i <= m ; i++) anorm = std::max(anorm, (R)std::abs(coef[i]));
+        m++;
+        anorm = std::max(anorm, nrm);
+
+        bool breakdown = nrm <= eps*anorm;
+        bool full = (m == max_basis);
+        bool restarted = false;
+
+        //Check the Ritz pairs
+        if (m >= k && (full || breakdown || m % 5 == 0)){
+            KMatrix<T> hm((int)m, (int)m);
+            for (size_t r = 0 ; r < m ; r++){
+                for (size_t c = 0 ; c <= r ; c++) hm(r, c) = h[r*max_basis + c];
+            }
+            KSymEigen<T> eig(hm, true);
+            theta = eig.values().get_vec();
+            KMatrix<T> sv = eig.vectors();
+            s.resize(m*m);
+            for (size_t r = 0 ; r < m ; r++){
+                for (size_t c = 0 ; c < m ; c++) s[r*m + c] = sv.get(r, c);
+            }
+
+            order = kmatrix_eigen_order(theta, which);
+            conv = true;
+            for (size_t i = 0 ; i < k ; i++){
+                R res = nrm*std::abs(s[(m-1)*m + order[i]]);
+                if (res > tol*std::max((R)std::abs(theta[order[i]]), anorm*eps)){
+                    conv = false;
+                }
+            }
+
+            if (conv || m == n){
+                conv = true;
+                break;
+            }
+
+            //Thick restart: keep the best Ritz vectors. A*u_i = theta_i*u_i + r*s(m-1, i),
+            //so they couple to the next basis vector through the last row of 's'.
+            if (full){
+                if (++nrestart > KMATRIX_KRYLOV_RESTARTS){
+                    throw conv_ex;
+                }
+                std::vector<size_t> kept(order.begin(), order.begin() + keep);
+                v = kmatrix_krylov_combine(v, s.data(), m, kept);
+                std::fill(h.begin(), h.end(), T(0));
+                for (size_t i = 0 ; i < keep ; i++){
+                    h[i*max_basis + i] = T(theta[kept[i]]);
+                    h[keep*max_basis + i] = T(nrm)*s[(m-1)*m + kept[i]];
+                }
+                m = keep;
+                restarted = true;
+            }
+        }
+
+        //Invariant subspace found early: continue from a fresh vector
+        if (breakdown){
+            kmatrix_krylov_start(w, (unsigned)(m + 1 + nrestart*max_basis));
+            nrm = kmatrix_reorthogonalize(v, m, w, (T*)NULL);
+            for (size_t i = 0 ; i < m ; i++) h[m*max_basis + i] = T(0);
+        }else if (!restarted){
+            h[m*max_basis + m-1] = T(nrm);
+        }
+    }
+
+    //Ritz vectors
+    basis = m;
+    vals.resize(k);
+    std::vector<size_t> wanted(order.begin(), order.begin() + k);
+    std::vector<std::vector<T> > x = kmatrix_krylov_combine(v, s.data(), m, wanted);
+    vecs = KMatrix<T>((int)n, (int)k);
+    for (size_t i = 0 ; i < k ; i++){
+        vals[i] = theta[wanted[i]];
+        for (size_t r = 0 ; r < n ; r++) vecs(r, i) = x[i][r];
+    }
+}
+
+/*
+ Returns the eigenvalues, ordered as selected by 'which'
+ */
+template <class T>
+KVector<typename KLanczos<T>::real_type> KLanczos<T>::values() const{
+    return KVector<real_type>(vals);
+}
+
+/*
+ Returns the eigenvectors as the columns of an n x k matrix
+ */
+template <class T>
+KMatrix<T> KLanczos<T>::vectors() const{
+    return vecs;
+}
+
+/*
+ Returns true if every requested eigenpair met the tolerance. compute() throws rather than
+ return unconverged pairs, so this is false only before the first compute().
+ */
+template <class T>
+bool KLanczos<T>::converged() const{
+    return conv;
+}
+
+/*
+ Returns the size of the Krylov basis the eigenpairs were taken from
+ */
+template <class T>
+size_t KLanczos<T>::basisSize() const{
+    return basis;
+}
+
+/*
+ Returns the number of times the basis was compressed and extended again
+ */
+template <class T>
+size_t KLanczos<T>::restarts() const{
+    return nrestart;
+}
+
+/*----------------------------------------------------------------
+---------------------------- KArnoldi ----------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KArnoldi<T>::KArnoldi() : conv(false), basis(0), nrestart(0){
+
+}
+
+/*
+ Computes 'k' eigenpairs of 'a'. See compute().
+ */
+template <class T>
+KArnoldi<T>::KArnoldi(const KMatrix<T>& a, size_t k, KEigenWhich which, double tol, size_t max_basis) : conv(false), basis(0), nrestart(0){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    compute(kmatrix_matvec<T, complex_type>(a), a.rows(), k, which, tol, max_basis);
+}
+
+/*
+ Computes 'k' eigenpairs of the operator 'op'. See compute().
+ */
+template <class T>
+KArnoldi<T>::KArnoldi(std::function<void(const complex_type*, complex_type*)> op, size_t n, size_t k, KEigenWhich which, double tol, size_t max_basis) : conv(false), basis(0), nrestart(0){
+    compute(op, n, k, which, tol, max_basis);
+}
+
+/*
+ Computes 'k' eigenpairs of a general operator.
+
+ op - computes y = A*x for length-n arrays x and y
+ n - dimension
+ k - number of eigenpairs
+ which - which part of the spectrum to find
+ tol - convergence tolerance on the relative residual ||A*x - lambda*x||
+ max_basis - largest Krylov basis to build (0 for the default)
+
+ Void return
+ */
+template <class T>
+void KArnoldi<T>::compute(std::function<void(const complex_type*, complex_type*)> op, size_t n, size_t k, KEigenWhich which, double tol, size_t max_basis){
+
+    typedef complex_type C;
+    typedef typename kmatrix_real<C>::type R;
+    const R eps = std::numeric_limits<R>::epsilon();
+    matrix_convergence_exception conv_ex;
+
+    if (k > n) k = n;
+    if (max_basis == 0) max_basis = std::max(2*k + 40, 4*k);
+    if (max_basis < k + 2) max_basis = k + 2; //Room to restart
+    if (max_basis > n) max_basis = n;
+    size_t keep = std::min(k + (max_basis - k)/2, max_basis - 1);
+
+    conv = false;
+    vals.clear();
+    vecs = KMatrix<C>();
+    basis = 0;
+    nrestart = 0;
+    if (k == 0) return;
+
+    std::vector<std::vector<C> > v;
+    std::vector<C> hess((max_basis+1)*max_basis, C(0)); //Row-major, leading dimension max_basis
+    std::vector<C> w(n);
+    R anorm = 0;
+
+    kmatrix_krylov_start(w, 1);
+    R nrm = kmatrix_reorthogonalize(v, 0, w, (C*)NULL);
+
+    std::vector<C> theta, y;
+    std::vector<size_t> order;
+    size_t m = 0;
+    while (true){
+
+        v.push_back(w);
+        for (size_t r = 0 ; r < n ; r++) v[m][r] /= C(nrm);
+
+        op(v[m].data(), w.data());
+        std::vector<C> hcol(m+1, C(0));
+        nrm = kmatrix_reorthogonalize(v, m+1, w, hcol.data());
+        for (size_t i = 0 ; i <= m ; i++){
+            hess[i*max_basis + m] = hcol[i];
+            anorm = std::max(anorm, (R)std::abs(hcol[i]));
+        }
+        m++;
+        anorm = std::max(anorm, nrm);
+
+        bool breakdown = nrm <= eps*anorm;
+        bool full = (m == max_basis);
+        bool restarted = false;
+
+        //Check the Ritz pairs. After a restart the projected matrix is no longer Hessenberg,
+        //so it is reduced again first.
+        if (m >= k && (full || breakdown || m % 5 == 0)){
+            std::vector<C> hm(m*m), zm(m*m, C(0)), ym(m*m);
+            for (size_t r = 0 ; r < m ; r++){
+                zm[r*m + r] = C(1);
+                for (size_t c = 0 ; c < m ; c++) hm[r*m + c] = hess[r*max_basis + c];
+            }
+            kmatrix_hessenberg(m, hm.data(), zm.data());
+            kmatrix_hessenberg_qr(m, hm.data(), zm.data());
+            kmatrix_schur_vectors(m, hm.data(), zm.data(), ym.data());
+
+            theta.resize(m);
+            for (size_t i = 0 ; i < m ; i++) theta[i] = hm[i*m + i];
+            y = ym;
+
+            order = kmatrix_eigen_order(theta, which);
+            conv = true;
+            for (size_t i = 0 ; i < k ; i++){
+                R res = nrm*std::abs(y[(m-1)*m + order[i]]);
+                if (res > tol*std::max((R)std::abs(theta[order[i]]), anorm*eps)){
+                    conv = false;
+                }
+            }
+
+            if (conv || m == n){
+                conv = true;
+                break;
+            }
+
+            //Krylov-Schur restart: move the best Ritz values to the top of the Schur form
+            //and keep the leading Schur vectors, which couple to the next basis vector
+            //through the last row of Z
+            if (full){
+                if (++nrestart > KMATRIX_KRYLOV_RESTARTS){
+                    throw conv_ex;
+                }
+                std::vector<size_t> kept(order.begin(), order.begin() + keep);
+                kmatrix_schur_reorder(m, hm.data(), zm.data(), kept);
+                std::vector<size_t> lead(keep);
+                for (size_t i = 0 ; i < keep ; i++) lead[i] = i;
+                v = kmatrix_krylov_combine(v, zm.data(), m, lead);
+                std::fill(hess.begin(), hess.end(), C(0));
+                for (size_t i = 0 ; i < keep ; i++){
+                    for (size_t c = i ; c < keep ; c++) hess[i*max_basis + c] = hm[i*m + c];
+                    hess[keep*max_basis + i] = C(nrm)*zm[(m-1)*m + i];
+                }
+                m = keep;
+                restarted = true;
+            }
+        }
+
+        if (breakdown){
+            kmatrix_krylov_start(w, (unsigned)(m + 1 + nrestart*max_basis));
+            nrm = kmatrix_reorthogonalize(v, m, w, (C*)NULL);
+            for (size_t i = 0 ; i < m ; i++) hess[m*max_basis + i] = C(0);
+        }else if (!restarted){
+            hess[m*max_basis + m-1] = C(nrm);
+        }
+    }
+
+    //Ritz vectors
+    basis = m;
+    vals.resize(k);
+    std::vector<size_t> wanted(order.begin(), order.begin() + k);
+    std::vector<std::vector<C> > x = kmatrix_krylov_combine(v, y.data(), m, wanted);
+    vecs = KMatrix<C>((int)n, (int)k);
+    for (size_t i = 0 ; i < k ; i++){
+        vals[i] = theta[wanted[i]];
+        for (size_t r = 0 ; r < n ; r++) vecs(r, i) = x[i][r];
+    }
+}
+
+/*
+ Returns the eigenvalues, ordered as selected by 'which'
+ */
+template <class T>
+KVector<typename KArnoldi<T>::complex_type> KArnoldi<T>::values() const{
+    return KVector<complex_type>(vals);
+}
+
+/*
+ Returns the eigenvectors as the columns of an n x k matrix
+ */
+template <class T>
+KMatrix<typename KArnoldi<T>::complex_type> KArnoldi<T>::vectors() const{
+    return vecs;
+}
+
+/*
+ Returns true if every requested eigenpair met the tolerance. compute() throws rather than
+ return unconverged pairs, so this is false only before the first compute().
+ */
+template <class T>
+bool KArnoldi<T>::converged() const{
+    return conv;
+}
+
+/*
+ Returns the size of the Krylov basis the eigenpairs were taken from
+ */
+template <class T>
+size_t KArnoldi<T>::basisSize() const{
+    return basis;
+}
+
+/*
+ Returns the number of times the basis was compressed and extended again
+ */
+template <class T>
+size_t KArnoldi<T>::restarts() const{
+    return nrestart;
+}
+
+#endif /* KMatrixEigen_hpp */
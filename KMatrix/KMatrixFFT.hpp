@@ -0,0 +1,943 @@
+//
+//  KMatrixFFT.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixFFT_hpp
+#define KMatrixFFT_hpp
+
+#include <vector>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <algorithm>
+#include "KMatrix.hpp"
+#include "KVector.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Fast Fourier transforms of KVector and KMatrix objects, and convolution built on them.
+
+ KFFTPlan - complex transform of one length. The length is split into factors of 4, 2, 3 and
+            other primes, which are combined by a recursive mixed-radix decimation in time.
+            A length with a prime factor above KMATRIX_FFT_MAX_RADIX is transformed through
+            a power of two instead (Bluestein's chirp-z algorithm), so every length costs
+            O(n log n).
+ KRealFFTPlan - transform of real data. An even length is packed into a complex transform
+                of half the length.
+
+ A plan holds the factors and twiddle factors of its length and is not changed by
+ transforming, so it can be reused, copied and shared between threads. The free functions
+ (fft(), ifft(), rfft(), irfft(), fft2(), ifft2()) make a plan for each call.
+
+ The forward transform is X[k] = sum x[j]*exp(-2*pi*i*j*k/n) and the inverse divides by n,
+ so inverse(forward(x)) = x.
+ */
+
+//Largest prime factor transformed directly. Lengths with larger prime factors use Bluestein.
+#define KMATRIX_FFT_MAX_RADIX 64
+
+//Smallest number of elements for which a transform is split across the thread pool
+#define KMATRIX_FFT_PARALLEL 65536
+
+//convolve() and correlate() use FFTs once both inputs are longer than this, and multiply
+//directly otherwise
+#define KMATRIX_CONV_CROSSOVER 128
+
+template <class R>
+class KFFTPlan {
+public:
+
+    typedef std::complex<R> complex_type;
+
+    KFFTPlan();
+    KFFTPlan(size_t n);
+
+    void plan(size_t n);
+
+    void forward(const complex_type* in, complex_type* out) const;
+    void inverse(const complex_type* in, complex_type* out) const;
+    KVector<complex_type> forward(const KVector<complex_type>& x) const;
+    KVector<complex_type> inverse(const KVector<complex_type>& x) const;
+
+    size_t size() const;
+    std::vector<size_t> factors() const;
+    bool bluestein() const;
+
+private:
+
+    void transform(const complex_type* in, complex_type* out) const;
+    void work(complex_type* out, const complex_type* in, size_t fstride, size_t level, bool parallel) const;
+    void butterfly(complex_type* out, size_t fstride, size_t level, size_t u0, size_t u1) const;
+
+    size_t n;
+    std::vector<size_t> radix;
+    std::vector<size_t> span;
+    std::vector<complex_type> tw;
+    std::shared_ptr<KFFTPlan<R> > inner;
+    std::vector<complex_type> chirp;
+    std::vector<complex_type> chirp_fft;
+};
+
+/*
+ Transform of real data. The forward transform returns only the n/2 + 1 non-redundant
+ frequencies; the rest are their complex conjugates, X[n-k] = conj(X[k]).
+ */
+template <class R>
+class KRealFFTPlan {
+public:
+
+    typedef std::complex<R> complex_type;
+
+    KRealFFTPlan();
+    KRealFFTPlan(size_t n);
+
+    void plan(size_t n);
+
+    void forward(const R* in, complex_type* out) const;
+    void inverse(const complex_type* in, R* out) const;
+    KVector<complex_type> forward(const KVector<R>& x) const;
+    KVector<R> inverse(const KVector<complex_type>& x) const;
+
+    size_t size() const;
+
+private:
+
+    size_t n;
+    KFFTPlan<R> half;
+    std::vector<complex_type> tw;
+};
+
+template <class R>
+KVector<std::complex<R> > fft(const KVector<std::complex<R> >& x);
+
+template <class R>
+KVector<std::complex<R> > fft(const KVector<R>& x);
+
+template <class R>
+KVector<std::complex<R> > ifft(const KVector<std::complex<R> >& x);
+
+template <class R>
+KVector<std::complex<R> > rfft(const KVector<R>& x);
+
+template <class R>
+KVector<R> irfft(const KVector<std::complex<R> >& x, size_t n);
+
+template <class R>
+KMatrix<std::complex<R> > fft2(const KMatrix<std::complex<R> >& x);
+
+template <class R>
+KMatrix<std::complex<R> > fft2(const KMatrix<R>& x);
+
+template <class R>
+KMatrix<std::complex<R> > ifft2(const KMatrix<std::complex<R> >& x);
+
+template <class T>
+KVector<T> convolve(const KVector<T>& a, const KVector<T>& b, size_t crossover = KMATRIX_CONV_CROSSOVER);
+
+template <class T>
+KVector<T> correlate(const KVector<T>& a, const KVector<T>& b, size_t crossover = KMATRIX_CONV_CROSSOVER);
+
+/*----------------------------------------------------------------
+-------------------------- FFT HELPERS ---------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns exp(-2*pi*i*k/n)
+ */
+template <class R>
+std::complex<R> kmatrix_twiddle(size_t k, size_t n){
+    const double pi = 3.141592653589793238462643383279502884;
+    double angle = -2*pi*((double)k/(double)n);
+    return std::complex<R>(R(std::cos(angle)), R(std::sin(angle)));
+}
+
+/*
+ Returns the smallest length of at least 'n' whose only prime factors are 2, 3 and 5
+ */
+inline size_t kmatrix_fft_size(size_t n){
+
+    if (n <= 1) return 1;
+
+    for (size_t m = n ; ; m++){
+        size_t r = m;
+        while (r % 2 == 0) r /= 2;
+        while (r % 3 == 0) r /= 3;
+        while (r % 5 == 0) r /= 5;
+        if (r == 1) return m;
+    }
+}
+
+/*
+ Copies the elements of 'v' into a std::vector
+ */
+template <class T>
+std::vector<T> kmatrix_values(const KVector<T>& v){
+
+    std::vector<T> out(v.size());
+    for (size_t i = 0 ; i < out.size() ; i++) out[i] = v.get(i);
+
+    return out;
+}
+
+/*----------------------------------------------------------------
+---------------------------- KFFTPlan ----------------------------
+----------------------------------------------------------------*/
+
+template <class R>
+KFFTPlan<R>::KFFTPlan() : n(0){
+
+}
+
+template <class R>
+KFFTPlan<R>::KFFTPlan(size_t n) : n(0){
+    plan(n);
+}
+
+/*
+ Prepares transforms of length 'n': factors it and computes the twiddle factors, or for a
+ length with a large prime factor, the chirp and the plan of the power of two it is
+ convolved through.
+
+ Void return
+ */
+template <class R>
+void KFFTPlan<R>::plan(size_t n){
+
+    this->n = n;
+    radix.clear();
+    span.clear();
+    tw.clear();
+    inner.reset();
+    chirp.clear();
+    chirp_fft.clear();
+
+    if (n <= 1) return;
+
+    //Fours first, then twos, then odd factors in increasing order
+    size_t rest = n;
+    size_t p = 4;
+    while (rest > 1){
+        while (rest % p != 0){
+            p = (p == 4) ? 2 : (p == 2) ? 3 : p + 2;
+            if (p*p > rest) p = rest;
+        }
+        rest /= p;
+        radix.push_back(p);
+        span.push_back(rest);
+    }
+
+    if (radix.back() <= KMATRIX_FFT_MAX_RADIX){
+        tw.resize(n);
+        for (size_t k = 0 ; k < n ; k++) tw[k] = kmatrix_twiddle<R>(k, n);
+        return;
+    }
+
+    //Bluestein: X[k] = w[k]*sum (x[j]*w[j])*conj(w[k-j]) with w[k] = exp(-pi*i*k^2/n), a
+    //convolution evaluated with transforms of a power of two at least 2n - 1 long
+    radix.clear();
+    span.clear();
+
+    size_t m = 1;
+    while (m < 2*n - 1) m *= 2;
+    inner = std::make_shared<KFFTPlan<R> >(m);
+
+    chirp.resize(n);
+    for (size_t k = 0 ; k < n ; k++){
+        //k^2 mod 2n keeps the angle small, so it stays accurate for large k
+        unsigned long long k2 = ((unsigned long long)k*k) % (2ULL*n);
+        chirp[k] = kmatrix_twiddle<R>((size_t)k2, 2*n);
+    }
+
+    std::vector<complex_type> b(m, complex_type(0));
+    b[0] = std::conj(chirp[0]);
+    for (size_t k = 1 ; k < n ; k++){
+        b[k] = std::conj(chirp[k]);
+        b[m - k] = b[k];
+    }
+    chirp_fft.resize(m);
+    inner->forward(b.data(), chirp_fft.data());
+}
+
+/*
+ Computes the forward transform of the n elements at 'in' into 'out'. They may be the same
+ array.
+
+ Void return
+ */
+template <class R>
+void KFFTPlan<R>::forward(const complex_type* in, complex_type* out) const{
+    transform(in, out);
+}
+
+/*
+ Computes the inverse transform (including the 1/n) of the n elements at 'in' into 'out'.
+ They may be the same array.
+
+ Void return
+ */
+template <class R>
+void KFFTPlan<R>::inverse(const complex_type* in, complex_type* out) const{
+
+    std::vector<complex_type> conj(n);
+    for (size_t k = 0 ; k < n ; k++) conj[k] = std::conj(in[k]);
+
+    transform(conj.data(), out);
+
+    R scale = R(1)/R((double)n);
+    for (size_t k = 0 ; k < n ; k++) out[k] = std::conj(out[k])*scale;
+}
+
+/*
+ Returns the forward transform of 'x', which must have size() elements. Throws
+ matrix_bounds_excep otherwise.
+ */
+template <class R>
+KVector<typename KFFTPlan<R>::complex_type> KFFTPlan<R>::forward(const KVector<complex_type>& x) const{
+
+    matrix_bounds_excep bounds_ex;
+    if (x.size() != n){
+        throw bounds_ex;
+    }
+
+    std::vector<complex_type> out = kmatrix_values(x);
+    transform(out.data(), out.data());
+
+    return KVector<complex_type>(out);
+}
+
+/*
+ Returns the inverse transform of 'x', which must have size() elements. Throws
+ matrix_bounds_excep otherwise.
+ */
+template <class R>
+KVector<typename KFFTPlan<R>::complex_type> KFFTPlan<R>::inverse(const KVector<complex_type>& x) const{
+
+    matrix_bounds_excep bounds_ex;
+    if (x.size() != n){
+        throw bounds_ex;
+    }
+
+    std::vector<complex_type> out = kmatrix_values(x);
+    inverse(out.data(), out.data());
+
+    return KVector<complex_type>(out);
+}
+
+template <class R>
+size_t KFFTPlan<R>::size() const{
+    return n;
+}
+
+/*
+ Returns the radices of the mixed-radix stages, outermost first (empty for Bluestein)
+ */
+template <class R>
+std::vector<size_t> KFFTPlan<R>::factors() const{
+    return radix;
+}
+
+/*
+ Returns true if the length is transformed through Bluestein's algorithm
+ */
+template <class R>
+bool KFFTPlan<R>::bluestein() const{
+    return (bool)inner;
+}
+
+/*
+ Unnormalized forward transform of 'in' into 'out'
+ */
+template <class R>
+void KFFTPlan<R>::transform(const complex_type* in, complex_type* out) const{
+
+    if (n == 0) return;
+    if (n == 1){
+        out[0] = in[0];
+        return;
+    }
+
+    if (inner){
+        size_t m = inner->size();
+        std::vector<complex_type> a(m, complex_type(0)), fa(m);
+        for (size_t k = 0 ; k < n ; k++) a[k] = in[k]*chirp[k];
+        inner->transform(a.data(), fa.data());
+
+        //Inverse of the product through conj(forward(conj(.)))
+        for (size_t k = 0 ; k < m ; k++) fa[k] = std::conj(fa[k]*chirp_fft[k]);
+        inner->transform(fa.data(), a.data());
+
+        R scale = R(1)/R((double)m);
+        for (size_t k = 0 ; k < n ; k++) out[k] = chirp[k]*std::conj(a[k])*scale;
+        return;
+    }
+
+    //The recursion reads the input with strides, so it can not work in place
+    std::vector<complex_type> copy;
+    if (in == out){
+        copy.assign(in, in + n);
+        in = copy.data();
+    }
+
+    work(out, in, 1, 0, n >= KMATRIX_FFT_PARALLEL);
+}
+
+/*
+ Transforms the subsequence in[0], in[fstride], in[2*fstride], ... of length
+ radix[level]*span[level] into 'out': each of the radix[level] interleaved subsequences is
+ transformed recursively into its own block of 'out', then the blocks are combined.
+
+ parallel - split this level across the thread pool (only the outermost level is split)
+
+ Void return
+ */
+template <class R>
+void KFFTPlan<R>::work(complex_type* out, const complex_type* in, size_t fstride, size_t level, bool parallel) const{
+
+    size_t p = radix[level];
+    size_t m = span[level];
+
+    if (m == 1){
+        for (size_t q = 0 ; q < p ; q++) out[q] = in[q*fstride];
+    }else if (parallel){
+        KThreadPool::global().parallel_for(0, p, [&](size_t lo, size_t hi){
+            for (size_t q = lo ; q < hi ; q++) work(out + q*m, in + q*fstride, fstride*p, level + 1, false);
+        });
+    }else{
+        for (size_t q = 0 ; q < p ; q++) work(out + q*m, in + q*fstride, fstride*p, level + 1, false);
+    }
+
+    if (parallel){
+        KThreadPool::global().parallel_for(0, m, [&](size_t lo, size_t hi){
+            butterfly(out, fstride, level, lo, hi);
+        }, 64);
+    }else{
+        butterfly(out, fstride, level, 0, m);
+    }
+}
+
+/*
+ Combines the radix[level] transformed blocks of length m = span[level] at 'out', for the
+ butterflies u0 <= u < u1. Element u of block q is multiplied by the twiddle
+ exp(-2*pi*i*q*u/(p*m)) (tw[q*u*fstride]) before the length p transforms across blocks.
+
+ Void return
+ */
+template <class R>
+void KFFTPlan<R>::butterfly(complex_type* out, size_t fstride, size_t level, size_t u0, size_t u1) const{
+
+    size_t p = radix[level];
+    size_t m = span[level];
+
+    if (p == 2){
+        for (size_t u = u0 ; u < u1 ; u++){
+            complex_type t = out[u + m]*tw[u*fstride];
+            out[u + m] = out[u] - t;
+            out[u] += t;
+        }
+    }else if (p == 4){
+        for (size_t u = u0 ; u < u1 ; u++){
+            complex_type s0 = out[u + m]*tw[u*fstride];
+            complex_type s1 = out[u + 2*m]*tw[2*u*fstride];
+            complex_type s2 = out[u + 3*m]*tw[3*u*fstride];
+            complex_type s5 = out[u] - s1;
+            complex_type s3 = s0 + s2;
+            complex_type s4 = s0 - s2;
+            out[u] += s1;
+            out[u + 2*m] = out[u] - s3;
+            out[u] += s3;
+            out[u + m] = complex_type(s5.real() + s4.imag(), s5.imag() - s4.real());
+            out[u + 3*m] = complex_type(s5.real() - s4.imag(), s5.imag() + s4.real());
+        }
+    }else if (p == 3){
+        R h = tw[fstride*m].imag(); //-sin(2*pi/3)
+        for (size_t u = u0 ; u < u1 ; u++){
+            complex_type s1 = out[u + m]*tw[u*fstride];
+            complex_type s2 = out[u + 2*m]*tw[2*u*fstride];
+            complex_type s3 = s1 + s2;
+            complex_type s0 = (s1 - s2)*h;
+            complex_type mid = out[u] - s3*R(0.5);
+            out[u] += s3;
+            out[u + m] = complex_type(mid.real() - s0.imag(), mid.imag() + s0.real());
+            out[u + 2*m] = complex_type(mid.real() + s0.imag(), mid.imag() - s0.real());
+        }
+    }else{
+        //Direct DFT across blocks, with the twiddle folded into the DFT's roots of unity
+        std::vector<complex_type> scratch(p);
+        for (size_t u = u0 ; u < u1 ; u++){
+            for (size_t q = 0 ; q < p ; q++) scratch[q] = out[u + q*m];
+            for (size_t q1 = 0 ; q1 < p ; q1++){
+                size_t k = u + q1*m;
+                size_t idx = 0;
+                complex_type sum = scratch[0];
+                for (size_t q = 1 ; q < p ; q++){
+                    idx += fstride*k;
+                    if (idx >= n) idx -= n;
+                    sum += scratch[q]*tw[idx];
+                }
+                out[k] = sum;
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------
+-------------------------- KRealFFTPlan --------------------------
+----------------------------------------------------------------*/
+
+template <class R>
+KRealFFTPlan<R>::KRealFFTPlan() : n(0){
+
+}
+
+template <class R>
+KRealFFTPlan<R>::KRealFFTPlan(size_t n) : n(0){
+    plan(n);
+}
+
+/*
+ Prepares transforms of 'n' real values. An even length uses a complex plan of n/2, an odd
+ one a complex plan of n.
+
+ Void return
+ */
+template <class R>
+void KRealFFTPlan<R>::plan(size_t n){
+
+    this->n = n;
+    tw.clear();
+
+    if (n % 2 != 0){
+        half.plan(n);
+        return;
+    }
+
+    half.plan(n/2);
+    tw.resize(n/2 + 1);
+    for (size_t k = 0 ; k <= n/2 ; k++) tw[k] = kmatrix_twiddle<R>(k, n);
+}
+
+/*
+ Computes the n/2 + 1 non-redundant frequencies of the n real values at 'in' into 'out'.
+ For even n, the even and odd elements are transformed together as the real and imaginary
+ parts of one half-length complex sequence, then separated.
+
+ Void return
+ */
+template <class R>
+void KRealFFTPlan<R>::forward(const R* in, complex_type* out) const{
+
+    if (n == 0) return;
+
+    if (n % 2 != 0){
+        std::vector<complex_type> x(n);
+        for (size_t k = 0 ; k < n ; k++) x[k] = complex_type(in[k], R(0));
+        half.forward(x.data(), x.data());
+        for (size_t k = 0 ; k <= n/2 ; k++) out[k] = x[k];
+        return;
+    }
+
+    size_t h = n/2;
+    std::vector<complex_type> z(h);
+    for (size_t k = 0 ; k < h ; k++) z[k] = complex_type(in[2*k], in[2*k + 1]);
+    half.forward(z.data(), z.data());
+
+    for (size_t k = 0 ; k <= h ; k++){
+        complex_type zk = z[k % h];
+        complex_type zc = std::conj(z[(h - k) % h]);
+        complex_type even = (zk + zc)*R(0.5);
+        complex_type odd = (zk - zc)*complex_type(R(0), R(-0.5));
+        out[k] = even + tw[k]*odd;
+    }
+}
+
+/*
+ Computes the n real values whose non-redundant frequencies are the n/2 + 1 values at 'in'
+ into 'out' (including the 1/n). The imaginary parts of in[0] and, for even n, in[n/2] are
+ ignored.
+
+ Void return
+ */
+template <class R>
+void KRealFFTPlan<R>::inverse(const complex_type* in, R* out) const{
+
+    if (n == 0) return;
+
+    if (n % 2 != 0){
+        std::vector<complex_type> x(n);
+        for (size_t k = 0 ; k <= n/2 ; k++) x[k] = in[k];
+        for (size_t k = 1 ; k <= n/2 ; k++) x[n - k] = std::conj(in[k]);
+        half.inverse(x.data(), x.data());
+        for (size_t k = 0 ; k < n ; k++) out[k] = x[k].real();
+        return;
+    }
+
+    size_t h = n/2;
+    std::vector<complex_type> z(h);
+    for (size_t k = 0 ; k < h ; k++){
+        complex_type xk = in[k];
+        complex_type xc = std::conj(in[h - k]);
+        if (k == 0){
+            xk = complex_type(in[0].real(), R(0));
+            xc = complex_type(in[h].real(), R(0));
+        }
+        complex_type even = (xk + xc)*R(0.5);
+        complex_type odd = (xk - xc)*R(0.5)*std::conj(tw[k]);
+        z[k] = even + complex_type(-odd.imag(), odd.real());
+    }
+    half.inverse(z.data(), z.data());
+
+    for (size_t k = 0 ; k < h ; k++){
+        out[2*k] = z[k].real();
+        out[2*k + 1] = z[k].imag();
+    }
+}
+
+/*
+ Returns the n/2 + 1 non-redundant frequencies of 'x', which must have size() elements.
+ Throws matrix_bounds_excep otherwise.
+ */
+template <class R>
+KVector<typename KRealFFTPlan<R>::complex_type> KRealFFTPlan<R>::forward(const KVector<R>& x) const{
+
+    matrix_bounds_excep bounds_ex;
+    if (x.size() != n){
+        throw bounds_ex;
+    }
+
+    std::vector<R> in = kmatrix_values(x);
+    std::vector<complex_type> out(n/2 + 1);
+    forward(in.data(), out.data());
+
+    return KVector<complex_type>(out);
+}
+
+/*
+ Returns the size() real values whose non-redundant frequencies are 'x', which must have
+ size()/2 + 1 elements. Throws matrix_bounds_excep otherwise.
+ */
+template <class R>
+KVector<R> KRealFFTPlan<R>::inverse(const KVector<complex_type>& x) const{
+
+    matrix_bounds_excep bounds_ex;
+    if (x.size() != n/2 + 1){
+        throw bounds_ex;
+    }
+
+    std::vector<complex_type> in = kmatrix_values(x);
+    std::vector<R> out(n);
+    inverse(in.data(), out.data());
+
+    return KVector<R>(out);
+}
+
+template <class R>
+size_t KRealFFTPlan<R>::size() const{
+    return n;
+}
+
+/*----------------------------------------------------------------
+------------------------- FFT FUNCTIONS --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns the forward transform of 'x'
+ */
+template <class R>
+KVector<std::complex<R> > fft(const KVector<std::complex<R> >& x){
+    return KFFTPlan<R>(x.size()).forward(x);
+}
+
+/*
+ Returns the full forward transform of the real values 'x', computed with a real transform
+ and completed by conjugate symmetry
+ */
+template <class R>
+KVector<std::complex<R> > fft(const KVector<R>& x){
+
+    size_t n = x.size();
+    std::vector<R> in = kmatrix_values(x);
+    std::vector<std::complex<R> > out(n);
+    if (n == 0) return KVector<std::complex<R> >(out);
+
+    KRealFFTPlan<R>(n).forward(in.data(), out.data());
+    for (size_t k = n/2 + 1 ; k < n ; k++) out[k] = std::conj(out[n - k]);
+
+    return KVector<std::complex<R> >(out);
+}
+
+/*
+ Returns the inverse transform of 'x'
+ */
+template <class R>
+KVector<std::complex<R> > ifft(const KVector<std::complex<R> >& x){
+    return KFFTPlan<R>(x.size()).inverse(x);
+}
+
+/*
+ Returns the n/2 + 1 non-redundant frequencies of the real values 'x'
+ */
+template <class R>
+KVector<std::complex<R> > rfft(const KVector<R>& x){
+    return KRealFFTPlan<R>(x.size()).forward(x);
+}
+
+/*
+ Returns the 'n' real values whose non-redundant frequencies are 'x' (n/2 + 1 elements).
+ Throws matrix_bounds_excep if 'x' has the wrong size.
+ */
+template <class R>
+KVector<R> irfft(const KVector<std::complex<R> >& x, size_t n){
+    return KRealFFTPlan<R>(n).inverse(x);
+}
+
+/*
+ Transforms each row of the row-major 'rows' x 'cols' array 'a' in place, splitting the rows
+ across the thread pool when the array is large enough.
+
+ Void return
+ */
+template <class R>
+void kmatrix_fft_rows(std::vector<std::complex<R> >& a, size_t rows, size_t cols, bool inverse){
+
+    KFFTPlan<R> plan(cols);
+    auto transform = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++){
+            std::complex<R>* row = a.data() + r*cols;
+            if (inverse) plan.inverse(row, row); else plan.forward(row, row);
+        }
+    };
+
+    if (rows*cols < KMATRIX_FFT_PARALLEL){
+        transform(0, rows);
+    }else{
+        KThreadPool::global().parallel_for(0, rows, transform);
+    }
+}
+
+/*
+ Transforms the first 'ncols' columns of the row-major 'rows' x 'cols' array 'a' in place.
+ Each column is gathered into a contiguous buffer, transformed and scattered back.
+
+ Void return
+ */
+template <class R>
+void kmatrix_fft_cols(std::vector<std::complex<R> >& a, size_t rows, size_t cols, size_t ncols, bool inverse){
+
+    KFFTPlan<R> plan(rows);
+    auto transform = [&](size_t lo, size_t hi){
+        std::vector<std::complex<R> > col(rows);
+        for (size_t c = lo ; c < hi ; c++){
+            for (size_t r = 0 ; r < rows ; r++) col[r] = a[r*cols + c];
+            if (inverse) plan.inverse(col.data(), col.data()); else plan.forward(col.data(), col.data());
+            for (size_t r = 0 ; r < rows ; r++) a[r*cols + c] = col[r];
+        }
+    };
+
+    if (rows*ncols < KMATRIX_FFT_PARALLEL){
+        transform(0, ncols);
+    }else{
+        KThreadPool::global().parallel_for(0, ncols, transform);
+    }
+}
+
+/*
+ Returns the 2-D forward transform of 'x': every row is transformed, then every column
+ */
+template <class R>
+KMatrix<std::complex<R> > fft2(const KMatrix<std::complex<R> >& x){
+
+    size_t rows = x.rows(), cols = x.cols();
+    std::vector<std::complex<R> > a = kmatrix_dense<std::complex<R> >(x);
+    kmatrix_fft_rows(a, rows, cols, false);
+    kmatrix_fft_cols(a, rows, cols, cols, false);
+
+    return KMatrix<std::complex<R> >(a.data(), (int)rows, (int)cols, KMAT_ROW_MAJOR);
+}
+
+/*
+ Returns the 2-D forward transform of the real matrix 'x'. Rows are transformed with real
+ transforms, only the non-redundant half of the columns are then transformed, and the other
+ half is filled in by conjugate symmetry, X[r][c] = conj(X[-r][-c]).
+ */
+template <class R>
+KMatrix<std::complex<R> > fft2(const KMatrix<R>& x){
+
+    typedef std::complex<R> C;
+
+    size_t rows = x.rows(), cols = x.cols();
+    std::vector<R> in = kmatrix_dense<R>(x);
+    std::vector<C> a(rows*cols);
+    if (rows*cols == 0) return KMatrix<C>((int)rows, (int)cols);
+
+    KRealFFTPlan<R> row_plan(cols);
+    auto do_rows = [&](size_t lo, size_t hi){
+        for (size_t r = lo ; r < hi ; r++) row_plan.forward(in.data() + r*cols, a.data() + r*cols);
+    };
+    if (rows*cols >= KMATRIX_FFT_PARALLEL) KThreadPool::global().parallel_for(0, rows, do_rows); else do_rows(0, rows);
+
+    size_t half = cols/2 + 1;
+    kmatrix_fft_cols(a, rows, cols, half, false);
+
+    for (size_t r = 0 ; r < rows ; r++){
+        for (size_t c = half ; c < cols ; c++){
+            a[r*cols + c] = std::conj(a[((rows - r) % rows)*cols + (cols - c)]);
+        }
+    }
+
+    return KMatrix<C>(a.data(), (int)rows, (int)cols, KMAT_ROW_MAJOR);
+}
+
+/*
+ Returns the 2-D inverse transform of 'x'
+ */
+template <class R>
+KMatrix<std::complex<R> > ifft2(const KMatrix<std::complex<R> >& x){
+
+    size_t rows = x.rows(), cols = x.cols();
+    std::vector<std::complex<R> > a = kmatrix_dense<std::complex<R> >(x);
+    kmatrix_fft_rows(a, rows, cols, true);
+    kmatrix_fft_cols(a, rows, cols, cols, true);
+
+    return KMatrix<std::complex<R> >(a.data(), (int)rows, (int)cols, KMAT_ROW_MAJOR);
+}
+
+/*----------------------------------------------------------------
+-------------------------- CONVOLUTION ---------------------------
+----------------------------------------------------------------*/
+
+/*
+ Full linear convolution of 'a' and 'b' by direct summation, split across the thread pool
+ for long inputs.
+
+ Returns the na + nb - 1 values
+ */
+template <class T>
+std::vector<T> kmatrix_convolve_direct(const std::vector<T>& a, const std::vector<T>& b){
+
+    size_t na = a.size(), nb = b.size();
+    std::vector<T> out(na + nb - 1, T(0));
+
+    auto conv = [&](size_t lo, size_t hi){
+        for (size_t k = lo ; k < hi ; k++){
+            size_t i0 = (k + 1 > nb) ? k + 1 - nb : 0;
+            size_t i1 = (k < na) ? k : na - 1;
+            T sum = T(0);
+            for (size_t i = i0 ; i <= i1 ; i++) sum += a[i]*b[k - i];
+            out[k] = sum;
+        }
+    };
+
+    if (na*nb < KMATRIX_ELEMENTWISE_PARALLEL){
+        conv(0, out.size());
+    }else{
+        KThreadPool::global().parallel_for(0, out.size(), conv, 64);
+    }
+
+    return out;
+}
+
+/*
+ Full linear convolution of real 'a' and 'b' through real transforms of a length of at
+ least na + nb - 1 with only small prime factors.
+
+ Returns the na + nb - 1 values
+ */
+template <class T>
+std::vector<T> kmatrix_convolve_fft(const std::vector<T>& a, const std::vector<T>& b, T*){
+
+    typedef std::complex<T> C;
+
+    size_t len = a.size() + b.size() - 1;
+    size_t m = kmatrix_fft_size(len);
+    KRealFFTPlan<T> plan(m);
+
+    std::vector<T> pa(m, T(0)), pb(m, T(0));
+    std::copy(a.begin(), a.end(), pa.begin());
+    std::copy(b.begin(), b.end(), pb.begin());
+
+    std::vector<C> fa(m/2 + 1), fb(m/2 + 1);
+    plan.forward(pa.data(), fa.data());
+    plan.forward(pb.data(), fb.data());
+    for (size_t k = 0 ; k < fa.size() ; k++) fa[k] *= fb[k];
+    plan.inverse(fa.data(), pa.data());
+
+    pa.resize(len);
+    return pa;
+}
+
+/*
+ Full linear convolution of complex 'a' and 'b' through complex transforms.
+
+ Returns the na + nb - 1 values
+ */
+template <class R>
+std::vector<std::complex<R> > kmatrix_convolve_fft(const std::vector<std::complex<R> >& a, const std::vector<std::complex<R> >& b, std::complex<R>*){
+
+    typedef std::complex<R> C;
+
+    size_t len = a.size() + b.size() - 1;
+    size_t m = kmatrix_fft_size(len);
+    KFFTPlan<R> plan(m);
+
+    std::vector<C> pa(m, C(0)), pb(m, C(0));
+    std::copy(a.begin(), a.end(), pa.begin());
+    std::copy(b.begin(), b.end(), pb.begin());
+
+    plan.forward(pa.data(), pa.data());
+    plan.forward(pb.data(), pb.data());
+    for (size_t k = 0 ; k < m ; k++) pa[k] *= pb[k];
+    plan.inverse(pa.data(), pa.data());
+
+    pa.resize(len);
+    return pa;
+}
+
+/*
+ Computes the full linear convolution out[k] = sum a[i]*b[k-i]. When both inputs are longer
+ than 'crossover' it is computed with FFTs in O(n log n), otherwise by direct summation,
+ which is faster (and exact for exact inputs) when one of them is short.
+
+ a, b - vectors to convolve (real or complex)
+ crossover - length at or below which an input is considered short
+
+ Returns the a.size() + b.size() - 1 values (empty if either input is)
+ */
+template <class T>
+KVector<T> convolve(const KVector<T>& a, const KVector<T>& b, size_t crossover){
+
+    if (a.size() == 0 || b.size() == 0) return KVector<T>(std::vector<T>());
+
+    std::vector<T> va = kmatrix_values(a);
+    std::vector<T> vb = kmatrix_values(b);
+
+    if (std::min(va.size(), vb.size()) <= crossover){
+        return KVector<T>(kmatrix_convolve_direct(va, vb));
+    }
+
+    return KVector<T>(kmatrix_convolve_fft(va, vb, (T*)NULL));
+}
+
+/*
+ Computes the full cross-correlation out[k] = sum a[j + k - (nb-1)]*conj(b[j]), that is,
+ the convolution of 'a' with 'b' reversed and conjugated. Element nb-1 is lag zero.
+
+ a, b - vectors to correlate (real or complex)
+ crossover - see convolve()
+
+ Returns the a.size() + b.size() - 1 values, for lags -(nb-1) to na-1
+ */
+template <class T>
+KVector<T> correlate(const KVector<T>& a, const KVector<T>& b, size_t crossover){
+
+    std::vector<T> rev = kmatrix_values(b);
+    std::reverse(rev.begin(), rev.end());
+    for (size_t i = 0 ; i < rev.size() ; i++) rev[i] = kmatrix_conj(rev[i]);
+
+    return convolve(a, KVector<T>(rev), crossover);
+}
+
+#endif /* KMatrixFFT_hpp */
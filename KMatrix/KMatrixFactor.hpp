@@ -0,0 +1,2054 @@
+//
+//  KMatrixFactor.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixFactor_hpp
+#define KMatrixFactor_hpp
+
+#include <vector>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include "KMatrix.hpp"
+#include "KVector.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Factorizations of KMatrix objects. Each factor object is computed once and can then
+ solve any number of right-hand sides (as the columns of a KMatrix, or as a KVector).
+
+ KQR - blocked Householder QR for least-squares problems (m >= n)
+ KTSQR - tall-skinny QR: row blocks are factored in parallel and their R factors combined
+ KCholesky - blocked Cholesky (A = L*L^H) for symmetric/Hermitian positive definite systems
+ KLU - LU with partial pivoting (P*A = L*U) for general square systems
+ KInverse - an explicit inverse
+
+ KCholesky, KLU and KInverse can also follow changes to A without starting over: update()
+ adds u*v^H (u*u^H for KCholesky) of any rank k, downdate() subtracts it, and replaceRow() /
+ replaceCol() change one row or column. Each costs O(n^2*k) instead of the O(n^3) of a new
+ factorization. After every change the factor solves a fixed probe system and compares the
+ result against the updated A; if the relative residual has drifted above driftTolerance(),
+ it refactors A from scratch. For a Hermitian u*v^H, v is conjugated.
+ */
+
+//Panel width used by the blocked factorizations
+#define KMATRIX_FACTOR_BLOCK 64
+
+//Largest total rank of the updates KLU carries through the Woodbury identity before it
+//folds them into a new factorization
+#define KMATRIX_UPDATE_RANK 16
+
+/*
+ Householder QR factorization, A = Q*R. A is copied into column-major storage; R is kept in
+ the upper triangle and the Householder vectors below it. Panels of KMATRIX_FACTOR_BLOCK
+ columns are factored column by column, and each panel's reflectors are applied to the
+ remaining columns at once as a block reflector (I - V*T*V^H), split across the thread pool.
+ */
+template <class T>
+class KQR {
+public:
+
+    KQR();
+    KQR(const KMatrix<T>& a, size_t block = KMATRIX_FACTOR_BLOCK);
+
+    void factor(const KMatrix<T>& a, size_t block = KMATRIX_FACTOR_BLOCK);
+
+    KMatrix<T> solve(const KMatrix<T>& b) const;
+    KVector<T> solve(const KVector<T>& b) const;
+    KMatrix<T> applyQt(const KMatrix<T>& b) const;
+    KMatrix<T> getQ() const;
+    KMatrix<T> getR() const;
+
+    size_t rows() const;
+    size_t cols() const;
+
+private:
+
+    void applyQt(T* col) const;
+    void backSubstitute(T* col) const;
+
+    std::vector<T> f;
+    std::vector<T> tau;
+    size_t m;
+    size_t n;
+};
+
+/*
+ Tall-skinny QR. The rows of A are split into blocks (one per thread by default) that are
+ QR-factored in parallel, then the stacked R factors are factored again to give the final R.
+ Q is kept implicitly as the leaf and top factors. Use for least-squares problems with many
+ more rows than columns.
+ */
+template <class T>
+class KTSQR {
+public:
+
+    KTSQR();
+    KTSQR(const KMatrix<T>& a, size_t blocks = 0);
+
+    void factor(const KMatrix<T>& a, size_t blocks = 0);
+
+    KMatrix<T> solve(const KMatrix<T>& b) const;
+    KVector<T> solve(const KVector<T>& b) const;
+    KMatrix<T> getR() const;
+
+    size_t rows() const;
+    size_t cols() const;
+
+private:
+
+    std::vector<KQR<T> > leaves;
+    std::vector<size_t> offsets;
+    KQR<T> top;
+    size_t m;
+    size_t n;
+};
+
+/*
+ Cholesky factorization, A = L*L^H, of a symmetric (Hermitian) positive definite matrix. Only
+ the lower triangle of A is read. Right-looking blocked algorithm: each diagonal block is
+ factored, the panel below it solved, and the trailing matrix updated in parallel.
+
+ update() and downdate() rotate L to the factor of A + x*x^H or A - x*x^H, one column of x
+ at a time. A copy of A is kept for the drift check and for refactoring.
+ */
+template <class T>
+class KCholesky {
+public:
+
+    KCholesky();
+    KCholesky(const KMatrix<T>& a, size_t block = KMATRIX_FACTOR_BLOCK);
+
+    void factor(const KMatrix<T>& a, size_t block = KMATRIX_FACTOR_BLOCK);
+
+    void update(const KMatrix<T>& x);
+    void update(const KVector<T>& x);
+    void downdate(const KMatrix<T>& x);
+    void downdate(const KVector<T>& x);
+    void refactor();
+
+    KMatrix<T> solve(const KMatrix<T>& b) const;
+    KVector<T> solve(const KVector<T>& b) const;
+    KMatrix<T> getL() const;
+
+    size_t size() const;
+    size_t refactors() const;
+    double drift() const;
+    void setDriftTolerance(double tol);
+    double driftTolerance() const;
+
+private:
+
+    void decompose();
+    void rotate(const std::vector<T>& x, size_t k, bool add);
+    void substitute(T* x) const;
+    void check_drift();
+
+    std::vector<T> l;
+    std::vector<T> a;
+    size_t n;
+    size_t blk;
+    size_t nrefactor;
+    double last_drift;
+    double tol;
+};
+
+/*
+ LU factorization with partial pivoting, P*A = L*U, of a square matrix. The factorization
+ itself is kmatrix_lu(), the same one behind KMatrix::inverse() and determinant().
+
+ Updates are not folded into L and U. Instead the factor keeps U_k and V_k, the columns of
+ every update so far, with Z = A0^-1*U_k and the small k x k matrix C = I + V_k^H*Z, and
+ solves with the Woodbury identity:
+ (A0 + U_k*V_k^H)^-1 = A0^-1 - Z*C^-1*V_k^H*A0^-1.
+ Once k would pass KMATRIX_UPDATE_RANK, or the drift check fails, A is factored again. A
+ copy of A is kept for this.
+
+ A factor whose matrix has become singular throws matrix_factorization_exception from
+ solve() and inverse() until an update makes it invertible again.
+ */
+template <class T>
+class KLU {
+public:
+
+    KLU();
+    KLU(const KMatrix<T>& a);
+
+    void factor(const KMatrix<T>& a);
+
+    void update(const KMatrix<T>& u, const KMatrix<T>& v);
+    void update(const KVector<T>& u, const KVector<T>& v);
+    void downdate(const KMatrix<T>& u, const KMatrix<T>& v);
+    void downdate(const KVector<T>& u, const KVector<T>& v);
+    void replaceRow(size_t r, const KVector<T>& row);
+    void replaceCol(size_t c, const KVector<T>& col);
+    void refactor();
+
+    KMatrix<T> solve(const KMatrix<T>& b) const;
+    KVector<T> solve(const KVector<T>& b) const;
+    KMatrix<T> inverse() const;
+    T determinant() const;
+    KMatrix<T> getL() const;
+    KMatrix<T> getU() const;
+
+    size_t size() const;
+    bool singular() const;
+    size_t updateRank() const;
+    size_t refactors() const;
+    double drift() const;
+    void setDriftTolerance(double tol);
+    double driftTolerance() const;
+
+private:
+
+    void decompose();
+    void apply(std::vector<T> u, const std::vector<T>& v, size_t k);
+    void solve_in_place(T* b, size_t nrhs) const;
+    void check_drift();
+
+    std::vector<T> a;
+    std::vector<T> lu;
+    std::vector<size_t> piv;
+    std::vector<T> z;
+    std::vector<T> vc;
+    std::vector<T> cap;
+    std::vector<size_t> cpiv;
+    size_t n;
+    size_t rank;
+    bool is_singular;
+    size_t nrefactor;
+    double last_drift;
+    double tol;
+};
+
+/*
+ Explicit inverse of a square matrix that can be kept current as the matrix changes. Each
+ update is applied to the inverse with the Sherman-Morrison-Woodbury formula (see
+ woodburyUpdate()). A copy of A is kept for the drift check and for recomputing the inverse.
+ */
+template <class T>
+class KInverse {
+public:
+
+    KInverse();
+    KInverse(const KMatrix<T>& a);
+
+    void compute(const KMatrix<T>& a);
+
+    void update(const KMatrix<T>& u, const KMatrix<T>& v);
+    void update(const KVector<T>& u, const KVector<T>& v);
+    void downdate(const KMatrix<T>& u, const KMatrix<T>& v);
+    void downdate(const KVector<T>& u, const KVector<T>& v);
+    void replaceRow(size_t r, const KVector<T>& row);
+    void replaceCol(size_t c, const KVector<T>& col);
+    void refactor();
+
+    KMatrix<T> get() const;
+    KMatrix<T> solve(const KMatrix<T>& b) const;
+    KVector<T> solve(const KVector<T>& b) const;
+
+    size_t size() const;
+    size_t refactors() const;
+    double drift() const;
+    void setDriftTolerance(double tol);
+    double driftTolerance() const;
+
+private:
+
+    void invert();
+    void apply(const std::vector<T>& u, const std::vector<T>& v, size_t k);
+    void check_drift();
+
+    std::vector<T> a;
+    std::vector<T> inv;
+    size_t n;
+    size_t nrefactor;
+    double last_drift;
+    double tol;
+};
+
+template <class T>
+void shermanMorrisonUpdate(KMatrix<T>& ainv, const KVector<T>& u, const KVector<T>& v);
+
+template <class T>
+void woodburyUpdate(KMatrix<T>& ainv, const KMatrix<T>& u, const KMatrix<T>& v);
+
+/*----------------------------------------------------------------
+---------------------------- HELPERS -----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Approximate operation counts of columns [j0, j1) of a QR factorization of an m x n matrix,
+ and of a Cholesky factorization of an n x n matrix. These are the amounts the factorizations
+ pass to kmatrix_checkpoint(), so the full range gives a task's total work.
+ */
+inline double kmatrix_qr_work(size_t m, size_t n, size_t j0, size_t j1){
+    double w = 0;
+    for (size_t j = j0 ; j < j1 ; j++) w += 4.0*(m - j)*(n - j);
+    return w;
+}
+
+inline double kmatrix_cholesky_work(size_t n, size_t j0, size_t j1){
+    double w = 0;
+    for (size_t j = j0 ; j < j1 ; j++) w += (double)(n - j)*(n - j);
+    return w;
+}
+
+/*
+ Default drift tolerance of the updatable factorizations: the square root of the precision,
+ far above the residual of a fresh factorization (about n*epsilon) but well before an update
+ has lost half the digits.
+ */
+template <class T>
+double kmatrix_drift_tolerance(){
+    return std::sqrt((double)std::numeric_limits<typename kmatrix_real<T>::type>::epsilon());
+}
+
+/*
+ Right-hand side of the drift checks: a fixed vector of length 'n' with entries in [-1, 1].
+ */
+template <class T>
+std::vector<T> kmatrix_probe(size_t n){
+    std::vector<T> p(n);
+    for (size_t i = 0 ; i < n ; i++){
+        p[i] = T(((double)((i*7919 + 17) % 101) - 50.5)/50.5);
+    }
+    return p;
+}
+
+/*
+ Relative residual of a solution of A*x = b, ||A*x - b|| / (||A||*||x|| + ||b||) in the
+ infinity norm. Small (about n*epsilon) for any backward-stable solve, however badly
+ conditioned A is.
+
+ a - n x n row-major matrix
+ x - solution
+ b - right-hand side
+
+ Returns the relative residual
+ */
+template <class T>
+double kmatrix_residual(const std::vector<T>& a, size_t n, const T* x, const T* b){
+
+    double rnorm = 0, anorm = 0, xnorm = 0, bnorm = 0;
+    for (size_t i = 0 ; i < n ; i++){
+        const T* ai = &a[i*n];
+        T s = T(0);
+        double row = 0;
+        for (size_t j = 0 ; j < n ; j++){
+            s += ai[j]*x[j];
+            row += std::abs(ai[j]);
+        }
+        rnorm = std::max(rnorm, (double)std::abs(s - b[i]));
+        anorm = std::max(anorm, row);
+        xnorm = std::max(xnorm, (double)std::abs(x[i]));
+        bnorm = std::max(bnorm, (double)std::abs(b[i]));
+    }
+
+    double d = anorm*xnorm + bnorm;
+    return (d > 0) ? rnorm/d : 0;
+}
+
+/*
+ Adds u*v^H to the n x n row-major matrix 'a'.
+
+ u, v - n x k row-major
+
+ Void return
+ */
+template <class T>
+void kmatrix_add_outer(std::vector<T>& a, size_t n, const std::vector<T>& u, const std::vector<T>& v, size_t k){
+    for (size_t i = 0 ; i < n ; i++){
+        T* ai = &a[i*n];
+        for (size_t c = 0 ; c < k ; c++){
+            const T uic = u[i*k + c];
+            for (size_t j = 0 ; j < n ; j++) ai[j] += uic*kmatrix_conj(v[j*k + c]);
+        }
+    }
+}
+
+/*
+ Applies A + U*V^H to an explicit inverse with the Woodbury identity,
+ (A + U*V^H)^-1 = A^-1 - A^-1*U * (I + V^H*A^-1*U)^-1 * V^H*A^-1.
+ With k = 1 this is the Sherman-Morrison formula. Costs O(n^2*k).
+
+ inv - n x n row-major inverse of A. Updated in place.
+ u, v - n x k row-major
+
+ Returns false, leaving 'inv' unchanged, if the updated matrix is singular
+ */
+template <class T>
+bool kmatrix_woodbury(std::vector<T>& inv, size_t n, const std::vector<T>& u, const std::vector<T>& v, size_t k){
+
+    //Z = A^-1*U (n x k) and W = V^H*A^-1 (k x n)
+    std::vector<T> zm(n*k, T(0));
+    std::vector<T> wm(k*n, T(0));
+    for (size_t i = 0 ; i < n ; i++){
+        const T* invi = &inv[i*n];
+        for (size_t j = 0 ; j < n ; j++){
+            for (size_t c = 0 ; c < k ; c++){
+                zm[i*k + c] += invi[j]*u[j*k + c];
+                wm[c*n + j] += kmatrix_conj(v[i*k + c])*invi[j];
+            }
+        }
+    }
+
+    //C = I + V^H*Z
+    std::vector<T> cm(k*k, T(0));
+    for (size_t r = 0 ; r < k ; r++){
+        cm[r*k + r] = T(1);
+        for (size_t i = 0 ; i < n ; i++){
+            const T vir = kmatrix_conj(v[i*k + r]);
+            for (size_t c = 0 ; c < k ; c++) cm[r*k + c] += vir*zm[i*k + c];
+        }
+    }
+
+    std::vector<size_t> cp(k);
+    if (kmatrix_lu(cm.data(), k, cp.data(), kmatrix_lu_tolerance(cm.data(), k)) < k){
+        return false;
+    }
+
+    //A^-1 -= Z * (C^-1*W)
+    kmatrix_lu_solve(cm.data(), cp.data(), k, wm.data(), n, n);
+    for (size_t i = 0 ; i < n ; i++){
+        T* invi = &inv[i*n];
+        for (size_t c = 0 ; c < k ; c++){
+            const T zic = zm[i*k + c];
+            const T* wc = &wm[c*n];
+            for (size_t j = 0 ; j < n ; j++) invi[j] -= zic*wc[j];
+        }
+    }
+
+    return true;
+}
+
+/*
+ Columns of an update: 'u' and 'v' as n x k row-major arrays, checking that both have 'n'
+ rows and the same number of columns (throws matrix_multiplication_exception otherwise).
+
+ Returns k
+ */
+template <class T>
+size_t kmatrix_update_cols(const KMatrix<T>& u, const KMatrix<T>& v, size_t n, std::vector<T>& ud, std::vector<T>& vd){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (u.rows() != n || v.rows() != n || u.cols() != v.cols()){
+        throw mat_mult_ex;
+    }
+
+    ud = kmatrix_dense<T>(u);
+    vd = kmatrix_dense<T>(v);
+    return u.cols();
+}
+
+/*
+ Copies column 'c' of 'km' into 'out'.
+ */
+template <class T>
+void kmatrix_get_col(const KMatrix<T>& km, size_t c, T* out){
+    for (size_t r = 0 ; r < km.rows() ; r++){
+        out[r] = km.get(r, c);
+    }
+}
+
+/*
+ Converts a KVector into a single-column KMatrix.
+ */
+template <class T>
+KMatrix<T> kmatrix_column(const KVector<T>& v){
+    KMatrix<T> out((int)v.size(), 1);
+    for (size_t i = 0 ; i < v.size() ; i++){
+        out(i, 0) = v.get(i);
+    }
+    return out;
+}
+
+/*
+ Generates a Householder reflector H = I - tau*v*v^H such that H^H*x = beta*e1. On return
+ x[0] holds beta and x[1..len) holds v[1..len) (v[0] is implicitly 1).
+
+ Returns tau
+ */
+template <class T>
+T kmatrix_householder(size_t len, T* x){
+
+    if (len < 1) return T(0);
+
+    T alpha = x[0];
+    double xnorm = 0;
+    for (size_t i = 1 ; i < len ; i++){
+        xnorm += std::norm(x[i]);
+    }
+
+    if (xnorm == 0 && std::imag(alpha) == 0){
+        return T(0);
+    }
+
+    double beta = std::sqrt(std::norm(alpha) + xnorm);
+    if (std::real(alpha) >= 0) beta = -beta;
+
+    T tau = (T(beta) - alpha)/T(beta);
+    T scale = T(1)/(alpha - T(beta));
+    for (size_t i = 1 ; i < len ; i++){
+        x[i] *= scale;
+    }
+    x[0] = T(beta);
+
+    return tau;
+}
+
+/*----------------------------------------------------------------
+------------------------------ KQR -------------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KQR<T>::KQR() : m(0), n(0){
+
+}
+
+/*
+ Factors 'a'. See factor().
+ */
+template <class T>
+KQR<T>::KQR(const KMatrix<T>& a, size_t block) : m(0), n(0){
+    factor(a, block);
+}
+
+/*
+ Computes the QR factorization of 'a'.
+
+ a - matrix to factor (m x n)
+ block - panel width
+
+ Void return
+ */
+template <class T>
+void KQR<T>::factor(const KMatrix<T>& a, size_t block){
+
+    m = a.rows();
+    n = a.cols();
+    if (block < 1) block = 1;
+
+    //Copy to column-major storage
+    f.resize(m*n);
+    for (size_t c = 0 ; c < n ; c++){
+        kmatrix_get_col(a, c, &f[c*m]);
+    }
+
+    size_t kmax = (m < n) ? m : n;
+    tau.assign(kmax, T(0));
+
+    for (size_t j0 = 0 ; j0 < kmax ; j0 += block){
+
+        size_t j1 = (j0 + block < kmax) ? j0 + block : kmax;
+        size_t nb = j1 - j0;
+
+        //Factor the panel one column at a time, applying each reflector within the panel
+        for (size_t j = j0 ; j < j1 ; j++){
+            T* v = &f[j*m + j];
+            tau[j] = kmatrix_householder(m - j, v);
+            T beta = v[0];
+            v[0] = T(1);
+            for (size_t c = j+1 ; c < j1 ; c++){
+                T* col = &f[c*m + j];
+                T w = T(0);
+                for (size_t i = 0 ; i < m - j ; i++) w += kmatrix_conj(v[i])*col[i];
+                w *= kmatrix_conj(tau[j]);
+                for (size_t i = 0 ; i < m - j ; i++) col[i] -= v[i]*w;
+            }
+            v[0] = beta;
+        }
+
+        if (j1 >= n){
+            kmatrix_checkpoint(kmatrix_qr_work(m, n, j0, j1));
+            continue;
+        }
+
+        //Build triangular factor T of the block reflector H = I - V*T*V^H
+        std::vector<T> tri(nb*nb, T(0));
+        for (size_t i = 0 ; i < nb ; i++){
+            size_t ci = j0 + i;
+            std::vector<T> temp(i, T(0));
+            for (size_t p = 0 ; p < i ; p++){
+                size_t cp = j0 + p;
+                T s = kmatrix_conj(f[cp*m + ci]); //v_i is 1 at row ci
+                for (size_t r = ci+1 ; r < m ; r++) s += kmatrix_conj(f[cp*m + r])*f[ci*m + r];
+                temp[p] = -tau[ci]*s;
+            }
+            for (size_t p = 0 ; p < i ; p++){
+                T s = T(0);
+                for (size_t q = p ; q < i ; q++) s += tri[p*nb + q]*temp[q];
+                tri[p*nb + i] = s;
+            }
+            tri[i*nb + i] = tau[ci];
+        }
+
+        //Apply H^H = I - V*T^H*V^H to the trailing columns
+        KThreadPool::global().parallel_for(j1, n, [&](size_t lo, size_t hi){
+            std::vector<T> w(nb);
+            std::vector<T> tw(nb);
+            for (size_t c = lo ; c < hi ; c++){
+                T* col = &f[c*m];
+
+                //w = V^H * col
+                for (size_t p = 0 ; p < nb ; p++){
+                    size_t cp = j0 + p;
+                    T s = col[cp];
+                    for (size_t r = cp+1 ; r < m ; r++) s += kmatrix_conj(f[cp*m + r])*col[r];
+                    w[p] = s;
+                }
+
+                //tw = T^H * w
+                for (size_t p = 0 ; p < nb ; p++){
+                    T s = T(0);
+                    for (size_t q = 0 ; q <= p ; q++) s += kmatrix_conj(tri[q*nb + p])*w[q];
+                    tw[p] = s;
+                }
+
+                //col -= V * tw
+                for (size_t p = 0 ; p < nb ; p++){
+                    size_t cp = j0 + p;
+                    col[cp] -= tw[p];
+                    for (size_t r = cp+1 ; r < m ; r++) col[r] -= f[cp*m + r]*tw[p];
+                }
+            }
+        }, 8);
+
+        kmatrix_checkpoint(kmatrix_qr_work(m, n, j0, j1));
+    }
+}
+
+/*
+ Overwrites the length-m column 'col' with Q^H*col.
+ */
+template <class T>
+void KQR<T>::applyQt(T* col) const{
+
+    for (size_t j = 0 ; j < tau.size() ; j++){
+        T w = col[j];
+        for (size_t r = j+1 ; r < m ; r++) w += kmatrix_conj(f[j*m + r])*col[r];
+        w *= kmatrix_conj(tau[j]);
+        col[j] -= w;
+        for (size_t r = j+1 ; r < m ; r++) col[r] -= f[j*m + r]*w;
+    }
+}
+
+/*
+ Solves R*x = col for the first n entries of 'col', in place.
+ */
+template <class T>
+void KQR<T>::backSubstitute(T* col) const{
+
+    matrix_factorization_exception mat_fact_ex;
+
+    for (size_t i = n ; i-- > 0 ; ){
+        T s = col[i];
+        for (size_t c = i+1 ; c < n ; c++) s -= f[c*m + i]*col[c];
+        if (f[i*m + i] == T(0)){
+            throw mat_fact_ex;
+        }
+        col[i] = s/f[i*m + i];
+    }
+}
+
+/*
+ Computes Q^H*b.
+
+ b - matrix with the same number of rows as the factored matrix
+
+ Returns Q^H*b (m x b.cols())
+ */
+template <class T>
+KMatrix<T> KQR<T>::applyQt(const KMatrix<T>& b) const{
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (b.rows() != m){
+        throw mat_mult_ex;
+    }
+
+    KMatrix<T> out((int)m, (int)b.cols());
+    KThreadPool::global().parallel_for(0, b.cols(), [&](size_t lo, size_t hi){
+        std::vector<T> col(m);
+        for (size_t c = lo ; c < hi ; c++){
+            kmatrix_get_col(b, c, col.data());
+            applyQt(col.data());
+            for (size_t r = 0 ; r < m ; r++) out(r, c) = col[r];
+        }
+    });
+
+    return out;
+}
+
+/*
+ Solves the least-squares problem min ||A*x - b|| for each column of 'b'. Requires m >= n and
+ A of full column rank (throws matrix_factorization_exception otherwise).
+
+ b - right-hand sides (m x k)
+
+ Returns x (n x k)
+ */
+template <class T>
+KMatrix<T> KQR<T>::solve(const KMatrix<T>& b) const{
+
+    matrix_multiplication_exception mat_mult_ex;
+    matrix_factorization_exception mat_fact_ex;
+    if (b.rows() != m){
+        throw mat_mult_ex;
+    }
+    if (m < n){
+        throw mat_fact_ex;
+    }
+
+    KMatrix<T> out((int)n, (int)b.cols());
+    KThreadPool::global().parallel_for(0, b.cols(), [&](size_t lo, size_t hi){
+        std::vector<T> col(m);
+        for (size_t c = lo ; c < hi ; c++){
+            kmatrix_get_col(b, c, col.data());
+            applyQt(col.data());
+            backSubstitute(col.data());
+            for (size_t r = 0 ; r < n ; r++) out(r, c) = col[r];
+        }
+    });
+
+    return out;
+}
+
+/*
+ Solves the least-squares problem min ||A*x - b|| for a single right-hand side.
+
+ Returns x
+ */
+template <class T>
+KVector<T> KQR<T>::solve(const KVector<T>& b) const{
+    KMatrix<T> x = solve(kmatrix_column(b));
+    std::vector<T> out(x.rows());
+    for (size_t i = 0 ; i < x.rows() ; i++) out[i] = x.get(i, 0);
+    return KVector<T>(out);
+}
+
+/*
+ Forms the thin Q factor (m x min(m, n)) explicitly.
+
+ Returns Q
+ */
+template <class T>
+KMatrix<T> KQR<T>::getQ() const{
+
+    size_t k = tau.size();
+    KMatrix<T> out((int)m, (int)k);
+
+    KThreadPool::global().parallel_for(0, k, [&](size_t lo, size_t hi){
+        std::vector<T> col(m);
+        for (size_t c = lo ; c < hi ; c++){
+
+            //Q*e_c = H_0*H_1*...*H_(k-1)*e_c
+            std::fill(col.begin(), col.end(), T(0));
+            col[c] = T(1);
+            for (size_t j = k ; j-- > 0 ; ){
+                T w = col[j];
+                for (size_t r = j+1 ; r < m ; r++) w += kmatrix_conj(f[j*m + r])*col[r];
+                w *= tau[j];
+                col[j] -= w;
+                for (size_t r = j+1 ; r < m ; r++) col[r] -= f[j*m + r]*w;
+            }
+
+            for (size_t r = 0 ; r < m ; r++) out(r, c) = col[r];
+        }
+    });
+
+    return out;
+}
+
+/*
+ Returns the R factor (min(m, n) x n, upper triangular)
+ */
+template <class T>
+KMatrix<T> KQR<T>::getR() const{
+
+    size_t k = tau.size();
+    KMatrix<T> out((int)k, (int)n);
+    for (size_t r = 0 ; r < k ; r++){
+        for (size_t c = r ; c < n ; c++){
+            out(r, c) = f[c*m + r];
+        }
+    }
+
+    return out;
+}
+
+template <class T>
+size_t KQR<T>::rows() const{
+    return m;
+}
+
+template <class T>
+size_t KQR<T>::cols() const{
+    return n;
+}
+
+/*----------------------------------------------------------------
+----------------------------- KTSQR ------------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KTSQR<T>::KTSQR() : m(0), n(0){
+
+}
+
+/*
+ Factors 'a'. See factor().
+ */
+template <class T>
+KTSQR<T>::KTSQR(const KMatrix<T>& a, size_t blocks) : m(0), n(0){
+    factor(a, blocks);
+}
+
+/*
+ Computes the tall-skinny QR factorization of 'a'.
+
+ a - matrix to factor (m x n, m >= n)
+ blocks - number of row blocks. If 0, uses one per thread. Reduced so every block has at
+          least n rows.
+
+ Void return
+ */
+template <class T>
+void KTSQR<T>::factor(const KMatrix<T>& a, size_t blocks){
+
+    m = a.rows();
+    n = a.cols();
+
+    if (blocks == 0) blocks = KThreadPool::global().threads();
+    if (n > 0 && blocks > m/n) blocks = m/n;
+    if (blocks < 1) blocks = 1;
+
+    offsets.resize(blocks+1);
+    for (size_t i = 0 ; i <= blocks ; i++){
+        offsets[i] = KThreadPool::partition(i, blocks, 0, m, 1);
+    }
+
+    //Factor each row block
+    leaves.assign(blocks, KQR<T>());
+    KThreadPool::global().parallel_for(0, blocks, [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++){
+            KMatrix<T> part((int)(offsets[i+1] - offsets[i]), (int)n);
+            for (size_t r = offsets[i] ; r < offsets[i+1] ; r++){
+                for (size_t c = 0 ; c < n ; c++){
+                    part(r - offsets[i], c) = a.get(r, c);
+                }
+            }
+            leaves[i].factor(part);
+        }
+    });
+
+    //Stack the R factors and factor again
+    KMatrix<T> stacked((int)(blocks*n), (int)n);
+    for (size_t i = 0 ; i < blocks ; i++){
+        KMatrix<T> r = leaves[i].getR();
+        for (size_t rr = 0 ; rr < r.rows() ; rr++){
+            for (size_t c = 0 ; c < n ; c++){
+                stacked(i*n + rr, c) = r.get(rr, c);
+            }
+        }
+    }
+    top.factor(stacked);
+}
+
+/*
+ Solves the least-squares problem min ||A*x - b|| for each column of 'b'.
+
+ b - right-hand sides (m x k)
+
+ Returns x (n x k)
+ */
+template <class T>
+KMatrix<T> KTSQR<T>::solve(const KMatrix<T>& b) const{
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (b.rows() != m){
+        throw mat_mult_ex;
+    }
+
+    //Apply each leaf's Q^H to its rows of b and keep the first n rows
+    size_t blocks = leaves.size();
+    KMatrix<T> stacked((int)(blocks*n), (int)b.cols());
+    KThreadPool::global().parallel_for(0, blocks, [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++){
+            KMatrix<T> part((int)(offsets[i+1] - offsets[i]), (int)b.cols());
+            for (size_t r = offsets[i] ; r < offsets[i+1] ; r++){
+                for (size_t c = 0 ; c < b.cols() ; c++){
+                    part(r - offsets[i], c) = b.get(r, c);
+                }
+            }
+            KMatrix<T> qtb = leaves[i].applyQt(part);
+            for (size_t r = 0 ; r < n && r < qtb.rows() ; r++){
+                for (size_t c = 0 ; c < b.cols() ; c++){
+                    stacked(i*n + r, c) = qtb.get(r, c);
+                }
+            }
+        }
+    });
+
+    return top.solve(stacked);
+}
+
+/*
+ Solves the least-squares problem min ||A*x - b|| for a single right-hand side.
+
+ Returns x
+ */
+template <class T>
+KVector<T> KTSQR<T>::solve(const KVector<T>& b) const{
+    KMatrix<T> x = solve(kmatrix_column(b));
+    std::vector<T> out(x.rows());
+    for (size_t i = 0 ; i < x.rows() ; i++) out[i] = x.get(i, 0);
+    return KVector<T>(out);
+}
+
+/*
+ Returns the R factor (n x n, upper triangular)
+ */
+template <class T>
+KMatrix<T> KTSQR<T>::getR() const{
+    return top.getR();
+}
+
+template <class T>
+size_t KTSQR<T>::rows() const{
+    return m;
+}
+
+template <class T>
+size_t KTSQR<T>::cols() const{
+    return n;
+}
+
+/*----------------------------------------------------------------
+--------------------------- KCholesky ----------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KCholesky<T>::KCholesky() : n(0), blk(KMATRIX_FACTOR_BLOCK), nrefactor(0), last_drift(0), tol(kmatrix_drift_tolerance<T>()){
+
+}
+
+/*
+ Factors 'a'. See factor().
+ */
+template <class T>
+KCholesky<T>::KCholesky(const KMatrix<T>& a, size_t block) : n(0), blk(KMATRIX_FACTOR_BLOCK), nrefactor(0), last_drift(0), tol(kmatrix_drift_tolerance<T>()){
+    factor(a, block);
+}
+
+/*
+ Computes the Cholesky factorization of 'a'. Throws matrix_factorization_exception if 'a' is
+ not positive definite, and matrix_multiplication_exception if it is not square.
+
+ a - symmetric (Hermitian) positive definite matrix. Only the lower triangle is read.
+ block - panel width
+
+ Void return
+ */
+template <class T>
+void KCholesky<T>::factor(const KMatrix<T>& a, size_t block){
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    //Keep A (made Hermitian from its lower triangle) for updates
+    n = a.rows();
+    blk = (block < 1) ? 1 : block;
+    nrefactor = 0;
+    this->a.assign(n*n, T(0));
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c <= r ; c++){
+            this->a[r*n + c] = a.get(r, c);
+            this->a[c*n + r] = kmatrix_conj(a.get(r, c));
+        }
+    }
+    last_drift = 0;
+
+    decompose();
+}
+
+/*
+ Factors the stored A again, discarding the effect of earlier updates on L. Throws
+ matrix_factorization_exception if A is no longer positive definite.
+
+ Void return
+ */
+template <class T>
+void KCholesky<T>::refactor(){
+    nrefactor++;
+    decompose();
+}
+
+/*
+ Computes L from the stored A (lower triangle).
+ */
+template <class T>
+void KCholesky<T>::decompose(){
+
+    matrix_factorization_exception mat_fact_ex;
+    size_t block = blk;
+
+    //Copy lower triangle to row-major storage
+    l.assign(n*n, T(0));
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c <= r ; c++){
+            l[r*n + c] = a[r*n + c];
+        }
+    }
+
+    for (size_t k0 = 0 ; k0 < n ; k0 += block){
+
+        size_t k1 = (k0 + block < n) ? k0 + block : n;
+
+        //Factor diagonal block
+        for (size_t j = k0 ; j < k1 ; j++){
+            double d = std::real(l[j*n + j]);
+            for (size_t p = k0 ; p < j ; p++) d -= std::norm(l[j*n + p]);
+            if (!(d > 0)){
+                throw mat_fact_ex;
+            }
+            d = std::sqrt(d);
+            l[j*n + j] = T(d);
+            for (size_t i = j+1 ; i < k1 ; i++){
+                T s = l[i*n + j];
+                for (size_t p = k0 ; p < j ; p++) s -= l[i*n + p]*kmatrix_conj(l[j*n + p]);
+                l[i*n + j] = s/T(d);
+            }
+        }
+
+        if (k1 >= n){
+            kmatrix_checkpoint(kmatrix_cholesky_work(n, k0, k1));
+            break;
+        }
+
+        //Solve panel below the diagonal block: L21 = A21 * L11^-H
+        KThreadPool::global().parallel_for(k1, n, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                for (size_t j = k0 ; j < k1 ; j++){
+                    T s = l[i*n + j];
+                    for (size_t p = k0 ; p < j ; p++) s -= l[i*n + p]*kmatrix_conj(l[j*n + p]);
+                    l[i*n + j] = s/l[j*n + j];
+                }
+            }
+        }, 16);
+
+        //Update trailing matrix: A22 -= L21 * L21^H (lower triangle only)
+        KThreadPool::global().parallel_for(k1, n, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                const T* li = &l[i*n + k0];
+                for (size_t j = k1 ; j <= i ; j++){
+                    const T* lj = &l[j*n + k0];
+                    T s = T(0);
+                    for (size_t p = 0 ; p < k1 - k0 ; p++) s += li[p]*kmatrix_conj(lj[p]);
+                    l[i*n + j] -= s;
+                }
+            }
+        }, 16);
+
+        kmatrix_checkpoint(kmatrix_cholesky_work(n, k0, k1));
+    }
+}
+
+/*
+ Solves A*x = b for each column of 'b' by forward and back substitution. The right-hand sides
+ are processed together a row at a time, and split across the thread pool when there are many.
+
+ b - right-hand sides (n x k)
+
+ Returns x (n x k)
+ */
+template <class T>
+KMatrix<T> KCholesky<T>::solve(const KMatrix<T>& b) const{
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (b.rows() != n){
+        throw mat_mult_ex;
+    }
+
+    size_t k = b.cols();
+    KMatrix<T> x(b);
+    x.setLayout(KMAT_ROW_MAJOR);
+    std::vector<typename KMatrix<T>::row_type>& xm = x.getMat();
+
+    KThreadPool::global().parallel_for(0, k, [&](size_t lo, size_t hi){
+
+        //Forward substitution: L*y = b
+        for (size_t i = 0 ; i < n ; i++){
+            T* xi = xm[i].data();
+            for (size_t p = 0 ; p < i ; p++){
+                const T lip = l[i*n + p];
+                const T* xp = xm[p].data();
+                for (size_t c = lo ; c < hi ; c++) xi[c] -= lip*xp[c];
+            }
+            const T inv = T(1)/l[i*n + i];
+            for (size_t c = lo ; c < hi ; c++) xi[c] *= inv;
+        }
+
+        //Back substitution: L^H*x = y
+        for (size_t i = n ; i-- > 0 ; ){
+            T* xi = xm[i].data();
+            for (size_t j = i+1 ; j < n ; j++){
+                const T lji = kmatrix_conj(l[j*n + i]);
+                const T* xj = xm[j].data();
+                for (size_t c = lo ; c < hi ; c++) xi[c] -= lji*xj[c];
+            }
+            const T inv = T(1)/l[i*n + i];
+            for (size_t c = lo ; c < hi ; c++) xi[c] *= inv;
+        }
+
+    }, 64);
+
+    return x;
+}
+
+/*
+ Solves A*x = b for a single right-hand side.
+
+ Returns x
+ */
+template <class T>
+KVector<T> KCholesky<T>::solve(const KVector<T>& b) const{
+    KMatrix<T> x = solve(kmatrix_column(b));
+    std::vector<T> out(x.rows());
+    for (size_t i = 0 ; i < x.rows() ; i++) out[i] = x.get(i, 0);
+    return KVector<T>(out);
+}
+
+/*
+ Returns the lower triangular factor L
+ */
+template <class T>
+KMatrix<T> KCholesky<T>::getL() const{
+
+    KMatrix<T> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c <= r ; c++){
+            out(r, c) = l[r*n + c];
+        }
+    }
+
+    return out;
+}
+
+/*
+ Returns the dimension of the factored matrix
+ */
+template <class T>
+size_t KCholesky<T>::size() const{
+    return n;
+}
+
+/*
+ Updates the factorization to that of A + x*x^H, in O(n^2) per column of 'x'.
+
+ x - n x k matrix. Each column is added as a rank-1 term.
+
+ Void return
+ */
+template <class T>
+void KCholesky<T>::update(const KMatrix<T>& x){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (x.rows() != n){
+        throw mat_mult_ex;
+    }
+
+    std::vector<T> xd = kmatrix_dense<T>(x);
+    rotate(xd, x.cols(), true);
+}
+
+template <class T>
+void KCholesky<T>::update(const KVector<T>& x){
+    update(kmatrix_column(x));
+}
+
+/*
+ Updates the factorization to that of A - x*x^H, in O(n^2) per column of 'x'. Throws
+ matrix_factorization_exception, leaving the factorization unchanged, if the result is not
+ positive definite.
+
+ x - n x k matrix. Each column is subtracted as a rank-1 term.
+
+ Void return
+ */
+template <class T>
+void KCholesky<T>::downdate(const KMatrix<T>& x){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (x.rows() != n){
+        throw mat_mult_ex;
+    }
+
+    std::vector<T> xd = kmatrix_dense<T>(x);
+    rotate(xd, x.cols(), false);
+}
+
+template <class T>
+void KCholesky<T>::downdate(const KVector<T>& x){
+    downdate(kmatrix_column(x));
+}
+
+/*
+ Rotates L into the factor of A + x*x^H ('add') or A - x*x^H for each column of 'x'. Column
+ j of L and the remaining part of x are combined by a plane rotation (a hyperbolic one for a
+ downdate) chosen to zero x[j]. A and L are restored if a downdate fails.
+
+ x - n x k row-major
+
+ Void return
+ */
+template <class T>
+void KCholesky<T>::rotate(const std::vector<T>& x, size_t k, bool add){
+
+    matrix_factorization_exception mat_fact_ex;
+
+    std::vector<T> l0(l);
+
+    std::vector<T> w(n);
+    for (size_t c = 0 ; c < k ; c++){
+
+        for (size_t i = 0 ; i < n ; i++) w[i] = x[i*k + c];
+
+        for (size_t j = 0 ; j < n ; j++){
+            double ljj = std::real(l[j*n + j]);
+            double r2 = add ? ljj*ljj + std::norm(w[j]) : ljj*ljj - std::norm(w[j]);
+            if (!(r2 > 0)){
+                l.swap(l0);
+                throw mat_fact_ex;
+            }
+            double r = std::sqrt(r2);
+            const T cinv = T(ljj/r);
+            const T s = w[j]/T(ljj);
+            const T sc = kmatrix_conj(s);
+            l[j*n + j] = T(r);
+            for (size_t i = j+1 ; i < n ; i++){
+                const T lij = l[i*n + j];
+                l[i*n + j] = add ? (lij + sc*w[i])*cinv : (lij - sc*w[i])*cinv;
+                w[i] = (w[i] - s*lij)*cinv;
+            }
+        }
+    }
+
+    //Apply the same change to A
+    std::vector<T> xs(x);
+    if (!add){
+        for (size_t i = 0 ; i < xs.size() ; i++) xs[i] = -xs[i];
+    }
+    kmatrix_add_outer(a, n, xs, x, k);
+
+    check_drift();
+}
+
+/*
+ Solves A*x = b for one right-hand side in place, with L from the last factorization or
+ update.
+ */
+template <class T>
+void KCholesky<T>::substitute(T* x) const{
+
+    for (size_t i = 0 ; i < n ; i++){
+        T s = x[i];
+        for (size_t p = 0 ; p < i ; p++) s -= l[i*n + p]*x[p];
+        x[i] = s/l[i*n + i];
+    }
+    for (size_t i = n ; i-- > 0 ; ){
+        T s = x[i];
+        for (size_t j = i+1 ; j < n ; j++) s -= kmatrix_conj(l[j*n + i])*x[j];
+        x[i] = s/l[i*n + i];
+    }
+}
+
+/*
+ Solves the probe system and refactors if its residual exceeds the drift tolerance.
+ */
+template <class T>
+void KCholesky<T>::check_drift(){
+
+    std::vector<T> b = kmatrix_probe<T>(n);
+    std::vector<T> x(b);
+    substitute(x.data());
+    last_drift = kmatrix_residual(a, n, x.data(), b.data());
+
+    if (last_drift > tol){
+        refactor();
+        x = b;
+        substitute(x.data());
+        last_drift = kmatrix_residual(a, n, x.data(), b.data());
+    }
+}
+
+/*
+ Returns the number of times updates have been folded into a new factorization
+ */
+template <class T>
+size_t KCholesky<T>::refactors() const{
+    return nrefactor;
+}
+
+/*
+ Returns the relative residual measured by the last drift check (0 before any update)
+ */
+template <class T>
+double KCholesky<T>::drift() const{
+    return last_drift;
+}
+
+/*
+ Sets the relative residual above which an update refactors. The default is
+ kmatrix_drift_tolerance<T>().
+
+ Void return
+ */
+template <class T>
+void KCholesky<T>::setDriftTolerance(double tol){
+    this->tol = tol;
+}
+
+template <class T>
+double KCholesky<T>::driftTolerance() const{
+    return tol;
+}
+
+/*----------------------------------------------------------------
+------------------------------ KLU -------------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KLU<T>::KLU() : n(0), rank(0), is_singular(false), nrefactor(0), last_drift(0), tol(kmatrix_drift_tolerance<T>()){
+
+}
+
+/*
+ Factors 'a'. See factor().
+ */
+template <class T>
+KLU<T>::KLU(const KMatrix<T>& a) : n(0), rank(0), is_singular(false), nrefactor(0), last_drift(0), tol(kmatrix_drift_tolerance<T>()){
+    factor(a);
+}
+
+/*
+ Computes the LU factorization of 'a'. Throws matrix_multiplication_exception if 'a' is not
+ square and matrix_factorization_exception if it is singular.
+
+ a - square matrix
+
+ Void return
+ */
+template <class T>
+void KLU<T>::factor(const KMatrix<T>& a){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    n = a.rows();
+    this->a = kmatrix_dense<T>(a);
+    nrefactor = 0;
+    last_drift = 0;
+
+    decompose();
+}
+
+/*
+ Factors the stored A again, folding in every update so far. Throws
+ matrix_factorization_exception (and marks the factor singular) if A is singular.
+
+ Void return
+ */
+template <class T>
+void KLU<T>::refactor(){
+    nrefactor++;
+    decompose();
+}
+
+/*
+ Computes L and U from the stored A and drops the Woodbury terms.
+ */
+template <class T>
+void KLU<T>::decompose(){
+
+    matrix_factorization_exception mat_fact_ex;
+
+    rank = 0;
+    z.clear();
+    vc.clear();
+    cap.clear();
+    cpiv.clear();
+
+    lu = a;
+    piv.assign(n, 0);
+    is_singular = (kmatrix_lu(lu.data(), n, piv.data(), kmatrix_lu_tolerance(a.data(), n)) < n);
+    if (is_singular){
+        throw mat_fact_ex;
+    }
+}
+
+/*
+ Updates the factorization to that of A + u*v^H.
+
+ u, v - n x k matrices
+
+ Void return
+ */
+template <class T>
+void KLU<T>::update(const KMatrix<T>& u, const KMatrix<T>& v){
+    std::vector<T> ud, vd;
+    size_t k = kmatrix_update_cols(u, v, n, ud, vd);
+    apply(ud, vd, k);
+}
+
+template <class T>
+void KLU<T>::update(const KVector<T>& u, const KVector<T>& v){
+    update(kmatrix_column(u), kmatrix_column(v));
+}
+
+/*
+ Updates the factorization to that of A - u*v^H.
+
+ u, v - n x k matrices
+
+ Void return
+ */
+template <class T>
+void KLU<T>::downdate(const KMatrix<T>& u, const KMatrix<T>& v){
+    std::vector<T> ud, vd;
+    size_t k = kmatrix_update_cols(u, v, n, ud, vd);
+    for (size_t i = 0 ; i < ud.size() ; i++) ud[i] = -ud[i];
+    apply(ud, vd, k);
+}
+
+template <class T>
+void KLU<T>::downdate(const KVector<T>& u, const KVector<T>& v){
+    downdate(kmatrix_column(u), kmatrix_column(v));
+}
+
+/*
+ Replaces row 'r' of A with 'row' (a rank-1 update).
+
+ Void return
+ */
+template <class T>
+void KLU<T>::replaceRow(size_t r, const KVector<T>& row){
+
+    matrix_bounds_excep mat_bnd_ex;
+    if (r >= n || row.size() != n){
+        throw mat_bnd_ex;
+    }
+
+    std::vector<T> u(n, T(0)), v(n);
+    u[r] = T(1);
+    for (size_t j = 0 ; j < n ; j++) v[j] = kmatrix_conj(row.get(j) - a[r*n + j]);
+    apply(u, v, 1);
+}
+
+/*
+ Replaces column 'c' of A with 'col' (a rank-1 update).
+
+ Void return
+ */
+template <class T>
+void KLU<T>::replaceCol(size_t c, const KVector<T>& col){
+
+    matrix_bounds_excep mat_bnd_ex;
+    if (c >= n || col.size() != n){
+        throw mat_bnd_ex;
+    }
+
+    std::vector<T> u(n), v(n, T(0));
+    v[c] = T(1);
+    for (size_t i = 0 ; i < n ; i++) u[i] = col.get(i) - a[i*n + c];
+    apply(u, v, 1);
+}
+
+/*
+ Adds u*v^H to A and to the Woodbury terms, refactoring when the rank limit is reached, C
+ becomes singular or the drift check fails.
+
+ u, v - n x k row-major
+
+ Void return
+ */
+template <class T>
+void KLU<T>::apply(std::vector<T> u, const std::vector<T>& v, size_t k){
+
+    kmatrix_add_outer(a, n, u, v, k);
+
+    if (is_singular || rank + k > KMATRIX_UPDATE_RANK){
+        refactor();
+        check_drift();
+        return;
+    }
+
+    //Z gains A0^-1*u; both are stored a column at a time
+    kmatrix_lu_solve(lu.data(), piv.data(), n, u.data(), k, k);
+    for (size_t c = 0 ; c < k ; c++){
+        for (size_t i = 0 ; i < n ; i++){
+            z.push_back(u[i*k + c]);
+            vc.push_back(v[i*k + c]);
+        }
+    }
+    rank += k;
+
+    //C = I + V^H*Z
+    cap.assign(rank*rank, T(0));
+    for (size_t r = 0 ; r < rank ; r++){
+        const T* vr = &vc[r*n];
+        for (size_t c = 0 ; c < rank ; c++){
+            const T* zc = &z[c*n];
+            T s = (r == c) ? T(1) : T(0);
+            for (size_t i = 0 ; i < n ; i++) s += kmatrix_conj(vr[i])*zc[i];
+            cap[r*rank + c] = s;
+        }
+    }
+    cpiv.assign(rank, 0);
+    if (kmatrix_lu(cap.data(), rank, cpiv.data(), kmatrix_lu_tolerance(cap.data(), rank)) < rank){
+        refactor();
+    }
+
+    check_drift();
+}
+
+/*
+ Solves A*X = B in place for the n x nrhs row-major 'b', with the base factors and the
+ Woodbury terms.
+ */
+template <class T>
+void KLU<T>::solve_in_place(T* b, size_t nrhs) const{
+
+    kmatrix_lu_solve(lu.data(), piv.data(), n, b, nrhs, nrhs);
+    if (rank == 0) return;
+
+    //w = C^-1 * V^H*x0, then x = x0 - Z*w
+    std::vector<T> w(rank*nrhs, T(0));
+    for (size_t r = 0 ; r < rank ; r++){
+        const T* vr = &vc[r*n];
+        T* wr = &w[r*nrhs];
+        for (size_t i = 0 ; i < n ; i++){
+            const T vir = kmatrix_conj(vr[i]);
+            const T* bi = b + i*nrhs;
+            for (size_t c = 0 ; c < nrhs ; c++) wr[c] += vir*bi[c];
+        }
+    }
+    kmatrix_lu_solve(cap.data(), cpiv.data(), rank, w.data(), nrhs, nrhs);
+
+    for (size_t i = 0 ; i < n ; i++){
+        T* bi = b + i*nrhs;
+        for (size_t r = 0 ; r < rank ; r++){
+            const T zir = z[r*n + i];
+            const T* wr = &w[r*nrhs];
+            for (size_t c = 0 ; c < nrhs ; c++) bi[c] -= zir*wr[c];
+        }
+    }
+}
+
+/*
+ Solves the probe system and refactors if its residual exceeds the drift tolerance.
+ */
+template <class T>
+void KLU<T>::check_drift(){
+
+    std::vector<T> b = kmatrix_probe<T>(n);
+    std::vector<T> x(b);
+    solve_in_place(x.data(), 1);
+    last_drift = kmatrix_residual(a, n, x.data(), b.data());
+
+    if (last_drift > tol){
+        refactor();
+        x = b;
+        solve_in_place(x.data(), 1);
+        last_drift = kmatrix_residual(a, n, x.data(), b.data());
+    }
+}
+
+/*
+ Solves A*x = b for each column of 'b'. Throws matrix_factorization_exception if A is
+ singular.
+
+ b - right-hand sides (n x k)
+
+ Returns x (n x k)
+ */
+template <class T>
+KMatrix<T> KLU<T>::solve(const KMatrix<T>& b) const{
+
+    matrix_multiplication_exception mat_mult_ex;
+    matrix_factorization_exception mat_fact_ex;
+    if (b.rows() != n){
+        throw mat_mult_ex;
+    }
+    if (is_singular){
+        throw mat_fact_ex;
+    }
+
+    size_t k = b.cols();
+    std::vector<T> x = kmatrix_dense<T>(b);
+    solve_in_place(x.data(), k);
+
+    return KMatrix<T>(x.data(), (int)n, (int)k, KMAT_ROW_MAJOR);
+}
+
+/*
+ Solves A*x = b for a single right-hand side.
+
+ Returns x
+ */
+template <class T>
+KVector<T> KLU<T>::solve(const KVector<T>& b) const{
+    KMatrix<T> x = solve(kmatrix_column(b));
+    std::vector<T> out(x.rows());
+    for (size_t i = 0 ; i < x.rows() ; i++) out[i] = x.get(i, 0);
+    return KVector<T>(out);
+}
+
+/*
+ Returns A^-1, solving for the columns of the identity
+ */
+template <class T>
+KMatrix<T> KLU<T>::inverse() const{
+    return solve(KMatrix<T>::identity((int)n));
+}
+
+/*
+ Returns the determinant of A: the product of the pivots, times det(C) when updates are
+ pending (the matrix determinant lemma). 0 if A is singular.
+ */
+template <class T>
+T KLU<T>::determinant() const{
+
+    if (is_singular) return T(0);
+
+    T det = T(1);
+    for (size_t i = 0 ; i < n ; i++){
+        det *= lu[i*n + i];
+        if (piv[i] != i) det = -det;
+    }
+    for (size_t i = 0 ; i < rank ; i++){
+        det *= cap[i*rank + i];
+        if (cpiv[i] != i) det = -det;
+    }
+
+    return det;
+}
+
+/*
+ Returns the unit lower triangular factor L of the last full factorization. Updates since
+ then (updateRank() > 0) are not included; call refactor() first to include them.
+ */
+template <class T>
+KMatrix<T> KLU<T>::getL() const{
+
+    KMatrix<T> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = 0 ; c < r ; c++){
+            out(r, c) = lu[r*n + c];
+        }
+        out(r, r) = T(1);
+    }
+
+    return out;
+}
+
+/*
+ Returns the upper triangular factor U of the last full factorization (see getL())
+ */
+template <class T>
+KMatrix<T> KLU<T>::getU() const{
+
+    KMatrix<T> out((int)n, (int)n);
+    for (size_t r = 0 ; r < n ; r++){
+        for (size_t c = r ; c < n ; c++){
+            out(r, c) = lu[r*n + c];
+        }
+    }
+
+    return out;
+}
+
+/*
+ Returns the dimension of the factored matrix
+ */
+template <class T>
+size_t KLU<T>::size() const{
+    return n;
+}
+
+/*
+ Returns true if A is singular to working precision
+ */
+template <class T>
+bool KLU<T>::singular() const{
+    return is_singular;
+}
+
+/*
+ Returns the total rank of the updates carried since the last full factorization
+ */
+template <class T>
+size_t KLU<T>::updateRank() const{
+    return rank;
+}
+
+/*
+ Returns the number of times updates have been folded into a new factorization
+ */
+template <class T>
+size_t KLU<T>::refactors() const{
+    return nrefactor;
+}
+
+/*
+ Returns the relative residual measured by the last drift check (0 before any update)
+ */
+template <class T>
+double KLU<T>::drift() const{
+    return last_drift;
+}
+
+/*
+ Sets the relative residual above which an update refactors. The default is
+ kmatrix_drift_tolerance<T>().
+
+ Void return
+ */
+template <class T>
+void KLU<T>::setDriftTolerance(double tol){
+    this->tol = tol;
+}
+
+template <class T>
+double KLU<T>::driftTolerance() const{
+    return tol;
+}
+
+/*----------------------------------------------------------------
+---------------------------- KINVERSE ----------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KInverse<T>::KInverse() : n(0), nrefactor(0), last_drift(0), tol(kmatrix_drift_tolerance<T>()){
+
+}
+
+/*
+ Inverts 'a'. See compute().
+ */
+template <class T>
+KInverse<T>::KInverse(const KMatrix<T>& a) : n(0), nrefactor(0), last_drift(0), tol(kmatrix_drift_tolerance<T>()){
+    compute(a);
+}
+
+/*
+ Computes the inverse of 'a'. Throws matrix_multiplication_exception if 'a' is not square
+ and matrix_factorization_exception if it is singular.
+
+ a - square matrix
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::compute(const KMatrix<T>& a){
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    n = a.rows();
+    this->a = kmatrix_dense<T>(a);
+    nrefactor = 0;
+    last_drift = 0;
+
+    invert();
+}
+
+/*
+ Computes the inverse of the stored A again, discarding the rounding error accumulated by
+ updates. Throws matrix_factorization_exception if A is singular.
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::refactor(){
+    nrefactor++;
+    invert();
+}
+
+/*
+ Inverts the stored A through its LU factorization.
+ */
+template <class T>
+void KInverse<T>::invert(){
+
+    matrix_factorization_exception mat_fact_ex;
+
+    std::vector<T> lu(a);
+    std::vector<size_t> piv(n);
+    if (kmatrix_lu(lu.data(), n, piv.data(), kmatrix_lu_tolerance(a.data(), n)) < n){
+        throw mat_fact_ex;
+    }
+
+    inv.assign(n*n, T(0));
+    for (size_t i = 0 ; i < n ; i++) inv[i*n + i] = T(1);
+    kmatrix_lu_solve(lu.data(), piv.data(), n, inv.data(), n, n);
+}
+
+/*
+ Updates the inverse to that of A + u*v^H.
+
+ u, v - n x k matrices
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::update(const KMatrix<T>& u, const KMatrix<T>& v){
+    std::vector<T> ud, vd;
+    size_t k = kmatrix_update_cols(u, v, n, ud, vd);
+    apply(ud, vd, k);
+}
+
+template <class T>
+void KInverse<T>::update(const KVector<T>& u, const KVector<T>& v){
+    update(kmatrix_column(u), kmatrix_column(v));
+}
+
+/*
+ Updates the inverse to that of A - u*v^H.
+
+ u, v - n x k matrices
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::downdate(const KMatrix<T>& u, const KMatrix<T>& v){
+    std::vector<T> ud, vd;
+    size_t k = kmatrix_update_cols(u, v, n, ud, vd);
+    for (size_t i = 0 ; i < ud.size() ; i++) ud[i] = -ud[i];
+    apply(ud, vd, k);
+}
+
+template <class T>
+void KInverse<T>::downdate(const KVector<T>& u, const KVector<T>& v){
+    downdate(kmatrix_column(u), kmatrix_column(v));
+}
+
+/*
+ Replaces row 'r' of A with 'row' (a rank-1 update).
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::replaceRow(size_t r, const KVector<T>& row){
+
+    matrix_bounds_excep mat_bnd_ex;
+    if (r >= n || row.size() != n){
+        throw mat_bnd_ex;
+    }
+
+    std::vector<T> u(n, T(0)), v(n);
+    u[r] = T(1);
+    for (size_t j = 0 ; j < n ; j++) v[j] = kmatrix_conj(row.get(j) - a[r*n + j]);
+    apply(u, v, 1);
+}
+
+/*
+ Replaces column 'c' of A with 'col' (a rank-1 update).
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::replaceCol(size_t c, const KVector<T>& col){
+
+    matrix_bounds_excep mat_bnd_ex;
+    if (c >= n || col.size() != n){
+        throw mat_bnd_ex;
+    }
+
+    std::vector<T> u(n), v(n, T(0));
+    v[c] = T(1);
+    for (size_t i = 0 ; i < n ; i++) u[i] = col.get(i) - a[i*n + c];
+    apply(u, v, 1);
+}
+
+/*
+ Adds u*v^H to A and applies it to the inverse. If the Woodbury step finds the updated
+ matrix singular, the inverse is recomputed from A instead, which throws
+ matrix_factorization_exception if A really is singular.
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::apply(const std::vector<T>& u, const std::vector<T>& v, size_t k){
+
+    kmatrix_add_outer(a, n, u, v, k);
+
+    if (!kmatrix_woodbury(inv, n, u, v, k)){
+        refactor();
+    }
+
+    check_drift();
+}
+
+/*
+ Solves the probe system with the inverse and recomputes it if the residual exceeds the
+ drift tolerance.
+ */
+template <class T>
+void KInverse<T>::check_drift(){
+
+    std::vector<T> b = kmatrix_probe<T>(n);
+    std::vector<T> x(n);
+
+    auto probe = [&](){
+        for (size_t i = 0 ; i < n ; i++){
+            T s = T(0);
+            for (size_t j = 0 ; j < n ; j++) s += inv[i*n + j]*b[j];
+            x[i] = s;
+        }
+        return kmatrix_residual(a, n, x.data(), b.data());
+    };
+
+    last_drift = probe();
+    if (last_drift > tol){
+        refactor();
+        last_drift = probe();
+    }
+}
+
+/*
+ Returns the inverse
+ */
+template <class T>
+KMatrix<T> KInverse<T>::get() const{
+    return KMatrix<T>(inv.data(), (int)n, (int)n, KMAT_ROW_MAJOR);
+}
+
+/*
+ Returns A^-1*b
+
+ b - right-hand sides (n x k)
+ */
+template <class T>
+KMatrix<T> KInverse<T>::solve(const KMatrix<T>& b) const{
+
+    matrix_multiplication_exception mat_mult_ex;
+    if (b.rows() != n){
+        throw mat_mult_ex;
+    }
+
+    return matrixMult(get(), b);
+}
+
+template <class T>
+KVector<T> KInverse<T>::solve(const KVector<T>& b) const{
+    KMatrix<T> x = solve(kmatrix_column(b));
+    std::vector<T> out(x.rows());
+    for (size_t i = 0 ; i < x.rows() ; i++) out[i] = x.get(i, 0);
+    return KVector<T>(out);
+}
+
+/*
+ Returns the dimension of the inverted matrix
+ */
+template <class T>
+size_t KInverse<T>::size() const{
+    return n;
+}
+
+/*
+ Returns the number of times the inverse has been recomputed after an update
+ */
+template <class T>
+size_t KInverse<T>::refactors() const{
+    return nrefactor;
+}
+
+/*
+ Returns the relative residual measured by the last drift check (0 before any update)
+ */
+template <class T>
+double KInverse<T>::drift() const{
+    return last_drift;
+}
+
+/*
+ Sets the relative residual above which an update recomputes the inverse. The default is
+ kmatrix_drift_tolerance<T>().
+
+ Void return
+ */
+template <class T>
+void KInverse<T>::setDriftTolerance(double tol){
+    this->tol = tol;
+}
+
+template <class T>
+double KInverse<T>::driftTolerance() const{
+    return tol;
+}
+
+/*----------------------------------------------------------------
+--------------------------- FUNCTIONS ----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Updates a stored inverse of A to the inverse of A + u*v^H in O(n^2) (Sherman-Morrison).
+ Throws matrix_factorization_exception, leaving 'ainv' unchanged, if A + u*v^H is singular.
+ Nothing guards against accumulated rounding error; use KInverse for that.
+
+ ainv - inverse of A (n x n)
+ u, v - vectors of length n
+
+ Void return
+ */
+template <class T>
+void shermanMorrisonUpdate(KMatrix<T>& ainv, const KVector<T>& u, const KVector<T>& v){
+    woodburyUpdate(ainv, kmatrix_column(u), kmatrix_column(v));
+}
+
+/*
+ Updates a stored inverse of A to the inverse of A + u*v^H in O(n^2*k) (Woodbury). Throws
+ matrix_factorization_exception, leaving 'ainv' unchanged, if A + u*v^H is singular.
+
+ ainv - inverse of A (n x n)
+ u, v - n x k matrices
+
+ Void return
+ */
+template <class T>
+void woodburyUpdate(KMatrix<T>& ainv, const KMatrix<T>& u, const KMatrix<T>& v){
+
+    matrix_multiplication_exception mat_mult_ex;
+    matrix_factorization_exception mat_fact_ex;
+    if (ainv.rows() != ainv.cols()){
+        throw mat_mult_ex;
+    }
+
+    size_t n = ainv.rows();
+    std::vector<T> ud, vd;
+    size_t k = kmatrix_update_cols(u, v, n, ud, vd);
+
+    std::vector<T> inv = kmatrix_dense<T>(ainv);
+    if (!kmatrix_woodbury(inv, n, ud, vd, k)){
+        throw mat_fact_ex;
+    }
+
+    KMatrix<T> out(inv.data(), (int)n, (int)n, KMAT_ROW_MAJOR);
+    out.setAlignment(ainv.alignment());
+    out.setMemoryPolicy(ainv.memoryPolicy());
+    out.setLayout(ainv.layout());
+    swapMat(ainv, out);
+}
+
+#endif /* KMatrixFactor_hpp */
@@ -0,0 +1,505 @@
+//
+//  KMatrixFunctions.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixFunctions_hpp
+#define KMatrixFunctions_hpp
+
+#include <vector>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include "KMatrix.hpp"
+#include "KVector.hpp"
+#include "KMatrixFactor.hpp"
+#include "KMatrixEigen.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Functions of a square matrix in the linear algebra sense, as opposed to the element-wise
+ sin(), cos(), etc. in KMatrix.hpp.
+
+ expm - exponential, by scaling and squaring with a diagonal Pade approximant (Higham 2005)
+ pow - integer power, by repeated squaring with matrixMult()
+ sqrtm - principal square root, by the Schur method (Bjorck and Hammarling)
+ expmMultiply - exp(t*A)*B without forming exp(t*A), by a truncated Taylor series applied to
+                B (Al-Mohy and Higham 2011). Only products A*x are needed, so A can also be
+                given as a function, and the cost is a few dozen of those products rather
+                than the O(n^3) of expm().
+
+ These are meant for floating point and complex matrices.
+ */
+
+//Largest 1-norm of A for which the degree 13 Pade approximant of exp(A) is accurate to double
+//precision. expm() scales A down to this norm and squares the result back up.
+#define KMATRIX_EXPM_THETA13 5.371920351148152
+
+template <class T>
+KMatrix<T> expm(const KMatrix<T>& a);
+
+template <class T>
+KMatrix<T> pow(const KMatrix<T>& a, long long k);
+
+template <class T>
+KMatrix<T> sqrtm(const KMatrix<T>& a);
+
+template <class T>
+KMatrix<T> expmMultiply(const KMatrix<T>& a, const KMatrix<T>& b, double t = 1);
+
+template <class T>
+KVector<T> expmMultiply(const KMatrix<T>& a, const KVector<T>& b, double t = 1);
+
+template <class T>
+KVector<T> expmMultiply(std::function<void(const T*, T*)> op, double norm, const KVector<T>& b, double t = 1);
+
+/*----------------------------------------------------------------
+---------------------------- HELPERS -----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns the 1-norm of 'a' (its largest column sum of absolute values)
+ */
+template <class T>
+double kmatrix_norm1(const KMatrix<T>& a){
+
+    std::vector<double> sums(a.cols(), 0);
+    for (size_t r = 0 ; r < a.rows() ; r++){
+        for (size_t c = 0 ; c < a.cols() ; c++) sums[c] += (double)std::abs(a.get(r, c));
+    }
+
+    double norm = 0;
+    for (size_t c = 0 ; c < sums.size() ; c++){
+        if (sums[c] > norm || std::isnan(sums[c])) norm = sums[c];
+    }
+
+    return norm;
+}
+
+/*
+ Returns the largest absolute value of the 'n' elements of 'x'
+ */
+template <class T>
+double kmatrix_norm_inf(const T* x, size_t n){
+
+    double norm = 0;
+    for (size_t i = 0 ; i < n ; i++){
+        double v = (double)std::abs(x[i]);
+        if (v > norm) norm = v;
+    }
+
+    return norm;
+}
+
+/*
+ Converts a complex result back to the element type: the real part for real types (the
+ caller has checked that the imaginary parts are rounding error), unchanged for complex types.
+ */
+template <class T, class R>
+T kmatrix_from_complex(const std::complex<R>& x, T*){
+    return T(x.real());
+}
+
+template <class R>
+std::complex<R> kmatrix_from_complex(const std::complex<R>& x, std::complex<R>*){
+    return x;
+}
+
+/*
+ Evaluates the degree 'm' (3, 5, 7, 9 or 13) diagonal Pade approximant of exp(a) as
+ (V - U)^-1*(V + U), where U holds the odd and V the even powers of 'a'.
+
+ Returns the approximant
+ */
+template <class T>
+KMatrix<T> kmatrix_pade(const KMatrix<T>& a, int m){
+
+    static const double b3[] = {120, 60, 12, 1};
+    static const double b5[] = {30240, 15120, 3360, 420, 30, 1};
+    static const double b7[] = {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1};
+    static const double b9[] = {17643225600.0, 8821612800.0, 2075673600, 302702400, 30270240, 2162160, 110880, 3960, 90, 1};
+    static const double b13[] = {64764752532480000.0, 32382376266240000.0, 7771770303897600.0, 1187353796428800.0, 129060195264000.0, 10559470521600.0, 670442572800.0, 33522128640.0, 1323241920, 40840800, 960960, 16380, 182, 1};
+
+    const double* b = (m == 3) ? b3 : (m == 5) ? b5 : (m == 7) ? b7 : (m == 9) ? b9 : b13;
+
+    KMatrix<T> ident = KMatrix<T>::identity((int)a.rows());
+    KMatrix<T> a2 = matrixMult(a, a);
+    KMatrix<T> u, v;
+
+    if (m == 13){
+        //Grouped so that only A^2, A^4 and A^6 need forming (Higham 2005, eq. 2.2)
+        KMatrix<T> a4 = matrixMult(a2, a2);
+        KMatrix<T> a6 = matrixMult(a4, a2);
+        u = matrixMult(a6, T(b[13])*a6 + T(b[11])*a4 + T(b[9])*a2) + T(b[7])*a6 + T(b[5])*a4 + T(b[3])*a2 + T(b[1])*ident;
+        v = matrixMult(a6, T(b[12])*a6 + T(b[10])*a4 + T(b[8])*a2) + T(b[6])*a6 + T(b[4])*a4 + T(b[2])*a2 + T(b[0])*ident;
+    }else{
+        u = T(b[1])*ident;
+        v = T(b[0])*ident;
+        KMatrix<T> p = a2;
+        for (int j = 1 ; 2*j < m ; j++){
+            if (j > 1) p = matrixMult(p, a2);
+            u += T(b[2*j + 1])*p;
+            v += T(b[2*j])*p;
+        }
+    }
+    u = matrixMult(a, u);
+
+    KLU<T> lu(v - u);
+    return lu.solve(v + u);
+}
+
+/*
+ Chooses the Taylor degree 'm' and number of steps 's' for expmMultiply() that minimize the
+ number of products m*s while keeping the truncation error of each step below double
+ precision unit roundoff, given the 1-norm of t*A.
+
+ Void return
+ */
+inline void kmatrix_taylor_degree(double norm, size_t& m, size_t& s){
+
+    //Largest 1-norm for which degree m is accurate enough (Al-Mohy and Higham 2011, table 3.1)
+    static const size_t degrees[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 35, 40, 45, 50, 55};
+    static const double thetas[] = {2.29e-16, 2.58e-8, 1.39e-5, 3.40e-4, 2.40e-3, 9.07e-3, 2.38e-2, 5.00e-2, 8.96e-2, 1.44e-1, 2.14e-1, 3.00e-1, 4.00e-1, 5.14e-1, 6.41e-1, 7.81e-1, 9.31e-1, 1.09, 1.26, 1.44, 1.62, 1.82, 2.01, 2.22, 2.43, 2.64, 2.86, 3.08, 3.31, 3.54, 4.7, 6.0, 7.2, 8.5, 9.9};
+
+    m = 0;
+    s = 1;
+    if (norm == 0) return;
+
+    double best = std::numeric_limits<double>::infinity();
+    for (size_t i = 0 ; i < sizeof(degrees)/sizeof(degrees[0]) ; i++){
+        double steps = std::ceil(norm/thetas[i]);
+        if (steps < 1) steps = 1;
+        if ((double)degrees[i]*steps < best){
+            best = (double)degrees[i]*steps;
+            m = degrees[i];
+            s = (size_t)steps;
+        }
+    }
+}
+
+/*
+ Overwrites the n-vector 'b' with exp(t*(B + shift*I))*b, where 'op' computes y = B*x and
+ 'norm' is the 1-norm of B. The series for each of the s steps stops early once two
+ successive terms are negligible.
+
+ Void return
+ */
+template <class T>
+void kmatrix_expm_multiply(const std::function<void(const T*, T*)>& op, size_t n, double norm, T shift, double t, T* b){
+
+    typedef typename kmatrix_real<T>::type R;
+    matrix_domain_exception domain_ex;
+
+    if (!std::isfinite(norm*t)){
+        throw domain_ex;
+    }
+
+    size_t m, s;
+    kmatrix_taylor_degree(std::fabs(t)*norm, m, s);
+    double tol = (double)std::numeric_limits<R>::epsilon()/2;
+    T eta = std::exp(T(t)*shift/T((double)s));
+
+    std::vector<T> f(b, b + n);
+    std::vector<T> w(n);
+
+    for (size_t i = 0 ; i < s ; i++){
+
+        double c1 = kmatrix_norm_inf(b, n);
+        for (size_t k = 1 ; k <= m ; k++){
+            op(b, w.data());
+            T scale = T(t/((double)s*(double)k));
+            for (size_t j = 0 ; j < n ; j++){
+                b[j] = scale*w[j];
+                f[j] += b[j];
+            }
+            double c2 = kmatrix_norm_inf(b, n);
+            if (c1 + c2 <= tol*kmatrix_norm_inf(f.data(), n)) break;
+            c1 = c2;
+        }
+
+        for (size_t j = 0 ; j < n ; j++){
+            f[j] *= eta;
+            b[j] = f[j];
+        }
+    }
+}
+
+/*----------------------------------------------------------------
+------------------------ MATRIX FUNCTIONS ------------------------
+----------------------------------------------------------------*/
+
+/*
+ Computes the matrix exponential of 'a'. The Pade degree is the lowest that is accurate for
+ the 1-norm of 'a'; above KMATRIX_EXPM_THETA13, 'a' is divided by 2^s to bring it under and
+ the result squared s times.
+
+ Throws matrix_multiplication_exception if 'a' is not square, and matrix_domain_exception if
+ it has infinite or NaN elements.
+
+ Returns exp(a)
+ */
+template <class T>
+KMatrix<T> expm(const KMatrix<T>& a){
+
+    matrix_multiplication_exception mat_mult_ex;
+    matrix_domain_exception domain_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+    if (a.rows() == 0) return KMatrix<T>(a);
+
+    //Largest 1-norm each lower degree is accurate for (Higham 2005, table 2.3)
+    static const int degrees[] = {3, 5, 7, 9};
+    static const double thetas[] = {1.495585217958292e-2, 2.539398330063230e-1, 9.504178996162932e-1, 2.097847961257068};
+
+    double norm = kmatrix_norm1(a);
+    if (!std::isfinite(norm)){
+        throw domain_ex;
+    }
+
+    for (int i = 0 ; i < 4 ; i++){
+        if (norm <= thetas[i]) return kmatrix_pade(a, degrees[i]);
+    }
+
+    int s = (int)std::ceil(std::log2(norm/KMATRIX_EXPM_THETA13));
+    if (s < 0) s = 0;
+
+    KMatrix<T> out = kmatrix_pade(a*T(std::ldexp(1.0, -s)), 13);
+    for (int i = 0 ; i < s ; i++){
+        out = matrixMult(out, out);
+    }
+
+    return out;
+}
+
+/*
+ Raises 'a' to the integer power 'k' by repeated squaring, which takes about 2*log2(|k|)
+ calls to matrixMult(). A negative power inverts 'a' first.
+
+ Throws matrix_multiplication_exception if 'a' is not square, and (for k < 0)
+ matrix_factorization_exception if it is singular.
+
+ Returns a^k (the identity for k = 0)
+ */
+template <class T>
+KMatrix<T> pow(const KMatrix<T>& a, long long k){
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+    if (k == 0) return KMatrix<T>::identity((int)a.rows());
+
+    KMatrix<T> base(a);
+    if (k < 0) base = base.inverse();
+    unsigned long long e = (k < 0) ? -(unsigned long long)k : (unsigned long long)k;
+
+    KMatrix<T> out;
+    bool started = false;
+    while (true){
+        if (e & 1){
+            out = started ? matrixMult(out, base) : base;
+            started = true;
+        }
+        e >>= 1;
+        if (e == 0) break;
+        base = matrixMult(base, base);
+    }
+
+    return out;
+}
+
+/*
+ Computes the principal square root of 'a', the one whose eigenvalues all have positive real
+ part. 'a' is reduced to complex Schur form Z*T*Z^H (see KEigen), the upper triangular root
+ of T is found one superdiagonal at a time (each in parallel), and the result is transformed
+ back.
+
+ Throws matrix_multiplication_exception if 'a' is not square, matrix_convergence_exception
+ if the Schur reduction fails, and matrix_domain_exception if there is no principal root: a
+ real matrix with a negative real eigenvalue (whose root is complex), or a singular matrix
+ whose zero eigenvalue is defective.
+
+ Returns X with X*X = a
+ */
+template <class T>
+KMatrix<T> sqrtm(const KMatrix<T>& a){
+
+    typedef typename kmatrix_complex<T>::type C;
+    typedef typename kmatrix_real<T>::type R;
+    matrix_multiplication_exception mat_mult_ex;
+    matrix_domain_exception domain_ex;
+
+    if (a.rows() != a.cols()){
+        throw mat_mult_ex;
+    }
+
+    size_t n = a.rows();
+    if (n == 0) return KMatrix<T>(a);
+
+    KEigen<T> eig(a, false);
+    KMatrix<C> tri = eig.getSchur();
+
+    std::vector<C> t(n*n), r(n*n, C(0));
+    double scale = 0;
+    for (size_t i = 0 ; i < n ; i++){
+        for (size_t j = i ; j < n ; j++){
+            t[i*n + j] = tri.get(i, j);
+            if ((double)std::abs(t[i*n + j]) > scale) scale = (double)std::abs(t[i*n + j]);
+        }
+    }
+
+    double small = (double)n*(double)std::numeric_limits<R>::epsilon()*scale;
+    for (size_t i = 0 ; i < n ; i++){
+        C d = t[i*n + i];
+        if (std::is_same<T, R>::value && d.real() < 0 && (double)std::abs(d.imag()) <= small){
+            throw domain_ex;
+        }
+        r[i*n + i] = std::sqrt(d);
+    }
+
+    //R(i,j) depends only on elements of R on lower superdiagonals
+    std::atomic<bool> defective(false);
+    for (size_t d = 1 ; d < n ; d++){
+        auto diag = [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                size_t j = i + d;
+                C s = t[i*n + j];
+                for (size_t k = i + 1 ; k < j ; k++) s -= r[i*n + k]*r[k*n + j];
+                C den = r[i*n + i] + r[j*n + j];
+                if (den == C(0)){
+                    if (s != C(0)) defective.store(true, std::memory_order_relaxed);
+                    continue;
+                }
+                r[i*n + j] = s/den;
+            }
+        };
+        if ((n - d)*d < KMATRIX_ELEMENTWISE_PARALLEL){
+            diag(0, n - d);
+        }else{
+            KThreadPool::global().parallel_for(0, n - d, diag);
+        }
+    }
+    if (defective.load()){
+        throw domain_ex;
+    }
+
+    KMatrix<C> z = eig.getSchurVectors();
+    KMatrix<C> root((int)n, (int)n), zh((int)n, (int)n);
+    for (size_t i = 0 ; i < n ; i++){
+        for (size_t j = 0 ; j < n ; j++){
+            root(i, j) = r[i*n + j];
+            zh(i, j) = std::conj(z.get(j, i));
+        }
+    }
+    KMatrix<C> x = matrixMult(matrixMult(z, root), zh);
+
+    KMatrix<T> out((int)n, (int)n);
+    for (size_t i = 0 ; i < n ; i++){
+        for (size_t j = 0 ; j < n ; j++){
+            C v = x.get(i, j);
+            if (!std::isfinite((double)std::abs(v))){
+                throw domain_ex;
+            }
+            out(i, j) = kmatrix_from_complex(v, (T*)NULL);
+        }
+    }
+
+    return out;
+}
+
+/*
+ Computes exp(t*a)*b without forming exp(t*a). 'a' is shifted by the mean of its diagonal
+ first, which shrinks the norm the number of products depends on, and exp(t*mean) is
+ multiplied back in. Each column of 'b' is handled separately.
+
+ a - square matrix
+ b - matrix with as many rows as 'a'
+ t - time (scale) applied to 'a'
+
+ Throws matrix_multiplication_exception if the sizes do not agree, and
+ matrix_domain_exception if 'a' has infinite or NaN elements.
+
+ Returns exp(t*a)*b
+ */
+template <class T>
+KMatrix<T> expmMultiply(const KMatrix<T>& a, const KMatrix<T>& b, double t){
+
+    matrix_multiplication_exception mat_mult_ex;
+
+    if (a.rows() != a.cols() || a.cols() != b.rows()){
+        throw mat_mult_ex;
+    }
+
+    size_t n = a.rows();
+    KMatrix<T> out(b);
+    if (n == 0) return out;
+
+    T shift = T(0);
+    for (size_t i = 0 ; i < n ; i++) shift += a.get(i, i);
+    shift = shift/T((double)n);
+
+    KMatrix<T> shifted(a);
+    for (size_t i = 0 ; i < n ; i++) shifted(i, i) -= shift;
+    double norm = kmatrix_norm1(shifted);
+    std::function<void(const T*, T*)> op = kmatrix_matvec<T, T>(shifted);
+
+    std::vector<T> col(n);
+    for (size_t c = 0 ; c < b.cols() ; c++){
+        for (size_t r = 0 ; r < n ; r++) col[r] = b.get(r, c);
+        kmatrix_expm_multiply(op, n, norm, shift, t, col.data());
+        for (size_t r = 0 ; r < n ; r++) out(r, c) = col[r];
+    }
+
+    return out;
+}
+
+/*
+ Computes exp(t*a)*b for a vector 'b'. See the KMatrix version.
+
+ Returns exp(t*a)*b
+ */
+template <class T>
+KVector<T> expmMultiply(const KMatrix<T>& a, const KVector<T>& b, double t){
+
+    KMatrix<T> x = expmMultiply(a, kmatrix_column(b), t);
+    std::vector<T> out(x.rows());
+    for (size_t i = 0 ; i < x.rows() ; i++) out[i] = x.get(i, 0);
+
+    return KVector<T>(out);
+}
+
+/*
+ Computes exp(t*A)*b where A is only available through 'op', so it can be sparse or
+ implicit.
+
+ op - computes y = A*x for vectors of b.size() elements
+ norm - 1-norm of A, or an upper bound for it. An overestimate costs extra products; an
+        underestimate costs accuracy.
+ b - vector to multiply
+ t - time (scale) applied to A
+
+ Throws matrix_domain_exception if 'norm' is infinite or NaN.
+
+ Returns exp(t*A)*b
+ */
+template <class T>
+KVector<T> expmMultiply(std::function<void(const T*, T*)> op, double norm, const KVector<T>& b, double t){
+
+    std::vector<T> x(b.size());
+    for (size_t i = 0 ; i < x.size() ; i++) x[i] = b.get(i);
+
+    kmatrix_expm_multiply(op, x.size(), norm, T(0), t, x.data());
+
+    return KVector<T>(x);
+}
+
+#endif /* KMatrixFunctions_hpp */
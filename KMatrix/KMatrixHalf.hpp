@@ -0,0 +1,147 @@
+//
+//  KMatrixHalf.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixHalf_hpp
+#define KMatrixHalf_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "KMatrixHelpers.hpp"
+
+/*
+ 16-bit storage types for KMatrix. KHalf is IEEE 754 binary16 (5 exponent bits, 10 mantissa
+ bits, range +-65504) and KBFloat16 is bfloat16 (the top half of a float: 8 exponent bits,
+ 7 mantissa bits, the full float range). Both halve the memory and bandwidth of a
+ KMatrix<float>.
+
+ They are storage formats only. Every operation converts to float, computes in float and
+ rounds the result once (round to nearest even), and matrixMult(), avg() and stdev()
+ accumulate in float (see kmatrix_accum). Construction from a number is explicit; reading
+ a value as a float is implicit.
+ */
+
+/*
+ Conversions between float and the 16-bit formats. NaN stays NaN and values too large for
+ binary16 become infinity.
+ */
+inline uint16_t kmatrix_float_to_half(float f){
+
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+    uint32_t absx = x & 0x7FFFFFFF;
+
+    if (absx >= 0x7F800000){ //Inf or NaN (NaN stays quiet)
+        return sign | ((absx > 0x7F800000) ? 0x7E00 : 0x7C00);
+    }
+    if (absx >= 0x477FF000){ //Rounds past 65504
+        return sign | 0x7C00;
+    }
+    if (absx < 0x38800000){ //Subnormal half: let float addition do the rounding
+        float af;
+        std::memcpy(&af, &absx, sizeof(af));
+        af += 0.5f;
+        uint32_t y;
+        std::memcpy(&y, &af, sizeof(y));
+        return sign | (uint16_t)(y - 0x3F000000);
+    }
+
+    //Rebias the exponent and round the dropped 13 bits to nearest even
+    absx += 0xC8000FFF + ((absx >> 13) & 1);
+    return sign | (uint16_t)(absx >> 13);
+}
+
+inline float kmatrix_half_to_float(uint16_t h){
+
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    uint32_t x;
+
+    if (exp == 0){
+        float f = (float)mant * 5.9604644775390625e-8f; //mant * 2^-24, exact
+        std::memcpy(&x, &f, sizeof(x));
+        x |= sign;
+    }else if (exp == 31){
+        x = sign | 0x7F800000 | (mant << 13);
+    }else{
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+
+    float out;
+    std::memcpy(&out, &x, sizeof(out));
+    return out;
+}
+
+inline uint16_t kmatrix_float_to_bfloat16(float f){
+
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    if ((x & 0x7FFFFFFF) > 0x7F800000){ //NaN: keep it quiet rather than rounding to Inf
+        return (uint16_t)((x >> 16) | 0x0040);
+    }
+
+    x += 0x7FFF + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+inline float kmatrix_bfloat16_to_float(uint16_t b){
+
+    uint32_t x = (uint32_t)b << 16;
+    float out;
+    std::memcpy(&out, &x, sizeof(out));
+    return out;
+}
+
+/*
+ Defines a 16-bit storage type 'NAME' converting with TO_BITS and FROM_BITS. Arithmetic and
+ comparisons go through float.
+ */
+#define KMATRIX_DEFINE_HALF(NAME, TO_BITS, FROM_BITS) \
+class NAME { \
+public: \
+    NAME() : bits(0){} \
+    template <class U, class = typename std::enable_if<std::is_arithmetic<U>::value>::type> \
+    explicit NAME(U x) : bits(TO_BITS((float)x)){} \
+    NAME& operator=(float x){ bits = TO_BITS(x); return *this; } \
+    operator float() const { return FROM_BITS(bits); } \
+    static NAME fromBits(uint16_t b){ NAME out; out.bits = b; return out; } \
+    uint16_t toBits() const { return bits; } \
+    NAME& operator+=(NAME rv){ bits = TO_BITS(float(*this) + float(rv)); return *this; } \
+    NAME& operator-=(NAME rv){ bits = TO_BITS(float(*this) - float(rv)); return *this; } \
+    NAME& operator*=(NAME rv){ bits = TO_BITS(float(*this) * float(rv)); return *this; } \
+    NAME& operator/=(NAME rv){ bits = TO_BITS(float(*this) / float(rv)); return *this; } \
+    NAME operator-() const { return fromBits(bits ^ 0x8000); } \
+private: \
+    uint16_t bits; \
+}; \
+inline NAME operator+(NAME a, NAME b){ return NAME(float(a) + float(b)); } \
+inline NAME operator-(NAME a, NAME b){ return NAME(float(a) - float(b)); } \
+inline NAME operator*(NAME a, NAME b){ return NAME(float(a) * float(b)); } \
+inline NAME operator/(NAME a, NAME b){ return NAME(float(a) / float(b)); } \
+inline bool operator==(NAME a, NAME b){ return float(a) == float(b); } \
+inline bool operator!=(NAME a, NAME b){ return float(a) != float(b); } \
+inline bool operator<(NAME a, NAME b){ return float(a) < float(b); } \
+inline bool operator>(NAME a, NAME b){ return float(a) > float(b); } \
+inline bool operator<=(NAME a, NAME b){ return float(a) <= float(b); } \
+inline bool operator>=(NAME a, NAME b){ return float(a) >= float(b); } \
+inline std::string limited_template_to_string(NAME x){ return limited_template_to_string((double)float(x)); }
+
+KMATRIX_DEFINE_HALF(KHalf, kmatrix_float_to_half, kmatrix_half_to_float)
+KMATRIX_DEFINE_HALF(KBFloat16, kmatrix_float_to_bfloat16, kmatrix_bfloat16_to_float)
+
+template <>
+struct kmatrix_accum<KHalf> { typedef float type; };
+
+template <>
+struct kmatrix_accum<KBFloat16> { typedef float type; };
+
+#endif /* KMatrixHalf_hpp */
@@ -7,9 +7,72 @@
 //
 
 #include "KMatrixHelpers.hpp"
+#include "KMatrixStats.hpp"
 #include <vector>
-#include <IEGA/stdutil.hpp>
-#include <IEGA/string_manip.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+
+/*
+ String utilities used by the parser. These were previously pulled in from IEGA/stdutil.hpp,
+ which made the helpers (and every translation unit linking them) depend on the full IEGA
+ headers. They are kept local to this file so they do not collide with the IEGA versions.
+ */
+namespace {
+
+    /*
+     Surrounds each character of 'input' found in 'chars' with spaces.
+     */
+    void ensure_whitespace(std::string& input, std::string chars){
+        std::string out;
+        out.reserve(input.size()*2);
+        for (size_t i = 0 ; i < input.size() ; i++){
+            if (chars.find(input[i]) != std::string::npos){
+                out = out + ' ' + input[i] + ' ';
+            }else{
+                out = out + input[i];
+            }
+        }
+        input = out;
+    }
+
+    /*
+     Splits 'input' at any of the characters in 'delims'. Empty tokens are discarded.
+     */
+    std::vector<std::string> parse(std::string input, std::string delims){
+        std::vector<std::string> tokens;
+        std::string token;
+        for (size_t i = 0 ; i < input.size() ; i++){
+            if (delims.find(input[i]) != std::string::npos){
+                if (!token.empty()) tokens.push_back(token);
+                token.clear();
+            }else{
+                token = token + input[i];
+            }
+        }
+        if (!token.empty()) tokens.push_back(token);
+        return tokens;
+    }
+
+    /*
+     Returns true if the entire string 'x' can be interpreted as a number.
+     */
+    bool isnum(std::string x){
+        if (x.empty()) return false;
+        char* end;
+        std::strtod(x.c_str(), &end);
+        return (*end == '\0');
+    }
+
+    double strtod(std::string x){
+        return std::strtod(x.c_str(), NULL);
+    }
+
+    std::string bool_to_str(bool x){
+        return x ? "true" : "false";
+    }
+
+}
 
 const char* matrix_bounds_excep::what() const throw(){
     return "Attempted to access element out of bounds";
@@ -19,6 +82,42 @@ const char* matrix_multiplication_exception::what() const throw(){
     return "Attempted to multiply matricies of the wrong size";
 }
 
+const char* matrix_alignment_exception::what() const throw(){
+    return "Matrix alignment must be zero or a power of two";
+}
+
+const char* matrix_factorization_exception::what() const throw(){
+    return "Matrix can not be factored (it is singular, rank deficient or not positive definite)";
+}
+
+const char* matrix_convergence_exception::what() const throw(){
+    return "Iterative matrix algorithm failed to converge";
+}
+
+const char* matrix_quantization_exception::what() const throw(){
+    return "Quantized matrices must share scales along the inner dimension (left per row, right per column)";
+}
+
+const char* matrix_cancelled_exception::what() const throw(){
+    return "Matrix operation was cancelled";
+}
+
+const char* matrix_io_exception::what() const throw(){
+    return "Failed to read or write matrix storage file";
+}
+
+const char* matrix_domain_exception::what() const throw(){
+    return "Matrix function is not defined for this matrix";
+}
+
+/*
+ Returns the library-wide multiplication policy used by matrixMult()
+ */
+KMultPolicy& kmatrix_mult_policy(){
+    static KMultPolicy policy;
+    return policy;
+}
+
 /*
  Creates a 2D vector of int from a string. The result is saved to 'out'.
  
@@ -45,6 +144,49 @@ bool matrixFromString(std::string input, std::vector<std::vector<int> >& out){
     return ret;
 }
 
+/*
+ Creates a 2D vector of floats from a string. The result is saved to 'out'.
+ 
+ input - string interpreted as a matrix
+ out - 2D vector in which result is saved
+ 
+ Returns true if creating vector was successful
+ */
+bool matrixFromString(std::string input, std::vector<std::vector<float> >& out){
+    
+    std::vector<std::vector<double> > temp;
+    bool ret = matrixFromString(input, temp);
+    
+    out.clear();
+    for (size_t i = 0 ; i < temp.size() ; i++){
+        out.push_back(std::vector<float>(temp[i].begin(), temp[i].end()));
+    }
+    
+    return ret;
+}
+
+/*
+ Creates a 2D vector of complex doubles from a string. Only real values are parsed; the
+ imaginary part of each element is zero. The result is saved to 'out'.
+ 
+ input - string interpreted as a matrix
+ out - 2D vector in which result is saved
+ 
+ Returns true if creating vector was successful
+ */
+bool matrixFromString(std::string input, std::vector<std::vector<std::complex<double> > >& out){
+    
+    std::vector<std::vector<double> > temp;
+    bool ret = matrixFromString(input, temp);
+    
+    out.clear();
+    for (size_t i = 0 ; i < temp.size() ; i++){
+        out.push_back(std::vector<std::complex<double> >(temp[i].begin(), temp[i].end()));
+    }
+    
+    return ret;
+}
+
 /*
  Creates a 2D vector of doubles from a string. The result is saved to 'out'.
  
@@ -55,12 +197,14 @@ bool matrixFromString(std::string input, std::vector<std::vector<int> >& out){
  */
 bool matrixFromString(std::string input, std::vector<std::vector<double> >& out){
     
+    KMATRIX_STAT_SCOPE(KOP_PARSE, 0, 0);
+    
     int c = -1;
     int r = 0;
     std::vector<double> values;
     
     ensure_whitespace(input, ",;");
-    std::vector<std::string> tokens = parse(input, " ");
+    std::vector<std::string> tokens = parse(input, " []"); //Brackets separate tokens like spaces
     
     int ticker = 0;
     bool add_line = false;
@@ -114,6 +258,10 @@ bool matrixFromString(std::string input, std::vector<std::vector<double> >& out)
     }
     
     if (add_line){
+        if (c != -1 && c != ticker){
+            std::cout << "ERROR: Failed to create matrix from string:\n\t'" << input << "'" << std::endl;
+            return false;
+        }
         c = ticker;
         r++;
     }
@@ -129,6 +277,7 @@ bool matrixFromString(std::string input, std::vector<std::vector<double> >& out)
         }
         out.push_back(temp);
     }
+    KMATRIX_STAT_ADD(0, (size_t)r*c*sizeof(double));
     
     return true;
 }
@@ -169,6 +318,13 @@ std::string limited_template_to_string(double x){
     return std::to_string(x);
 }
 
+std::string limited_template_to_string(std::complex<double> x){
+    if (x.imag() < 0){
+        return std::to_string(x.real()) + " - " + std::to_string(-x.imag()) + "i";
+    }
+    return std::to_string(x.real()) + " + " + std::to_string(x.imag()) + "i";
+}
+
 std::string limited_template_to_string(bool x){
     return bool_to_str(x);
 }
@@ -176,3 +332,15 @@ std::string limited_template_to_string(bool x){
 std::string limited_template_to_string(char x){
     return std::to_string((int)(x));
 }
+
+/*
+ Converts all lowercase characters in 'x' to uppercase.
+ 
+ Returns the uppercase string
+ */
+std::string kmatrix_to_uppercase(std::string x){
+    for (size_t i = 0 ; i < x.size() ; i++){
+        x[i] = toupper(x[i]);
+    }
+    return x;
+}
@@ -9,11 +9,46 @@
 #ifndef KMatrixHelpers_hpp
 #define KMatrixHelpers_hpp
 
-#include <stdio.h>
 #include <string>
+#include <vector>
+#include <complex>
+#include <exception>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 
 bool matrixFromString(std::string input, std::vector<std::vector<double> >& out);
+bool matrixFromString(std::string input, std::vector<std::vector<float> >& out);
 bool matrixFromString(std::string input, std::vector<std::vector<int> >& out);
+bool matrixFromString(std::string input, std::vector<std::vector<std::complex<double> > >& out);
+
+/*
+ Creates a 2D vector of any type constructible from double (eg. KHalf) from a string. The
+ values are parsed as doubles and converted. The result is saved to 'out'.
+
+ input - string interpreted as a matrix
+ out - 2D vector in which result is saved
+
+ Returns true if creating vector was successful
+ */
+template <class T>
+bool matrixFromString(std::string input, std::vector<std::vector<T> >& out){
+
+    std::vector<std::vector<double> > temp;
+    bool ret = matrixFromString(input, temp);
+
+    out.clear();
+    for (size_t i = 0 ; i < temp.size() ; i++){
+        std::vector<T> row;
+        row.reserve(temp[i].size());
+        for (size_t j = 0 ; j < temp[i].size() ; j++){
+            row.push_back(T(temp[i][j]));
+        }
+        out.push_back(row);
+    }
+
+    return ret;
+}
 
 std::string limited_template_to_string(int x);
 //std::string limited_template_to_string(long int x);
@@ -23,10 +58,206 @@ std::string limited_template_to_string(int x);
 //std::string limited_template_to_string(unsigned long long int x);
 //std::string limited_template_to_string(float x);
 std::string limited_template_to_string(double x);
+std::string limited_template_to_string(std::complex<double> x);
 std::string limited_template_to_string(std::string x);
 std::string limited_template_to_string(bool x);
 std::string limited_template_to_string(char x);
 
+std::string kmatrix_to_uppercase(std::string x);
+
+//Default size at or below which strassenMult() multiplies directly with the blocked kernel
+#define KMATRIX_STRASSEN_CROSSOVER 256
+
+/*
+ Selects the algorithm matrixMult() uses. The library-wide policy is returned by
+ kmatrix_mult_policy(); it is read on every call, so set it during startup rather than
+ while other threads are multiplying. Pass a KMultPolicy to matrixMult() to override it
+ for one call.
+
+ use_strassen - use strassenMult() for square products larger than strassen_crossover
+ strassen_crossover - size at or below which the blocked kernel is used
+ */
+class KMultPolicy {
+public:
+    bool use_strassen = false;
+    size_t strassen_crossover = KMATRIX_STRASSEN_CROSSOVER;
+};
+
+KMultPolicy& kmatrix_mult_policy();
+
+/*
+ Storage order of a KMatrix. Row-major matrices store each row contiguously; column-major
+ matrices store each column contiguously, matching Fortran and MATLAB data.
+ */
+enum KMatrixLayout {
+    KMAT_ROW_MAJOR,
+    KMAT_COL_MAJOR
+};
+
+/*
+ Ordering used by max(), min() and range(). Complex values are compared by magnitude.
+ */
+template <class T>
+bool kmatrix_greater(const T& a, const T& b){
+    return a > b;
+}
+
+template <class T>
+bool kmatrix_greater(const std::complex<T>& a, const std::complex<T>& b){
+    return std::abs(a) > std::abs(b);
+}
+
+/*
+ Complex conjugate that leaves real types as real types (std::conj(double) returns a complex).
+ */
+template <class T>
+T kmatrix_conj(const T& x){
+    return x;
+}
+
+template <class T>
+std::complex<T> kmatrix_conj(const std::complex<T>& x){
+    return std::conj(x);
+}
+
+/*
+ Real and complex types matching T. kmatrix_real<std::complex<double> >::type is double, and
+ kmatrix_complex<double>::type is std::complex<double>.
+ */
+template <class T>
+struct kmatrix_real { typedef T type; };
+
+template <class T>
+struct kmatrix_real<std::complex<T> > { typedef T type; };
+
+template <class T>
+struct kmatrix_complex { typedef std::complex<T> type; };
+
+template <class T>
+struct kmatrix_complex<std::complex<T> > { typedef std::complex<T> type; };
+
+/*
+ Type in which sums of T are accumulated by matrixMult(), avg() and stdev(). T itself unless
+ T is a reduced-precision storage type (KHalf and KBFloat16 accumulate in float).
+ */
+template <class T>
+struct kmatrix_accum { typedef T type; };
+
+/*
+ Type in which inverse(), determinant() and is_invertable() factor a matrix of T: double for
+ integer types, otherwise kmatrix_accum<T>::type.
+ */
+template <class T>
+struct kmatrix_solve { typedef typename std::conditional<std::is_integral<T>::value, double, typename kmatrix_accum<T>::type>::type type; };
+
+//Columns per independent random stream in KMatrix::random() and KMatrix::randn()
+#define KMATRIX_RANDOM_BLOCK 4096
+
+/*
+ Small, fast random generator (xoshiro256**) used to fill random matrices. Each (seed,
+ stream) pair gives an independent sequence, so blocks of a matrix can be filled by any
+ thread and still reproduce the same values. 'seed' and 'stream' are each expanded to two
+ words by splitmix64, which is one-to-one in its input, and the words are combined so that
+ distinct pairs never share a state.
+ */
+class KMatrixRNG {
+public:
+
+    KMatrixRNG(unsigned long long seed, unsigned long long stream = 0) : spare(0), have_spare(false){
+        state[2] = splitmix(stream);
+        state[3] = splitmix(stream);
+        state[0] = splitmix(seed) ^ state[3];
+        state[1] = splitmix(seed) ^ state[2]; //First output depends on both
+    }
+
+    //Next 64 random bits
+    unsigned long long next(){
+        unsigned long long result = rotl(state[1]*5, 7)*9;
+        unsigned long long t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    //Uniform on [0, 1)
+    double uniform(){
+        return (next() >> 11) * (1.0/9007199254740992.0);
+    }
+
+    //Standard normal (Box-Muller, generated in pairs)
+    double normal(){
+        if (have_spare){
+            have_spare = false;
+            return spare;
+        }
+        double u1 = 1.0 - uniform(); //(0, 1], so log() is finite
+        double u2 = uniform();
+        double rad = std::sqrt(-2.0*std::log(u1));
+        double ang = 6.283185307179586*u2;
+        spare = rad*std::sin(ang);
+        have_spare = true;
+        return rad*std::cos(ang);
+    }
+
+private:
+
+    static unsigned long long rotl(unsigned long long x, int k){
+        return (x << k) | (x >> (64 - k));
+    }
+
+    static unsigned long long splitmix(unsigned long long& x){
+        unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    unsigned long long state[4];
+    double spare;
+    bool have_spare;
+};
+
+/*
+ Draws one value of type T from 'gen', uniform on [0, 1) or standard normal. Complex values
+ draw the real and imaginary parts separately (each with variance 1/2 when normal). Integer
+ types, which [0, 1) would leave all zero, are instead uniform over [0, max] of the type, or
+ standard normal rounded to the nearest integer.
+ */
+template <class T>
+T kmatrix_random_value(KMatrixRNG& gen, bool normal, T*, std::false_type){
+    return T(normal ? gen.normal() : gen.uniform());
+}
+
+template <class T>
+T kmatrix_random_value(KMatrixRNG& gen, bool normal, T*, std::true_type){
+
+    if (normal){
+        return T(std::llround(gen.normal()));
+    }
+
+    unsigned long long span = (unsigned long long)std::numeric_limits<T>::max();
+    return T((span == ~0ULL) ? gen.next() : gen.next() % (span + 1));
+}
+
+template <class T>
+T kmatrix_random_value(KMatrixRNG& gen, bool normal, T* tag){
+    return kmatrix_random_value(gen, normal, tag, std::is_integral<T>());
+}
+
+template <class T>
+std::complex<T> kmatrix_random_value(KMatrixRNG& gen, bool normal, std::complex<T>*){
+    if (normal){
+        double re = gen.normal(), im = gen.normal();
+        return std::complex<T>(T(re*0.7071067811865476), T(im*0.7071067811865476));
+    }
+    double re = gen.uniform(), im = gen.uniform();
+    return std::complex<T>(T(re), T(im));
+}
+
 class matrix_bounds_excep: public std::exception
 {
     virtual const char* what() const throw();
@@ -37,4 +268,39 @@ class matrix_multiplication_exception: public std::exception
     virtual const char* what() const throw();
 };
 
+class matrix_alignment_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
+class matrix_factorization_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
+class matrix_convergence_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
+class matrix_quantization_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
+class matrix_cancelled_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
+class matrix_io_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
+class matrix_domain_exception: public std::exception
+{
+    virtual const char* what() const throw();
+};
+
 #endif /* KMatrixHelpers_hpp */
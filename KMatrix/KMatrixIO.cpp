@@ -0,0 +1,171 @@
+//
+//  KMatrixIO.cpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#include "KMatrixIO.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KMATRIX_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Longest value kmatrix_parse_value() accepts
+#define KMATRIX_MAX_VALUE_CHARS 127
+
+/*
+ Parses the characters [begin, end) as a number. Unlike std::strtod on the text in place,
+ this never reads past 'end', so it is safe on a mapped file with no terminating zero.
+
+ begin, end - characters of the value
+ out - set to the value
+
+ Returns true if all the characters form a number
+ */
+bool kmatrix_parse_value(const char* begin, const char* end, double& out){
+
+    size_t len = (size_t)(end - begin);
+    if (len == 0 || len > KMATRIX_MAX_VALUE_CHARS) return false;
+
+    char buf[KMATRIX_MAX_VALUE_CHARS + 1];
+    std::memcpy(buf, begin, len);
+    buf[len] = '\0';
+
+    char* stop;
+    out = std::strtod(buf, &stop);
+    return (stop == buf + len);
+}
+
+/*
+ Splits [begin, end) into at most 'max_chunks' pieces of at least 'min_chunk' bytes (except
+ the last), each ending just after a line break or at 'end'.
+
+ Returns the chunk boundaries, starting with 'begin' and ending with 'end'
+ */
+std::vector<const char*> kmatrix_split_lines(const char* begin, const char* end, size_t min_chunk, size_t max_chunks){
+
+    size_t len = (size_t)(end - begin);
+    if (max_chunks < 1) max_chunks = 1;
+    size_t target = len/max_chunks + 1;
+    if (target < min_chunk) target = min_chunk;
+
+    std::vector<const char*> bounds;
+    bounds.push_back(begin);
+
+    const char* p = begin;
+    while ((size_t)(end - p) > target){
+        const void* nl = std::memchr(p + target, '\n', (size_t)(end - p) - target);
+        if (nl == NULL) break;
+        p = (const char*)nl + 1;
+        if (p < end) bounds.push_back(p);
+    }
+    bounds.push_back(end);
+
+    return bounds;
+}
+
+/*
+ Copies 'err' to 'error', or prints it if 'error' is NULL.
+
+ Void return
+ */
+void kmatrix_report_parse_error(const KMatrixParseError& err, KMatrixParseError* error){
+
+    if (error != NULL){
+        *error = err;
+        return;
+    }
+
+    std::cout << "ERROR: Failed to load matrix - ";
+    if (err.line > 0){
+        std::cout << "line " << err.line;
+        if (err.column > 0) std::cout << ", column " << err.column;
+        std::cout << ": ";
+    }
+    std::cout << err.message << std::endl;
+}
+
+/*----------------------------------------------------------------
+-------------------------- MAPPED FILES --------------------------
+----------------------------------------------------------------*/
+
+KMatrixMappedFile::KMatrixMappedFile() : ptr(NULL), len(0), mapped(false){
+
+}
+
+KMatrixMappedFile::~KMatrixMappedFile(){
+    close();
+}
+
+/*
+ Maps 'filename' read-only. If the file can not be mapped (or the platform has no mmap), it
+ is read into memory instead.
+
+ Returns true if the file was opened
+ */
+bool KMatrixMappedFile::open(std::string filename){
+
+    close();
+
+#ifdef KMATRIX_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+        void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED){
+            ::close(fd);
+            madvise(p, (size_t)st.st_size, MADV_WILLNEED);
+            ptr = (const char*)p;
+            len = (size_t)st.st_size;
+            mapped = true;
+            return true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open()) return false;
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    ptr = buffer.data();
+    len = buffer.size();
+
+    return !file.bad();
+}
+
+/*
+ Unmaps (or frees) the file.
+
+ Void return
+ */
+void KMatrixMappedFile::close(){
+
+#ifdef KMATRIX_HAVE_MMAP
+    if (mapped) munmap((void*)ptr, len);
+#endif
+    mapped = false;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    ptr = NULL;
+    len = 0;
+}
+
+const char* KMatrixMappedFile::data() const{
+    return ptr;
+}
+
+size_t KMatrixMappedFile::size() const{
+    return len;
+}
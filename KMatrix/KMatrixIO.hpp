@@ -0,0 +1,442 @@
+//
+//  KMatrixIO.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixIO_hpp
+#define KMatrixIO_hpp
+
+#include <cmath>
+#include <cstddef>
+#include <istream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "KMatrix.hpp"
+#include "KMatrixStats.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Loaders for large text matrices, read from a file or a stream without first building one
+ string for the whole matrix.
+
+ The text uses the same notation as KMatrix(std::string): values are separated by commas
+ and/or whitespace, rows end at a semicolon, and square brackets are ignored. In addition
+ every line break ends a row, so files with one row per line need no semicolons, and empty
+ rows (blank lines, or a ';' at the end of a line) are skipped. Matrices of integer type
+ only accept whole numbers within the type's range; anything else is reported as an error.
+
+ The text is split at line breaks into chunks that are scanned in parallel twice: once to
+ count the rows and check that every row has the same number of values, and once (after
+ the matrix has been allocated at its final size) to parse each chunk straight into its
+ rows. Files are memory-mapped where the platform allows; streams are read in blocks of
+ KMATRIX_LOAD_BLOCK bytes, so only one block is held in memory at a time.
+ */
+
+//Bytes of a stream read and parsed at a time
+#define KMATRIX_LOAD_BLOCK (64u << 20)
+
+//Smallest chunk of text given to one thread
+#define KMATRIX_LOAD_CHUNK (1u << 20)
+
+/*
+ Position and description of the first problem found while loading.
+
+ line - line number, starting at 1
+ column - character position in the line, starting at 1 (0 when the whole row is at fault)
+ message - description of the problem
+ */
+struct KMatrixParseError {
+    size_t line = 0;
+    size_t column = 0;
+    std::string message;
+};
+
+template <class T>
+bool matrixFromFile(std::string filename, KMatrix<T>& out, KMatrixParseError* error=NULL);
+
+template <class T>
+bool matrixFromStream(std::istream& in, KMatrix<T>& out, KMatrixParseError* error=NULL);
+
+bool kmatrix_parse_value(const char* begin, const char* end, double& out);
+std::vector<const char*> kmatrix_split_lines(const char* begin, const char* end, size_t min_chunk, size_t max_chunks);
+void kmatrix_report_parse_error(const KMatrixParseError& err, KMatrixParseError* error);
+
+/*
+ A file mapped read-only into memory (or, where mapping is unavailable, read into a buffer).
+ */
+class KMatrixMappedFile {
+public:
+
+    KMatrixMappedFile();
+    ~KMatrixMappedFile();
+
+    KMatrixMappedFile(const KMatrixMappedFile&) = delete;
+    KMatrixMappedFile& operator=(const KMatrixMappedFile&) = delete;
+
+    bool open(std::string filename);
+    void close();
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+
+    const char* ptr;
+    size_t len;
+    bool mapped;
+    std::vector<char> buffer;
+};
+
+/*----------------------------------------------------------------
+---------------------------- SCANNING ----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Walks the text [begin, end), which must start at the beginning of a line, calling
+
+     value(const char* b, const char* e, size_t line, size_t column, size_t index)
+
+ for each value (index is its position in the row) and
+
+     row(size_t line, size_t count)
+
+ at the end of each row with at least one value. Lines are counted from 0 at 'begin'. Either
+ callback may fill in 'err' and return false to stop the scan.
+
+ begin, end - text to scan
+ value, row - callbacks
+ lines - set to the number of line breaks scanned
+ err - set to the problem found (with a line relative to 'begin')
+
+ Returns true if the whole text was scanned
+ */
+template <class V, class R>
+bool kmatrix_scan_text(const char* begin, const char* end, V value, R row, size_t& lines, KMatrixParseError& err){
+
+    size_t line = 0;
+    const char* line_start = begin;
+    size_t count = 0;
+    bool comma = false; //A comma has been seen since the last value
+
+    auto fail = [&](const char* at, std::string message){
+        err.line = line;
+        err.column = (size_t)(at - line_start) + 1;
+        err.message = message;
+        lines = line;
+        return false;
+    };
+
+    const char* p = begin;
+    while (p < end){
+
+        char ch = *p;
+        if (ch == '\n' || ch == ';'){
+            if (comma) return fail(p, "missing value after comma");
+            if (count > 0 && !row(line, count)){
+                lines = line;
+                return false;
+            }
+            count = 0;
+            if (ch == '\n'){
+                line++;
+                line_start = p + 1;
+            }
+            p++;
+        }else if (ch == ','){
+            if (comma || count == 0) return fail(p, "missing value before comma");
+            comma = true;
+            p++;
+        }else if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '[' || ch == ']'){
+            p++;
+        }else{
+            const char* q = p;
+            while (q < end && *q != '\n' && *q != ';' && *q != ',' && *q != ' ' && *q != '\t' && *q != '\r' && *q != '[' && *q != ']') q++;
+            if (!value(p, q, line, (size_t)(p - line_start) + 1, count)){
+                lines = line;
+                return false;
+            }
+            count++;
+            comma = false;
+            p = q;
+        }
+    }
+
+    if (comma) return fail(p, "missing value after comma");
+    if (count > 0 && !row(line, count)){
+        lines = line;
+        return false;
+    }
+
+    lines = line;
+    return true;
+}
+
+/*
+ Converts a parsed value to T. Values for integer types must be whole numbers within the
+ type's range, since converting anything else would silently change it (or, out of range,
+ be undefined).
+
+ x - parsed value
+ out - set to the converted value
+ why - set to the reason if the value is rejected
+
+ Returns true if the value was converted
+ */
+template <class T>
+bool kmatrix_load_convert(double x, T& out, std::string&, std::false_type){
+    out = T(x);
+    return true;
+}
+
+template <class T>
+bool kmatrix_load_convert(double x, T& out, std::string& why, std::true_type){
+
+    if (!std::isfinite(x) || x != std::trunc(x)){
+        why = "is not an integer";
+        return false;
+    }
+
+    //Exact powers of two bound the range: -2^digits (signed) or 0, up to 2^digits exclusive
+    double top = std::ldexp(1.0, std::numeric_limits<T>::digits);
+    double bottom = std::numeric_limits<T>::is_signed ? -top : 0.0;
+    if (x < bottom || x >= top){
+        why = "is out of range";
+        return false;
+    }
+
+    out = (T)x;
+    return true;
+}
+
+/*
+ Parses the text [begin, end), which must start at the beginning of a line, and appends its
+ rows to 'km' (which must be row-major). The text is split into chunks that are scanned in
+ parallel to count rows, the rows are allocated, and the chunks are parsed in parallel
+ directly into them.
+
+ begin, end - text to parse
+ line - line number of 'begin', starting at 1. Advanced past the text on success.
+ km - matrix to append to
+ cols - row width. If 0 it is set by the first row; otherwise every row must match it.
+ err - set to the first problem found
+
+ Returns true if the text was parsed
+ */
+template <class T>
+bool kmatrix_load_text(const char* begin, const char* end, size_t& line, KMatrix<T>& km, size_t& cols, KMatrixParseError& err){
+
+    struct Chunk {
+        size_t lines = 0;
+        size_t rows = 0;
+        size_t width = 0;
+        size_t width_line = 0;
+        bool ok = true;
+        KMatrixParseError err;
+    };
+
+    KThreadPool& pool = KThreadPool::global();
+    std::vector<const char*> bounds = kmatrix_split_lines(begin, end, KMATRIX_LOAD_CHUNK, pool.threads()*4);
+    size_t nchunks = bounds.size() - 1;
+    std::vector<Chunk> chunks(nchunks);
+
+    //Pass 1: count rows and check their widths
+    pool.parallel_for(0, nchunks, [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++){
+            Chunk& ch = chunks[i];
+            ch.ok = kmatrix_scan_text(bounds[i], bounds[i+1],
+                [](const char*, const char*, size_t, size_t, size_t){ return true; },
+                [&](size_t at, size_t count){
+                    if (ch.width == 0){
+                        ch.width = count;
+                        ch.width_line = at;
+                    }else if (count != ch.width){
+                        ch.err.line = at;
+                        ch.err.column = 0;
+                        ch.err.message = "row has " + std::to_string(count) + " values, expected " + std::to_string(ch.width);
+                        return false;
+                    }
+                    ch.rows++;
+                    return true;
+                }, ch.lines, ch.err);
+        }
+    });
+
+    //Give each chunk its first line and row, and check widths across chunks
+    std::vector<size_t> line0(nchunks), row0(nchunks);
+    size_t rows = km.rows();
+    for (size_t i = 0 ; i < nchunks ; i++){
+        line0[i] = line;
+        row0[i] = rows;
+        if (!chunks[i].ok){
+            err = chunks[i].err;
+            err.line += line;
+            return false;
+        }
+        if (chunks[i].rows > 0){
+            if (cols == 0){
+                cols = chunks[i].width;
+            }else if (chunks[i].width != cols){
+                err.line = line + chunks[i].width_line;
+                err.column = 0;
+                err.message = "row has " + std::to_string(chunks[i].width) + " values, expected " + std::to_string(cols);
+                return false;
+            }
+        }
+        line += chunks[i].lines;
+        rows += chunks[i].rows;
+    }
+
+    //Pass 2: allocate the rows and parse into them
+    std::vector<typename KMatrix<T>::row_type>& mat = km.getMat();
+    KMatrixAllocator<T> alloc = km.allocator();
+    size_t old_rows = mat.size();
+    mat.resize(rows);
+
+    pool.parallel_for(0, nchunks, [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++){
+            Chunk& ch = chunks[i];
+            size_t r = row0[i];
+            if (ch.rows > 0) mat[r] = typename KMatrix<T>::row_type(cols, T(), alloc);
+            ch.ok = kmatrix_scan_text(bounds[i], bounds[i+1],
+                [&](const char* b, const char* e, size_t at, size_t column, size_t index){
+                    double x;
+                    std::string why = "is not a number";
+                    if (!kmatrix_parse_value(b, e, x) || !kmatrix_load_convert(x, mat[r][index], why, std::is_integral<T>())){
+                        ch.err.line = at;
+                        ch.err.column = column;
+                        ch.err.message = "'" + std::string(b, e) + "' " + why;
+                        return false;
+                    }
+                    return true;
+                },
+                [&](size_t, size_t){
+                    if (++r < row0[i] + ch.rows) mat[r] = typename KMatrix<T>::row_type(cols, T(), alloc);
+                    return true;
+                }, ch.lines, ch.err);
+        }
+    });
+
+    for (size_t i = 0 ; i < nchunks ; i++){
+        if (!chunks[i].ok){
+            err = chunks[i].err;
+            err.line += line0[i];
+            mat.resize(old_rows);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------
+---------------------------- LOADERS -----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Loads a matrix from a text file (see the notation above). The file is memory-mapped and
+ parsed by the whole thread pool.
+
+ filename - file to read
+ out - set to the matrix (row-major, keeping its alignment and memory policy). Not altered if loading fails.
+ error - set to the location and cause of a failure. If NULL, failures are printed instead.
+
+ Returns true if the file was loaded
+ */
+template <class T>
+bool matrixFromFile(std::string filename, KMatrix<T>& out, KMatrixParseError* error){
+
+    KMATRIX_STAT_SCOPE(KOP_PARSE, 0, 0);
+
+    KMatrixParseError err;
+    KMatrixMappedFile file;
+    if (!file.open(filename)){
+        err.message = "can not open '" + filename + "'";
+        kmatrix_report_parse_error(err, error);
+        return false;
+    }
+
+    KMatrix<T> temp;
+    temp.setAlignment(out.alignment());
+    temp.setMemoryPolicy(out.memoryPolicy());
+    size_t cols = 0;
+    size_t line = 1;
+    if (!kmatrix_load_text(file.data(), file.data() + file.size(), line, temp, cols, err)){
+        kmatrix_report_parse_error(err, error);
+        return false;
+    }
+    KMATRIX_STAT_ADD(0, temp.rows()*cols*sizeof(T));
+
+    swapMat(out, temp);
+    return true;
+}
+
+/*
+ Loads a matrix from a text stream (see the notation above). The stream is read in blocks of
+ KMATRIX_LOAD_BLOCK bytes, cut at the last line break, and each block is parsed by the whole
+ thread pool before the next is read.
+
+ in - stream to read until its end
+ out - set to the matrix (row-major, keeping its alignment and memory policy). Not altered if loading fails.
+ error - set to the location and cause of a failure. If NULL, failures are printed instead.
+
+ Returns true if the stream was loaded
+ */
+template <class T>
+bool matrixFromStream(std::istream& in, KMatrix<T>& out, KMatrixParseError* error){
+
+    KMATRIX_STAT_SCOPE(KOP_PARSE, 0, 0);
+
+    KMatrixParseError err;
+    KMatrix<T> temp;
+    temp.setAlignment(out.alignment());
+    temp.setMemoryPolicy(out.memoryPolicy());
+    size_t cols = 0;
+    size_t line = 1;
+
+    std::vector<char> buf;
+    size_t carry = 0; //Bytes of an unfinished line kept from the last block
+    while (true){
+
+        buf.resize(carry + KMATRIX_LOAD_BLOCK);
+        in.read(buf.data() + carry, KMATRIX_LOAD_BLOCK);
+        size_t got = carry + (size_t)in.gcount();
+        bool last = !in;
+
+        //Parse up to the last line break (if there is none, keep reading), or everything at
+        //the end of the stream
+        size_t cut = got;
+        if (!last){
+            while (cut > 0 && buf[cut-1] != '\n') cut--;
+        }
+
+        if (cut > 0){
+            const char* b = buf.data();
+            if (!kmatrix_load_text(b, b + cut, line, temp, cols, err)){
+                kmatrix_report_parse_error(err, error);
+                return false;
+            }
+        }
+
+        carry = got - cut;
+        std::copy(buf.begin() + cut, buf.begin() + got, buf.begin());
+        if (last) break;
+    }
+
+    if (in.bad()){
+        err.line = line;
+        err.message = "read error";
+        kmatrix_report_parse_error(err, error);
+        return false;
+    }
+    KMATRIX_STAT_ADD(0, temp.rows()*cols*sizeof(T));
+
+    swapMat(out, temp);
+    return true;
+}
+
+#endif /* KMatrixIO_hpp */
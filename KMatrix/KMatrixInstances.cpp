@@ -0,0 +1,36 @@
+//
+//  KMatrixInstances.cpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+/*
+ Explicit instantiations for the types declared extern in the KMatrix headers. Code
+ that includes the headers links against these instead of re-instantiating them.
+ */
+
+#include "KMatrix.hpp"
+#include "KVector.hpp"
+#include "KLinMatrix.hpp"
+
+KMATRIX_INSTANTIATE(, float)
+KMATRIX_INSTANTIATE(, double)
+KMATRIX_INSTANTIATE(, int)
+KMATRIX_INSTANTIATE(, std::complex<double>)
+KMATRIX_INSTANTIATE(, KHalf)
+KMATRIX_INSTANTIATE(, KBFloat16)
+
+KVECTOR_INSTANTIATE(, float)
+KVECTOR_INSTANTIATE(, double)
+KVECTOR_INSTANTIATE(, std::complex<double>)
+KVECTOR_INSTANTIATE(, KHalf)
+KVECTOR_INSTANTIATE(, KBFloat16)
+
+KLINMATRIX_INSTANTIATE(, float)
+KLINMATRIX_INSTANTIATE(, double)
+KLINMATRIX_INSTANTIATE(, int)
+KLINMATRIX_INSTANTIATE(, std::complex<double>)
+KLINMATRIX_INSTANTIATE(, KHalf)
+KLINMATRIX_INSTANTIATE(, KBFloat16)
@@ -0,0 +1,439 @@
+//
+//  KMatrixKernels.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixKernels_hpp
+#define KMatrixKernels_hpp
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "KMatrixHelpers.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Raw-pointer kernels behind matrixMult(), strassenMult() and the LU factorization used by
+ inverse(), determinant() and KLU. For the products, matrices are passed as a
+ callable returning a pointer to the start of a row, so the same kernel runs over
+ KMatrix rows and over contiguous (pointer + leading dimension) blocks. Each kernel passes
+ its operation count to kmatrix_checkpoint() a block at a time, so products run as tasks
+ (KMatrixAsync.hpp) report progress and can be cancelled part way.
+ */
+
+//Cache blocking for kmatrix_gemm: a KMATRIX_GEMM_KB x KMATRIX_GEMM_JB block of the
+//right matrix is reused across every row of the left matrix.
+#define KMATRIX_GEMM_KB 128
+#define KMATRIX_GEMM_JB 256
+
+//Smallest m*k*n for which kmatrix_gemm splits rows across the thread pool
+#define KMATRIX_GEMM_PARALLEL_FLOPS 2000000
+
+/*
+ Blocked matrix multiply, C = A*B, where A is m x k, B is k x n and C is m x n. C is
+ overwritten. Rows of C are split across the thread pool when the product is large.
+
+ m, k, n - dimensions
+ a, b - callables returning const T* to row 'r' of A and B
+ c - callable returning T* to row 'r' of C
+
+ Void return
+ */
+template <class T, class RowA, class RowB, class RowC>
+void kmatrix_gemm(size_t m, size_t k, size_t n, RowA a, RowB b, RowC c){
+
+    auto rows = [&](size_t lo, size_t hi){
+
+        for (size_t i = lo ; i < hi ; i++){
+            T* crow = c(i);
+            for (size_t j = 0 ; j < n ; j++) crow[j] = T(0);
+        }
+
+        for (size_t kk = 0 ; kk < k ; kk += KMATRIX_GEMM_KB){
+            size_t kend = (kk + KMATRIX_GEMM_KB < k) ? kk + KMATRIX_GEMM_KB : k;
+            for (size_t jj = 0 ; jj < n ; jj += KMATRIX_GEMM_JB){
+                size_t jn = (jj + KMATRIX_GEMM_JB < n) ? KMATRIX_GEMM_JB : n - jj;
+                for (size_t i = lo ; i < hi ; i++){
+                    T* crow = c(i) + jj;
+                    const T* arow = a(i);
+                    for (size_t p = kk ; p < kend ; p++){
+                        const T aip = arow[p];
+                        const T* brow = b(p) + jj;
+                        for (size_t j = 0 ; j < jn ; j++){
+                            crow[j] += aip*brow[j];
+                        }
+                    }
+                }
+                kmatrix_checkpoint(2.0*(hi - lo)*(kend - kk)*jn);
+            }
+        }
+    };
+
+    if ((double)m*k*n < KMATRIX_GEMM_PARALLEL_FLOPS){
+        rows(0, m);
+    }else{
+        KThreadPool::global().parallel_for(0, m, rows, 4);
+    }
+}
+
+//Rows of B per block in kmatrix_gemm_nt, reused across every row of A
+#define KMATRIX_GEMM_NT_JB 64
+
+/*
+ Blocked multiply by a transposed matrix, C = A*B^T, where A is m x k, B^T is k x n and C
+ is m x n (so 'b' returns the n rows of B, each of length k). Each element of C is a dot
+ product of two contiguous rows. C is overwritten. Rows of C are split across the thread
+ pool when the product is large.
+
+ m, k, n - dimensions of the product
+ a - callable returning const T* to row 'r' of A
+ b - callable returning const T* to row 'r' of B (column 'r' of B^T)
+ c - callable returning T* to row 'r' of C
+
+ Void return
+ */
+template <class T, class RowA, class RowB, class RowC>
+void kmatrix_gemm_nt(size_t m, size_t k, size_t n, RowA a, RowB b, RowC c){
+
+    auto rows = [&](size_t lo, size_t hi){
+
+        for (size_t i = lo ; i < hi ; i++){
+            T* crow = c(i);
+            for (size_t j = 0 ; j < n ; j++) crow[j] = T(0);
+        }
+
+        for (size_t kk = 0 ; kk < k ; kk += KMATRIX_GEMM_KB){
+            size_t kn = (kk + KMATRIX_GEMM_KB < k) ? KMATRIX_GEMM_KB : k - kk;
+            for (size_t jj = 0 ; jj < n ; jj += KMATRIX_GEMM_NT_JB){
+                size_t jend = (jj + KMATRIX_GEMM_NT_JB < n) ? jj + KMATRIX_GEMM_NT_JB : n;
+                for (size_t i = lo ; i < hi ; i++){
+                    T* crow = c(i);
+                    const T* arow = a(i) + kk;
+                    for (size_t j = jj ; j < jend ; j++){
+                        const T* brow = b(j) + kk;
+                        T sum = T(0);
+                        for (size_t p = 0 ; p < kn ; p++){
+                            sum += arow[p]*brow[p];
+                        }
+                        crow[j] += sum;
+                    }
+                }
+                kmatrix_checkpoint(2.0*(hi - lo)*kn*(jend - jj));
+            }
+        }
+    };
+
+    if ((double)m*k*n < KMATRIX_GEMM_PARALLEL_FLOPS){
+        rows(0, m);
+    }else{
+        KThreadPool::global().parallel_for(0, m, rows, 4);
+    }
+}
+
+/*
+ Blocked multiply of a transposed matrix, C = A^T*B, where A^T is m x k, B is k x n and C
+ is m x n (so 'a' returns the k rows of A, each of length m). Rows of B are accumulated into
+ C as in kmatrix_gemm, reading A down its columns. C is overwritten. Rows of C are split
+ across the thread pool when the product is large.
+
+ m, k, n - dimensions of the product
+ a - callable returning const T* to row 'r' of A (column 'r' of A^T)
+ b - callable returning const T* to row 'r' of B
+ c - callable returning T* to row 'r' of C
+
+ Void return
+ */
+template <class T, class RowA, class RowB, class RowC>
+void kmatrix_gemm_tn(size_t m, size_t k, size_t n, RowA a, RowB b, RowC c){
+
+    auto rows = [&](size_t lo, size_t hi){
+
+        for (size_t i = lo ; i < hi ; i++){
+            T* crow = c(i);
+            for (size_t j = 0 ; j < n ; j++) crow[j] = T(0);
+        }
+
+        for (size_t kk = 0 ; kk < k ; kk += KMATRIX_GEMM_KB){
+            size_t kend = (kk + KMATRIX_GEMM_KB < k) ? kk + KMATRIX_GEMM_KB : k;
+            for (size_t jj = 0 ; jj < n ; jj += KMATRIX_GEMM_JB){
+                size_t jn = (jj + KMATRIX_GEMM_JB < n) ? KMATRIX_GEMM_JB : n - jj;
+                for (size_t i = lo ; i < hi ; i++){
+                    T* crow = c(i) + jj;
+                    for (size_t p = kk ; p < kend ; p++){
+                        const T api = a(p)[i];
+                        const T* brow = b(p) + jj;
+                        for (size_t j = 0 ; j < jn ; j++){
+                            crow[j] += api*brow[j];
+                        }
+                    }
+                }
+                kmatrix_checkpoint(2.0*(hi - lo)*(kend - kk)*jn);
+            }
+        }
+    };
+
+    if ((double)m*k*n < KMATRIX_GEMM_PARALLEL_FLOPS){
+        rows(0, m);
+    }else{
+        KThreadPool::global().parallel_for(0, m, rows, 4);
+    }
+}
+
+/*
+ out = x + y, or out = x - y if 'subtract', over h x h blocks. 'out' may alias 'x' or 'y'.
+ */
+template <class T>
+void kmatrix_block_add(T* out, size_t ldo, const T* x, size_t ldx, const T* y, size_t ldy, size_t h, bool subtract){
+
+    for (size_t r = 0 ; r < h ; r++){
+        T* o = out + r*ldo;
+        const T* xr = x + r*ldx;
+        const T* yr = y + r*ldy;
+        if (subtract){
+            for (size_t c = 0 ; c < h ; c++) o[c] = xr[c] - yr[c];
+        }else{
+            for (size_t c = 0 ; c < h ; c++) o[c] = xr[c] + yr[c];
+        }
+    }
+
+    kmatrix_checkpoint((double)h*h);
+}
+
+/*
+ Strassen-Winograd multiply of n x n row-major blocks, C = A*B (C is overwritten and may
+ not alias A or B). Recurses while n is even and greater than 'crossover', then finishes
+ with kmatrix_gemm. Uses 7 half-size products and 15 additions per level, with two
+ half-size temporaries and the quadrants of C as workspace (Douglas et al. schedule).
+
+ Void return
+ */
+template <class T>
+void kmatrix_strassen(const T* A, size_t lda, const T* B, size_t ldb, T* C, size_t ldc, size_t n, size_t crossover){
+
+    if (n <= crossover || n % 2 != 0){
+        kmatrix_gemm<T>(n, n, n,
+            [&](size_t r){ return A + r*lda; },
+            [&](size_t r){ return B + r*ldb; },
+            [&](size_t r){ return C + r*ldc; });
+        return;
+    }
+
+    size_t h = n/2;
+    const T* A11 = A;          const T* A12 = A + h;
+    const T* A21 = A + h*lda;  const T* A22 = A + h*lda + h;
+    const T* B11 = B;          const T* B12 = B + h;
+    const T* B21 = B + h*ldb;  const T* B22 = B + h*ldb + h;
+    T* C11 = C;                T* C12 = C + h;
+    T* C21 = C + h*ldc;        T* C22 = C + h*ldc + h;
+
+    std::vector<T> xbuf(h*h);
+    std::vector<T> ybuf(h*h);
+    T* X = xbuf.data();
+    T* Y = ybuf.data();
+
+    kmatrix_block_add(X, h, A11, lda, A21, lda, h, true);      //X = S3 = A11 - A21
+    kmatrix_block_add(Y, h, B22, ldb, B12, ldb, h, true);      //Y = T3 = B22 - B12
+    kmatrix_strassen(X, h, Y, h, C21, ldc, h, crossover);      //C21 = M7 = S3*T3
+
+    kmatrix_block_add(X, h, A21, lda, A22, lda, h, false);     //X = S1 = A21 + A22
+    kmatrix_block_add(Y, h, B12, ldb, B11, ldb, h, true);      //Y = T1 = B12 - B11
+    kmatrix_strassen(X, h, Y, h, C22, ldc, h, crossover);      //C22 = M5 = S1*T1
+
+    kmatrix_block_add(X, h, X, h, A11, lda, h, true);          //X = S2 = S1 - A11
+    kmatrix_block_add(Y, h, B22, ldb, Y, h, h, true);          //Y = T2 = B22 - T1
+    kmatrix_strassen(X, h, Y, h, C12, ldc, h, crossover);      //C12 = M6 = S2*T2
+
+    kmatrix_block_add(X, h, A12, lda, X, h, h, true);          //X = S4 = A12 - S2
+    kmatrix_strassen(X, h, B22, ldb, C11, ldc, h, crossover);  //C11 = M3 = S4*B22
+
+    kmatrix_strassen(A11, lda, B11, ldb, X, h, h, crossover);  //X = M1 = A11*B11
+
+    kmatrix_block_add(C12, ldc, X, h, C12, ldc, h, false);     //C12 = U2 = M1 + M6
+    kmatrix_block_add(C21, ldc, C12, ldc, C21, ldc, h, false); //C21 = U3 = U2 + M7
+    kmatrix_block_add(C12, ldc, C12, ldc, C22, ldc, h, false); //C12 = U4 = U2 + M5
+    kmatrix_block_add(C22, ldc, C21, ldc, C22, ldc, h, false); //C22 = U7 = U3 + M5
+    kmatrix_block_add(C12, ldc, C12, ldc, C11, ldc, h, false); //C12 = U5 = U4 + M3
+
+    kmatrix_block_add(Y, h, Y, h, B21, ldb, h, true);          //Y = T4 = T2 - B21
+    kmatrix_strassen(A22, lda, Y, h, C11, ldc, h, crossover);  //C11 = M4 = A22*T4
+    kmatrix_block_add(C21, ldc, C21, ldc, C11, ldc, h, true);  //C21 = U6 = U3 - M4
+
+    kmatrix_strassen(A12, lda, B21, ldb, C11, ldc, h, crossover); //C11 = M2 = A12*B21
+    kmatrix_block_add(C11, ldc, X, h, C11, ldc, h, false);     //C11 = U1 = M1 + M2
+}
+
+/*
+ Arithmetic operations performed by kmatrix_strassen() for an n x n product: 7 half-size
+ products and 15 half-size additions per level, and 2*n^3 for each block finished by
+ kmatrix_gemm.
+
+ Returns the operation count
+ */
+inline double kmatrix_strassen_flops(size_t n, size_t crossover){
+
+    if (n <= crossover || n % 2 != 0){
+        return 2.0*n*n*n;
+    }
+
+    double h = (double)(n/2);
+    return 7.0*kmatrix_strassen_flops(n/2, crossover) + 15.0*h*h;
+}
+
+//Smallest trailing matrix (elements) for which kmatrix_lu updates rows in parallel
+#define KMATRIX_LU_PARALLEL 65536
+
+/*
+ Operations in columns [j0, j1) of an n x n LU factorization, the amount kmatrix_lu() passes
+ to kmatrix_checkpoint(), and in solving for 'nrhs' right-hand sides with kmatrix_lu_solve().
+ */
+inline double kmatrix_lu_work(size_t n, size_t j0, size_t j1){
+    double w = 0;
+    for (size_t j = j0 ; j < j1 ; j++) w += 2.0*(n - j)*(n - j);
+    return w;
+}
+
+inline double kmatrix_lu_solve_work(size_t n, size_t nrhs){
+    return 2.0*n*n*nrhs;
+}
+
+/*
+ Pivot magnitude at or below which kmatrix_lu() treats an n x n matrix as singular:
+ n*epsilon times its largest element.
+ */
+template <class T>
+double kmatrix_lu_tolerance(const T* a, size_t n){
+
+    double big = 0;
+    for (size_t i = 0 ; i < n*n ; i++){
+        double x = std::abs(a[i]);
+        if (x > big) big = x;
+    }
+
+    return n*std::numeric_limits<typename kmatrix_real<T>::type>::epsilon()*big;
+}
+
+/*
+ LU factorization with partial pivoting, P*A = L*U, in place. Right-looking: after each
+ pivot the rows below it are updated, split across the thread pool while the trailing matrix
+ is large.
+
+ a - n x n row-major matrix. Overwritten with U on and above the diagonal and the
+     multipliers of L (whose diagonal is 1) below it.
+ n - dimension
+ piv - set to the row exchanged with row i at step i
+ tol - pivots of magnitude at or below 'tol' count as zero. The factorization stops at the
+       first one.
+
+ Returns n if every pivot is nonzero, otherwise the step of the first zero pivot
+ */
+template <class T>
+size_t kmatrix_lu(T* a, size_t n, size_t* piv, double tol){
+
+    for (size_t k = 0 ; k < n ; k++){
+
+        //Choose the largest pivot in column k
+        size_t p = k;
+        double best = std::abs(a[k*n + k]);
+        for (size_t i = k+1 ; i < n ; i++){
+            double x = std::abs(a[i*n + k]);
+            if (x > best){
+                best = x;
+                p = i;
+            }
+        }
+        piv[k] = p;
+        if (!(best > tol)) return k;
+
+        if (p != k){
+            for (size_t j = 0 ; j < n ; j++) std::swap(a[k*n + j], a[p*n + j]);
+        }
+
+        //Eliminate below the pivot
+        const T inv = T(1)/a[k*n + k];
+        const T* uk = a + k*n;
+        auto eliminate = [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                T* ai = a + i*n;
+                const T lik = ai[k]*inv;
+                ai[k] = lik;
+                for (size_t j = k+1 ; j < n ; j++) ai[j] -= lik*uk[j];
+            }
+        };
+
+        if ((n - k)*(n - k) < KMATRIX_LU_PARALLEL){
+            eliminate(k+1, n);
+        }else{
+            KThreadPool::global().parallel_for(k+1, n, eliminate, 16);
+        }
+
+        kmatrix_checkpoint(kmatrix_lu_work(n, k, k+1));
+    }
+
+    return n;
+}
+
+/*
+ Solves A*X = B using the factors from kmatrix_lu(). The right-hand sides are processed
+ together a row at a time, and split across the thread pool when there are many.
+
+ lu, piv - output of kmatrix_lu() for A (n x n)
+ n - dimension
+ b - n x nrhs row-major right-hand sides, with leading dimension 'ldb'. Overwritten with X.
+ nrhs - number of right-hand sides
+
+ Void return
+ */
+template <class T>
+void kmatrix_lu_solve(const T* lu, const size_t* piv, size_t n, T* b, size_t nrhs, size_t ldb){
+
+    auto cols = [&](size_t lo, size_t hi){
+
+        //Apply the row exchanges
+        for (size_t i = 0 ; i < n ; i++){
+            if (piv[i] != i){
+                T* bi = b + i*ldb;
+                T* bp = b + piv[i]*ldb;
+                for (size_t c = lo ; c < hi ; c++) std::swap(bi[c], bp[c]);
+            }
+        }
+
+        //Forward substitution: L*y = P*b
+        for (size_t i = 1 ; i < n ; i++){
+            T* bi = b + i*ldb;
+            const T* li = lu + i*n;
+            for (size_t p = 0 ; p < i ; p++){
+                const T lip = li[p];
+                const T* bp = b + p*ldb;
+                for (size_t c = lo ; c < hi ; c++) bi[c] -= lip*bp[c];
+            }
+        }
+
+        //Back substitution: U*x = y
+        for (size_t i = n ; i-- > 0 ; ){
+            T* bi = b + i*ldb;
+            const T* ui = lu + i*n;
+            for (size_t j = i+1 ; j < n ; j++){
+                const T uij = ui[j];
+                const T* bj = b + j*ldb;
+                for (size_t c = lo ; c < hi ; c++) bi[c] -= uij*bj[c];
+            }
+            const T inv = T(1)/ui[i];
+            for (size_t c = lo ; c < hi ; c++) bi[c] *= inv;
+        }
+
+        kmatrix_checkpoint(kmatrix_lu_solve_work(n, hi - lo));
+    };
+
+    if (nrhs < 2 || (double)n*n*nrhs < KMATRIX_GEMM_PARALLEL_FLOPS){
+        cols(0, nrhs);
+    }else{
+        KThreadPool::global().parallel_for(0, nrhs, cols, 64);
+    }
+}
+
+#endif /* KMatrixKernels_hpp */
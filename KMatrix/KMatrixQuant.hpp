@@ -0,0 +1,584 @@
+//
+//  KMatrixQuant.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixQuant_hpp
+#define KMatrixQuant_hpp
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include "KMatrix.hpp"
+#include "KMatrixAllocator.hpp"
+#include "KMatrixThreads.hpp"
+#include "KMatrixKernels.hpp"
+
+//Hand-written int8 kernels for x86, selected at run time from the CPU's features
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define KMATRIX_QUANT_X86
+#include <immintrin.h>
+#endif
+
+/*
+ Rows of the right matrix per block in quantizedMult(), reused across every row of the
+ left matrix while they are in cache.
+ */
+#define KMATRIX_QUANT_JB 64
+
+/*
+ Inner-dimension elements per int8 dot product in quantizedMult(). Each product of two int8
+ values is at most 128^2 in magnitude, so 65536 of them always fit in int32; blocks are
+ summed in int64.
+ */
+#define KMATRIX_QUANT_KB 65536
+
+/*
+ Which elements share a scale and zero point: the whole matrix, each row or each column.
+ */
+enum KQuantAxis {
+    KQUANT_PER_TENSOR,
+    KQUANT_PER_ROW,
+    KQUANT_PER_COL
+};
+
+/*
+ A matrix of 8- or 16-bit integers (Q = int8_t or int16_t) with affine quantization
+ parameters, representing the float values
+
+     x(r, c) = scale * (q(r, c) - zero_point)
+
+ where the scale and zero point are per matrix, per row or per column. Symmetric
+ quantization fixes the zero point at 0. Values are stored row-major in one cache-line
+ aligned buffer.
+
+ Products of the raw values are accumulated in accum_type: int32 for int8, over blocks of
+ at most KMATRIX_QUANT_KB along the inner dimension, and int64 for int16, since two int16
+ products already fill an int32. The blocks and the zero-point corrections are combined in
+ int64: with non-zero zero points each term (q_a - z_a)*(q_b - z_b) can reach 255^2, which
+ would overflow int32 for inner dimensions near 33000.
+ */
+template <class Q>
+class KQuantMatrix {
+public:
+
+    typedef typename std::conditional<sizeof(Q) == 1, int32_t, int64_t>::type accum_type;
+
+    //Initializers
+    KQuantMatrix();
+    KQuantMatrix(const KMatrix<float>& km, KQuantAxis axis=KQUANT_PER_ROW, bool symmetric=false);
+
+    void quantize(const KMatrix<float>& km, KQuantAxis axis=KQUANT_PER_ROW, bool symmetric=false);
+    KMatrix<float> dequantize() const;
+
+    //Access
+    Q get(int r, int c) const;
+    const Q* row(size_t r) const;
+    float scale(size_t idx) const;
+    int32_t zeroPoint(size_t idx) const;
+    KQuantAxis axis() const;
+
+    size_t rows() const;
+    size_t cols() const;
+
+private:
+
+    size_t param_index(size_t r, size_t c) const;
+
+    std::vector<Q, KMatrixAllocator<Q> > data;
+    std::vector<float> scales;
+    std::vector<int32_t> zeros;
+    KQuantAxis ax;
+    size_t nr;
+    size_t nc;
+
+    matrix_bounds_excep mat_bnd_ex;
+};
+
+template <class Q>
+KQuantMatrix<Q> quantize(const KMatrix<float>& km, KQuantAxis axis=KQUANT_PER_ROW, bool symmetric=false);
+
+template <class Q>
+KMatrix<float> dequantize(const KQuantMatrix<Q>& qm);
+
+template <class Q>
+KMatrix<float> quantizedMult(const KQuantMatrix<Q>& a, const KQuantMatrix<Q>& b);
+
+typedef KQuantMatrix<int8_t> KQuant8;
+typedef KQuantMatrix<int16_t> KQuant16;
+
+/*----------------------------------------------------------------
+-------------------------- INITIALIZERS --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to an empty (0x0) matrix.
+ */
+template <class Q>
+KQuantMatrix<Q>::KQuantMatrix() : data(KMatrixAllocator<Q>(KMATRIX_CACHE_LINE)), ax(KQUANT_PER_TENSOR), nr(0), nc(0){
+
+}
+
+/*
+ Quantizes 'km'. See quantize().
+ */
+template <class Q>
+KQuantMatrix<Q>::KQuantMatrix(const KMatrix<float>& km, KQuantAxis axis, bool symmetric) : data(KMatrixAllocator<Q>(KMATRIX_CACHE_LINE)), ax(axis), nr(0), nc(0){
+    quantize(km, axis, symmetric);
+}
+
+/*
+ Replaces the contents with the quantization of 'km'. Each group (the matrix, a row or a
+ column) is mapped linearly from [min, max] (widened to include 0, so zero is exact) onto
+ the full range of Q. Symmetric quantization maps [-max|x|, max|x|] onto [-Qmax, Qmax]
+ with a zero point of 0. Values are rounded to nearest.
+
+ km - matrix to quantize (either layout)
+ axis - elements sharing a scale and zero point
+ symmetric - use a zero point of 0
+
+ Void return
+ */
+template <class Q>
+void KQuantMatrix<Q>::quantize(const KMatrix<float>& km, KQuantAxis axis, bool symmetric){
+
+    KMatrix<float> src(km);
+    src.setLayout(KMAT_ROW_MAJOR);
+    const std::vector<KMatrix<float>::row_type>& sm = src.getMat();
+
+    nr = src.rows();
+    nc = src.cols();
+    ax = axis;
+    size_t groups = (axis == KQUANT_PER_ROW) ? nr : ((axis == KQUANT_PER_COL) ? nc : 1);
+
+    //Range of each group, always including zero
+    std::vector<float> lo(groups, 0.0f), hi(groups, 0.0f);
+    for (size_t r = 0 ; r < nr ; r++){
+        for (size_t c = 0 ; c < nc ; c++){
+            size_t g = param_index(r, c);
+            float x = sm[r][c];
+            if (x < lo[g]) lo[g] = x;
+            if (x > hi[g]) hi[g] = x;
+        }
+    }
+
+    const float qmin = (float)std::numeric_limits<Q>::min();
+    const float qmax = (float)std::numeric_limits<Q>::max();
+
+    scales.assign(groups, 1.0f);
+    zeros.assign(groups, 0);
+    for (size_t g = 0 ; g < groups ; g++){
+        if (symmetric){
+            float m = std::max(-lo[g], hi[g]);
+            if (m > 0) scales[g] = m/qmax;
+        }else{
+            if (hi[g] > lo[g]) scales[g] = (hi[g] - lo[g])/(qmax - qmin);
+            float z = std::nearbyint(qmin - lo[g]/scales[g]);
+            zeros[g] = (int32_t)std::min(std::max(z, qmin), qmax);
+        }
+    }
+
+    //Quantize, a row at a time across the thread pool
+    data.assign(nr*nc, Q(0));
+    auto rows = [&](size_t rlo, size_t rhi){
+        for (size_t r = rlo ; r < rhi ; r++){
+            const float* x = sm[r].data();
+            Q* q = data.data() + r*nc;
+            for (size_t c = 0 ; c < nc ; c++){
+                size_t g = param_index(r, c);
+                float v = std::nearbyint(x[c]/scales[g]) + (float)zeros[g];
+                q[c] = (Q)std::min(std::max(v, qmin), qmax);
+            }
+        }
+    };
+
+    if (nr*nc < KMATRIX_ELEMENTWISE_PARALLEL){
+        rows(0, nr);
+    }else{
+        KThreadPool::global().parallel_for(0, nr, rows);
+    }
+}
+
+/*
+ Converts back to float, scale*(q - zero_point) for each element.
+
+ Returns the row-major float matrix
+ */
+template <class Q>
+KMatrix<float> KQuantMatrix<Q>::dequantize() const{
+
+    KMatrix<float> out((int)nr, (int)nc);
+    std::vector<KMatrix<float>::row_type>& om = out.getMat();
+
+    for (size_t r = 0 ; r < nr ; r++){
+        const Q* q = data.data() + r*nc;
+        float* x = om[r].data();
+        for (size_t c = 0 ; c < nc ; c++){
+            size_t g = param_index(r, c);
+            x[c] = scales[g]*(float)((int32_t)q[c] - zeros[g]);
+        }
+    }
+
+    return out;
+}
+
+/*----------------------------------------------------------------
+----------------------------- ACCESS -----------------------------
+----------------------------------------------------------------*/
+
+template <class Q>
+Q KQuantMatrix<Q>::get(int r, int c) const{
+
+    if (r < 0 || c < 0 || (size_t)r >= nr || (size_t)c >= nc){
+        throw mat_bnd_ex;
+    }
+
+    return data[r*nc + c];
+}
+
+/*
+ Returns a pointer to the 'cols()' quantized values of row 'r'.
+ */
+template <class Q>
+const Q* KQuantMatrix<Q>::row(size_t r) const{
+    return data.data() + r*nc;
+}
+
+/*
+ Returns the scale of group 'idx' (0 for per-tensor, otherwise the row or column index).
+ */
+template <class Q>
+float KQuantMatrix<Q>::scale(size_t idx) const{
+    return scales[idx];
+}
+
+/*
+ Returns the zero point of group 'idx' (0 for per-tensor, otherwise the row or column index).
+ */
+template <class Q>
+int32_t KQuantMatrix<Q>::zeroPoint(size_t idx) const{
+    return zeros[idx];
+}
+
+template <class Q>
+KQuantAxis KQuantMatrix<Q>::axis() const{
+    return ax;
+}
+
+template <class Q>
+size_t KQuantMatrix<Q>::rows() const{
+    return nr;
+}
+
+template <class Q>
+size_t KQuantMatrix<Q>::cols() const{
+    return nc;
+}
+
+/*
+ Returns the index of the scale and zero point used by element (r, c).
+ */
+template <class Q>
+size_t KQuantMatrix<Q>::param_index(size_t r, size_t c) const{
+    if (ax == KQUANT_PER_ROW) return r;
+    if (ax == KQUANT_PER_COL) return c;
+    return 0;
+}
+
+/*----------------------------------------------------------------
+---------------------------- KERNELS -----------------------------
+----------------------------------------------------------------*/
+
+typedef int32_t (*kmatrix_dot_s8_fn)(const int8_t*, const int8_t*, size_t);
+
+/*
+ Dot product of two int8 vectors of length 'n' (below 131072, so the sum fits in int32).
+ A plain widening loop, used where no vector kernel below is available.
+
+ Returns the sum of a[p]*b[p]
+ */
+inline int32_t kmatrix_dot_s8_scalar(const int8_t* a, const int8_t* b, size_t n){
+
+    int32_t s = 0;
+    for (size_t p = 0 ; p < n ; p++){
+        s += (int32_t)a[p]*(int32_t)b[p];
+    }
+
+    return s;
+}
+
+#ifdef KMATRIX_QUANT_X86
+
+/*
+ The x86 multiply-add instructions take one unsigned and one signed byte operand, so 'a' is
+ offset by 128 (its sign bit flipped) and 128*sum(b) is subtracted at the end. Lanes may
+ wrap while accumulating, but the final sum is exact since it fits in int32 (two's
+ complement arithmetic is modular).
+ */
+
+/*
+ AVX2 kernel: vpmaddubsw multiplies unsigned by signed bytes and adds pairs into int16
+ with saturation, which a full unsigned byte times -128 would hit (2*255*128 > 32767).
+ The offset 'a' is therefore split into nibbles (at most 15*128*2 per pair), each summed
+ into int32 with vpmaddwd, and recombined as lo + 16*hi.
+ */
+__attribute__((target("avx2")))
+inline int32_t kmatrix_dot_s8_avx2(const int8_t* a, const int8_t* b, size_t n){
+
+    const __m256i flip = _mm256_set1_epi8((char)0x80);
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    const __m256i ones8 = _mm256_set1_epi8(1);
+    const __m256i ones16 = _mm256_set1_epi16(1);
+    __m256i lo = _mm256_setzero_si256();
+    __m256i hi = _mm256_setzero_si256();
+    __m256i sb = _mm256_setzero_si256();
+
+    size_t p = 0;
+    for ( ; p + 32 <= n ; p += 32){
+        __m256i va = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + p)), flip);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + p));
+        __m256i al = _mm256_and_si256(va, nib);
+        __m256i ah = _mm256_and_si256(_mm256_srli_epi16(va, 4), nib);
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_maddubs_epi16(al, vb), ones16));
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_maddubs_epi16(ah, vb), ones16));
+        sb = _mm256_add_epi32(sb, _mm256_madd_epi16(_mm256_maddubs_epi16(ones8, vb), ones16));
+    }
+
+    __m256i t = _mm256_sub_epi32(_mm256_add_epi32(lo, _mm256_slli_epi32(hi, 4)), _mm256_slli_epi32(sb, 7));
+    __m128i h = _mm_add_epi32(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0x4E));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0xB1));
+
+    return _mm_cvtsi128_si32(h) + kmatrix_dot_s8_scalar(a + p, b + p, n - p);
+}
+
+/*
+ AVX-VNNI kernel: vpdpbusd multiplies unsigned by signed bytes and adds groups of four
+ straight into int32, without the int16 saturation of vpmaddubsw.
+ */
+__attribute__((target("avx2,avxvnni")))
+inline int32_t kmatrix_dot_s8_avxvnni(const int8_t* a, const int8_t* b, size_t n){
+
+    const __m256i flip = _mm256_set1_epi8((char)0x80);
+    const __m256i ones8 = _mm256_set1_epi8(1);
+    __m256i acc = _mm256_setzero_si256();
+    __m256i sb = _mm256_setzero_si256();
+
+    size_t p = 0;
+    for ( ; p + 32 <= n ; p += 32){
+        __m256i va = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + p)), flip);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + p));
+        acc = _mm256_dpbusd_avx_epi32(acc, va, vb);
+        sb = _mm256_dpbusd_avx_epi32(sb, ones8, vb);
+    }
+
+    __m256i t = _mm256_sub_epi32(acc, _mm256_slli_epi32(sb, 7));
+    __m128i h = _mm_add_epi32(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0x4E));
+    h = _mm_add_epi32(h, _mm_shuffle_epi32(h, 0xB1));
+
+    return _mm_cvtsi128_si32(h) + kmatrix_dot_s8_scalar(a + p, b + p, n - p);
+}
+
+/*
+ AVX-512 VNNI kernel: as the AVX-VNNI one, 64 bytes at a time.
+ */
+__attribute__((target("avx512f,avx512vnni")))
+inline int32_t kmatrix_dot_s8_avx512vnni(const int8_t* a, const int8_t* b, size_t n){
+
+    const __m512i flip = _mm512_set1_epi32((int)0x80808080);
+    const __m512i ones8 = _mm512_set1_epi32(0x01010101);
+    __m512i acc = _mm512_setzero_si512();
+    __m512i sb = _mm512_setzero_si512();
+
+    size_t p = 0;
+    for ( ; p + 64 <= n ; p += 64){
+        __m512i va = _mm512_xor_si512(_mm512_loadu_si512((const void*)(a + p)), flip);
+        __m512i vb = _mm512_loadu_si512((const void*)(b + p));
+        acc = _mm512_dpbusd_epi32(acc, va, vb);
+        sb = _mm512_dpbusd_epi32(sb, ones8, vb);
+    }
+
+    //Summed through memory: GCC's _mm512_slli_epi32() and _mm512_reduce_add_epi32() raise
+    //spurious -Wuninitialized warnings
+    alignas(64) int32_t lanes[32];
+    _mm512_store_si512((void*)lanes, acc);
+    _mm512_store_si512((void*)(lanes + 16), sb);
+    int32_t s = 0;
+    for (int l = 0 ; l < 16 ; l++){
+        s += lanes[l] - 128*lanes[16 + l];
+    }
+
+    return s + kmatrix_dot_s8_scalar(a + p, b + p, n - p);
+}
+
+#endif
+
+/*
+ Picks the fastest int8 dot product kernel the CPU supports: AVX-512 VNNI, AVX-VNNI, AVX2,
+ or the scalar loop. Checked once; the CPU's features cannot change while running.
+
+ Returns the kernel
+ */
+inline kmatrix_dot_s8_fn kmatrix_dot_s8_kernel(){
+
+    static const kmatrix_dot_s8_fn fn = [](){
+#ifdef KMATRIX_QUANT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512vnni")) return &kmatrix_dot_s8_avx512vnni;
+        if (__builtin_cpu_supports("avxvnni")) return &kmatrix_dot_s8_avxvnni;
+        if (__builtin_cpu_supports("avx2")) return &kmatrix_dot_s8_avx2;
+#endif
+        return &kmatrix_dot_s8_scalar;
+    }();
+
+    return fn;
+}
+
+/*
+ Dot product of two quantized vectors of length 'n', exact in int64. int8 is summed in
+ blocks of KMATRIX_QUANT_KB by the kernel chosen by kmatrix_dot_s8_kernel(); int16 by a
+ widening loop.
+
+ Returns the sum of a[p]*b[p]
+ */
+template <class Q>
+int64_t kmatrix_quant_dot(const Q* a, const Q* b, size_t n){
+
+    int64_t s = 0;
+    for (size_t p = 0 ; p < n ; p++){
+        s += (int64_t)a[p]*(int64_t)b[p];
+    }
+
+    return s;
+}
+
+inline int64_t kmatrix_quant_dot(const int8_t* a, const int8_t* b, size_t n){
+
+    kmatrix_dot_s8_fn dot = kmatrix_dot_s8_kernel();
+    int64_t s = 0;
+    for (size_t p = 0 ; p < n ; p += KMATRIX_QUANT_KB){
+        s += dot(a + p, b + p, (n - p < KMATRIX_QUANT_KB) ? n - p : KMATRIX_QUANT_KB);
+    }
+
+    return s;
+}
+
+/*----------------------------------------------------------------
+--------------------------- FUNCTIONS ----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Quantizes a float matrix to Q (int8_t or int16_t).
+
+ km - matrix to quantize
+ axis - elements sharing a scale and zero point
+ symmetric - use a zero point of 0
+
+ Returns the quantized matrix
+ */
+template <class Q>
+KQuantMatrix<Q> quantize(const KMatrix<float>& km, KQuantAxis axis, bool symmetric){
+    return KQuantMatrix<Q>(km, axis, symmetric);
+}
+
+/*
+ Returns the float matrix represented by 'qm'.
+ */
+template <class Q>
+KMatrix<float> dequantize(const KQuantMatrix<Q>& qm){
+    return qm.dequantize();
+}
+
+/*
+ Multiplies two quantized matrices, returning the float product. The integer products are
+ summed exactly (see KQuantMatrix) and the zero points are removed afterwards in int64 with
+ the row sums of 'a' and column sums of 'b':
+
+     C(i, j) = sa_i*sb_j*( sum_p qa_ip*qb_pj - zb_j*sum_p qa_ip - za_i*sum_p qb_pj + k*za_i*zb_j )
+
+ so the only rounding is in the final conversion to float. That factorization needs the
+ scale to be constant along the inner dimension, so 'a' must be quantized per row or per
+ tensor and 'b' per column or per tensor; otherwise matrix_quantization_exception is thrown.
+ Throws matrix_multiplication_exception if the sizes do not match.
+
+ 'b' is transposed once so every element of C is a dot product of two contiguous integer
+ rows. For int8 that is a hand-written kernel chosen at run time from the CPU's features
+ (vpdpbusd with AVX-512 VNNI or AVX-VNNI, vpmaddubsw with AVX2, otherwise a scalar loop); for
+ int16 a widening loop the compiler vectorizes. Rows of C are split across the thread pool.
+
+ a - left matrix (m x k)
+ b - right matrix (k x n)
+
+ Returns the product (m x n)
+ */
+template <class Q>
+KMatrix<float> quantizedMult(const KQuantMatrix<Q>& a, const KQuantMatrix<Q>& b){
+
+    if (a.cols() != b.rows()){
+        throw matrix_multiplication_exception();
+    }
+    if (a.axis() == KQUANT_PER_COL || b.axis() == KQUANT_PER_ROW){
+        throw matrix_quantization_exception();
+    }
+
+    size_t m = a.rows(), k = a.cols(), n = b.cols();
+
+    //Transpose b so its columns are contiguous, and take its column sums
+    std::vector<Q, KMatrixAllocator<Q> > bt(n*k, Q(0), KMatrixAllocator<Q>(KMATRIX_CACHE_LINE));
+    std::vector<int64_t> bsum(n, 0);
+    for (size_t p = 0 ; p < k ; p++){
+        const Q* brow = b.row(p);
+        for (size_t j = 0 ; j < n ; j++){
+            bt[j*k + p] = brow[j];
+            bsum[j] += brow[j];
+        }
+    }
+
+    KMatrix<float> out((int)m, (int)n);
+    std::vector<KMatrix<float>::row_type>& om = out.getMat();
+
+    auto rows = [&](size_t lo, size_t hi){
+
+        std::vector<int64_t> acc(n);
+
+        for (size_t i = lo ; i < hi ; i++){
+            const Q* arow = a.row(i);
+            int64_t asum = 0;
+            for (size_t p = 0 ; p < k ; p++) asum += arow[p];
+
+            const int64_t za = a.zeroPoint((a.axis() == KQUANT_PER_ROW) ? i : 0);
+            const float sa = a.scale((a.axis() == KQUANT_PER_ROW) ? i : 0);
+
+            for (size_t jj = 0 ; jj < n ; jj += KMATRIX_QUANT_JB){
+                size_t jend = (jj + KMATRIX_QUANT_JB < n) ? jj + KMATRIX_QUANT_JB : n;
+                for (size_t j = jj ; j < jend ; j++){
+                    acc[j] = kmatrix_quant_dot(arow, bt.data() + j*k, k);
+                }
+            }
+
+            float* crow = om[i].data();
+            for (size_t j = 0 ; j < n ; j++){
+                size_t g = (b.axis() == KQUANT_PER_COL) ? j : 0;
+                const int64_t zb = b.zeroPoint(g);
+                int64_t v = acc[j] - zb*asum - za*bsum[j] + (int64_t)k*za*zb;
+                crow[j] = sa*b.scale(g)*(float)v;
+            }
+        }
+    };
+
+    if ((double)m*k*n < KMATRIX_GEMM_PARALLEL_FLOPS){
+        rows(0, m);
+    }else{
+        KThreadPool::global().parallel_for(0, m, rows, 4);
+    }
+
+    return out;
+}
+
+#endif /* KMatrixQuant_hpp */
@@ -0,0 +1,203 @@
+//
+//  KMatrixStats.cpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#include "KMatrixStats.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+    struct OpCounters {
+        std::atomic<unsigned long long> calls;
+        std::atomic<unsigned long long> flops;
+        std::atomic<unsigned long long> bytes;
+        std::atomic<unsigned long long> nanoseconds;
+    };
+
+    //Zero-initialized (static storage), so usable before any constructor runs
+    OpCounters counters[KOP_COUNT];
+
+    const char* op_names[KOP_COUNT] = {
+        "matrixMult",
+        "strassenMult",
+        "elementMult",
+        "elementwise",
+        "scalar",
+        "compare",
+        "sin",
+        "cos",
+        "tan",
+        "asin",
+        "acos",
+        "atan",
+        "parse",
+        "to_string",
+        "max",
+        "min",
+        "avg",
+        "stdev",
+        "inverse",
+        "determinant",
+        "allocate"
+    };
+
+    /*
+     Writes one Prometheus counter family, one sample per operation.
+     */
+    void prometheus_family(std::ostringstream& out, const std::vector<KMatrixOpStats>& stats, std::string metric, std::string help, int field){
+        out << "# HELP " << metric << " " << help << "\n";
+        out << "# TYPE " << metric << " counter\n";
+        for (size_t i = 0 ; i < stats.size() ; i++){
+            out << metric << "{op=\"" << stats[i].name << "\"} ";
+            switch (field){
+                case 0: out << stats[i].calls; break;
+                case 1: out << stats[i].flops; break;
+                case 2: out << stats[i].bytes; break;
+                default: out << (stats[i].nanoseconds / 1e9); break;
+            }
+            out << "\n";
+        }
+    }
+
+}
+
+/*
+ Adds one call to the counters of 'op'.
+
+ op - operation
+ flops - operations performed by the call
+ bytes - bytes allocated by the call
+ nanoseconds - wall time of the call
+
+ Void return
+ */
+void kmatrix_stats_record(KMatrixOp op, unsigned long long flops, unsigned long long bytes, unsigned long long nanoseconds){
+    if (op < 0 || op >= KOP_COUNT) return;
+    counters[op].calls.fetch_add(1, std::memory_order_relaxed);
+    counters[op].flops.fetch_add(flops, std::memory_order_relaxed);
+    counters[op].bytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters[op].nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+/*
+ Reads the counters of every operation. Each counter is read atomically, but updates
+ running concurrently may be seen in some counters of an operation and not others.
+
+ Returns one entry per KMatrixOp, in enum order
+ */
+std::vector<KMatrixOpStats> kmatrix_stats_snapshot(){
+    std::vector<KMatrixOpStats> out(KOP_COUNT);
+    for (int i = 0 ; i < KOP_COUNT ; i++){
+        out[i].name = op_names[i];
+        out[i].calls = counters[i].calls.load(std::memory_order_relaxed);
+        out[i].flops = counters[i].flops.load(std::memory_order_relaxed);
+        out[i].bytes = counters[i].bytes.load(std::memory_order_relaxed);
+        out[i].nanoseconds = counters[i].nanoseconds.load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+/*
+ Sets every counter back to zero.
+
+ Void return
+ */
+void kmatrix_stats_reset(){
+    for (int i = 0 ; i < KOP_COUNT ; i++){
+        counters[i].calls.store(0, std::memory_order_relaxed);
+        counters[i].flops.store(0, std::memory_order_relaxed);
+        counters[i].bytes.store(0, std::memory_order_relaxed);
+        counters[i].nanoseconds.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*
+ Returns true if the library was compiled with KMATRIX_INSTRUMENT
+ */
+bool kmatrix_stats_enabled(){
+#ifdef KMATRIX_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ Formats a snapshot as a JSON object keyed by operation name, for example
+ {"matrixMult": {"calls": 2, "flops": 4000, "bytes": 8000, "seconds": 0.0001}, ...}
+
+ Returns the JSON text
+ */
+std::string kmatrix_stats_json(){
+
+    std::vector<KMatrixOpStats> stats = kmatrix_stats_snapshot();
+
+    std::ostringstream out;
+    out << "{\n";
+    for (size_t i = 0 ; i < stats.size() ; i++){
+        out << "  \"" << stats[i].name << "\": {\"calls\": " << stats[i].calls << ", \"flops\": " << stats[i].flops << ", \"bytes\": " << stats[i].bytes << ", \"seconds\": " << (stats[i].nanoseconds / 1e9) << "}";
+        out << ((i+1 < stats.size()) ? ",\n" : "\n");
+    }
+    out << "}\n";
+
+    return out.str();
+}
+
+/*
+ Formats a snapshot in the Prometheus text exposition format, as four counter families
+ (kmatrix_op_calls_total, kmatrix_op_flops_total, kmatrix_op_bytes_total and
+ kmatrix_op_seconds_total) labelled by operation.
+
+ Returns the exposition text
+ */
+std::string kmatrix_stats_prometheus(){
+
+    std::vector<KMatrixOpStats> stats = kmatrix_stats_snapshot();
+
+    std::ostringstream out;
+    prometheus_family(out, stats, "kmatrix_op_calls_total", "Calls to each KMatrix operation.", 0);
+    prometheus_family(out, stats, "kmatrix_op_flops_total", "Arithmetic operations performed by each KMatrix operation.", 1);
+    prometheus_family(out, stats, "kmatrix_op_bytes_total", "Bytes allocated by each KMatrix operation.", 2);
+    prometheus_family(out, stats, "kmatrix_op_seconds_total", "Wall time spent in each KMatrix operation.", 3);
+
+    return out.str();
+}
+
+/*
+ Writes a snapshot to a file. The text is written to a temporary file next to 'filename'
+ and renamed over it, so a scraper (such as a textfile collector) never reads a partial dump.
+
+ filename - file to write
+ prometheus - write the Prometheus text format instead of JSON
+
+ Returns true if the file was written
+ */
+bool kmatrix_stats_dump(std::string filename, bool prometheus){
+
+    std::string text = prometheus ? kmatrix_stats_prometheus() : kmatrix_stats_json();
+    std::string temp = filename + ".tmp";
+
+    {
+        std::ofstream file(temp.c_str(), std::ios::out | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file << text;
+        file.close();
+        if (file.fail()){
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temp.c_str(), filename.c_str()) != 0){
+        std::remove(temp.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,119 @@
+//
+//  KMatrixStats.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixStats_hpp
+#define KMatrixStats_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ Optional instrumentation. When KMATRIX_INSTRUMENT is defined (CMake option
+ KMATRIX_INSTRUMENT, which must match between the library and the code using it), each
+ public operation records its call count, the FLOPs it performed, the bytes of storage
+ it allocated for its result and its wall time. Without the define the KMATRIX_STAT_*
+ macros expand to nothing, their arguments are never evaluated, and the counters stay zero.
+
+ Counters are relaxed atomics, so they may be updated from any thread. Timings are
+ inclusive: an operation that calls another (strassenMult finishing with matrixMult, or
+ stdev calling avg) is counted under both.
+ */
+
+enum KMatrixOp {
+    KOP_MATRIX_MULT,
+    KOP_STRASSEN_MULT,
+    KOP_ELEMENT_MULT,
+    KOP_ELEMENTWISE,
+    KOP_SCALAR,
+    KOP_COMPARE,
+    KOP_SIN,
+    KOP_COS,
+    KOP_TAN,
+    KOP_ASIN,
+    KOP_ACOS,
+    KOP_ATAN,
+    KOP_PARSE,
+    KOP_TO_STRING,
+    KOP_MAX,
+    KOP_MIN,
+    KOP_AVG,
+    KOP_STDEV,
+    KOP_INVERSE,
+    KOP_DETERMINANT,
+    KOP_ALLOCATE,
+    KOP_COUNT
+};
+
+/*
+ Counters for one operation, as returned by kmatrix_stats_snapshot().
+
+ name - operation name used in the text dumps
+ calls - number of calls
+ flops - floating point (or integer) operations performed
+ bytes - bytes allocated for results (for KOP_ALLOCATE, by KMatrixAllocator)
+ nanoseconds - total wall time
+ */
+struct KMatrixOpStats {
+    std::string name;
+    unsigned long long calls;
+    unsigned long long flops;
+    unsigned long long bytes;
+    unsigned long long nanoseconds;
+};
+
+void kmatrix_stats_record(KMatrixOp op, unsigned long long flops, unsigned long long bytes, unsigned long long nanoseconds);
+std::vector<KMatrixOpStats> kmatrix_stats_snapshot();
+void kmatrix_stats_reset();
+bool kmatrix_stats_enabled();
+std::string kmatrix_stats_json();
+std::string kmatrix_stats_prometheus();
+bool kmatrix_stats_dump(std::string filename, bool prometheus = false);
+
+/*
+ Times the enclosing scope and records it against 'op' when destroyed. FLOPs and bytes
+ known only part way through the operation can be added with add().
+ */
+class KMatrixOpTimer {
+public:
+
+    KMatrixOpTimer(KMatrixOp op, unsigned long long flops = 0, unsigned long long bytes = 0) : op(op), flops(flops), bytes(bytes), start(std::chrono::steady_clock::now()){}
+
+    ~KMatrixOpTimer(){
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        kmatrix_stats_record(op, flops, bytes, (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    void add(unsigned long long more_flops, unsigned long long more_bytes){
+        flops += more_flops;
+        bytes += more_bytes;
+    }
+
+    KMatrixOpTimer(const KMatrixOpTimer&) = delete;
+    KMatrixOpTimer& operator=(const KMatrixOpTimer&) = delete;
+
+private:
+    KMatrixOp op;
+    unsigned long long flops;
+    unsigned long long bytes;
+    std::chrono::steady_clock::time_point start;
+};
+
+#ifdef KMATRIX_INSTRUMENT
+#define KMATRIX_STAT_SCOPE(op, flops, bytes) KMatrixOpTimer kmatrix_op_timer((op), (unsigned long long)(flops), (unsigned long long)(bytes))
+#define KMATRIX_STAT_ADD(flops, bytes) kmatrix_op_timer.add((unsigned long long)(flops), (unsigned long long)(bytes))
+#define KMATRIX_STAT_COUNT(op, flops, bytes) kmatrix_stats_record((op), (unsigned long long)(flops), (unsigned long long)(bytes), 0)
+#else
+#define KMATRIX_STAT_SCOPE(op, flops, bytes)
+#define KMATRIX_STAT_ADD(flops, bytes)
+#define KMATRIX_STAT_COUNT(op, flops, bytes)
+#endif
+
+#endif /* KMatrixStats_hpp */
@@ -0,0 +1,367 @@
+//
+//  KMatrixStorage.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixStorage_hpp
+#define KMatrixStorage_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "KMatrixThreads.hpp"
+
+//Smallest element count for which element-wise operations and fills split rows across the
+//thread pool
+#define KMATRIX_ELEMENTWISE_PARALLEL 65536
+
+/*
+ Storage lines (rows, or columns of a column-major matrix) of a KMatrix, held behind a
+ reference-counted pointer so that copies can share them.
+
+ By default every copy is a deep copy, as with a plain std::vector. With copy-on-write
+ enabled (setCopyOnWrite()), copies share the lines and are themselves copy-on-write; the
+ first write through either copy then gives it a private copy first. Reads never copy.
+ Which accesses count as writes is decided by constness: the non-const operator[], begin(),
+ end(), write() and every resizing function detach, the const ones and read() do not. Code
+ that only reads a non-const matrix should go through read() to avoid an unneeded copy.
+
+ The reference count is atomic, so copies sharing lines can be read, written (detaching)
+ and destroyed from different threads. As for any container, one KMatrixStorage object
+ must not be written by two threads at once. A reference or pointer into shared lines
+ obtained from a non-const access is only private until the storage is next copied; after
+ that, writes through it are seen by the copy as well.
+
+ Every non-const access also advances version(), which KMatrix uses to tell whether values
+ it has cached (see KMatrixCache) still describe the lines. The same caveat applies: a write
+ through a reference kept from an earlier access does not advance it.
+ */
+template <class R>
+class KMatrixStorage {
+public:
+
+    typedef std::vector<R> lines_type;
+    typedef typename lines_type::size_type size_type;
+    typedef typename lines_type::iterator iterator;
+    typedef typename lines_type::const_iterator const_iterator;
+
+    KMatrixStorage();
+    KMatrixStorage(const KMatrixStorage& other);
+    KMatrixStorage& operator=(const KMatrixStorage& other);
+
+    size_type size() const;
+    bool empty() const;
+    R& operator[](size_type idx);
+    const R& operator[](size_type idx) const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    void clear();
+    void resize(size_type n);
+    void push_back(const R& line);
+    void push_back(R&& line);
+    void assign(lines_type&& lines);
+    void swap(KMatrixStorage& other);
+
+    lines_type& write();
+    const lines_type& read() const;
+
+    void setCopyOnWrite(bool enable);
+    bool copyOnWrite() const;
+    bool shared() const;
+    unsigned long long version() const;
+
+private:
+
+    static std::shared_ptr<lines_type> copy_lines(const lines_type& src);
+    void detach();
+    void advance();
+    void touch();
+
+    std::shared_ptr<lines_type> data;
+    bool cow;
+    std::atomic<unsigned long long> ver;
+};
+
+/*----------------------------------------------------------------
+------------------------- KMATRIXSTORAGE -------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to no lines, with copy-on-write disabled.
+ */
+template <class R>
+KMatrixStorage<R>::KMatrixStorage() : data(std::make_shared<lines_type>()), cow(false), ver(0){
+
+}
+
+/*
+ Copies 'other', sharing its lines if it is copy-on-write. The copy has the same mode and
+ version.
+ */
+template <class R>
+KMatrixStorage<R>::KMatrixStorage(const KMatrixStorage& other) : data(other.cow ? other.data : copy_lines(*other.data)), cow(other.cow), ver(other.version()){
+
+}
+
+/*
+ Makes this a copy of 'other' (see the copy constructor), including its mode. The version
+ moves past both this storage's and 'other's, so it differs from any this had before.
+ */
+template <class R>
+KMatrixStorage<R>& KMatrixStorage<R>::operator=(const KMatrixStorage& other){
+
+    if (this != &other){
+        data = other.cow ? other.data : copy_lines(*other.data);
+        cow = other.cow;
+        unsigned long long v = (version() > other.version()) ? version() : other.version();
+        ver.store(v + 1, std::memory_order_relaxed);
+    }
+
+    return *this;
+}
+
+template <class R>
+typename KMatrixStorage<R>::size_type KMatrixStorage<R>::size() const{
+    return data->size();
+}
+
+template <class R>
+bool KMatrixStorage<R>::empty() const{
+    return data->empty();
+}
+
+template <class R>
+R& KMatrixStorage<R>::operator[](size_type idx){
+    touch();
+    return (*data)[idx];
+}
+
+template <class R>
+const R& KMatrixStorage<R>::operator[](size_type idx) const{
+    return (*data)[idx];
+}
+
+template <class R>
+typename KMatrixStorage<R>::iterator KMatrixStorage<R>::begin(){
+    touch();
+    return data->begin();
+}
+
+template <class R>
+typename KMatrixStorage<R>::iterator KMatrixStorage<R>::end(){
+    touch();
+    return data->end();
+}
+
+template <class R>
+typename KMatrixStorage<R>::const_iterator KMatrixStorage<R>::begin() const{
+    return data->begin();
+}
+
+template <class R>
+typename KMatrixStorage<R>::const_iterator KMatrixStorage<R>::end() const{
+    return data->end();
+}
+
+/*
+ Removes every line. Shared lines are released rather than copied.
+
+ Void return
+ */
+template <class R>
+void KMatrixStorage<R>::clear(){
+
+    advance();
+    if (shared()){
+        data = std::make_shared<lines_type>();
+        return;
+    }
+
+    data->clear();
+}
+
+template <class R>
+void KMatrixStorage<R>::resize(size_type n){
+    touch();
+    data->resize(n);
+}
+
+template <class R>
+void KMatrixStorage<R>::push_back(const R& line){
+    touch();
+    data->push_back(line);
+}
+
+template <class R>
+void KMatrixStorage<R>::push_back(R&& line){
+    touch();
+    data->push_back(std::move(line));
+}
+
+/*
+ Replaces the lines with 'lines'. Shared lines are released rather than copied.
+
+ Void return
+ */
+template <class R>
+void KMatrixStorage<R>::assign(lines_type&& lines){
+
+    advance();
+    if (shared()){
+        data = std::make_shared<lines_type>(std::move(lines));
+        return;
+    }
+
+    *data = std::move(lines);
+}
+
+/*
+ Exchanges lines, and their versions, with 'other'. Each storage keeps its own mode, so a
+ storage without copy-on-write that receives shared lines makes a private copy of them.
+
+ Void return
+ */
+template <class R>
+void KMatrixStorage<R>::swap(KMatrixStorage& other){
+
+    data.swap(other.data);
+    unsigned long long v = version();
+    ver.store(other.version(), std::memory_order_relaxed);
+    other.ver.store(v, std::memory_order_relaxed);
+
+    if (!cow && data.use_count() > 1) data = copy_lines(*data);
+    if (!other.cow && other.data.use_count() > 1) other.data = copy_lines(*other.data);
+}
+
+/*
+ Returns the lines for writing, making a private copy first if they are shared
+ */
+template <class R>
+typename KMatrixStorage<R>::lines_type& KMatrixStorage<R>::write(){
+    touch();
+    return *data;
+}
+
+/*
+ Returns the lines for reading. Never copies.
+ */
+template <class R>
+const typename KMatrixStorage<R>::lines_type& KMatrixStorage<R>::read() const{
+    return *data;
+}
+
+/*
+ Enables or disables copy-on-write. Disabling it makes a private copy of shared lines.
+
+ enable - true to share lines between copies
+
+ Void return
+ */
+template <class R>
+void KMatrixStorage<R>::setCopyOnWrite(bool enable){
+
+    if (!enable && shared()){
+        data = copy_lines(*data);
+    }
+
+    cow = enable;
+}
+
+template <class R>
+bool KMatrixStorage<R>::copyOnWrite() const{
+    return cow;
+}
+
+/*
+ Returns true if the lines are currently shared with another copy
+ */
+template <class R>
+bool KMatrixStorage<R>::shared() const{
+    return data.use_count() > 1;
+}
+
+/*
+ Returns the version, which changes with every non-const access
+ */
+template <class R>
+unsigned long long KMatrixStorage<R>::version() const{
+    return ver.load(std::memory_order_relaxed);
+}
+
+/*
+ Deep copies 'src'. Each line keeps its allocator (and so its alignment). Large storage is
+ copied in parallel.
+ */
+template <class R>
+std::shared_ptr<typename KMatrixStorage<R>::lines_type> KMatrixStorage<R>::copy_lines(const lines_type& src){
+
+    size_t lines = src.size();
+    size_t len = (lines > 0) ? src[0].size() : 0;
+
+    std::shared_ptr<lines_type> out = std::make_shared<lines_type>(lines);
+    lines_type& o = *out;
+    auto copy = [&](size_t lo, size_t hi){
+        for (size_t i = lo ; i < hi ; i++){
+            o[i] = src[i];
+        }
+    };
+
+    if (lines*len < KMATRIX_ELEMENTWISE_PARALLEL){
+        copy(0, lines);
+    }else{
+        KThreadPool::global().parallel_for(0, lines, copy);
+    }
+
+    return out;
+}
+
+/*
+ Makes the lines private before a write. When they are not shared, the acquire fence orders
+ this write after the last access of any copy that has just released them on another thread.
+ */
+template <class R>
+void KMatrixStorage<R>::detach(){
+
+    if (!cow) return;
+
+    if (data.use_count() > 1){
+        data = copy_lines(*data);
+    }else{
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+}
+
+/*
+ Advances the version. This is a plain load and store rather than an atomic increment, so
+ that writing different elements from several threads (as the kernels do) stays cheap;
+ concurrent writers may then advance it by one between them, which is all a cache check
+ needs.
+ */
+template <class R>
+void KMatrixStorage<R>::advance(){
+    ver.store(ver.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*
+ Prepares the lines for a write: makes them private and advances the version.
+ */
+template <class R>
+void KMatrixStorage<R>::touch(){
+    detach();
+    advance();
+}
+
+template <class R>
+void swap(KMatrixStorage<R>& first, KMatrixStorage<R>& second){
+    first.swap(second);
+}
+
+#endif /* KMatrixStorage_hpp */
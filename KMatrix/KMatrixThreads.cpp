@@ -0,0 +1,353 @@
+//
+//  KMatrixThreads.cpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#include "KMatrixThreads.hpp"
+#include "KMatrixHelpers.hpp"
+#include <cstdlib>
+#include <exception>
+
+namespace {
+    thread_local const KThreadPool* kmatrix_worker_pool = NULL; //Pool the calling thread works for
+    thread_local KTaskControl* kmatrix_current_task = NULL;
+}
+
+/*----------------------------------------------------------------
+-------------------------- TASK CONTROL --------------------------
+----------------------------------------------------------------*/
+
+/*
+ total_work - expected sum of the work passed to advance(), used to compute progress()
+ progress - called as the task advances (may be empty)
+ */
+KTaskControl::KTaskControl(double total_work, KProgressCallback progress) : stop(false), done(0), reported(0), callback(progress){
+    total = (total_work < 1) ? 1 : (unsigned long long)total_work;
+}
+
+/*
+ Asks the task to stop. It throws matrix_cancelled_exception at its next checkpoint.
+ */
+void KTaskControl::cancel(){
+    stop.store(true, std::memory_order_relaxed);
+}
+
+bool KTaskControl::cancelled() const{
+    return stop.load(std::memory_order_relaxed);
+}
+
+/*
+ Returns the fraction of the work completed, from 0 to 1
+ */
+double KTaskControl::progress() const{
+    double p = (double)done.load(std::memory_order_relaxed)/(double)total;
+    return (p > 1) ? 1 : p;
+}
+
+/*
+ Adds 'work' to the completed work and reports progress if it has grown by a percent.
+ Throws matrix_cancelled_exception if the task has been cancelled.
+
+ Void return
+ */
+void KTaskControl::advance(double work){
+
+    if (stop.load(std::memory_order_relaxed)){
+        throw matrix_cancelled_exception();
+    }
+    if (work <= 0) return;
+
+    unsigned long long now = done.fetch_add((unsigned long long)work, std::memory_order_relaxed) + (unsigned long long)work;
+    int percent = (now >= total) ? 100 : (int)(100.0*now/total);
+
+    //Only the thread that moves 'reported' forward calls back, so a slow callback never blocks the others
+    int last = reported.load(std::memory_order_relaxed);
+    if (!callback || percent >= 100 || percent <= last) return;
+    if (!reported.compare_exchange_strong(last, percent, std::memory_order_relaxed)) return;
+    std::unique_lock<std::mutex> lock(callback_mtx, std::try_to_lock);
+    if (lock.owns_lock()) callback(percent/100.0);
+}
+
+/*
+ Marks all the work as done and reports progress 1.
+
+ Void return
+ */
+void KTaskControl::finish(){
+
+    done.store(total, std::memory_order_relaxed);
+    reported.store(100, std::memory_order_relaxed);
+    if (callback){
+        std::lock_guard<std::mutex> lock(callback_mtx);
+        callback(1.0);
+    }
+}
+
+/*
+ Returns the task running on this thread, or NULL if none
+ */
+KTaskControl* KTaskControl::current(){
+    return kmatrix_current_task;
+}
+
+KTaskControl::Scope::Scope(KTaskControl* task) : previous(kmatrix_current_task){
+    kmatrix_current_task = task;
+}
+
+KTaskControl::Scope::~Scope(){
+    kmatrix_current_task = previous;
+}
+
+/*----------------------------------------------------------------
+-------------------------- THREAD POOL ---------------------------
+----------------------------------------------------------------*/
+
+/*
+ Starts the pool.
+
+ threads - number of worker threads. If 0, uses the number of hardware threads.
+ reserved - workers kept free of submit() tasks for parallel_for() (see the class)
+ */
+KThreadPool::KThreadPool(size_t threads, size_t reserved) : running_submitted(0), stopping(false){
+
+    if (threads == 0){
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0){
+        threads = 1;
+    }
+    max_submitted = (reserved < threads) ? threads - reserved : 1;
+
+    for (size_t i = 0 ; i < threads ; i++){
+        workers.push_back(std::unique_ptr<Worker>(new Worker));
+        workers[i]->busy = false;
+    }
+    for (size_t i = 0 ; i < threads ; i++){
+        workers[i]->thread = std::thread(&KThreadPool::worker_loop, this, i);
+    }
+}
+
+/*
+ Finishes all queued tasks, then joins the workers.
+ */
+KThreadPool::~KThreadPool(){
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (size_t i = 0 ; i < workers.size() ; i++){
+        workers[i]->thread.join();
+    }
+}
+
+/*
+ Returns the number of worker threads
+ */
+size_t KThreadPool::threads() const{
+    return workers.size();
+}
+
+/*
+ Returns the first index of chunk 'chunk' when [begin, end) is split into 'chunks' pieces
+ by parallel_for(). Passing chunk == chunks returns 'end'. Use this to reproduce the pool's
+ partitioning elsewhere (eg. to first-touch memory on the thread that will later use it).
+ */
+size_t KThreadPool::partition(size_t chunk, size_t chunks, size_t begin, size_t end, size_t grain){
+
+    if (chunk >= chunks) return end;
+
+    if (grain < 1) grain = 1;
+    size_t blocks = (end - begin + grain - 1)/grain;
+    size_t idx = begin + (blocks*chunk/chunks)*grain;
+
+    return (idx > end) ? end : idx;
+}
+
+/*
+ Returns the library-wide thread pool
+ */
+KThreadPool& KThreadPool::global(){
+
+    static KThreadPool pool([](){
+        const char* env = std::getenv("KMATRIX_NUM_THREADS");
+        return (env == NULL) ? (size_t)0 : (size_t)std::strtoul(env, NULL, 10);
+    }());
+
+    return pool;
+}
+
+/*
+ Returns the pool that runs the operations of KMatrixAsync.hpp. Each of its workers drives
+ one operation at a time, handing the parallel parts to global(), so its size bounds how
+ many run at once: KMATRIX_ASYNC_THREADS, or the value of the environment variable of the
+ same name if set. None of its workers are reserved, since nothing calls parallel_for() on
+ it.
+ */
+KThreadPool& KThreadPool::drivers(){
+
+    static KThreadPool pool([](){
+        const char* env = std::getenv("KMATRIX_ASYNC_THREADS");
+        size_t n = (env == NULL) ? (size_t)0 : (size_t)std::strtoul(env, NULL, 10);
+        return (n == 0) ? (size_t)KMATRIX_ASYNC_THREADS : n;
+    }(), 0);
+
+    return pool;
+}
+
+/*
+ Returns true if the calling thread is a worker of any KThreadPool
+ */
+bool KThreadPool::in_worker(){
+    return kmatrix_worker_pool != NULL;
+}
+
+/*
+ Returns true if the calling thread is one of this pool's workers
+ */
+bool KThreadPool::on_worker() const{
+    return kmatrix_worker_pool == this;
+}
+
+/*
+ Runs the oldest task queued with submit() on the calling thread, if there is one. A worker
+ that has to wait for submitted work calls this in a loop so that the work it waits for
+ cannot be stuck behind it in the queue. The task is not counted against the submitted task
+ limit, since the caller already occupies a worker.
+
+ Returns true if a task was run
+ */
+bool KThreadPool::run_queued(){
+
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (submitted.empty()) return false;
+        task = std::move(submitted.front());
+        submitted.pop_front();
+    }
+    task();
+
+    return true;
+}
+
+/*
+ Runs fn(i) for i in [0, chunks), queuing chunk 'i' on worker 'i', and waits for all of
+ them.
+ */
+void KThreadPool::run_chunks(size_t chunks, const std::function<void(size_t)>& fn){
+
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    size_t remaining = chunks;
+    std::exception_ptr error;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (size_t i = 0 ; i < chunks ; i++){
+            workers[i % workers.size()]->tasks.push_back([&, i](){
+                std::exception_ptr ex;
+                try{
+                    fn(i);
+                }catch(...){
+                    ex = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(done_mtx);
+                if (ex && !error) error = ex;
+                if (--remaining == 0) done_cv.notify_all();
+            });
+        }
+    }
+    cv.notify_all(); //Owners, and idle workers that may take chunks queued on busy ones
+
+    std::unique_lock<std::mutex> lock(done_mtx);
+    done_cv.wait(lock, [&](){ return remaining == 0; });
+
+    if (error) std::rethrow_exception(error);
+}
+
+void KThreadPool::enqueue_submitted(std::function<void()> task){
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        submitted.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+/*
+ Takes the next task for worker 'idx', in order of preference: a chunk queued on it, a
+ submitted task (if fewer than max_submitted are running), or the newest chunk queued on a
+ busy worker. Must be called with 'mtx' held.
+
+ Returns true if a task was taken
+ */
+bool KThreadPool::next_task(size_t idx, std::function<void()>& task, bool& from_submitted){
+
+    from_submitted = false;
+
+    std::deque<std::function<void()> >& own = workers[idx]->tasks;
+    if (!own.empty()){
+        task = std::move(own.front());
+        own.pop_front();
+        return true;
+    }
+
+    if (!submitted.empty() && running_submitted < max_submitted){
+        task = std::move(submitted.front());
+        submitted.pop_front();
+        running_submitted++;
+        from_submitted = true;
+        return true;
+    }
+
+    for (size_t j = 0 ; j < workers.size() ; j++){
+        Worker& other = *workers[j];
+        if (j != idx && other.busy && !other.tasks.empty()){
+            task = std::move(other.tasks.back());
+            other.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void KThreadPool::worker_loop(size_t idx){
+
+    kmatrix_worker_pool = this;
+    Worker& w = *workers[idx];
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true){
+
+        std::function<void()> task;
+        bool from_submitted;
+        if (!next_task(idx, task, from_submitted)){
+            if (stopping && submitted.empty()) return; //Nothing left to do
+            cv.wait(lock);
+            continue;
+        }
+
+        //Chunks still queued here can now be taken by idle workers
+        w.busy = true;
+        bool waiting = !w.tasks.empty();
+        lock.unlock();
+        if (waiting) cv.notify_all();
+
+        task();
+        task = nullptr; //Release captures outside the lock
+
+        lock.lock();
+        w.busy = false;
+        if (from_submitted){
+            running_submitted--;
+            if (!submitted.empty()) cv.notify_one();
+        }
+    }
+}
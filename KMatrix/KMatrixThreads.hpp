@@ -0,0 +1,225 @@
+//
+//  KMatrixThreads.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixThreads_hpp
+#define KMatrixThreads_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//Default number of operations from KMatrixAsync.hpp that run at once (see KThreadPool::drivers())
+#define KMATRIX_ASYNC_THREADS 2
+
+/*
+ Called with the fraction (0 to 1) of a task's work that has been completed.
+ */
+typedef std::function<void(double)> KProgressCallback;
+
+/*
+ Cancellation flag and progress counter for one asynchronous task (see KMatrixAsync.hpp).
+
+ The task installs its control on the thread running it with a Scope, and parallel_for()
+ and submit() carry it to the workers they hand work to. Long-running kernels call
+ kmatrix_checkpoint() with the work (approximate operation count) they have just finished;
+ that adds to the task's progress, calls its progress callback, and throws
+ matrix_cancelled_exception once cancel() has been called. Outside a task the checkpoints
+ do nothing.
+
+ Work passed to submit() may outlive the call, so submit() holds the control through a
+ shared_ptr. A control that is current when submit() is called must therefore be owned by
+ one (create it with std::make_shared), or submit() throws std::bad_weak_ptr.
+
+ Progress callbacks run on whichever thread reached the checkpoint. Calls are serialized
+ and made at most once per percent of progress, plus once with 1 when the task finishes.
+ */
+class KTaskControl : public std::enable_shared_from_this<KTaskControl> {
+public:
+
+    KTaskControl(double total_work = 0, KProgressCallback progress = KProgressCallback());
+
+    KTaskControl(const KTaskControl&) = delete;
+    KTaskControl& operator=(const KTaskControl&) = delete;
+
+    void cancel();
+    bool cancelled() const;
+    double progress() const;
+
+    void advance(double work);
+    void finish();
+
+    static KTaskControl* current();
+
+    /*
+     Makes 'task' the current task of this thread until destroyed, then restores the
+     previous one.
+     */
+    class Scope {
+    public:
+        Scope(KTaskControl* task);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        KTaskControl* previous;
+    };
+
+private:
+
+    std::atomic<bool> stop;
+    std::atomic<unsigned long long> done;
+    std::atomic<int> reported;
+    unsigned long long total;
+    KProgressCallback callback;
+    std::mutex callback_mtx;
+};
+
+/*
+ Records 'work' as finished for the task running on this thread, if any. Throws
+ matrix_cancelled_exception if the task has been cancelled.
+ */
+inline void kmatrix_checkpoint(double work){
+    KTaskControl* task = KTaskControl::current();
+    if (task != NULL) task->advance(work);
+}
+
+/*
+ Fixed-size pool of worker threads used by the parallel KMatrix routines.
+
+ parallel_for() splits a range into one contiguous chunk per worker and queues chunk 'i'
+ on worker 'i', so two loops over the same range are normally partitioned onto the same
+ threads (see partition()). If worker 'i' is busy with other work, an idle worker takes the
+ chunk instead of leaving it waiting. Calls made from inside a worker of the same pool run
+ serially on that worker instead of waiting on the pool.
+
+ submit() puts work on a separate pool-wide queue, which workers take from once their own
+ queue is empty. A number of workers (one by default) are reserved for parallel_for(): at
+ most threads() minus that many submitted tasks run at once (but always at least one), so
+ long submitted tasks never occupy every worker while chunks wait.
+
+ The library-wide pool is returned by global(). Its size is the number of hardware
+ threads, or the value of the KMATRIX_NUM_THREADS environment variable if set. drivers()
+ is a second, small pool that runs the asynchronous operations of KMatrixAsync.hpp, whose
+ parallel parts go to global().
+ */
+class KThreadPool {
+public:
+
+    KThreadPool(size_t threads = 0, size_t reserved = 1);
+    ~KThreadPool();
+
+    KThreadPool(const KThreadPool&) = delete;
+    KThreadPool& operator=(const KThreadPool&) = delete;
+
+    size_t threads() const;
+
+    template <class F>
+    void parallel_for(size_t begin, size_t end, F fn, size_t grain = 1);
+
+    template <class F>
+    std::future<decltype(std::declval<F&>()())> submit(F fn);
+
+    static size_t partition(size_t chunk, size_t chunks, size_t begin, size_t end, size_t grain);
+    static KThreadPool& global();
+    static KThreadPool& drivers();
+    static bool in_worker();
+    bool on_worker() const;
+    bool run_queued();
+
+private:
+
+    struct Worker {
+        std::thread thread;
+        std::deque<std::function<void()> > tasks; //parallel_for() chunks queued on this worker
+        bool busy;
+    };
+
+    void run_chunks(size_t chunks, const std::function<void(size_t)>& fn);
+    void enqueue_submitted(std::function<void()> task);
+    bool next_task(size_t idx, std::function<void()>& task, bool& from_submitted);
+    void worker_loop(size_t idx);
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::deque<std::function<void()> > submitted;
+    size_t running_submitted;
+    size_t max_submitted;
+    bool stopping;
+    std::mutex mtx; //Guards every queue and flag above
+    std::condition_variable cv;
+};
+
+/*
+ Calls fn(lo, hi) over contiguous sub-ranges covering [begin, end), one per worker. Chunk
+ boundaries (other than 'end') are multiples of 'grain' past 'begin'. Returns once every
+ chunk has finished; if any chunk throws, the first exception is rethrown here.
+
+ begin - first index
+ end - one past last index
+ fn - callable taking (size_t lo, size_t hi)
+ grain - minimum chunk size and chunk alignment
+
+ Void return
+ */
+template <class F>
+void KThreadPool::parallel_for(size_t begin, size_t end, F fn, size_t grain){
+
+    if (end <= begin) return;
+    if (grain < 1) grain = 1;
+
+    //Determine number of chunks
+    size_t chunks = (end - begin + grain - 1)/grain;
+    if (chunks > threads()) chunks = threads();
+
+    //Run serially if there's nothing to split or if already on one of this pool's workers
+    if (chunks <= 1 || on_worker()){
+        fn(begin, end);
+        return;
+    }
+
+    KTaskControl* task = KTaskControl::current();
+    run_chunks(chunks, [&](size_t i){
+        KTaskControl::Scope scope(task);
+        fn(partition(i, chunks, begin, end, grain), partition(i+1, chunks, begin, end, grain));
+    });
+}
+
+/*
+ Queues 'fn' to run on one of the pool's workers, under the calling thread's current task
+ (if any).
+
+ Returns a future for the result of fn()
+ */
+template <class F>
+std::future<decltype(std::declval<F&>()())> KThreadPool::submit(F fn){
+
+    typedef decltype(std::declval<F&>()()) R;
+
+    std::shared_ptr<std::packaged_task<R()> > task = std::make_shared<std::packaged_task<R()> >(fn);
+    std::future<R> result = task->get_future();
+
+    std::shared_ptr<KTaskControl> control;
+    if (KTaskControl::current() != NULL){
+        control = KTaskControl::current()->shared_from_this();
+    }
+    enqueue_submitted([task, control](){
+        KTaskControl::Scope scope(control.get());
+        (*task)();
+    });
+
+    return result;
+}
+
+#endif /* KMatrixThreads_hpp */
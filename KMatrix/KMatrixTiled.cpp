@@ -0,0 +1,389 @@
+//
+//  KMatrixTiled.cpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#include "KMatrixTiled.hpp"
+#include "KMatrixHelpers.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KMATRIX_HAVE_PREAD
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    void* tile_alloc(size_t bytes){
+        return ::operator new(bytes, std::align_val_t(KMATRIX_CACHE_LINE));
+    }
+
+    void tile_free(void* p){
+        ::operator delete(p, std::align_val_t(KMATRIX_CACHE_LINE));
+    }
+
+}
+
+/*
+ Opens the backing file and sizes it to hold every tile. New space reads back as zeros.
+
+ tile_bytes - size of one tile
+ tiles - number of tiles
+ cache_bytes - bytes of tiles to keep in memory (at least KMATRIX_TILE_CACHE_MIN tiles)
+ filename - backing file. If empty, an anonymous temporary file is used and deleted when the
+            store is destroyed. A named file is kept, and reused if it already exists.
+
+ Throws matrix_io_exception if the file can not be opened or sized.
+ */
+KTileStore::KTileStore(size_t tile_bytes, size_t tiles, size_t cache_bytes, std::string filename) : tile_bytes(tile_bytes), ntiles(tiles), fd(-1), file(NULL), stopping(false), tile_reads(0), tile_writes(0){
+
+    capacity = (tile_bytes > 0) ? cache_bytes/tile_bytes : 0;
+    if (capacity < KMATRIX_TILE_CACHE_MIN) capacity = KMATRIX_TILE_CACHE_MIN;
+
+    unsigned long long total = (unsigned long long)tile_bytes*tiles;
+
+#ifdef KMATRIX_HAVE_PREAD
+    if (filename.empty()){
+        const char* dir = std::getenv("TMPDIR");
+        std::string path = std::string((dir != NULL && dir[0] != '\0') ? dir : "/tmp") + "/kmatrix_tiles_XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        fd = mkstemp(name.data());
+        if (fd >= 0) unlink(name.data()); //Removed by the OS once closed
+    }else{
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    }
+    if (fd < 0){
+        throw matrix_io_exception();
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((unsigned long long)st.st_size < total && ftruncate(fd, (off_t)total) != 0)){
+        ::close(fd);
+        throw matrix_io_exception();
+    }
+#else
+    if (filename.empty()){
+        file = std::tmpfile();
+    }else{
+        file = std::fopen(filename.c_str(), "r+b");
+        if (file == NULL) file = std::fopen(filename.c_str(), "w+b");
+    }
+    if (file == NULL){
+        throw matrix_io_exception();
+    }
+#endif
+}
+
+/*
+ Stops prefetching, writes back dirty tiles and closes the file.
+ */
+KTileStore::~KTileStore(){
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    prefetch_cv.notify_all();
+    if (prefetcher.joinable()) prefetcher.join();
+
+    try{
+        flush();
+    }catch(...){
+        //Nowhere to report a failed write-back from a destructor
+    }
+
+    for (std::unordered_map<size_t, Entry>::iterator it = entries.begin() ; it != entries.end() ; ++it){
+        tile_free(it->second.data);
+    }
+
+#ifdef KMATRIX_HAVE_PREAD
+    if (fd >= 0) ::close(fd);
+#else
+    if (file != NULL) std::fclose(file);
+#endif
+}
+
+/*
+ Pins tile 'idx' in memory, reading it from the file if it is not cached, and returns its
+ data. Every acquire() must be matched by a release().
+
+ idx - tile index
+ write - the caller will modify the tile (it will be written back before eviction)
+ discard - the caller will overwrite the whole tile, so it is zero-filled instead of read
+
+ Returns a pointer to the tile's 'tile_bytes' bytes
+ */
+void* KTileStore::acquire(size_t idx, bool write, bool discard){
+
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while (true){
+
+        std::unordered_map<size_t, Entry>::iterator it = entries.find(idx);
+        if (it == entries.end()){
+            make_room(lock);
+            if (entries.count(idx) == 0) break;
+            continue; //Loaded by another thread while a tile was being written back
+        }
+
+        //Another thread is reading or writing back this tile
+        if (it->second.busy){
+            state_cv.wait(lock);
+            continue;
+        }
+
+        Entry& e = it->second;
+        e.pins++;
+        e.dirty = e.dirty || write;
+        lru.splice(lru.begin(), lru, e.pos);
+        return e.data;
+    }
+
+    //Insert it while it loads, so other threads wait for it rather than reading it twice
+    Entry& e = entries[idx];
+    e.data = tile_alloc(tile_bytes);
+    e.pins = 1;
+    e.dirty = write;
+    e.busy = true;
+    lru.push_front(idx);
+    e.pos = lru.begin();
+    void* data = e.data;
+
+    lock.unlock();
+    bool ok = true;
+    if (discard){
+        std::memset(data, 0, tile_bytes);
+    }else{
+        ok = read_tile(idx, data);
+    }
+    lock.lock();
+
+    Entry& done = entries[idx];
+    done.busy = false;
+    if (!ok){
+        lru.erase(done.pos);
+        tile_free(done.data);
+        entries.erase(idx);
+        state_cv.notify_all();
+        throw matrix_io_exception();
+    }
+    state_cv.notify_all();
+
+    return data;
+}
+
+/*
+ Unpins a tile acquired with acquire(). It stays cached until evicted.
+
+ Void return
+ */
+void KTileStore::release(size_t idx){
+
+    std::lock_guard<std::mutex> lock(mtx);
+    std::unordered_map<size_t, Entry>::iterator it = entries.find(idx);
+    if (it != entries.end() && it->second.pins > 0) it->second.pins--;
+}
+
+/*
+ Asks the background thread to read tile 'idx' into the cache, so a later acquire() does not
+ wait for the disk. Prefetches are dropped if the cache is full of pinned tiles.
+
+ Void return
+ */
+void KTileStore::prefetch(size_t idx){
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (idx >= ntiles || entries.count(idx) > 0) return;
+        if (!prefetcher.joinable()){
+            prefetcher = std::thread(&KTileStore::prefetch_loop, this);
+        }
+        prefetch_queue.push_back(idx);
+        if (prefetch_queue.size() > capacity) prefetch_queue.pop_front();
+    }
+    prefetch_cv.notify_one();
+}
+
+/*
+ Writes every dirty, unpinned tile back to the file.
+
+ Void return
+ */
+void KTileStore::flush(){
+
+    std::lock_guard<std::mutex> lock(mtx);
+    for (std::unordered_map<size_t, Entry>::iterator it = entries.begin() ; it != entries.end() ; ++it){
+        Entry& e = it->second;
+        if (e.dirty && !e.busy && e.pins == 0){
+            if (!write_tile(it->first, e.data)){
+                throw matrix_io_exception();
+            }
+            e.dirty = false;
+        }
+    }
+
+#ifndef KMATRIX_HAVE_PREAD
+    std::lock_guard<std::mutex> io(io_mtx);
+    std::fflush(file);
+#endif
+}
+
+size_t KTileStore::tileBytes() const{
+    return tile_bytes;
+}
+
+size_t KTileStore::tiles() const{
+    return ntiles;
+}
+
+/*
+ Returns the number of tiles the cache holds before evicting
+ */
+size_t KTileStore::capacityTiles() const{
+    return capacity;
+}
+
+/*
+ Returns the number of tiles read from the file so far
+ */
+unsigned long long KTileStore::reads() const{
+    return tile_reads.load(std::memory_order_relaxed);
+}
+
+/*
+ Returns the number of tiles written to the file so far
+ */
+unsigned long long KTileStore::writes() const{
+    return tile_writes.load(std::memory_order_relaxed);
+}
+
+/*
+ Evicts least recently used unpinned tiles until there is space for one more, writing dirty
+ ones back with the lock released. If every cached tile is pinned the cache is allowed to
+ grow past its capacity instead of waiting.
+ */
+void KTileStore::make_room(std::unique_lock<std::mutex>& lock){
+
+    while (entries.size() >= capacity){
+
+        std::list<size_t>::reverse_iterator victim = lru.rbegin();
+        while (victim != lru.rend() && (entries[*victim].pins > 0 || entries[*victim].busy)) ++victim;
+        if (victim == lru.rend()) return;
+
+        size_t idx = *victim;
+        Entry& e = entries[idx];
+
+        if (e.dirty){
+            e.busy = true;
+            void* data = e.data;
+            lock.unlock();
+            bool ok = write_tile(idx, data);
+            lock.lock();
+            Entry& w = entries[idx];
+            w.busy = false;
+            if (!ok){
+                state_cv.notify_all();
+                throw matrix_io_exception();
+            }
+            w.dirty = false;
+            state_cv.notify_all();
+            continue; //It may have been pinned again while it was being written
+        }
+
+        lru.erase(e.pos);
+        tile_free(e.data);
+        entries.erase(idx);
+    }
+}
+
+void KTileStore::prefetch_loop(){
+
+    while (true){
+
+        size_t idx;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            prefetch_cv.wait(lock, [&](){ return stopping || !prefetch_queue.empty(); });
+            if (stopping) return;
+            idx = prefetch_queue.front();
+            prefetch_queue.pop_front();
+
+            //Skip tiles already cached, and don't evict to make room when the cache is
+            //full of pinned tiles
+            if (entries.count(idx) > 0) continue;
+            size_t pinned = 0;
+            for (std::unordered_map<size_t, Entry>::iterator it = entries.begin() ; it != entries.end() ; ++it){
+                if (it->second.pins > 0 || it->second.busy) pinned++;
+            }
+            if (pinned + 1 >= capacity) continue;
+        }
+
+        try{
+            acquire(idx, false, false);
+            release(idx);
+        }catch(...){
+            //The next acquire() of this tile reports the error
+        }
+    }
+}
+
+bool KTileStore::read_tile(size_t idx, void* data){
+
+    tile_reads.fetch_add(1, std::memory_order_relaxed);
+    unsigned long long offset = (unsigned long long)idx*tile_bytes;
+
+#ifdef KMATRIX_HAVE_PREAD
+    char* p = (char*)data;
+    size_t left = tile_bytes;
+    while (left > 0){
+        ssize_t got = pread(fd, p, left, (off_t)offset);
+        if (got < 0) return false;
+        if (got == 0){ //Past the end of a short file: zeros
+            std::memset(p, 0, left);
+            break;
+        }
+        p += got;
+        left -= (size_t)got;
+        offset += (unsigned long long)got;
+    }
+    return true;
+#else
+    std::lock_guard<std::mutex> io(io_mtx);
+    if (std::fseek(file, (long)offset, SEEK_SET) != 0) return false;
+    size_t got = std::fread(data, 1, tile_bytes, file);
+    if (got < tile_bytes) std::memset((char*)data + got, 0, tile_bytes - got);
+    return !std::ferror(file);
+#endif
+}
+
+bool KTileStore::write_tile(size_t idx, const void* data){
+
+    tile_writes.fetch_add(1, std::memory_order_relaxed);
+    unsigned long long offset = (unsigned long long)idx*tile_bytes;
+
+#ifdef KMATRIX_HAVE_PREAD
+    const char* p = (const char*)data;
+    size_t left = tile_bytes;
+    while (left > 0){
+        ssize_t put = pwrite(fd, p, left, (off_t)offset);
+        if (put <= 0) return false;
+        p += put;
+        left -= (size_t)put;
+        offset += (unsigned long long)put;
+    }
+    return true;
+#else
+    std::lock_guard<std::mutex> io(io_mtx);
+    if (std::fseek(file, (long)offset, SEEK_SET) != 0) return false;
+    return std::fwrite(data, 1, tile_bytes, file) == tile_bytes;
+#endif
+}
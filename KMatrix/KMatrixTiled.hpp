@@ -0,0 +1,803 @@
+//
+//  KMatrixTiled.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KMatrixTiled_hpp
+#define KMatrixTiled_hpp
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "KMatrix.hpp"
+#include "KMatrixAllocator.hpp"
+#include "KMatrixKernels.hpp"
+#include "KMatrixThreads.hpp"
+
+/*
+ Out-of-core matrices. A KTiledMatrix keeps its elements in a file as square tiles and holds
+ only a bounded number of them in memory, so it can be larger than RAM. Tiles are paged in
+ and out by an LRU cache (KTileStore) that writes modified tiles back when they are evicted,
+ and a background thread reads ahead the tiles an operation will need next, so disk reads
+ overlap computation.
+
+ matrixMult(), the element-wise operators and the reductions walk the tiles in an order that
+ keeps reuse inside the cache (see matrixMult()), and hand the work on each tile to the
+ thread pool as KMatrix does.
+ */
+
+//Default tile edge, in elements
+#define KMATRIX_TILE 512
+
+//Default bytes of tiles cached in memory per matrix
+#define KMATRIX_TILE_CACHE (256ull << 20)
+
+//Fewest tiles a cache holds: an operation pins up to three, plus room to read ahead
+#define KMATRIX_TILE_CACHE_MIN 6
+
+/*
+ File of fixed-size tiles with an LRU cache in front of it. Tiles are pinned while in use
+ (acquire()/release()); unpinned tiles are evicted least recently used first, and written
+ back if modified. Thread-safe; disk I/O is done without holding the cache lock.
+ */
+class KTileStore {
+public:
+
+    KTileStore(size_t tile_bytes, size_t tiles, size_t cache_bytes, std::string filename);
+    ~KTileStore();
+
+    KTileStore(const KTileStore&) = delete;
+    KTileStore& operator=(const KTileStore&) = delete;
+
+    void* acquire(size_t idx, bool write, bool discard=false);
+    void release(size_t idx);
+    void prefetch(size_t idx);
+    void flush();
+
+    size_t tileBytes() const;
+    size_t tiles() const;
+    size_t capacityTiles() const;
+    unsigned long long reads() const;
+    unsigned long long writes() const;
+
+private:
+
+    struct Entry {
+        void* data = NULL;
+        size_t pins = 0;
+        bool dirty = false;
+        bool busy = false; //Being read or written back
+        std::list<size_t>::iterator pos;
+    };
+
+    void make_room(std::unique_lock<std::mutex>& lock);
+    void prefetch_loop();
+    bool read_tile(size_t idx, void* data);
+    bool write_tile(size_t idx, const void* data);
+
+    size_t tile_bytes;
+    size_t ntiles;
+    size_t capacity;
+
+    int fd;
+    std::FILE* file;
+    std::mutex io_mtx;
+
+    std::unordered_map<size_t, Entry> entries;
+    std::list<size_t> lru; //Most recently used first
+    std::mutex mtx;
+    std::condition_variable state_cv;
+
+    std::thread prefetcher;
+    std::deque<size_t> prefetch_queue;
+    std::condition_variable prefetch_cv;
+    bool stopping;
+
+    std::atomic<unsigned long long> tile_reads;
+    std::atomic<unsigned long long> tile_writes;
+};
+
+/*
+ Disk-backed matrix of 'tileSize()' x 'tileSize()' tiles. Tiles on the right and bottom edges
+ are stored at full size; the padding is never read. T must be trivially copyable (every
+ KMatrix element type is).
+
+ Element access through get() and set() goes through the cache one element at a time; use
+ the whole-matrix operations, or tile() for direct access to a tile's memory.
+ */
+template <class T>
+class KTiledMatrix {
+public:
+
+    static_assert(std::is_trivially_copyable<T>::value, "KTiledMatrix elements are stored as raw bytes");
+
+    /*
+     A pinned tile. The tile stays in memory until the handle is destroyed. Elements are
+     row-major with a row stride of tileSize().
+     */
+    class Tile {
+    public:
+        Tile(KTileStore* store, size_t idx, bool write, bool discard);
+        ~Tile();
+        Tile(Tile&& other);
+        Tile(const Tile&) = delete;
+        Tile& operator=(const Tile&) = delete;
+        T* data() const;
+    private:
+        KTileStore* store;
+        size_t idx;
+        T* ptr;
+    };
+
+    //Initializers
+    KTiledMatrix(size_t rows, size_t cols, size_t tile=KMATRIX_TILE, size_t cache_bytes=KMATRIX_TILE_CACHE, std::string filename="");
+    KTiledMatrix(const KMatrix<T>& km, size_t tile=KMATRIX_TILE, size_t cache_bytes=KMATRIX_TILE_CACHE, std::string filename="");
+    KTiledMatrix(KTiledMatrix&& other) = default;
+    KTiledMatrix& operator=(KTiledMatrix&& other) = default;
+    KTiledMatrix(const KTiledMatrix&) = delete;
+    KTiledMatrix& operator=(const KTiledMatrix&) = delete;
+
+    //Access
+    T get(size_t r, size_t c) const;
+    void set(size_t r, size_t c, T val);
+    Tile tile(size_t tr, size_t tc, bool write=false, bool discard=false) const;
+    void prefetch(size_t tr, size_t tc) const;
+    KMatrix<T> toKMatrix() const;
+    void flush();
+
+    size_t rows() const;
+    size_t cols() const;
+    size_t tileSize() const;
+    size_t tileRows() const;
+    size_t tileCols() const;
+    size_t tileHeight(size_t tr) const;
+    size_t tileWidth(size_t tc) const;
+    size_t cacheBytes() const;
+    KTileStore& store() const;
+
+    //Element-wise
+    template <class F>
+    void apply(F fn);
+
+    //Reductions
+    T max() const;
+    T min() const;
+    T avg() const;
+    T stdev() const;
+
+private:
+
+    std::unique_ptr<KTileStore> tiles;
+    size_t nr;
+    size_t nc;
+    size_t ts;
+    size_t ntr;
+    size_t ntc;
+    size_t cache;
+};
+
+template <class T>
+KTiledMatrix<T> matrixMult(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b);
+
+template <class T, class F>
+KTiledMatrix<T> kmatrix_tiled_zip(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b, F op);
+
+template <class T>
+KTiledMatrix<T> operator+(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b);
+
+template <class T>
+KTiledMatrix<T> operator-(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b);
+
+template <class T>
+KTiledMatrix<T> operator/(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b);
+
+template <class T>
+KTiledMatrix<T> elementMult(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b);
+
+/*----------------------------------------------------------------
+------------------------------ TILE ------------------------------
+----------------------------------------------------------------*/
+
+template <class T>
+KTiledMatrix<T>::Tile::Tile(KTileStore* store, size_t idx, bool write, bool discard) : store(store), idx(idx){
+    ptr = (T*)store->acquire(idx, write, discard);
+}
+
+template <class T>
+KTiledMatrix<T>::Tile::~Tile(){
+    if (store != NULL) store->release(idx);
+}
+
+template <class T>
+KTiledMatrix<T>::Tile::Tile(Tile&& other) : store(other.store), idx(other.idx), ptr(other.ptr){
+    other.store = NULL;
+}
+
+template <class T>
+T* KTiledMatrix<T>::Tile::data() const{
+    return ptr;
+}
+
+/*----------------------------------------------------------------
+-------------------------- INITIALIZERS --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Creates a zero-filled 'rows' x 'cols' matrix.
+
+ rows, cols - dimensions
+ tile - tile edge in elements
+ cache_bytes - memory to use for cached tiles
+ filename - backing file. If empty, a temporary file that is deleted with the matrix. A named
+            file is kept, and an existing file is reopened with its contents.
+ */
+template <class T>
+KTiledMatrix<T>::KTiledMatrix(size_t rows, size_t cols, size_t tile, size_t cache_bytes, std::string filename) : nr(rows), nc(cols), cache(cache_bytes){
+
+    ts = (tile < 1) ? 1 : tile;
+    ntr = (nr + ts - 1)/ts;
+    ntc = (nc + ts - 1)/ts;
+    tiles.reset(new KTileStore(ts*ts*sizeof(T), ntr*ntc, cache_bytes, filename));
+}
+
+/*
+ Copies an in-memory matrix into tiles.
+
+ km - matrix to copy (either layout)
+ tile, cache_bytes, filename - see above
+ */
+template <class T>
+KTiledMatrix<T>::KTiledMatrix(const KMatrix<T>& km, size_t tile, size_t cache_bytes, std::string filename) : KTiledMatrix(km.rows(), km.cols(), tile, cache_bytes, filename){
+
+    for (size_t tr = 0 ; tr < ntr ; tr++){
+        for (size_t tc = 0 ; tc < ntc ; tc++){
+            Tile t = this->tile(tr, tc, true, true);
+            T* p = t.data();
+            for (size_t i = 0 ; i < tileHeight(tr) ; i++){
+                for (size_t j = 0 ; j < tileWidth(tc) ; j++){
+                    p[i*ts + j] = km.get(tr*ts + i, tc*ts + j);
+                }
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------
+----------------------------- ACCESS -----------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns element (r, c). Throws matrix_bounds_excep if out of bounds.
+ */
+template <class T>
+T KTiledMatrix<T>::get(size_t r, size_t c) const{
+
+    if (r >= nr || c >= nc){
+        throw matrix_bounds_excep();
+    }
+
+    Tile t = tile(r/ts, c/ts);
+    return t.data()[(r%ts)*ts + c%ts];
+}
+
+/*
+ Sets element (r, c) to 'val'. Throws matrix_bounds_excep if out of bounds.
+
+ Void return
+ */
+template <class T>
+void KTiledMatrix<T>::set(size_t r, size_t c, T val){
+
+    if (r >= nr || c >= nc){
+        throw matrix_bounds_excep();
+    }
+
+    Tile t = tile(r/ts, c/ts, true);
+    t.data()[(r%ts)*ts + c%ts] = val;
+}
+
+/*
+ Pins tile (tr, tc) in memory.
+
+ tr, tc - tile row and column
+ write - the tile will be modified
+ discard - the whole tile will be overwritten, so its old contents are not read
+
+ Returns the pinned tile
+ */
+template <class T>
+typename KTiledMatrix<T>::Tile KTiledMatrix<T>::tile(size_t tr, size_t tc, bool write, bool discard) const{
+    return Tile(tiles.get(), tr*ntc + tc, write, discard);
+}
+
+/*
+ Starts reading tile (tr, tc) in the background.
+
+ Void return
+ */
+template <class T>
+void KTiledMatrix<T>::prefetch(size_t tr, size_t tc) const{
+    if (tr < ntr && tc < ntc) tiles->prefetch(tr*ntc + tc);
+}
+
+/*
+ Copies the matrix into memory. Only sensible for matrices that fit.
+
+ Returns the row-major matrix
+ */
+template <class T>
+KMatrix<T> KTiledMatrix<T>::toKMatrix() const{
+
+    KMatrix<T> out((int)nr, (int)nc);
+    std::vector<typename KMatrix<T>::row_type>& om = out.getMat();
+
+    for (size_t tr = 0 ; tr < ntr ; tr++){
+        for (size_t tc = 0 ; tc < ntc ; tc++){
+            prefetch(tr, tc + 1);
+            Tile t = tile(tr, tc);
+            for (size_t i = 0 ; i < tileHeight(tr) ; i++){
+                const T* p = t.data() + i*ts;
+                std::copy(p, p + tileWidth(tc), om[tr*ts + i].begin() + tc*ts);
+            }
+        }
+    }
+
+    return out;
+}
+
+/*
+ Writes all modified tiles to the backing file.
+
+ Void return
+ */
+template <class T>
+void KTiledMatrix<T>::flush(){
+    tiles->flush();
+}
+
+template <class T>
+size_t KTiledMatrix<T>::rows() const{
+    return nr;
+}
+
+template <class T>
+size_t KTiledMatrix<T>::cols() const{
+    return nc;
+}
+
+template <class T>
+size_t KTiledMatrix<T>::tileSize() const{
+    return ts;
+}
+
+/*
+ Returns the number of tile rows
+ */
+template <class T>
+size_t KTiledMatrix<T>::tileRows() const{
+    return ntr;
+}
+
+/*
+ Returns the number of tile columns
+ */
+template <class T>
+size_t KTiledMatrix<T>::tileCols() const{
+    return ntc;
+}
+
+/*
+ Returns the number of matrix rows in tile row 'tr' (less than tileSize() only at the bottom)
+ */
+template <class T>
+size_t KTiledMatrix<T>::tileHeight(size_t tr) const{
+    return (tr + 1 < ntr) ? ts : nr - tr*ts;
+}
+
+/*
+ Returns the number of matrix columns in tile column 'tc' (less than tileSize() only at the right)
+ */
+template <class T>
+size_t KTiledMatrix<T>::tileWidth(size_t tc) const{
+    return (tc + 1 < ntc) ? ts : nc - tc*ts;
+}
+
+/*
+ Returns the cache size the matrix was created with
+ */
+template <class T>
+size_t KTiledMatrix<T>::cacheBytes() const{
+    return cache;
+}
+
+/*
+ Returns the tile store, for its I/O counters
+ */
+template <class T>
+KTileStore& KTiledMatrix<T>::store() const{
+    return *tiles;
+}
+
+/*----------------------------------------------------------------
+-------------------------- ELEMENT-WISE --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Replaces every element x with fn(x), a tile at a time in file order, reading the next tile
+ ahead. The rows of each tile are split across the thread pool.
+
+ fn - callable taking and returning T
+
+ Void return
+ */
+template <class T>
+template <class F>
+void KTiledMatrix<T>::apply(F fn){
+
+    for (size_t idx = 0 ; idx < ntr*ntc ; idx++){
+
+        size_t tr = idx/ntc, tc = idx%ntc;
+        if (idx + 1 < ntr*ntc) tiles->prefetch(idx + 1);
+
+        Tile t = tile(tr, tc, true);
+        T* p = t.data();
+        size_t h = tileHeight(tr), w = tileWidth(tc);
+        KThreadPool::global().parallel_for(0, h, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                for (size_t j = 0 ; j < w ; j++) p[i*ts + j] = fn(p[i*ts + j]);
+            }
+        }, (h*w < KMATRIX_ELEMENTWISE_PARALLEL) ? h : 16);
+    }
+}
+
+/*
+ Returns op(a(r, c), b(r, c)) for every element, as a new tiled matrix with a's tile size and
+ cache size. Both operands are read a tile at a time in file order, each pair of tiles read
+ once, with the next pair read ahead. Throws matrix_multiplication_exception if the shapes
+ or tile sizes differ.
+
+ a, b - operands
+ op - callable taking (T, T) and returning T
+
+ Returns the result
+ */
+template <class T, class F>
+KTiledMatrix<T> kmatrix_tiled_zip(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b, F op){
+
+    if (a.rows() != b.rows() || a.cols() != b.cols() || a.tileSize() != b.tileSize()){
+        throw matrix_multiplication_exception();
+    }
+
+    KMATRIX_STAT_SCOPE(KOP_ELEMENTWISE, a.rows()*a.cols(), 0);
+
+    KTiledMatrix<T> out(a.rows(), a.cols(), a.tileSize(), a.cacheBytes());
+    size_t ts = a.tileSize();
+    size_t ntc = a.tileCols();
+    size_t count = a.tileRows()*ntc;
+
+    for (size_t idx = 0 ; idx < count ; idx++){
+
+        size_t tr = idx/ntc, tc = idx%ntc;
+        if (idx + 1 < count){
+            a.prefetch((idx + 1)/ntc, (idx + 1)%ntc);
+            b.prefetch((idx + 1)/ntc, (idx + 1)%ntc);
+        }
+
+        typename KTiledMatrix<T>::Tile ta = a.tile(tr, tc);
+        typename KTiledMatrix<T>::Tile tb = b.tile(tr, tc);
+        typename KTiledMatrix<T>::Tile to = out.tile(tr, tc, true, true);
+        const T* pa = ta.data();
+        const T* pb = tb.data();
+        T* po = to.data();
+
+        size_t h = a.tileHeight(tr), w = a.tileWidth(tc);
+        KThreadPool::global().parallel_for(0, h, [&](size_t lo, size_t hi){
+            for (size_t i = lo ; i < hi ; i++){
+                for (size_t j = 0 ; j < w ; j++) po[i*ts + j] = op(pa[i*ts + j], pb[i*ts + j]);
+            }
+        }, (h*w < KMATRIX_ELEMENTWISE_PARALLEL) ? h : 16);
+    }
+
+    return out;
+}
+
+template <class T>
+KTiledMatrix<T> operator+(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b){
+    return kmatrix_tiled_zip(a, b, [](T x, T y){ return T(x + y); });
+}
+
+template <class T>
+KTiledMatrix<T> operator-(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b){
+    return kmatrix_tiled_zip(a, b, [](T x, T y){ return T(x - y); });
+}
+
+/*
+ Element-wise division, as KMatrix's operator/.
+ */
+template <class T>
+KTiledMatrix<T> operator/(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b){
+    return kmatrix_tiled_zip(a, b, [](T x, T y){ return T(x / y); });
+}
+
+template <class T>
+KTiledMatrix<T> elementMult(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b){
+    return kmatrix_tiled_zip(a, b, [](T x, T y){ return T(x * y); });
+}
+
+/*----------------------------------------------------------------
+--------------------------- REDUCTIONS ---------------------------
+----------------------------------------------------------------*/
+
+/*
+ Returns the maximum element (the type's default value for an empty matrix). One pass over
+ the tiles in file order.
+ */
+template <class T>
+T KTiledMatrix<T>::max() const{
+
+    KMATRIX_STAT_SCOPE(KOP_MAX, nr*nc, 0);
+
+    T best{};
+    bool first = true;
+    for (size_t idx = 0 ; idx < ntr*ntc ; idx++){
+        size_t tr = idx/ntc, tc = idx%ntc;
+        if (idx + 1 < ntr*ntc) tiles->prefetch(idx + 1);
+        Tile t = tile(tr, tc);
+        for (size_t i = 0 ; i < tileHeight(tr) ; i++){
+            const T* p = t.data() + i*ts;
+            for (size_t j = 0 ; j < tileWidth(tc) ; j++){
+                if (first || kmatrix_greater(p[j], best)){
+                    best = p[j];
+                    first = false;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+/*
+ Returns the minimum element (the type's default value for an empty matrix). One pass over
+ the tiles in file order.
+ */
+template <class T>
+T KTiledMatrix<T>::min() const{
+
+    KMATRIX_STAT_SCOPE(KOP_MIN, nr*nc, 0);
+
+    T best{};
+    bool first = true;
+    for (size_t idx = 0 ; idx < ntr*ntc ; idx++){
+        size_t tr = idx/ntc, tc = idx%ntc;
+        if (idx + 1 < ntr*ntc) tiles->prefetch(idx + 1);
+        Tile t = tile(tr, tc);
+        for (size_t i = 0 ; i < tileHeight(tr) ; i++){
+            const T* p = t.data() + i*ts;
+            for (size_t j = 0 ; j < tileWidth(tc) ; j++){
+                if (first || kmatrix_greater(best, p[j])){
+                    best = p[j];
+                    first = false;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+/*
+ Returns the mean of the elements, accumulated in kmatrix_accum<T>::type. One pass over the
+ tiles in file order.
+ */
+template <class T>
+T KTiledMatrix<T>::avg() const{
+
+    KMATRIX_STAT_SCOPE(KOP_AVG, nr*nc, 0);
+
+    typedef typename kmatrix_accum<T>::type accum_type;
+
+    accum_type sum = accum_type(0);
+    for (size_t idx = 0 ; idx < ntr*ntc ; idx++){
+        size_t tr = idx/ntc, tc = idx%ntc;
+        if (idx + 1 < ntr*ntc) tiles->prefetch(idx + 1);
+        Tile t = tile(tr, tc);
+        for (size_t i = 0 ; i < tileHeight(tr) ; i++){
+            const T* p = t.data() + i*ts;
+            for (size_t j = 0 ; j < tileWidth(tc) ; j++) sum += accum_type(p[j]);
+        }
+    }
+
+    return T(sum/((accum_type)(nr*nc)));
+}
+
+/*
+ Returns the population standard deviation of the elements (the type's default value for an
+ empty matrix), as KMatrix::stdev(), in a single
+ pass over the tiles. Each tile's mean and sum of squared deviations are merged into the
+ running totals (Chan et al.), which is as stable as the two-pass formula without reading the
+ matrix twice. Integer types accumulate the sum and sum of squares exactly instead.
+ */
+template <class T>
+T KTiledMatrix<T>::stdev() const{
+
+    KMATRIX_STAT_SCOPE(KOP_STDEV, 3*nr*nc, 0);
+
+    typedef typename kmatrix_accum<T>::type accum_type;
+
+    accum_type mean = accum_type(0); //Running mean (floating) or sum (integral)
+    accum_type m2 = accum_type(0);   //Running sum of squared deviations (floating) or of squares (integral)
+    size_t n = 0;
+
+    for (size_t idx = 0 ; idx < ntr*ntc ; idx++){
+
+        size_t tr = idx/ntc, tc = idx%ntc;
+        if (idx + 1 < ntr*ntc) tiles->prefetch(idx + 1);
+        Tile t = tile(tr, tc);
+        size_t h = tileHeight(tr), w = tileWidth(tc);
+
+        if constexpr (std::is_integral<accum_type>::value){
+            for (size_t i = 0 ; i < h ; i++){
+                const T* p = t.data() + i*ts;
+                for (size_t j = 0 ; j < w ; j++){
+                    mean += accum_type(p[j]);
+                    m2 += accum_type(p[j])*accum_type(p[j]);
+                }
+            }
+            n += h*w;
+        }else{
+            size_t nb = h*w;
+            accum_type tmean = accum_type(0);
+            for (size_t i = 0 ; i < h ; i++){
+                const T* p = t.data() + i*ts;
+                for (size_t j = 0 ; j < w ; j++) tmean += accum_type(p[j]);
+            }
+            tmean = tmean/(accum_type)nb;
+            accum_type tm2 = accum_type(0);
+            for (size_t i = 0 ; i < h ; i++){
+                const T* p = t.data() + i*ts;
+                for (size_t j = 0 ; j < w ; j++){
+                    accum_type d = accum_type(p[j]) - tmean;
+                    tm2 += d*d;
+                }
+            }
+
+            accum_type delta = tmean - mean;
+            size_t total = n + nb;
+            mean += delta*((accum_type)nb/(accum_type)total);
+            m2 += tm2 + delta*delta*((accum_type)n*(accum_type)nb/(accum_type)total);
+            n = total;
+        }
+    }
+
+    if (n == 0) return T{};
+
+    if constexpr (std::is_integral<accum_type>::value){
+        accum_type average = mean/(accum_type)n;
+        accum_type sum = m2 - 2*average*mean + (accum_type)n*average*average;
+        return T(std::sqrt(sum/((accum_type)n)));
+    }else{
+        return T(std::sqrt(m2/((accum_type)n)));
+    }
+}
+
+/*----------------------------------------------------------------
+------------------------ MULTIPLICATION --------------------------
+----------------------------------------------------------------*/
+
+/*
+ Out-of-core matrix multiplication, C = A*B, with a's tile size and cache size. Throws
+ matrix_multiplication_exception if the inner dimensions or tile sizes differ.
+
+ Each tile of C is accumulated (in kmatrix_accum<T>::type) over the tile row of A and tile
+ column of B with the blocked kernel, and written once. Tiles of C are visited row by row,
+ alternating direction along each row (boustrophedon order): the tile row of A is reused
+ across the whole row of C, and the tile column of B used last in one row is used first in
+ the next. With room in the cache for a tile row of A and a tile column of B (twice A's tile
+ columns, plus two) each tile of A is read once and each tile of B about once per tile row
+ of C. The tiles of the next step are read ahead while the current product is computed.
+
+ a - left matrix (m x k)
+ b - right matrix (k x n)
+
+ Returns the product (m x n)
+ */
+template <class T>
+KTiledMatrix<T> matrixMult(const KTiledMatrix<T>& a, const KTiledMatrix<T>& b){
+
+    if (a.cols() != b.rows() || a.tileSize() != b.tileSize()){
+        throw matrix_multiplication_exception();
+    }
+
+    KMATRIX_STAT_SCOPE(KOP_MATRIX_MULT, 2.0*a.rows()*a.cols()*b.cols(), 0);
+
+    typedef typename kmatrix_accum<T>::type accum_type;
+
+    size_t ts = a.tileSize();
+    size_t mt = a.tileRows(), kt = a.tileCols(), nt = b.tileCols();
+    KTiledMatrix<T> c(a.rows(), b.cols(), ts, a.cacheBytes());
+
+    std::vector<accum_type> acc(ts*ts), prod(ts*ts), abuf, bbuf;
+    if constexpr (!std::is_same<accum_type, T>::value){
+        abuf.resize(ts*ts);
+        bbuf.resize(ts*ts);
+    }
+
+    //Steps in schedule order, so the next step's tiles can be read ahead
+    auto step = [&](size_t s, size_t& i, size_t& j, size_t& k){
+        k = s % kt;
+        size_t ij = s / kt;
+        i = ij / nt;
+        j = ij % nt;
+        if (i % 2 == 1) j = nt - 1 - j;
+    };
+
+    size_t steps = mt*nt*kt;
+    for (size_t s = 0 ; s < steps ; s++){
+
+        size_t i, j, k;
+        step(s, i, j, k);
+        if (s + 1 < steps){
+            size_t ni, nj, nk;
+            step(s + 1, ni, nj, nk);
+            a.prefetch(ni, nk);
+            b.prefetch(nk, nj);
+        }
+
+        if (k == 0) std::fill(acc.begin(), acc.end(), accum_type(0));
+
+        {
+            typename KTiledMatrix<T>::Tile ta = a.tile(i, k);
+            typename KTiledMatrix<T>::Tile tb = b.tile(k, j);
+            const accum_type* pa;
+            const accum_type* pb;
+            if constexpr (std::is_same<accum_type, T>::value){
+                pa = ta.data();
+                pb = tb.data();
+            }else{
+                std::copy(ta.data(), ta.data() + ts*ts, abuf.begin());
+                std::copy(tb.data(), tb.data() + ts*ts, bbuf.begin());
+                pa = abuf.data();
+                pb = bbuf.data();
+            }
+
+            //Padding of edge tiles is never read: only the valid rows, inner length and columns are used
+            size_t h = a.tileHeight(i), inner = a.tileWidth(k), w = b.tileWidth(j);
+            accum_type* pp = prod.data();
+            kmatrix_gemm<accum_type>(h, inner, w,
+                [&](size_t r){ return pa + r*ts; },
+                [&](size_t r){ return pb + r*ts; },
+                [&](size_t r){ return pp + r*ts; });
+            for (size_t r = 0 ; r < h ; r++){
+                for (size_t q = 0 ; q < w ; q++) acc[r*ts + q] += prod[r*ts + q];
+            }
+        }
+
+        if (k + 1 == kt){
+            typename KTiledMatrix<T>::Tile tc = c.tile(i, j, true, true);
+            T* pc = tc.data();
+            size_t h = c.tileHeight(i), w = c.tileWidth(j);
+            for (size_t r = 0 ; r < h ; r++){
+                for (size_t q = 0 ; q < w ; q++) pc[r*ts + q] = T(acc[r*ts + q]);
+            }
+        }
+    }
+
+    //An empty inner dimension leaves C zero, which the file already is
+    return c;
+}
+
+#endif /* KMatrixTiled_hpp */
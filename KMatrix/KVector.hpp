@@ -9,12 +9,11 @@
 #ifndef KVector_hpp
 #define KVector_hpp
 
-#include <stdio.h>
+#include <algorithm>
+#include <functional>
 #include <string>
-#include <GiesbrechtCPP/string_manip.hpp>
-#include <iostream>
-#include <exception>
-#include <cmath>
+#include <utility>
+#include <vector>
 #include "KMatrix.hpp"
 #include "KMatrixHelpers.hpp"
 
@@ -47,9 +46,20 @@ public:
 	KVector<T>& operator=(KVector rh);
 	KVector<T>& operator=(std::string rv);
 	KVector<T>& operator=(std::vector<double> rv);
+	template <class U>
+	KVector<T>& operator=(const std::vector<U>& rv);
 	
-	size_t size();
+	size_t size() const;
 	void setSize(size_t ns);
+	size_t capacity() const;
+	void reserve(size_t n);
+	void shrink_to_fit();
+	
+	void push_back(const T& val);
+	template <class... Args>
+	T& emplace_back(Args&&... args);
+	void append(const T* data, size_t n);
+	void append(const KVector<T>& v);
 	
 	static KVector zero(size_t elements); //TODO
 	static KVector constant(T val, size_t elements); //TODO
@@ -78,9 +88,9 @@ private:
 	using KMatrix<T>::range;
 	using KMatrix<T>::zero;
 	using KMatrix<T>::constant;
+	using KMatrix<T>::setLayout; //Vectors are always stored as one row
 	
-	using KMatrix<T>::setElementMultMode;
-	using KMatrix<T>::getElementMultMode;
+	typename KMatrix<T>::row_type& line();
 	
 	//TODO: Block some matrix operations (such as invert)
 	
@@ -199,22 +209,16 @@ KVector<T>::KVector(int elements){
 	
 	clear(elements);
 	
-	KMatrix<T>::element_mult_mode = true;
-	
 }
 
 template <class T>
 KVector<T>::KVector(const KVector<T>& init){
 	
-	//Resize matrix
-	clear(init.size());
-	
-	KMatrix<T>::element_mult_mode = true;
-	
-	//Populate matrix
-	for (int c = 0 ; c < init.size() ; c++){
-		KMatrix<T>::mat[0][c] = init[c];
-	}
+	//Copy vector
+	KMatrix<T>::mat = init.mat;
+	KMatrix<T>::row_align = init.row_align;
+	KMatrix<T>::mem_policy = init.mem_policy;
+	KMatrix<T>::arena = init.arena;
 	
 }
 
@@ -223,9 +227,7 @@ KVector<T>::KVector(std::vector<T> init){
 
 	clear();
 	
-	KMatrix<T>::mat.push_back(init);
-	
-	KMatrix<T>::element_mult_mode = true;
+	KMatrix<T>::mat.push_back(KMatrix<T>::new_row(init));
 }
 
 //From KMatrix (redefined to prevent multi-row vectors)
@@ -252,11 +254,10 @@ KVector<T>::KVector(std::string init){
 	//Read the string
 	if (matrixFromString(init, temp_mat)){
 		if (temp_mat.size() > 0){ //If the temp matrix isn't empty, copy the first row only
-			KMatrix<T>::mat.push_back(temp_mat[0]);
+			KMatrix<T>::mat.push_back(KMatrix<T>::new_row(temp_mat[0]));
 		}
 	}
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 template <class T>
@@ -268,9 +269,7 @@ KVector<T>::KVector(T* init, int elements){
 	for (int i = 0 ; i < elements ; i++){
 		temp[i] = init[i];
 	}
-	KMatrix<T>::mat.push_back(temp);
-	
-	KMatrix<T>::element_mult_mode = true;
+	KMatrix<T>::mat.push_back(KMatrix<T>::new_row(temp));
 	
 }
 
@@ -284,9 +283,8 @@ KVector<T>::KVector(T init, int elements){
 	for (int i = 0 ; i < elements ; i++){
 		temp[i] = init;
 	}
-	KMatrix<T>::mat.push_back(temp);
+	KMatrix<T>::mat.push_back(KMatrix<T>::new_row(temp));
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 /*
@@ -305,7 +303,6 @@ KVector<T>::KVector(int rows, int cols){
 	
 	clear(cols);
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 /*
@@ -329,9 +326,8 @@ KVector<T>::KVector(T** init, int rows, int cols){
 	for (int i = 0 ; i < cols ; i++){
 		temp[i] = init[0][i];
 	}
-	KMatrix<T>::mat.push_back(temp);
+	KMatrix<T>::mat.push_back(KMatrix<T>::new_row(temp));
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 /*
@@ -355,9 +351,8 @@ KVector<T>::KVector(T init, int rows, int cols){
 	for (int i = 0 ; i < cols ; i++){
 		temp[i] = init;
 	}
-	KMatrix<T>::mat.push_back(temp);
+	KMatrix<T>::mat.push_back(KMatrix<T>::new_row(temp));
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 /*
@@ -375,10 +370,9 @@ KVector<T>::KVector(std::vector<std::vector<T> > init){
 
 	clear();
 	if (init.size() > 0){
-		KMatrix<T>::mat.push_back(init[0]);
+		KMatrix<T>::mat.push_back(KMatrix<T>::new_row(init[0]));
 	}
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 /*
@@ -394,11 +388,19 @@ KVector<T>::KVector(const KMatrix<T>& init){
 	
 	clear();
 	
+	//A single row of a copy-on-write matrix is shared instead of copied
+	KMatrix<T>::setCopyOnWrite(init.copyOnWrite());
+	if (init.copyOnWrite() && init.layout() == KMAT_ROW_MAJOR && init.rows() == 1){
+		KMatrix<T>::operator=(init);
+		return;
+	}
+	
+	KMatrix<T>::setAlignment(init.alignment());
+	KMatrix<T>::setMemoryPolicy(init.memoryPolicy());
 	if (init.rows() > 0){
-		KMatrix<T>::mat.push_back(init.get_rowv(0));
+		KMatrix<T>::mat.push_back(KMatrix<T>::new_row(init.get_rowv(0)));
 	}
 	
-	KMatrix<T>::element_mult_mode = true;
 }
 
 /*
@@ -421,16 +423,14 @@ template <class T>
 void KVector<T>::clear(int elements){
 	
 	KVector<T>::clear();
-	std::vector<T> temp;
-	temp.resize(elements);
-	KMatrix<T>::mat.push_back(temp);
+	KMatrix<T>::mat.push_back(KMatrix<T>::new_row(elements));
 }
 
 /*
  Returns the number of elements in the KVector
  */
 template <class T>
-size_t KVector<T>::size(){
+size_t KVector<T>::size() const{
 	
 	if (KMatrix<T>::mat.size() > 0){
 		return KMatrix<T>::mat[0].size();
@@ -484,7 +484,8 @@ std::vector<T> KVector<T>::get_vec(){
 	}
 	
 	//Return row
-	return KMatrix<T>::mat[0];
+	const typename KMatrix<T>::row_type& row = KMatrix<T>::mat.read()[0];
+	return std::vector<T>(row.begin(), row.end());
 }
 
 /*
@@ -507,10 +508,9 @@ KVector<T>& KVector<T>::operator=(std::string init){
 		if (temp_mat.size() > 0){ //If the temp matrix isn't empty, copy the first row only
 			if (KMatrix<T>::mat.size() != 1){
 				clear();
-				std::vector<double> temp;
-				KMatrix<T>::mat.push_back(temp);
+				KMatrix<T>::mat.push_back(KMatrix<T>::new_row(0));
 			}
-			KMatrix<T>::mat[0] = (temp_mat[0]);
+			KMatrix<T>::mat[0].assign(temp_mat[0].begin(), temp_mat[0].end());
 		}
 	}
 	
@@ -524,12 +524,26 @@ KVector<T>& KVector<T>::operator=(std::string init){
 
 template <class T>
 KVector<T>& KVector<T>::operator=(std::vector<double> rv){
+	return this->operator=<double>(rv);
+}
+
+/*
+ Sets the vector from the values in 'rv', converting each to T (eg. a std::vector<float>
+ into a KVector<KHalf>).
+ 
+ Returns a reference to the vector
+ */
+template <class T>
+template <class U>
+KVector<T>& KVector<T>::operator=(const std::vector<U>& rv){
 	if (KMatrix<T>::mat.size() != 1){
 		clear();
-		std::vector<double> temp;
-		KMatrix<T>::mat.push_back(temp);
+		KMatrix<T>::mat.push_back(KMatrix<T>::new_row(0));
+	}
+	KMatrix<T>::mat[0].resize(rv.size());
+	for (size_t i = 0 ; i < rv.size() ; i++){
+		KMatrix<T>::mat[0][i] = T(rv[i]);
 	}
-	KMatrix<T>::mat[0] = (rv);
 	
 	return *this;
 }
@@ -544,13 +558,137 @@ KVector<T>& KVector<T>::operator=(std::vector<double> rv){
 template <class T>
 void KVector<T>::setSize(size_t ns){
 	if (KMatrix<T>::mat.size() < 1){
-		std::vector<double> temp;
-		KMatrix<T>::mat.push_back(temp);
+		KMatrix<T>::mat.push_back(KMatrix<T>::new_row(0));
 	}
 	
 	KMatrix<T>::mat[0].resize(ns);
 }
 
+/*
+ Returns the number of elements the KVector can hold before appending reallocates
+ */
+template <class T>
+size_t KVector<T>::capacity() const{
+	
+	if (KMatrix<T>::mat.size() > 0){
+		return KMatrix<T>::mat[0].capacity();
+	}else{
+		return 0;
+	}
+}
+
+/*
+ Allocates room for at least 'n' elements, so appending up to that length does not
+ reallocate. The size is unchanged.
+ 
+ n - number of elements to make room for
+ 
+ Void return
+ */
+template <class T>
+void KVector<T>::reserve(size_t n){
+	line().reserve(n);
+}
+
+/*
+ Releases capacity beyond the current size.
+ 
+ Void return
+ */
+template <class T>
+void KVector<T>::shrink_to_fit(){
+	
+	if (KMatrix<T>::mat.size() > 0){
+		KMatrix<T>::mat[0].shrink_to_fit();
+	}
+}
+
+/*
+ Appends 'val' to the end of the vector. The capacity doubles whenever it runs out, so a
+ sequence of appends costs amortized constant time per element. Growing moves the elements,
+ which invalidates references to them; a KSegmentedVector never moves them.
+ 
+ val - value to append
+ 
+ Void return
+ */
+template <class T>
+void KVector<T>::push_back(const T& val){
+	line().push_back(val);
+}
+
+/*
+ Constructs an element at the end of the vector from 'args' (see push_back()).
+ 
+ Returns a reference to the new element
+ */
+template <class T>
+template <class... Args>
+T& KVector<T>::emplace_back(Args&&... args){
+	return line().emplace_back(std::forward<Args>(args)...);
+}
+
+/*
+ Appends 'n' elements from 'data' in one copy, growing the capacity geometrically as
+ push_back() does. 'data' may point into this vector.
+ 
+ data - elements to append
+ n - number of elements
+ 
+ Void return
+ */
+template <class T>
+void KVector<T>::append(const T* data, size_t n){
+	
+	if (n == 0) return;
+	
+	typename KMatrix<T>::row_type& row = line();
+	std::less<const T*> before;
+	bool inside = !row.empty() && !before(data, row.data()) && before(data, row.data() + row.size());
+	size_t offset = inside ? (size_t)(data - row.data()) : 0;
+	
+	size_t old = row.size();
+	size_t need = old + n;
+	if (row.capacity() < need){
+		row.reserve((need > 2*row.capacity()) ? need : 2*row.capacity());
+	}
+	
+	//A range insert may not read from the vector itself, so copy after growing it in place
+	if (inside){
+		row.resize(need);
+		std::copy(row.data() + offset, row.data() + offset + n, row.data() + old);
+	}else{
+		row.insert(row.end(), data, data + n);
+	}
+}
+
+/*
+ Appends the elements of 'v' (which may be this vector).
+ 
+ Void return
+ */
+template <class T>
+void KVector<T>::append(const KVector<T>& v){
+	
+	if (v.size() > 0){
+		append(v.mat.read()[0].data(), v.size());
+	}
+}
+
+/*
+ Returns the vector's row for writing, creating it if the vector has none
+ */
+template <class T>
+typename KMatrix<T>::row_type& KVector<T>::line(){
+	
+	std::vector<typename KMatrix<T>::row_type>& m = KMatrix<T>::mat.write();
+	if (m.empty()){
+		m.push_back(KMatrix<T>::new_row(0));
+	}
+	
+	return m[0];
+}
+
 /*
  
  */
@@ -559,4 +697,19 @@ KVector<T> range(T start, T step_size, T end){
 	return KVector<T>(KMatrix<T>::range(start, step_size, end, 1));
 }
 
+/*
+ KVector<int> is not instantiated: KVector(T init, int elements) and KVector(int rows, int cols)
+ have the same signature when T is int.
+ */
+#define KVECTOR_INSTANTIATE(EXTERN, T) \
+	EXTERN template class KVector<T>;
+
+#ifndef KMATRIX_HEADER_ONLY
+KVECTOR_INSTANTIATE(extern, float)
+KVECTOR_INSTANTIATE(extern, double)
+KVECTOR_INSTANTIATE(extern, std::complex<double>)
+KVECTOR_INSTANTIATE(extern, KHalf)
+KVECTOR_INSTANTIATE(extern, KBFloat16)
+#endif
+
 #endif /* KVector_hpp */
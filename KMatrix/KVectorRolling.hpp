@@ -0,0 +1,302 @@
+//
+//  KVectorRolling.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KVectorRolling_hpp
+#define KVectorRolling_hpp
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "KMatrixHelpers.hpp"
+#include "KVector.hpp"
+
+/*
+ Sliding window over the latest 'window()' samples of a stream, held in a ring buffer. Each
+ push_back() replaces the oldest sample once the window is full, and updates the window's
+ statistics in place instead of rescanning it:
+
+ avg(), stdev() - a running mean and sum of squared deviations (Welford's update, applied
+                  as the new sample enters and the oldest leaves), O(1) per sample. Every
+                  time the ring wraps they are recomputed from the window, which costs O(1)
+                  per sample amortized and keeps rounding error from accumulating.
+ max(), min()   - monotonic deques of the samples that can still become the window's
+                  maximum or minimum, amortized O(1) per sample. Values are compared as in
+                  KMatrix (complex values by magnitude).
+
+ The accessors have the same names and meaning as KMatrix's (stdev() is the population
+ standard deviation), but read the maintained values in O(1). Sums are accumulated in
+ kmatrix_solve<T>::type (double for integer types). toKVector() copies the window out, oldest
+ sample first.
+ */
+template <class T>
+class KRollingVector {
+public:
+
+    KRollingVector(size_t window);
+
+    void push_back(const T& val);
+    void append(const T* data, size_t n);
+    void append(const KVector<T>& v);
+    void clear();
+
+    const T& operator[](size_t idx) const;
+    size_t size() const;
+    size_t window() const;
+    bool full() const;
+
+    T max() const;
+    T min() const;
+    T range() const;
+    T avg() const;
+    T stdev() const;
+
+    KVector<T> toKVector() const;
+
+private:
+
+    typedef typename kmatrix_solve<T>::type accum_type;
+
+    const T& at(unsigned long long seq) const;
+    void resync();
+
+    std::vector<T> ring;
+    unsigned long long pushed; //Samples pushed since the last clear(); the newest is pushed-1
+    accum_type mean;
+    accum_type m2; //Sum of squared deviations from the mean
+    std::deque<unsigned long long> max_q; //Sequence numbers, values decreasing from the front
+    std::deque<unsigned long long> min_q; //Sequence numbers, values increasing from the front
+};
+
+/*----------------------------------------------------------------
+------------------------- KROLLINGVECTOR -------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to an empty window. The ring is allocated here, so pushing never allocates
+ (apart from the min/max deques' blocks).
+
+ window - number of latest samples the statistics cover (at least 1)
+ */
+template <class T>
+KRollingVector<T>::KRollingVector(size_t window) : ring((window > 0) ? window : 1), pushed(0), mean(0), m2(0){
+
+}
+
+/*
+ Adds 'val' to the window, dropping the oldest sample if the window is full.
+
+ Void return
+ */
+template <class T>
+void KRollingVector<T>::push_back(const T& val){
+
+    size_t win = ring.size();
+    unsigned long long seq = pushed;
+    accum_type x = accum_type(val);
+
+    if (pushed >= win){
+        accum_type old = accum_type(ring[seq % win]);
+        accum_type prev = mean;
+        mean += (x - old)/accum_type(win);
+        m2 += (x - old)*(x - mean + old - prev);
+    }else{
+        accum_type d = x - mean;
+        mean += d/accum_type(seq + 1);
+        m2 += d*(x - mean);
+    }
+    ring[seq % win] = val;
+    pushed++;
+
+    //Drop the sample that left the window, then every sample the new one outranks
+    while (!max_q.empty() && max_q.front() + win <= seq) max_q.pop_front();
+    while (!min_q.empty() && min_q.front() + win <= seq) min_q.pop_front();
+    while (!max_q.empty() && !kmatrix_greater(at(max_q.back()), val)) max_q.pop_back();
+    while (!min_q.empty() && !kmatrix_greater(val, at(min_q.back()))) min_q.pop_back();
+    max_q.push_back(seq);
+    min_q.push_back(seq);
+
+    if (pushed > win && pushed % win == 0){
+        resync();
+    }
+}
+
+/*
+ Pushes 'n' samples from 'data' in order. Only the last window() of them can remain, so
+ earlier ones are skipped.
+
+ Void return
+ */
+template <class T>
+void KRollingVector<T>::append(const T* data, size_t n){
+
+    if (n >= ring.size()){
+        clear();
+        data += n - ring.size();
+        n = ring.size();
+    }
+
+    for (size_t i = 0 ; i < n ; i++){
+        push_back(data[i]);
+    }
+}
+
+/*
+ Pushes the elements of 'v' in order (see append()).
+
+ Void return
+ */
+template <class T>
+void KRollingVector<T>::append(const KVector<T>& v){
+
+    const std::vector<typename KMatrix<T>::row_type>& m = v.getMat();
+    if (!m.empty()){
+        append(m[0].data(), m[0].size());
+    }
+}
+
+/*
+ Empties the window. The window length is unchanged.
+
+ Void return
+ */
+template <class T>
+void KRollingVector<T>::clear(){
+    pushed = 0;
+    mean = accum_type(0);
+    m2 = accum_type(0);
+    max_q.clear();
+    min_q.clear();
+}
+
+/*
+ Returns sample 'idx' of the window, where 0 is the oldest. Throws matrix_bounds_excep if
+ 'idx' is not less than size().
+ */
+template <class T>
+const T& KRollingVector<T>::operator[](size_t idx) const{
+
+    if (idx >= size()){
+        throw matrix_bounds_excep();
+    }
+
+    return at(pushed - size() + idx);
+}
+
+/*
+ Returns the number of samples in the window: window() once it has filled
+ */
+template <class T>
+size_t KRollingVector<T>::size() const{
+    return (pushed < ring.size()) ? (size_t)pushed : ring.size();
+}
+
+template <class T>
+size_t KRollingVector<T>::window() const{
+    return ring.size();
+}
+
+template <class T>
+bool KRollingVector<T>::full() const{
+    return pushed >= ring.size();
+}
+
+/*
+ Returns the maximum value in the window. If it is empty, returns the type's default
+ initialization value.
+ */
+template <class T>
+T KRollingVector<T>::max() const{
+    return max_q.empty() ? T{} : at(max_q.front());
+}
+
+/*
+ Returns the minimum value in the window. If it is empty, returns the type's default
+ initialization value.
+ */
+template <class T>
+T KRollingVector<T>::min() const{
+    return min_q.empty() ? T{} : at(min_q.front());
+}
+
+/*
+ Returns the range of values in the window (max() - min())
+ */
+template <class T>
+T KRollingVector<T>::range() const{
+    return max() - min();
+}
+
+/*
+ Returns the mean of the window. If it is empty, returns the type's default initialization
+ value.
+ */
+template <class T>
+T KRollingVector<T>::avg() const{
+    return (pushed == 0) ? T{} : T(mean);
+}
+
+/*
+ Returns the population standard deviation of the window. If it is empty, returns the
+ type's default initialization value.
+ */
+template <class T>
+T KRollingVector<T>::stdev() const{
+
+    if (pushed == 0) return T{};
+
+    accum_type var = m2/accum_type(size());
+    if (kmatrix_greater(accum_type(0), var)) var = accum_type(0); //Rounding below zero
+
+    return T(std::sqrt(var));
+}
+
+/*
+ Returns the window as a KVector, oldest sample first
+ */
+template <class T>
+KVector<T> KRollingVector<T>::toKVector() const{
+
+    size_t n = size();
+    size_t start = (size_t)((pushed - n) % ring.size());
+    size_t first = (start + n <= ring.size()) ? n : ring.size() - start;
+
+    KVector<T> out;
+    out.reserve(n);
+    out.append(ring.data() + start, first);
+    out.append(ring.data(), n - first);
+
+    return out;
+}
+
+template <class T>
+const T& KRollingVector<T>::at(unsigned long long seq) const{
+    return ring[seq % ring.size()];
+}
+
+/*
+ Recomputes the mean and sum of squared deviations of the full window from its samples.
+ */
+template <class T>
+void KRollingVector<T>::resync(){
+
+    accum_type sum = accum_type(0);
+    for (size_t i = 0 ; i < ring.size() ; i++){
+        sum += accum_type(ring[i]);
+    }
+    mean = sum/accum_type(ring.size());
+
+    m2 = accum_type(0);
+    for (size_t i = 0 ; i < ring.size() ; i++){
+        accum_type d = accum_type(ring[i]) - mean;
+        m2 += d*d;
+    }
+}
+
+#endif /* KVectorRolling_hpp */
@@ -0,0 +1,365 @@
+//
+//  KVectorSegmented.hpp
+//  KMatrix
+//
+//  Created by Grant Giesbrecht on 10/19/26.
+//  Copyright © 2026 IEGA. All rights reserved.
+//
+
+#ifndef KVectorSegmented_hpp
+#define KVectorSegmented_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "KMatrixAllocator.hpp"
+#include "KMatrixHelpers.hpp"
+#include "KMatrixStorage.hpp"
+#include "KMatrixThreads.hpp"
+#include "KVector.hpp"
+
+//Default segment length of a KSegmentedVector, in elements
+#define KMATRIX_SEGMENT 65536
+
+/*
+ Append-only vector for long streams of samples, stored as fixed-length segments. Where a
+ KVector that runs out of capacity moves every element to a buffer twice the size, a
+ KSegmentedVector leaves full segments where they are and starts a new one. Appending never
+ copies existing elements, references to elements stay valid as the vector grows, and memory
+ for two copies of the stream is never needed at once.
+
+ The segment length is a power of two, so indexing is a shift and a mask. Operations that
+ need contiguous storage take the vector gathered into a KVector by toKVector(), or walk the
+ segments directly with segment() and segmentSize().
+ */
+template <class T>
+class KSegmentedVector {
+public:
+
+    typedef typename KMatrix<T>::row_type segment_type;
+
+    KSegmentedVector(size_t segment = KMATRIX_SEGMENT, KMatrixAllocator<T> alloc = KMatrixAllocator<T>());
+    KSegmentedVector(const KSegmentedVector& other);
+    KSegmentedVector(KSegmentedVector&& other) = default;
+
+    KSegmentedVector& operator=(const KSegmentedVector& other);
+    KSegmentedVector& operator=(KSegmentedVector&& other) = default;
+
+    void push_back(const T& val);
+    template <class... Args>
+    T& emplace_back(Args&&... args);
+    void append(const T* data, size_t n);
+    void append(const KVector<T>& v);
+    void reserve(size_t n);
+    void shrink_to_fit();
+    void clear();
+
+    T& operator[](size_t idx);
+    const T& operator[](size_t idx) const;
+    size_t size() const;
+    size_t capacity() const;
+
+    size_t segmentLength() const;
+    size_t segments() const;
+    const T* segment(size_t idx) const;
+    size_t segmentSize(size_t idx) const;
+
+    KVector<T> toKVector() const;
+
+private:
+
+    segment_type& tail();
+    void copy_segments(const KSegmentedVector& other);
+
+    size_t seg_len;
+    size_t shift;
+    size_t count;
+    KMatrixAllocator<T> alloc;
+    std::vector<segment_type> segs;
+};
+
+/*----------------------------------------------------------------
+------------------------ KSEGMENTEDVECTOR ------------------------
+----------------------------------------------------------------*/
+
+/*
+ Initialize to no elements. Nothing is allocated until the first append.
+
+ segment - elements per segment, rounded up to a power of two
+ alloc - allocator for the segments, eg. a matrix's allocator() to share its alignment and
+         memory policy
+ */
+template <class T>
+KSegmentedVector<T>::KSegmentedVector(size_t segment, KMatrixAllocator<T> alloc) : seg_len(1), shift(0), count(0), alloc(alloc){
+
+    while (seg_len < segment){
+        seg_len <<= 1;
+        shift++;
+    }
+}
+
+/*
+ Initialize to a copy of 'other'. Each segment is allocated at the full segment length, as
+ appending would, so the copy's next append does not move the elements of its last segment.
+ */
+template <class T>
+KSegmentedVector<T>::KSegmentedVector(const KSegmentedVector& other) : seg_len(other.seg_len), shift(other.shift), count(other.count), alloc(other.alloc){
+    copy_segments(other);
+}
+
+/*
+ Replaces the contents with a copy of 'other', including its segment length and allocator
+ (see the copy constructor).
+
+ Returns a reference to this vector
+ */
+template <class T>
+KSegmentedVector<T>& KSegmentedVector<T>::operator=(const KSegmentedVector& other){
+
+    if (this != &other){
+        seg_len = other.seg_len;
+        shift = other.shift;
+        count = other.count;
+        alloc = other.alloc;
+        segs.clear();
+        copy_segments(other);
+    }
+
+    return *this;
+}
+
+/*
+ Appends 'val', starting a new segment if the last one is full. Existing elements never
+ move.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::push_back(const T& val){
+    tail().push_back(val);
+    count++;
+}
+
+/*
+ Constructs an element at the end from 'args' (see push_back()).
+
+ Returns a reference to the new element, which stays valid as the vector grows
+ */
+template <class T>
+template <class... Args>
+T& KSegmentedVector<T>::emplace_back(Args&&... args){
+    T& val = tail().emplace_back(std::forward<Args>(args)...);
+    count++;
+    return val;
+}
+
+/*
+ Appends 'n' contiguous elements from 'data', copying into each segment in one block. Since
+ segments never move, 'data' may lie within one segment of this vector.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::append(const T* data, size_t n){
+
+    while (n > 0){
+        segment_type& seg = tail();
+        size_t take = std::min(n, seg_len - seg.size());
+        seg.insert(seg.end(), data, data + take);
+        count += take;
+        data += take;
+        n -= take;
+    }
+}
+
+/*
+ Appends the elements of 'v'.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::append(const KVector<T>& v){
+
+    const std::vector<segment_type>& m = v.getMat();
+    if (!m.empty()){
+        append(m[0].data(), m[0].size());
+    }
+}
+
+/*
+ Allocates segments until at least 'n' elements fit without allocating. The size is
+ unchanged.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::reserve(size_t n){
+
+    while (capacity() < n){
+        segs.push_back(segment_type(alloc));
+        segs.back().reserve(seg_len);
+    }
+}
+
+/*
+ Frees segments reserved beyond the last element. The last partly filled segment is kept
+ whole, since shrinking it would move its elements.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::shrink_to_fit(){
+
+    size_t used = (count + seg_len - 1) >> shift;
+    segs.resize(used, segment_type(alloc));
+    segs.shrink_to_fit();
+}
+
+/*
+ Removes every element and frees every segment.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::clear(){
+    segs.clear();
+    count = 0;
+}
+
+template <class T>
+T& KSegmentedVector<T>::operator[](size_t idx){
+
+    if (idx >= count){
+        throw matrix_bounds_excep();
+    }
+
+    return segs[idx >> shift][idx & (seg_len - 1)];
+}
+
+template <class T>
+const T& KSegmentedVector<T>::operator[](size_t idx) const{
+
+    if (idx >= count){
+        throw matrix_bounds_excep();
+    }
+
+    return segs[idx >> shift][idx & (seg_len - 1)];
+}
+
+template <class T>
+size_t KSegmentedVector<T>::size() const{
+    return count;
+}
+
+/*
+ Returns the number of elements that fit in the allocated segments
+ */
+template <class T>
+size_t KSegmentedVector<T>::capacity() const{
+    return segs.size()*seg_len;
+}
+
+template <class T>
+size_t KSegmentedVector<T>::segmentLength() const{
+    return seg_len;
+}
+
+/*
+ Returns the number of segments holding elements
+ */
+template <class T>
+size_t KSegmentedVector<T>::segments() const{
+    return (count + seg_len - 1) >> shift;
+}
+
+/*
+ Returns a pointer to the first element of segment 'idx' (elements idx*segmentLength()
+ onward). Throws matrix_bounds_excep if the segment holds no elements.
+ */
+template <class T>
+const T* KSegmentedVector<T>::segment(size_t idx) const{
+
+    if (idx >= segments()){
+        throw matrix_bounds_excep();
+    }
+
+    return segs[idx].data();
+}
+
+/*
+ Returns the number of elements in segment 'idx': segmentLength() for all but the last
+ */
+template <class T>
+size_t KSegmentedVector<T>::segmentSize(size_t idx) const{
+    return (idx < segs.size()) ? segs[idx].size() : 0;
+}
+
+/*
+ Gathers the elements into one contiguous KVector with the segments' alignment and memory
+ policy. Long vectors are copied a segment per task across the thread pool.
+
+ Returns the KVector
+ */
+template <class T>
+KVector<T> KSegmentedVector<T>::toKVector() const{
+
+    KVector<T> out;
+    out.setAlignment(alloc.alignment());
+    out.setMemoryPolicy(alloc.arena() ? alloc.arena()->policy() : (int)KMEM_DEFAULT);
+
+    size_t nseg = segments();
+    if (count < KMATRIX_ELEMENTWISE_PARALLEL){
+        out.reserve(count);
+        for (size_t s = 0 ; s < nseg ; s++){
+            out.append(segs[s].data(), segs[s].size());
+        }
+        return out;
+    }
+
+    out.setSize(count);
+    T* dst = out.getMat()[0].data();
+    KThreadPool::global().parallel_for(0, nseg, [&](size_t lo, size_t hi){
+        for (size_t s = lo ; s < hi ; s++){
+            std::copy(segs[s].begin(), segs[s].end(), dst + (s << shift));
+        }
+    });
+
+    return out;
+}
+
+/*
+ Returns the segment the next element goes in, allocating a new one if every allocated
+ segment is full
+ */
+template <class T>
+typename KSegmentedVector<T>::segment_type& KSegmentedVector<T>::tail(){
+
+    size_t s = count >> shift;
+    if (s == segs.size()){
+        segs.push_back(segment_type(alloc));
+        segs.back().reserve(seg_len);
+    }
+
+    return segs[s];
+}
+
+/*
+ Copies the segments of 'other' that hold elements, each into a new segment of full
+ capacity.
+
+ Void return
+ */
+template <class T>
+void KSegmentedVector<T>::copy_segments(const KSegmentedVector& other){
+
+    size_t nseg = other.segments();
+    segs.reserve(nseg);
+    for (size_t s = 0 ; s < nseg ; s++){
+        segs.push_back(segment_type(alloc));
+        segs.back().reserve(seg_len);
+        segs.back().insert(segs.back().end(), other.segs[s].begin(), other.segs[s].end());
+    }
+}
+
+#endif /* KVectorSegmented_hpp */